@@ -275,6 +275,8 @@ SOURCES += \
     src/xbridge/bitcoinrpcconnector.cpp \
     src/xbridge/xbridgeapp.cpp \
     src/xbridge/xbridgeexchange.cpp \
+    src/xbridge/xbridgeorderbook.cpp \
+    src/xbridge/xbridgeorderhistory.cpp \
     src/xbridge/xbridgesession.cpp \
     src/xbridge/xbridgetransaction.cpp \
     src/xbridge/xbridgetransactiondescr.cpp \
@@ -560,6 +562,8 @@ HEADERS += \
     src/xbridge/version.h \
     src/xbridge/xbridgeapp.h \
     src/xbridge/xbridgeexchange.h \
+    src/xbridge/xbridgeorderbook.h \
+    src/xbridge/xbridgeorderhistory.h \
     src/xbridge/xbridgepacket.h \
     src/xbridge/xbridgesession.h \
     src/xbridge/xbridgetransaction.h \
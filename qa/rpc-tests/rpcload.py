@@ -0,0 +1,151 @@
+#!/usr/bin/env python2
+# Copyright (c) 2018 The Blocknet developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Load test of the asynchronous RPC server: idle keep-alive clients must not
+# starve other callers, pipelined requests are answered in order, and many
+# concurrent keep-alive clients are served without errors.
+#
+# Number of clients and duration can be changed with --clients and --seconds,
+# the sustained request rate is printed at the end.
+#
+
+from test_framework import BitcoinTestFramework
+from util import *
+import base64
+import socket
+import threading
+import time
+
+try:
+    import http.client as httplib
+except ImportError:
+    import httplib
+try:
+    import urllib.parse as urlparse
+except ImportError:
+    import urlparse
+
+class RPCLoadTest (BitcoinTestFramework):
+    def add_options(self, parser):
+        BitcoinTestFramework.add_options(self, parser)
+        parser.add_option("--clients", dest="clients", default=200, type="int",
+                          help="Number of concurrent keep-alive clients (default: %default)")
+        parser.add_option("--seconds", dest="seconds", default=10, type="int",
+                          help="Duration of the load phase (default: %default)")
+
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain_clean(self.options.tmpdir, 1)
+
+    def setup_network(self):
+        self.nodes = start_nodes(1, self.options.tmpdir, extra_args=[[
+            '-rpcthreads=4', '-rpcworkqueue=%d' % (self.options.clients + 16),
+            '-rpcmethodlimit=getchaintips:1']])
+        self.is_network_split = False
+
+    def connect(self):
+        conn = httplib.HTTPConnection(self.url.hostname, self.url.port)
+        conn.connect()
+        return conn
+
+    def call(self, conn, method):
+        conn.request('POST', '/', '{"method": "%s"}' % method, self.headers)
+        return conn.getresponse().read()
+
+    def run_test(self):
+        self.url = urlparse.urlparse(self.nodes[0].url)
+        authpair = self.url.username + ':' + self.url.password
+        self.headers = {"Authorization": "Basic " + base64.b64encode(authpair)}
+
+        #####################################################
+        # idle keep-alive connections do not hold a thread  #
+        #####################################################
+        idle = []
+        for i in range(16):
+            conn = self.connect()
+            assert_equal('"error":null' in self.call(conn, 'getblockcount'), True)
+            idle.append(conn)
+
+        conn = self.connect()
+        assert_equal('"error":null' in self.call(conn, 'getbestblockhash'), True)
+        conn.close()
+        for conn in idle:
+            conn.close()
+
+        #####################################################
+        # pipelined requests are answered in order          #
+        #####################################################
+        request = ('POST / HTTP/1.1\r\n'
+                   'Authorization: %s\r\n'
+                   'Content-Length: %d\r\n'
+                   '\r\n%s')
+        body1 = '{"method": "getblockcount", "id": 1}'
+        body2 = '{"method": "getbestblockhash", "id": 2}'
+        sock = socket.create_connection((self.url.hostname, self.url.port))
+        sock.sendall(request % (self.headers["Authorization"], len(body1), body1) +
+                     request % (self.headers["Authorization"], len(body2), body2))
+        data = ''
+        while data.count('"id":') < 2:
+            chunk = sock.recv(4096)
+            assert_equal(len(chunk) > 0, True)
+            data += chunk
+        sock.close()
+        assert_equal(data.find('"id":1') < data.find('"id":2'), True)
+
+        #####################################################
+        # sustained load from many keep-alive clients       #
+        #####################################################
+        results = []
+        lock = threading.Lock()
+        start = threading.Event()
+        deadline = [0]
+
+        def client():
+            ok, failed = 0, 0
+            try:
+                conn = self.connect()
+                start.wait()
+                while time.time() < deadline[0]:
+                    if '"error":null' in self.call(conn, 'getblockcount'):
+                        ok += 1
+                    else:
+                        failed += 1
+                conn.close()
+            except Exception as e:
+                print("client error: %s" % e)
+                failed += 1
+            with lock:
+                results.append((ok, failed))
+
+        threads = [threading.Thread(target=client) for i in range(self.options.clients)]
+        for t in threads:
+            t.start()
+        begin = time.time()
+        deadline[0] = begin + self.options.seconds
+        start.set()
+        for t in threads:
+            t.join()
+        elapsed = time.time() - begin
+
+        total = sum(r[0] for r in results)
+        failed = sum(r[1] for r in results)
+        print("%d clients: %d requests in %.1fs, %.0f req/s, %d failed" %
+              (self.options.clients, total, elapsed, total / elapsed, failed))
+        assert_equal(failed, 0)
+        assert_equal(total > 0, True)
+
+        #####################################################
+        # queue metrics                                     #
+        #####################################################
+        self.nodes[0].getchaintips()
+        info = self.nodes[0].getrpcinfo()
+        assert_equal(info['threads'], 4)
+        assert_equal(info['rejected'], 0)
+        assert_equal(info['methods']['getblockcount']['calls'] >= total, True)
+        assert_equal(info['methods']['getchaintips']['limit'], 1)
+
+if __name__ == '__main__':
+    RPCLoadTest ().main ()
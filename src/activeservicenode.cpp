@@ -32,7 +32,7 @@ void CActiveServicenode::ManageStatus()
     if (status == ACTIVE_SERVICENODE_SYNC_IN_PROCESS) status = ACTIVE_SERVICENODE_INITIAL;
 
     if (status == ACTIVE_SERVICENODE_INITIAL) {
-        CServicenode* pmn;
+        CServicenodePtr pmn;
         pmn = mnodeman.Find(pubKeyServicenode);
         if (pmn != NULL) {
             pmn->Check();
@@ -182,7 +182,7 @@ bool CActiveServicenode::SendServicenodePing(std::string& errorMessage, bool for
     }
 
     // Update lastPing for our servicenode in Servicenode list
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
     if (pmn != NULL) {
         // If we have a force send ping request, skip the time check here
         if (!force && pmn->IsPingedWithin(SERVICENODE_PING_SECONDS, mnp.sigTime)) {
@@ -322,7 +322,7 @@ bool CActiveServicenode::Register(CTxIn vin, CService service, CKey keyCollatera
     mnodeman.mapSeenServicenodeBroadcast.insert(make_pair(mnb.GetHash(), mnb));
     servicenodeSync.AddedServicenodeList(mnb.GetHash());
 
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
     if (pmn == NULL) {
         CServicenode mn(mnb);
         mnodeman.Add(mn);
@@ -513,7 +513,7 @@ bool CActiveServicenode::EnableHotColdServiceNode(CTxIn& newVin, CService& newSe
     service = newService;
 
     // update xbridge info for my servicenode
-    CServicenode * mn = mnodeman.Find(vin);
+    CServicenodePtr mn = mnodeman.Find(vin);
     if (mn)
     {
         xbridge::Exchange & e = xbridge::Exchange::instance();
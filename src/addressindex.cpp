@@ -0,0 +1,61 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+
+#include "pubkey.h"
+
+bool GetAddressIndexKey(const CScript& script, int& type, uint160& hashBytes)
+{
+    // Byte patterns instead of Solver(): this runs for every input and output
+    // while the index is built
+    if (script.IsPayToScriptHash()) {
+        type = ADDRESS_INDEX_SCRIPTHASH;
+        hashBytes = uint160(&script[2], 20);
+        return true;
+    }
+    if (script.size() == 25 && script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 &&
+        script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG) {
+        type = ADDRESS_INDEX_PUBKEYHASH;
+        hashBytes = uint160(&script[3], 20);
+        return true;
+    }
+    // Pay-to-pubkey, as used by coinstake and early coinbase outputs
+    if ((script.size() == 35 || script.size() == 67) && script[0] == script.size() - 2 &&
+        script[script.size() - 1] == OP_CHECKSIG) {
+        CPubKey pubkey(script.begin() + 1, script.end() - 1);
+        if (!pubkey.IsValid())
+            return false;
+        type = ADDRESS_INDEX_PUBKEYHASH;
+        hashBytes = pubkey.GetID();
+        return true;
+    }
+    return false;
+}
+
+bool GetAddressIndexKey(const CTxDestination& dest, int& type, uint160& hashBytes)
+{
+    if (const CKeyID* keyID = boost::get<CKeyID>(&dest)) {
+        type = ADDRESS_INDEX_PUBKEYHASH;
+        hashBytes = *keyID;
+        return true;
+    }
+    if (const CScriptID* scriptID = boost::get<CScriptID>(&dest)) {
+        type = ADDRESS_INDEX_SCRIPTHASH;
+        hashBytes = *scriptID;
+        return true;
+    }
+    return false;
+}
+
+CTxDestination GetAddressIndexDestination(int type, const uint160& hashBytes)
+{
+    switch (type) {
+    case ADDRESS_INDEX_PUBKEYHASH:
+        return CKeyID(hashBytes);
+    case ADDRESS_INDEX_SCRIPTHASH:
+        return CScriptID(hashBytes);
+    }
+    return CNoDestination();
+}
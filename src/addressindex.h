@@ -0,0 +1,296 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_ADDRESSINDEX_H
+#define BITCOIN_ADDRESSINDEX_H
+
+#include "amount.h"
+#include "compat/endian.h"
+#include "script/script.h"
+#include "script/standard.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <stdint.h>
+
+/**
+ * Optional indexes kept in the block tree database (blocks/index/) next to
+ * the transaction index:
+ *
+ * - the address index ('a') lists every output paying an address and every
+ *   input spending one, ordered by address, height and position in the block;
+ * - the address unspent index ('u') lists the unspent outputs of an address;
+ * - the spent index ('p') tells which input spent an output.
+ *
+ * Heights and transaction positions are stored big-endian so that LevelDB
+ * returns the entries of an address in chain order and height ranges can be
+ * read with a single seek.
+ */
+
+//! Address types in the index; they select the base58 prefix of the address
+enum AddressIndexType {
+    ADDRESS_INDEX_NONE = 0,
+    ADDRESS_INDEX_PUBKEYHASH = 1,
+    ADDRESS_INDEX_SCRIPTHASH = 2,
+};
+
+/** Get the address an output script pays, as indexed. Pay-to-pubkey outputs are indexed under the key's address. */
+bool GetAddressIndexKey(const CScript& script, int& type, uint160& hashBytes);
+/** Get the indexed form of an address, false for destinations the index does not track. */
+bool GetAddressIndexKey(const CTxDestination& dest, int& type, uint160& hashBytes);
+/** Inverse of GetAddressIndexKey. */
+CTxDestination GetAddressIndexDestination(int type, const uint160& hashBytes);
+
+template <typename Stream>
+inline void SerializeIndexBE32(Stream& s, uint32_t n)
+{
+    n = htobe32(n);
+    WRITEDATA(s, n);
+}
+
+template <typename Stream>
+inline uint32_t UnserializeIndexBE32(Stream& s)
+{
+    uint32_t n;
+    READDATA(s, n);
+    return be32toh(n);
+}
+
+/** An output paying, or an input spending, an address. The value is the amount, negative for spends. */
+struct CAddressIndexKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+    unsigned int txindex;
+    uint256 txhash;
+    unsigned int index;
+    bool spending;
+
+    CAddressIndexKey() { SetNull(); }
+
+    CAddressIndexKey(int typeIn, const uint160& hashBytesIn, int blockHeightIn, unsigned int txindexIn,
+        const uint256& txhashIn, unsigned int indexIn, bool spendingIn)
+        : type(typeIn), hashBytes(hashBytesIn), blockHeight(blockHeightIn), txindex(txindexIn),
+          txhash(txhashIn), index(indexIn), spending(spendingIn)
+    {
+    }
+
+    void SetNull()
+    {
+        type = ADDRESS_INDEX_NONE;
+        hashBytes = 0;
+        blockHeight = 0;
+        txindex = 0;
+        txhash = 0;
+        index = 0;
+        spending = false;
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 66;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        WRITEDATA(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        SerializeIndexBE32(s, blockHeight);
+        SerializeIndexBE32(s, txindex);
+        txhash.Serialize(s, nType, nVersion);
+        WRITEDATA(s, index);
+        char f = spending;
+        WRITEDATA(s, f);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        READDATA(s, type);
+        hashBytes.Unserialize(s, nType, nVersion);
+        blockHeight = UnserializeIndexBE32(s);
+        txindex = UnserializeIndexBE32(s);
+        txhash.Unserialize(s, nType, nVersion);
+        READDATA(s, index);
+        char f;
+        READDATA(s, f);
+        spending = f;
+    }
+};
+
+/** Prefix of the address index entries of an address, optionally from a height on. */
+struct CAddressIndexIteratorKey {
+    unsigned char type;
+    uint160 hashBytes;
+    int blockHeight;
+    bool fHeight;
+
+    CAddressIndexIteratorKey(int typeIn, const uint160& hashBytesIn)
+        : type(typeIn), hashBytes(hashBytesIn), blockHeight(0), fHeight(false) {}
+
+    CAddressIndexIteratorKey(int typeIn, const uint160& hashBytesIn, int blockHeightIn)
+        : type(typeIn), hashBytes(hashBytesIn), blockHeight(blockHeightIn), fHeight(true) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return fHeight ? 25 : 21;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        WRITEDATA(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        if (fHeight)
+            SerializeIndexBE32(s, blockHeight);
+    }
+};
+
+/** An unspent output of an address. */
+struct CAddressUnspentKey {
+    unsigned char type;
+    uint160 hashBytes;
+    uint256 txhash;
+    unsigned int index;
+
+    CAddressUnspentKey() { SetNull(); }
+
+    CAddressUnspentKey(int typeIn, const uint160& hashBytesIn, const uint256& txhashIn, unsigned int indexIn)
+        : type(typeIn), hashBytes(hashBytesIn), txhash(txhashIn), index(indexIn) {}
+
+    void SetNull()
+    {
+        type = ADDRESS_INDEX_NONE;
+        hashBytes = 0;
+        txhash = 0;
+        index = 0;
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 57;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        WRITEDATA(s, type);
+        hashBytes.Serialize(s, nType, nVersion);
+        txhash.Serialize(s, nType, nVersion);
+        WRITEDATA(s, index);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        READDATA(s, type);
+        hashBytes.Unserialize(s, nType, nVersion);
+        txhash.Unserialize(s, nType, nVersion);
+        READDATA(s, index);
+    }
+};
+
+/** The output behind a CAddressUnspentKey; a null value erases the entry. */
+struct CAddressUnspentValue {
+    CAmount satoshis;
+    CScript script;
+    int blockHeight;
+
+    CAddressUnspentValue() { SetNull(); }
+
+    CAddressUnspentValue(CAmount satoshisIn, const CScript& scriptIn, int blockHeightIn)
+        : satoshis(satoshisIn), script(scriptIn), blockHeight(blockHeightIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(satoshis);
+        READWRITE(script);
+        READWRITE(blockHeight);
+    }
+
+    void SetNull()
+    {
+        satoshis = -1;
+        script.clear();
+        blockHeight = 0;
+    }
+
+    bool IsNull() const { return satoshis == -1; }
+};
+
+/** An output that has been spent. */
+struct CSpentIndexKey {
+    uint256 txid;
+    unsigned int outputIndex;
+
+    CSpentIndexKey() { SetNull(); }
+
+    CSpentIndexKey(const uint256& txidIn, unsigned int outputIndexIn)
+        : txid(txidIn), outputIndex(outputIndexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(outputIndex);
+    }
+
+    void SetNull()
+    {
+        txid = 0;
+        outputIndex = 0;
+    }
+};
+
+/** The input that spent a CSpentIndexKey; a null value erases the entry. */
+struct CSpentIndexValue {
+    uint256 txid;
+    unsigned int inputIndex;
+    int blockHeight;
+    CAmount satoshis;
+    int addressType;
+    uint160 addressHash;
+
+    CSpentIndexValue() { SetNull(); }
+
+    CSpentIndexValue(const uint256& txidIn, unsigned int inputIndexIn, int blockHeightIn, CAmount satoshisIn,
+        int addressTypeIn, const uint160& addressHashIn)
+        : txid(txidIn), inputIndex(inputIndexIn), blockHeight(blockHeightIn), satoshis(satoshisIn),
+          addressType(addressTypeIn), addressHash(addressHashIn)
+    {
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(txid);
+        READWRITE(inputIndex);
+        READWRITE(blockHeight);
+        READWRITE(satoshis);
+        READWRITE(addressType);
+        READWRITE(addressHash);
+    }
+
+    void SetNull()
+    {
+        txid = 0;
+        inputIndex = 0;
+        blockHeight = 0;
+        satoshis = 0;
+        addressType = ADDRESS_INDEX_NONE;
+        addressHash = 0;
+    }
+
+    bool IsNull() const { return txid == 0; }
+};
+
+#endif // BITCOIN_ADDRESSINDEX_H
@@ -131,8 +131,8 @@ bool CAlert::RelayTo(CNode* pnode) const
     // don't relay to nodes which haven't sent their version message
     if (pnode->nVersion == 0)
         return false;
-    // returns true if wasn't already contained in the set
-    if (pnode->setKnown.insert(GetHash()).second) {
+    // relay only if wasn't already known by the node
+    if (pnode->AddKnownMessage(GetHash())) {
         if (AppliesTo(pnode->nVersion, pnode->strSubVer) ||
             AppliesToMe() ||
             GetAdjustedTime() < nRelayUntil) {
@@ -0,0 +1,98 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "addressindex.h"
+#include "primitives/transaction.h"
+#include "random.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <vector>
+
+static const int BLOCK_TXS = 1000;
+static const int ADDRESSES = 500;
+
+/** A block of transactions with two inputs and two outputs, and the outputs they spend. */
+struct CIndexCorpus {
+    std::vector<CTransaction> vtx;
+    std::vector<std::vector<CTxOut> > vSpent;
+
+    CIndexCorpus()
+    {
+        std::vector<CScript> vScripts;
+        for (int i = 0; i < ADDRESSES; i++)
+            vScripts.push_back(GetScriptForDestination(CKeyID(uint160(GetRandHash().GetLow64()))));
+        for (int i = 0; i < BLOCK_TXS; i++) {
+            CMutableTransaction tx;
+            std::vector<CTxOut> vOut;
+            for (int j = 0; j < 2; j++) {
+                tx.vin.push_back(CTxIn(COutPoint(GetRandHash(), j)));
+                vOut.push_back(CTxOut(GetRand(100 * COIN), vScripts[GetRand(ADDRESSES)]));
+                tx.vout.push_back(CTxOut(GetRand(100 * COIN), vScripts[GetRand(ADDRESSES)]));
+            }
+            vtx.push_back(tx);
+            vSpent.push_back(vOut);
+        }
+    }
+};
+
+/** The address index work ConnectBlock adds for each block while reindexing. */
+static void AddressIndexConnect(benchmark::State& state)
+{
+    CIndexCorpus corpus;
+    CBlockTreeDB db(1 << 23, true);
+    int nHeight = 0;
+
+    state.SetItemsPerIteration(BLOCK_TXS);
+    while (state.KeepRunning()) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+        nHeight++;
+        for (unsigned int i = 0; i < corpus.vtx.size(); i++) {
+            const CTransaction& tx = corpus.vtx[i];
+            const uint256 txhash = tx.GetHash();
+            int nType;
+            uint160 hashBytes;
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const CTxOut& out = corpus.vSpent[i][j];
+                if (!GetAddressIndexKey(out.scriptPubKey, nType, hashBytes))
+                    continue;
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(nType, hashBytes, nHeight, i, txhash, j, true), -out.nValue));
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nType, hashBytes, tx.vin[j].prevout.hash, tx.vin[j].prevout.n), CAddressUnspentValue()));
+            }
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                if (!GetAddressIndexKey(out.scriptPubKey, nType, hashBytes))
+                    continue;
+                addressIndex.push_back(std::make_pair(CAddressIndexKey(nType, hashBytes, nHeight, i, txhash, k, false), out.nValue));
+                addressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, nHeight)));
+            }
+        }
+        db.WriteAddressIndex(addressIndex);
+        db.UpdateAddressUnspentIndex(addressUnspentIndex);
+    }
+}
+
+/** Reading the history of one address, as getaddresstxids does. */
+static void AddressIndexRead(benchmark::State& state)
+{
+    CBlockTreeDB db(1 << 23, true);
+    uint160 hashBytes = uint160(GetRandHash().GetLow64());
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    for (int i = 0; i < 10000; i++)
+        addressIndex.push_back(std::make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashBytes, i, 1, GetRandHash(), 0, false), COIN));
+    db.WriteAddressIndex(addressIndex);
+
+    state.SetItemsPerIteration(addressIndex.size());
+    while (state.KeepRunning()) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > vRead;
+        db.ReadAddressIndex(hashBytes, ADDRESS_INDEX_PUBKEYHASH, vRead);
+        assert(vRead.size() == addressIndex.size());
+    }
+}
+
+BENCHMARK(AddressIndexConnect);
+BENCHMARK(AddressIndexRead);
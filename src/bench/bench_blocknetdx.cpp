@@ -0,0 +1,20 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "util.h"
+
+int main(int argc, char** argv)
+{
+    SetupEnvironment();
+    fPrintToDebugLog = false; // don't want to write to debug.log file
+    SelectParams(CBaseChainParams::UNITTEST);
+    // In-memory databases still resolve a path in the data directory
+    mapArgs["-datadir"] = GetTempPath().string();
+
+    benchmark::BenchRunner::RunAll();
+}
@@ -0,0 +1,43 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "logwriter.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/filesystem/operations.hpp>
+
+static const int LINES_PER_ITERATION = 1000;
+
+/** Time spent by the callers writing lines, which is what a logging thread waits for. */
+static void LogWriterLines(benchmark::State& state, bool fAsync)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("bench_logwriter_%d.log", GetTimeMicros());
+    const std::string strLine = "CMasternodeMan::ProcessMessage -- mnp - Masternode ping, masternode=0123456789abcdef\n";
+    {
+        CLogWriter writer(path, fAsync);
+        state.SetItemsPerIteration(LINES_PER_ITERATION);
+        while (state.KeepRunning()) {
+            for (int i = 0; i < LINES_PER_ITERATION; i++)
+                writer.Write(strLine, GetTime());
+        }
+        writer.Flush();
+    }
+    boost::filesystem::remove(path);
+}
+
+static void LogWriterSync(benchmark::State& state)
+{
+    LogWriterLines(state, false);
+}
+
+static void LogWriterAsync(benchmark::State& state)
+{
+    LogWriterLines(state, true);
+}
+
+BENCHMARK(LogWriterSync);
+BENCHMARK(LogWriterAsync);
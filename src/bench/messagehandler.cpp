@@ -0,0 +1,81 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "main.h"
+#include "net.h"
+#include "version.h"
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+static const int PEERS = 64;
+static const int MESSAGES_PER_PEER = 32;
+
+/** Process the queued messages of the peers whose id modulo the thread count is nThread, as ThreadMessageHandler does. */
+static void HandlePeers(const std::vector<CNode*>& vPeers, int nThread, int nThreads)
+{
+    BOOST_FOREACH (CNode* pnode, vPeers) {
+        if (pnode->id % nThreads != nThread)
+            continue;
+        LOCK(pnode->cs_vRecvMsg);
+        while (!pnode->vRecvMsg.empty())
+            ProcessMessages(pnode);
+    }
+}
+
+/**
+ * PEERS synthetic peers each with MESSAGES_PER_PEER queued messages handled by
+ * nThreads threads. Half of the messages are pong, which runs without cs_main,
+ * the other half mempool, which takes cs_main.
+ */
+static void MessageHandlerPeers(benchmark::State& state, int nThreads)
+{
+    nMessageHandlerThreads = nThreads;
+    std::vector<CNode*> vPeers;
+    for (int i = 0; i < PEERS; i++) {
+        CNode* pnode = new CNode(INVALID_SOCKET, CAddress(), "", true);
+        pnode->nVersion = PROTOCOL_VERSION;
+        pnode->SetRecvVersion(PROTOCOL_VERSION);
+        vPeers.push_back(pnode);
+    }
+    uint64_t nonce = 0;
+    CSerializeDataPtr pong = CNode::MakeMessage("pong", (const char*)&nonce, sizeof(nonce));
+    CSerializeDataPtr mempoolRequest = CNode::MakeMessage("mempool", NULL, 0);
+
+    state.SetItemsPerIteration(PEERS * MESSAGES_PER_PEER);
+    while (state.KeepRunning()) {
+        BOOST_FOREACH (CNode* pnode, vPeers) {
+            for (int i = 0; i < MESSAGES_PER_PEER; i++) {
+                const CSerializeData& msg = i % 2 ? *mempoolRequest : *pong;
+                pnode->ReceiveMsgBytes(&msg[0], msg.size());
+            }
+        }
+
+        boost::thread_group threads;
+        for (int i = 1; i < nThreads; i++)
+            threads.create_thread(boost::bind(&HandlePeers, boost::cref(vPeers), i, nThreads));
+        HandlePeers(vPeers, 0, nThreads);
+        threads.join_all();
+    }
+
+    BOOST_FOREACH (CNode* pnode, vPeers)
+        delete pnode;
+    nMessageHandlerThreads = DEFAULT_MESSAGE_HANDLER_THREADS;
+}
+
+static void MessageHandlerThreads1(benchmark::State& state)
+{
+    MessageHandlerPeers(state, 1);
+}
+
+static void MessageHandlerThreads4(benchmark::State& state)
+{
+    MessageHandlerPeers(state, 4);
+}
+
+BENCHMARK(MessageHandlerThreads1);
+BENCHMARK(MessageHandlerThreads4);
@@ -0,0 +1,136 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "crypto/quark.h"
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "utilstrencodings.h"
+
+#include <iostream>
+#include <vector>
+
+static const size_t HEADER_SIZE = 80;
+static const size_t CORPUS_SIZE = 4096;
+
+#define QUARK_STEP(algo, in, out)          \
+    {                                      \
+        sph_##algo##_context ctx;          \
+        sph_##algo##_init(&ctx);           \
+        sph_##algo(&ctx, in, 64);          \
+        sph_##algo##_close(&ctx, out);     \
+    }
+
+/** The sphlib chain HashQuark used before the vectorized engine. */
+static void QuarkReference(unsigned char* output, const unsigned char* input, size_t len)
+{
+    unsigned char hash[9][64];
+    sph_blake512_context ctx;
+    sph_blake512_init(&ctx);
+    sph_blake512(&ctx, input, len);
+    sph_blake512_close(&ctx, hash[0]);
+    QUARK_STEP(bmw512, hash[0], hash[1]);
+    if (hash[1][0] & 8)
+        QUARK_STEP(groestl512, hash[1], hash[2])
+    else
+        QUARK_STEP(skein512, hash[1], hash[2])
+    QUARK_STEP(groestl512, hash[2], hash[3]);
+    QUARK_STEP(jh512, hash[3], hash[4]);
+    if (hash[4][0] & 8)
+        QUARK_STEP(blake512, hash[4], hash[5])
+    else
+        QUARK_STEP(bmw512, hash[4], hash[5])
+    QUARK_STEP(keccak512, hash[5], hash[6]);
+    QUARK_STEP(skein512, hash[6], hash[7]);
+    if (hash[7][0] & 8)
+        QUARK_STEP(keccak512, hash[7], hash[8])
+    else
+        QUARK_STEP(jh512, hash[7], hash[8])
+    memcpy(output, hash[8], 32);
+}
+
+#undef QUARK_STEP
+
+/**
+ * Serialized headers of a chain built on the main network genesis block: each
+ * links to the hash of the previous one, one minute apart, with random merkle
+ * roots and nonces. The headers take the Quark branches as real ones do.
+ */
+static const std::vector<unsigned char>& HeaderCorpus()
+{
+    static std::vector<unsigned char> corpus;
+    if (!corpus.empty())
+        return corpus;
+
+    CBlockHeader header;
+    header.nVersion = 1;
+    header.hashMerkleRoot.SetHex("b1f0e93f6df55af4c23a0719ab33be2b8115e2b6127fc1d926a06c60a8b56bf2");
+    header.nTime = 1502214073;
+    header.nBits = 0x1e0fffff;
+    header.nNonce = 734967;
+
+    corpus.resize(CORPUS_SIZE * HEADER_SIZE);
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+        memcpy(&corpus[i * HEADER_SIZE], BEGIN(header.nVersion), HEADER_SIZE);
+        header.nVersion = 3;
+        QuarkReference(header.hashPrevBlock.begin(), &corpus[i * HEADER_SIZE], HEADER_SIZE);
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime += 60;
+        header.nNonce = insecure_rand();
+    }
+
+    // The first header is the genesis block
+    uint256 hashGenesis;
+    QuarkHash(hashGenesis.begin(), &corpus[0], HEADER_SIZE);
+    if (hashGenesis != uint256("0x00000eb7919102da5a07dc90905651664e6ebf0811c28f06573b9a0fd84ab7b8"))
+        std::cerr << "quark: unexpected genesis hash " << hashGenesis.ToString() << "\n";
+    std::cerr << "quark: " << QuarkImplementation() << "\n";
+    return corpus;
+}
+
+// Before: the sphlib primitives, one header at a time
+static void QuarkHeadersReference(benchmark::State& state)
+{
+    const std::vector<unsigned char>& corpus = HeaderCorpus();
+    std::vector<unsigned char> out(CORPUS_SIZE * 32);
+    state.SetItemsPerIteration(CORPUS_SIZE);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < CORPUS_SIZE; i++)
+            QuarkReference(&out[i * 32], &corpus[i * HEADER_SIZE], HEADER_SIZE);
+    }
+}
+
+// HashQuark: the vectorized primitives, one header at a time
+static void QuarkHeadersSingle(benchmark::State& state)
+{
+    const std::vector<unsigned char>& corpus = HeaderCorpus();
+    std::vector<unsigned char> out(CORPUS_SIZE * 32);
+    state.SetItemsPerIteration(CORPUS_SIZE);
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < CORPUS_SIZE; i++)
+            QuarkHash(&out[i * 32], &corpus[i * HEADER_SIZE], HEADER_SIZE);
+    }
+}
+
+// Loading the block index: the whole corpus at once, several headers per vector
+static void QuarkHeadersMulti(benchmark::State& state)
+{
+    const std::vector<unsigned char>& corpus = HeaderCorpus();
+    std::vector<unsigned char> out(CORPUS_SIZE * 32);
+    state.SetItemsPerIteration(CORPUS_SIZE);
+    while (state.KeepRunning()) {
+        QuarkHashMulti(&out[0], &corpus[0], HEADER_SIZE, CORPUS_SIZE);
+    }
+}
+
+BENCHMARK(QuarkHeadersReference);
+BENCHMARK(QuarkHeadersSingle);
+BENCHMARK(QuarkHeadersMulti);
@@ -0,0 +1,95 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "net.h"
+#include "random.h"
+#include "util.h"
+
+#include <vector>
+
+#ifndef WIN32
+#include <sys/socket.h>
+
+// Peers that send a message in each wakeup, the others stay idle
+static const int ACTIVE_PEERS = 8;
+
+/**
+ * One ThreadSocketHandler wakeup with nPeers connected over socketpairs, of
+ * which ACTIVE_PEERS have a message to read, as with mostly idle peers.
+ */
+static void SocketHandlerWakeup(benchmark::State& state, int nPeers, bool fEpoll)
+{
+    mapArgs["-useepoll"] = fEpoll ? "1" : "0";
+    StartSocketEvents();
+
+    std::vector<SOCKET> vRemote;
+    {
+        LOCK(cs_vNodes);
+        for (int i = 0; i < nPeers; i++) {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+                break;
+            SOCKET hSocket = fds[0];
+            SetSocketNonBlocking(hSocket, true);
+            CNode* pnode = new CNode(hSocket, CAddress(), "", true);
+            pnode->nLastSend = pnode->nLastRecv = GetTime();
+            vNodes.push_back(pnode);
+            vRemote.push_back(fds[1]);
+        }
+    }
+    CSerializeDataPtr msg = CNode::MakeMessage("verack", NULL, 0);
+
+    state.SetItemsPerIteration(ACTIVE_PEERS);
+    while (state.KeepRunning()) {
+        for (int i = 0; i < ACTIVE_PEERS; i++)
+            send(vRemote[GetRand(vRemote.size())], &(*msg)[0], msg->size(), MSG_NOSIGNAL);
+        SocketHandlerWait();
+
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes) {
+            LOCK(pnode->cs_vRecvMsg);
+            pnode->vRecvMsg.clear();
+        }
+    }
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes)
+            delete pnode;
+        vNodes.clear();
+    }
+    BOOST_FOREACH (SOCKET hSocket, vRemote)
+        CloseSocket(hSocket);
+    StopSocketEvents();
+    mapArgs.erase("-useepoll");
+}
+
+static void SocketHandlerSelect100(benchmark::State& state)
+{
+    SocketHandlerWakeup(state, 100, false);
+}
+
+static void SocketHandlerEpoll100(benchmark::State& state)
+{
+    SocketHandlerWakeup(state, 100, true);
+}
+
+// select() is limited to FD_SETSIZE descriptors, both ends of each pair are open here
+static void SocketHandlerSelect400(benchmark::State& state)
+{
+    SocketHandlerWakeup(state, 400, false);
+}
+
+static void SocketHandlerEpoll400(benchmark::State& state)
+{
+    SocketHandlerWakeup(state, 400, true);
+}
+
+BENCHMARK(SocketHandlerSelect100);
+BENCHMARK(SocketHandlerEpoll100);
+BENCHMARK(SocketHandlerSelect400);
+BENCHMARK(SocketHandlerEpoll400);
+#endif
@@ -0,0 +1,56 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "kernel.h"
+#include "random.h"
+
+#include <vector>
+
+#include <boost/thread.hpp>
+
+static const int STAKE_COINS = 256;
+static const unsigned int STAKE_HASH_DRIFT = 45;
+
+/** One SearchStakeKernel() attempt over a wallet of coins that never meet the target. */
+static void StakeKernelSearch(benchmark::State& state, int nThreads)
+{
+    std::vector<CStakeKernelWork> vWork(STAKE_COINS);
+    for (int n = 0; n < STAKE_COINS; n++) {
+        vWork[n].nCandidate = n;
+        GetRandBytes(vWork[n].prefix, KERNEL_PREFIX_SIZE);
+        vWork[n].bnTarget = 0;
+    }
+
+    boost::thread_group threads;
+    nStakeKernelThreads = nThreads;
+    for (int i = 0; i < nThreads - 1; i++)
+        threads.create_thread(&ThreadStakeKernelSearch);
+
+    state.SetItemsPerIteration(STAKE_COINS * STAKE_HASH_DRIFT);
+    while (state.KeepRunning()) {
+        unsigned int nTimeTx = 1500000000;
+        uint256 hashProofOfStake;
+        uint64_t nHashes = 0;
+        SearchStakeKernelWork(vWork, 0, nTimeTx, STAKE_HASH_DRIFT, hashProofOfStake, nHashes);
+    }
+
+    threads.interrupt_all();
+    threads.join_all();
+    nStakeKernelThreads = 0;
+}
+
+static void StakeKernelSearchSingle(benchmark::State& state)
+{
+    StakeKernelSearch(state, 1);
+}
+
+static void StakeKernelSearchThreads(benchmark::State& state)
+{
+    StakeKernelSearch(state, std::max(2, (int)boost::thread::hardware_concurrency()));
+}
+
+BENCHMARK(StakeKernelSearchSingle);
+BENCHMARK(StakeKernelSearchThreads);
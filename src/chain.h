@@ -269,6 +269,8 @@ public:
         block.nTime = nTime;
         block.nBits = nBits;
         block.nNonce = nNonce;
+        if (phashBlock && (pprev || nHeight == 0))
+            block.SetCachedHash(*phashBlock);
         return block;
     }
 
@@ -5,9 +5,13 @@
 #include "coins.h"
 
 #include "random.h"
+#include "util.h"
 
 #include <assert.h>
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 /**
  * calculate number of bytes for the bitmask, and its number of non-zero bytes
  * each bit in the bitmask represents the availability of one output, but the
@@ -40,6 +44,8 @@ bool CCoins::Spend(const COutPoint& out, CTxInUndo& undo)
         return false;
     undo = CTxInUndo(vout[out.n]);
     vout[out.n].SetNull();
+    // clear() keeps the script buffer, release it as spent outputs stay cached
+    CScript().swap(vout[out.n].scriptPubKey);
     Cleanup();
     if (vout.size() == 0) {
         undo.nHeight = nHeight;
@@ -75,11 +81,17 @@ bool CCoinsViewBacked::GetStats(CCoinsStats& stats) const { return base->GetStat
 
 CCoinsKeyHasher::CCoinsKeyHasher() : salt(GetRandHash()) {}
 
-CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn) : CCoinsViewBacked(baseIn), hasModifier(false) {}
+CCoinsViewCache::CCoinsViewCache(CCoinsView* baseIn) : CCoinsViewBacked(baseIn), hasModifier(false), cachedCoinsUsage(0), pcacheWrite(NULL), cacheWriteUsage(0), pthreadWrite(NULL), fWriteDone(false), fWriteFailed(false) {}
 
 CCoinsViewCache::~CCoinsViewCache()
 {
     assert(!hasModifier);
+    WaitForWrite();
+}
+
+size_t CCoinsViewCache::DynamicMemoryUsage() const
+{
+    return memusage::DynamicUsage(cacheCoins) + cachedCoinsUsage + cacheWriteUsage;
 }
 
 CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256& txid) const
@@ -97,6 +109,7 @@ CCoinsMap::const_iterator CCoinsViewCache::FetchCoins(const uint256& txid) const
         // version as fresh.
         ret->second.flags = CCoinsCacheEntry::FRESH;
     }
+    cachedCoinsUsage += ret->second.coins.DynamicMemoryUsage();
     return ret;
 }
 
@@ -114,6 +127,7 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256& txid)
 {
     assert(!hasModifier);
     std::pair<CCoinsMap::iterator, bool> ret = cacheCoins.insert(std::make_pair(txid, CCoinsCacheEntry()));
+    size_t cachedCoinUsage = 0;
     if (ret.second) {
         if (!base->GetCoins(txid, ret.first->second.coins)) {
             // The parent view does not have this entry; mark it as fresh.
@@ -123,10 +137,12 @@ CCoinsModifier CCoinsViewCache::ModifyCoins(const uint256& txid)
             // The parent view only has a pruned entry for this; mark it as fresh.
             ret.first->second.flags = CCoinsCacheEntry::FRESH;
         }
+    } else {
+        cachedCoinUsage = ret.first->second.coins.DynamicMemoryUsage();
     }
     // Assume that whenever ModifyCoins is called, the entry will be modified.
     ret.first->second.flags |= CCoinsCacheEntry::DIRTY;
-    return CCoinsModifier(*this, ret.first);
+    return CCoinsModifier(*this, ret.first, cachedCoinUsage);
 }
 
 const CCoins* CCoinsViewCache::AccessCoins(const uint256& txid) const
@@ -176,6 +192,7 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
                     assert(it->second.flags & CCoinsCacheEntry::FRESH);
                     CCoinsCacheEntry& entry = cacheCoins[it->first];
                     entry.coins.swap(it->second.coins);
+                    cachedCoinsUsage += entry.coins.DynamicMemoryUsage();
                     entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
                 }
             } else {
@@ -183,10 +200,13 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
                     // The grandparent does not have an entry, and the child is
                     // modified and being pruned. This means we can just delete
                     // it from the parent.
+                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
                     cacheCoins.erase(itUs);
                 } else {
                     // A normal modification.
+                    cachedCoinsUsage -= itUs->second.coins.DynamicMemoryUsage();
                     itUs->second.coins.swap(it->second.coins);
+                    cachedCoinsUsage += itUs->second.coins.DynamicMemoryUsage();
                     itUs->second.flags |= CCoinsCacheEntry::DIRTY;
                 }
             }
@@ -200,11 +220,88 @@ bool CCoinsViewCache::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlockIn
 
 bool CCoinsViewCache::Flush()
 {
-    bool fOk = base->BatchWrite(cacheCoins, hashBlock);
+    bool fOk = WaitForWrite();
+    fOk = base->BatchWrite(cacheCoins, hashBlock) && fOk;
     cacheCoins.clear();
+    cachedCoinsUsage = 0;
+    return fOk;
+}
+
+bool CCoinsViewCache::Sync(size_t nTargetUsage, bool fBackground)
+{
+    assert(!hasModifier);
+    bool fOk = WaitForWrite();
+
+    // Everything written so far is in the base now and can be dropped. Entries
+    // of the write started below have to stay until it is done, as the base
+    // would return their old version meanwhile.
+    Trim(nTargetUsage);
+
+    CCoinsMap mapWrite;
+    size_t nWriteCoinsUsage = 0;
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); ++it) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            mapWrite.insert(*it);
+            nWriteCoinsUsage += it->second.coins.DynamicMemoryUsage();
+            // The base has (or is getting) this entry now, so it is not fresh
+            // anymore either; pruned entries are written as erasures.
+            it->second.flags = 0;
+        }
+    }
+
+    if (!fBackground)
+        return base->BatchWrite(mapWrite, hashBlock) && fOk;
+
+    // The copies are counted until the write is done, or a cache at its limit
+    // would use up to twice as much memory while it runs
+    pcacheWrite = new CCoinsMap();
+    pcacheWrite->swap(mapWrite);
+    cacheWriteUsage = memusage::DynamicUsage(*pcacheWrite) + nWriteCoinsUsage;
+    fWriteDone = false;
+    pthreadWrite = new boost::thread(boost::bind(&CCoinsViewCache::ThreadWrite, this, hashBlock));
     return fOk;
 }
 
+void CCoinsViewCache::ThreadWrite(uint256 hashBlockIn)
+{
+    RenameThread("blocknetdx-coinswr");
+    try {
+        if (!base->BatchWrite(*pcacheWrite, hashBlockIn))
+            fWriteFailed = true;
+    } catch (const std::exception& e) {
+        LogPrintf("%s: %s\n", __func__, e.what());
+        fWriteFailed = true;
+    }
+    fWriteDone = true;
+}
+
+bool CCoinsViewCache::WaitForWrite()
+{
+    if (pthreadWrite) {
+        pthreadWrite->join();
+        delete pthreadWrite;
+        pthreadWrite = NULL;
+        delete pcacheWrite;
+        pcacheWrite = NULL;
+        cacheWriteUsage = 0;
+    }
+    bool fOk = !fWriteFailed;
+    fWriteFailed = false;
+    return fOk;
+}
+
+void CCoinsViewCache::Trim(size_t nTargetUsage)
+{
+    for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end() && DynamicMemoryUsage() > nTargetUsage;) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            ++it;
+            continue;
+        }
+        cachedCoinsUsage -= it->second.coins.DynamicMemoryUsage();
+        cacheCoins.erase(it++);
+    }
+}
+
 unsigned int CCoinsViewCache::GetCacheSize() const
 {
     return cacheCoins.size();
@@ -259,7 +356,7 @@ double CCoinsViewCache::GetPriority(const CTransaction& tx, int nHeight) const
     return tx.ComputePriority(dResult);
 }
 
-CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_) : cache(cache_), it(it_)
+CCoinsModifier::CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage) : cache(cache_), it(it_), cachedCoinUsage(usage)
 {
     assert(!cache.hasModifier);
     cache.hasModifier = true;
@@ -270,7 +367,11 @@ CCoinsModifier::~CCoinsModifier()
     assert(cache.hasModifier);
     cache.hasModifier = false;
     it->second.coins.Cleanup();
+    cache.cachedCoinsUsage -= cachedCoinUsage; // Subtract the old usage
     if ((it->second.flags & CCoinsCacheEntry::FRESH) && it->second.coins.IsPruned()) {
         cache.cacheCoins.erase(it);
+    } else {
+        // If the coin still exists after the modification, add the new usage
+        cache.cachedCoinsUsage += it->second.coins.DynamicMemoryUsage();
     }
 }
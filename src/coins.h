@@ -7,6 +7,7 @@
 #define BITCOIN_COINS_H
 
 #include "compressor.h"
+#include "memusage.h"
 #include "script/standard.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -15,9 +16,16 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <atomic>
+
 #include <boost/foreach.hpp>
 #include <boost/unordered_map.hpp>
 
+namespace boost
+{
+class thread;
+} // namespace boost
+
 /** 
 
     ****Note - for BlocknetDX we added fCoinStake to the 2nd bit. Keep in mind when reading the following and adjust as needed.
@@ -128,8 +136,10 @@ public:
     void ClearUnspendable()
     {
         BOOST_FOREACH (CTxOut& txout, vout) {
-            if (txout.scriptPubKey.IsUnspendable())
+            if (txout.scriptPubKey.IsUnspendable()) {
                 txout.SetNull();
+                CScript().swap(txout.scriptPubKey);
+            }
         }
         Cleanup();
     }
@@ -283,6 +293,17 @@ public:
                 return false;
         return true;
     }
+
+    //! heap memory held by this entry (outputs and their scripts)
+    size_t DynamicMemoryUsage() const
+    {
+        size_t ret = memusage::DynamicUsage(vout);
+        BOOST_FOREACH (const CTxOut& out, vout) {
+            const std::vector<unsigned char>& script = out.scriptPubKey;
+            ret += memusage::DynamicUsage(script);
+        }
+        return ret;
+    }
 };
 
 class CCoinsKeyHasher
@@ -398,7 +419,8 @@ class CCoinsModifier
 private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
-    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_);
+    size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
     CCoins* operator->() { return &it->second.coins; }
@@ -421,6 +443,17 @@ protected:
     mutable uint256 hashBlock;
     mutable CCoinsMap cacheCoins;
 
+    /* Cached dynamic memory usage for the inner CCoins objects. */
+    mutable size_t cachedCoinsUsage;
+
+    /* Modified entries handed to a background write by Sync(), see WaitForWrite(). */
+    CCoinsMap* pcacheWrite;
+    /* Dynamic memory usage of pcacheWrite when the write started, part of DynamicMemoryUsage() until it is done. */
+    size_t cacheWriteUsage;
+    boost::thread* pthreadWrite;
+    std::atomic<bool> fWriteDone;
+    bool fWriteFailed;
+
 public:
     CCoinsViewCache(CCoinsView* baseIn);
     ~CCoinsViewCache();
@@ -453,9 +486,29 @@ public:
      */
     bool Flush();
 
+    /**
+     * Push the modifications applied to this cache to its base but keep the
+     * entries, then evict unmodified entries until the cache uses at most
+     * nTargetUsage bytes. Unlike Flush() this keeps the working set cached.
+     * With fBackground a copy of the modified entries is written on a separate
+     * thread, which requires the base to allow concurrent reads (CCoinsViewDB
+     * does); the write completes before the next Sync() or Flush() starts.
+     * Returns false if this or an earlier background write failed.
+     */
+    bool Sync(size_t nTargetUsage, bool fBackground);
+
+    //! Wait for a background write started by Sync(); returns false if it failed
+    bool WaitForWrite();
+
+    //! Whether a background write started by Sync() is still running
+    bool IsWriting() const { return pthreadWrite && !fWriteDone; }
+
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
+    //! Calculate the size of the cache (in bytes)
+    size_t DynamicMemoryUsage() const;
+
     /** 
      * Amount of blocknetdx coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
@@ -479,6 +532,10 @@ public:
 private:
     CCoinsMap::iterator FetchCoins(const uint256& txid);
     CCoinsMap::const_iterator FetchCoins(const uint256& txid) const;
+
+    //! Evict unmodified entries until at most nTargetUsage bytes are used
+    void Trim(size_t nTargetUsage);
+    void ThreadWrite(uint256 hashBlockIn);
 };
 
 #endif // BITCOIN_COINS_H
@@ -0,0 +1,682 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "crypto/quark.h"
+
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ENABLE_QUARK_SIMD
+// The vector helpers are always inlined, no vector crosses a call boundary
+#pragma GCC diagnostic ignored "-Wpsabi"
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// Internal implementation code.
+namespace
+{
+/// Internal Quark implementation.
+namespace quark
+{
+/** Messages hashed together; the intermediate digests of Quark are 64 bytes. */
+static const size_t BATCH = 16;
+typedef unsigned char Digest[64];
+
+/** Hash the digests d[idx[0..n-1]] in place with one primitive. */
+typedef void (*HashGroup)(Digest* d, const unsigned int* idx, size_t n);
+
+#define QUARK_SPH_GROUP(name, algo)                                            \
+    void name(Digest* d, const unsigned int* idx, size_t n)                    \
+    {                                                                          \
+        sph_##algo##_context ctx;                                              \
+        for (size_t i = 0; i < n; i++) {                                       \
+            sph_##algo##_init(&ctx);                                           \
+            sph_##algo(&ctx, d[idx[i]], 64);                                   \
+            sph_##algo##_close(&ctx, d[idx[i]]);                               \
+        }                                                                      \
+    }
+
+QUARK_SPH_GROUP(Blake512, blake512)
+QUARK_SPH_GROUP(Bmw512, bmw512)
+QUARK_SPH_GROUP(Skein512, skein512)
+QUARK_SPH_GROUP(Groestl512Ref, groestl512)
+#ifndef ENABLE_QUARK_SIMD
+QUARK_SPH_GROUP(JH512Ref, jh512)
+QUARK_SPH_GROUP(Keccak512Ref, keccak512)
+#endif
+
+#ifdef ENABLE_QUARK_SIMD
+#define QUARK_INLINE inline __attribute__((always_inline))
+
+typedef uint64_t v2u64 __attribute__((vector_size(16)));
+typedef uint64_t v4u64 __attribute__((vector_size(32)));
+
+uint64_t inline ReadLE64(const unsigned char* p)
+{
+    uint64_t x;
+    memcpy(&x, p, 8);
+    return x;
+}
+
+/** Load lanes of 64 bit words into a vector (or a plain uint64_t). */
+template <typename V>
+QUARK_INLINE V Load(const uint64_t* lanes)
+{
+    V v;
+    memcpy(&v, lanes, sizeof(v));
+    return v;
+}
+
+template <typename V>
+QUARK_INLINE void Store(uint64_t* lanes, const V& v)
+{
+    memcpy(lanes, &v, sizeof(v));
+}
+
+template <int n, typename V>
+QUARK_INLINE V Rotl(const V& x)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+//// Keccak-512: one permutation absorbs the 64 byte digest, one lane per message.
+
+static const uint64_t KECCAK_RC[24] = {
+    0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+    0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+    0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+    0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+    0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+    0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL};
+
+template <typename V>
+QUARK_INLINE void KeccakF(V* a)
+{
+    for (int round = 0; round < 24; round++) {
+        V c0 = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20];
+        V c1 = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];
+        V c2 = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22];
+        V c3 = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];
+        V c4 = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];
+        V d0 = c4 ^ Rotl<1>(c1), d1 = c0 ^ Rotl<1>(c2), d2 = c1 ^ Rotl<1>(c3), d3 = c2 ^ Rotl<1>(c4), d4 = c3 ^ Rotl<1>(c0);
+        for (int y = 0; y < 25; y += 5) {
+            a[y] ^= d0;
+            a[y + 1] ^= d1;
+            a[y + 2] ^= d2;
+            a[y + 3] ^= d3;
+            a[y + 4] ^= d4;
+        }
+
+        // rho and pi: lane (x, y) is rotated and moves to (y, 2x + 3y)
+        V b[25];
+        b[0] = a[0];
+        b[1] = Rotl<44>(a[6]);
+        b[2] = Rotl<43>(a[12]);
+        b[3] = Rotl<21>(a[18]);
+        b[4] = Rotl<14>(a[24]);
+        b[5] = Rotl<28>(a[3]);
+        b[6] = Rotl<20>(a[9]);
+        b[7] = Rotl<3>(a[10]);
+        b[8] = Rotl<45>(a[16]);
+        b[9] = Rotl<61>(a[22]);
+        b[10] = Rotl<1>(a[1]);
+        b[11] = Rotl<6>(a[7]);
+        b[12] = Rotl<25>(a[13]);
+        b[13] = Rotl<8>(a[19]);
+        b[14] = Rotl<18>(a[20]);
+        b[15] = Rotl<27>(a[4]);
+        b[16] = Rotl<36>(a[5]);
+        b[17] = Rotl<10>(a[11]);
+        b[18] = Rotl<15>(a[17]);
+        b[19] = Rotl<56>(a[23]);
+        b[20] = Rotl<62>(a[2]);
+        b[21] = Rotl<55>(a[8]);
+        b[22] = Rotl<39>(a[14]);
+        b[23] = Rotl<41>(a[15]);
+        b[24] = Rotl<2>(a[21]);
+
+        // chi and iota
+        a[0] = b[0] ^ (~b[1] & b[2]);
+        a[1] = b[1] ^ (~b[2] & b[3]);
+        a[2] = b[2] ^ (~b[3] & b[4]);
+        a[3] = b[3] ^ (~b[4] & b[0]);
+        a[4] = b[4] ^ (~b[0] & b[1]);
+        a[5] = b[5] ^ (~b[6] & b[7]);
+        a[6] = b[6] ^ (~b[7] & b[8]);
+        a[7] = b[7] ^ (~b[8] & b[9]);
+        a[8] = b[8] ^ (~b[9] & b[5]);
+        a[9] = b[9] ^ (~b[5] & b[6]);
+        a[10] = b[10] ^ (~b[11] & b[12]);
+        a[11] = b[11] ^ (~b[12] & b[13]);
+        a[12] = b[12] ^ (~b[13] & b[14]);
+        a[13] = b[13] ^ (~b[14] & b[10]);
+        a[14] = b[14] ^ (~b[10] & b[11]);
+        a[15] = b[15] ^ (~b[16] & b[17]);
+        a[16] = b[16] ^ (~b[17] & b[18]);
+        a[17] = b[17] ^ (~b[18] & b[19]);
+        a[18] = b[18] ^ (~b[19] & b[15]);
+        a[19] = b[19] ^ (~b[15] & b[16]);
+        a[20] = b[20] ^ (~b[21] & b[22]);
+        a[21] = b[21] ^ (~b[22] & b[23]);
+        a[22] = b[22] ^ (~b[23] & b[24]);
+        a[23] = b[23] ^ (~b[24] & b[20]);
+        a[24] = b[24] ^ (~b[20] & b[21]);
+        a[0] ^= KECCAK_RC[round];
+    }
+}
+
+/** Keccak-512 of N digests at once. */
+template <typename V, int N>
+QUARK_INLINE void Keccak512(Digest* d, const unsigned int* idx)
+{
+    uint64_t lanes[N];
+    V a[25];
+    for (int i = 0; i < 25; i++) {
+        for (int j = 0; j < N; j++) {
+            if (i < 8)
+                lanes[j] = ReadLE64(d[idx[j]] + 8 * i);
+            else if (i == 8)
+                lanes[j] = 0x8000000000000001ULL; // padding: 0x01 after the message, 0x80 closing the 72 byte block
+            else
+                lanes[j] = 0;
+        }
+        a[i] = Load<V>(lanes);
+    }
+    KeccakF(a);
+    for (int i = 0; i < 8; i++) {
+        Store(lanes, a[i]);
+        for (int j = 0; j < N; j++)
+            memcpy(d[idx[j]] + 8 * i, &lanes[j], 8);
+    }
+}
+
+void Keccak512x1(Digest* d, const unsigned int* idx) { Keccak512<uint64_t, 1>(d, idx); }
+void Keccak512x2(Digest* d, const unsigned int* idx) { Keccak512<v2u64, 2>(d, idx); }
+__attribute__((target("avx2"))) void Keccak512x4(Digest* d, const unsigned int* idx) { Keccak512<v4u64, 4>(d, idx); }
+
+//// JH-512: bitsliced as in sphlib, the two 64 bit halves of each 128 bit word
+//// share a vector, a vector of four lanes holds two messages.
+
+// The bitslice state is little-endian, so are the constants
+constexpr uint64_t JH_C(uint64_t x)
+{
+    return (x >> 56) | ((x >> 40) & 0xFF00ULL) | ((x >> 24) & 0xFF0000ULL) | ((x >> 8) & 0xFF000000ULL) |
+           ((x << 8) & 0xFF00000000ULL) | ((x << 24) & 0xFF0000000000ULL) | ((x << 40) & 0xFF000000000000ULL) | (x << 56);
+}
+
+/** Round constants, for round r: even words high and low half, odd words high and low half. */
+static const uint64_t JH_ROUND[168] = {
+    JH_C(0x72d5dea2df15f867), JH_C(0x7b84150ab7231557),
+    JH_C(0x81abd6904d5a87f6), JH_C(0x4e9f4fc5c3d12b40),
+    JH_C(0xea983ae05c45fa9c), JH_C(0x03c5d29966b2999a),
+    JH_C(0x660296b4f2bb538a), JH_C(0xb556141a88dba231),
+    JH_C(0x03a35a5c9a190edb), JH_C(0x403fb20a87c14410),
+    JH_C(0x1c051980849e951d), JH_C(0x6f33ebad5ee7cddc),
+    JH_C(0x10ba139202bf6b41), JH_C(0xdc786515f7bb27d0),
+    JH_C(0x0a2c813937aa7850), JH_C(0x3f1abfd2410091d3),
+    JH_C(0x422d5a0df6cc7e90), JH_C(0xdd629f9c92c097ce),
+    JH_C(0x185ca70bc72b44ac), JH_C(0xd1df65d663c6fc23),
+    JH_C(0x976e6c039ee0b81a), JH_C(0x2105457e446ceca8),
+    JH_C(0xeef103bb5d8e61fa), JH_C(0xfd9697b294838197),
+    JH_C(0x4a8e8537db03302f), JH_C(0x2a678d2dfb9f6a95),
+    JH_C(0x8afe7381f8b8696c), JH_C(0x8ac77246c07f4214),
+    JH_C(0xc5f4158fbdc75ec4), JH_C(0x75446fa78f11bb80),
+    JH_C(0x52de75b7aee488bc), JH_C(0x82b8001e98a6a3f4),
+    JH_C(0x8ef48f33a9a36315), JH_C(0xaa5f5624d5b7f989),
+    JH_C(0xb6f1ed207c5ae0fd), JH_C(0x36cae95a06422c36),
+    JH_C(0xce2935434efe983d), JH_C(0x533af974739a4ba7),
+    JH_C(0xd0f51f596f4e8186), JH_C(0x0e9dad81afd85a9f),
+    JH_C(0xa7050667ee34626a), JH_C(0x8b0b28be6eb91727),
+    JH_C(0x47740726c680103f), JH_C(0xe0a07e6fc67e487b),
+    JH_C(0x0d550aa54af8a4c0), JH_C(0x91e3e79f978ef19e),
+    JH_C(0x8676728150608dd4), JH_C(0x7e9e5a41f3e5b062),
+    JH_C(0xfc9f1fec4054207a), JH_C(0xe3e41a00cef4c984),
+    JH_C(0x4fd794f59dfa95d8), JH_C(0x552e7e1124c354a5),
+    JH_C(0x5bdf7228bdfe6e28), JH_C(0x78f57fe20fa5c4b2),
+    JH_C(0x05897cefee49d32e), JH_C(0x447e9385eb28597f),
+    JH_C(0x705f6937b324314a), JH_C(0x5e8628f11dd6e465),
+    JH_C(0xc71b770451b920e7), JH_C(0x74fe43e823d4878a),
+    JH_C(0x7d29e8a3927694f2), JH_C(0xddcb7a099b30d9c1),
+    JH_C(0x1d1b30fb5bdc1be0), JH_C(0xda24494ff29c82bf),
+    JH_C(0xa4e7ba31b470bfff), JH_C(0x0d324405def8bc48),
+    JH_C(0x3baefc3253bbd339), JH_C(0x459fc3c1e0298ba0),
+    JH_C(0xe5c905fdf7ae090f), JH_C(0x947034124290f134),
+    JH_C(0xa271b701e344ed95), JH_C(0xe93b8e364f2f984a),
+    JH_C(0x88401d63a06cf615), JH_C(0x47c1444b8752afff),
+    JH_C(0x7ebb4af1e20ac630), JH_C(0x4670b6c5cc6e8ce6),
+    JH_C(0xa4d5a456bd4fca00), JH_C(0xda9d844bc83e18ae),
+    JH_C(0x7357ce453064d1ad), JH_C(0xe8a6ce68145c2567),
+    JH_C(0xa3da8cf2cb0ee116), JH_C(0x33e906589a94999a),
+    JH_C(0x1f60b220c26f847b), JH_C(0xd1ceac7fa0d18518),
+    JH_C(0x32595ba18ddd19d3), JH_C(0x509a1cc0aaa5b446),
+    JH_C(0x9f3d6367e4046bba), JH_C(0xf6ca19ab0b56ee7e),
+    JH_C(0x1fb179eaa9282174), JH_C(0xe9bdf7353b3651ee),
+    JH_C(0x1d57ac5a7550d376), JH_C(0x3a46c2fea37d7001),
+    JH_C(0xf735c1af98a4d842), JH_C(0x78edec209e6b6779),
+    JH_C(0x41836315ea3adba8), JH_C(0xfac33b4d32832c83),
+    JH_C(0xa7403b1f1c2747f3), JH_C(0x5940f034b72d769a),
+    JH_C(0xe73e4e6cd2214ffd), JH_C(0xb8fd8d39dc5759ef),
+    JH_C(0x8d9b0c492b49ebda), JH_C(0x5ba2d74968f3700d),
+    JH_C(0x7d3baed07a8d5584), JH_C(0xf5a5e9f0e4f88e65),
+    JH_C(0xa0b8a2f436103b53), JH_C(0x0ca8079e753eec5a),
+    JH_C(0x9168949256e8884f), JH_C(0x5bb05c55f8babc4c),
+    JH_C(0xe3bb3b99f387947b), JH_C(0x75daf4d6726b1c5d),
+    JH_C(0x64aeac28dc34b36d), JH_C(0x6c34a550b828db71),
+    JH_C(0xf861e2f2108d512a), JH_C(0xe3db643359dd75fc),
+    JH_C(0x1cacbcf143ce3fa2), JH_C(0x67bbd13c02e843b0),
+    JH_C(0x330a5bca8829a175), JH_C(0x7f34194db416535c),
+    JH_C(0x923b94c30e794d1e), JH_C(0x797475d7b6eeaf3f),
+    JH_C(0xeaa8d4f7be1a3921), JH_C(0x5cf47e094c232751),
+    JH_C(0x26a32453ba323cd2), JH_C(0x44a3174a6da6d5ad),
+    JH_C(0xb51d3ea6aff2c908), JH_C(0x83593d98916b3c56),
+    JH_C(0x4cf87ca17286604d), JH_C(0x46e23ecc086ec7f6),
+    JH_C(0x2f9833b3b1bc765e), JH_C(0x2bd666a5efc4e62a),
+    JH_C(0x06f4b6e8bec1d436), JH_C(0x74ee8215bcef2163),
+    JH_C(0xfdc14e0df453c969), JH_C(0xa77d5ac406585826),
+    JH_C(0x7ec1141606e0fa16), JH_C(0x7e90af3d28639d3f),
+    JH_C(0xd2c9f2e3009bd20c), JH_C(0x5faace30b7d40c30),
+    JH_C(0x742a5116f2e03298), JH_C(0x0deb30d8e3cef89a),
+    JH_C(0x4bc59e7bb5f17992), JH_C(0xff51e66e048668d3),
+    JH_C(0x9b234d57e6966731), JH_C(0xcce6a6f3170a7505),
+    JH_C(0xb17681d913326cce), JH_C(0x3c175284f805a262),
+    JH_C(0xf42bcbb378471547), JH_C(0xff46548223936a48),
+    JH_C(0x38df58074e5e6565), JH_C(0xf2fc7c89fc86508e),
+    JH_C(0x31702e44d00bca86), JH_C(0xf04009a23078474e),
+    JH_C(0x65a0ee39d1f73883), JH_C(0xf75ee937e42c3abd),
+    JH_C(0x2197b2260113f86f), JH_C(0xa344edd1ef9fdee7),
+    JH_C(0x8ba0df15762592d9), JH_C(0x3c85f7f612dc42be),
+    JH_C(0xd8a7ec7cab27b07e), JH_C(0x538d7ddaaa3ea8de),
+    JH_C(0xaa25ce93bd0269d8), JH_C(0x5af643fd1a7308f9),
+    JH_C(0xc05fefda174a19a5), JH_C(0x974d66334cfd216a),
+    JH_C(0x35b49831db411570), JH_C(0xea1e0fbbedcd549b),
+    JH_C(0x9ad063a151974072), JH_C(0xf6759dbf91476fe2),
+};
+
+static const uint64_t JH_IV512[16] = {
+    JH_C(0x6fd14b963e00aa17), JH_C(0x636a2e057a15d543),
+    JH_C(0x8a225e8d0c97ef0b), JH_C(0xe9341259f2b3c361),
+    JH_C(0x891da0c1536f801e), JH_C(0x2aa9056bea2b6d80),
+    JH_C(0x588eccdb2075baa6), JH_C(0xa90f3a76baf83bf7),
+    JH_C(0x0169e60541e34a69), JH_C(0x46b58a8e2e6fe65a),
+    JH_C(0x1047a7d0c1843c24), JH_C(0x3b6e71b12d5ac199),
+    JH_C(0xcf57f6ec9db1f856), JH_C(0xa706887c5716b156),
+    JH_C(0xe3c2fcdfe68517fb), JH_C(0x545a4678cc8cdd4b),
+};
+
+/** Swap the high and low 64 bit halves of each 128 bit word. */
+#if defined(__clang__)
+QUARK_INLINE v2u64 Swap64(const v2u64& x) { return __builtin_shufflevector(x, x, 1, 0); }
+QUARK_INLINE v4u64 Swap64(const v4u64& x) { return __builtin_shufflevector(x, x, 1, 0, 3, 2); }
+#else
+QUARK_INLINE v2u64 Swap64(const v2u64& x) { return __builtin_shuffle(x, (v2u64){1, 0}); }
+QUARK_INLINE v4u64 Swap64(const v4u64& x) { return __builtin_shuffle(x, (v4u64){1, 0, 3, 2}); }
+#endif
+
+template <typename V>
+QUARK_INLINE void JHSbox(V& x0, V& x1, V& x2, V& x3, const V& c)
+{
+    x3 = ~x3;
+    x0 ^= c & ~x2;
+    V tmp = c ^ (x0 & x1);
+    x0 ^= x2 & x3;
+    x3 ^= ~x1 & x2;
+    x1 ^= x0 & x2;
+    x2 ^= x0 & ~x3;
+    x0 ^= x1 | x3;
+    x3 ^= x1 & x2;
+    x1 ^= tmp & x0;
+    x2 ^= tmp;
+}
+
+template <typename V>
+QUARK_INLINE void JHLinear(V& x0, V& x1, V& x2, V& x3, V& x4, V& x5, V& x6, V& x7)
+{
+    x4 ^= x1;
+    x5 ^= x2;
+    x6 ^= x3 ^ x0;
+    x7 ^= x0;
+    x0 ^= x5;
+    x1 ^= x6;
+    x2 ^= x7 ^ x4;
+    x3 ^= x4;
+}
+
+/** Swap the bit groups of width n selected by mask c with their neighbours. */
+template <typename V>
+QUARK_INLINE V JHSwap(const V& x, uint64_t c, int n)
+{
+    return ((x >> n) & c) | ((x & c) << n);
+}
+
+template <typename V>
+QUARK_INLINE void JHPermute(V& x, int r)
+{
+    switch (r % 7) {
+    case 0: x = JHSwap(x, 0x5555555555555555ULL, 1); break;
+    case 1: x = JHSwap(x, 0x3333333333333333ULL, 2); break;
+    case 2: x = JHSwap(x, 0x0F0F0F0F0F0F0F0FULL, 4); break;
+    case 3: x = JHSwap(x, 0x00FF00FF00FF00FFULL, 8); break;
+    case 4: x = JHSwap(x, 0x0000FFFF0000FFFFULL, 16); break;
+    case 5: x = JHSwap(x, 0x00000000FFFFFFFFULL, 32); break;
+    default: x = Swap64(x);
+    }
+}
+
+/** Round constant pair at offset, repeated for each message in V. */
+template <typename V, int N>
+QUARK_INLINE V JHConstant(const uint64_t* c)
+{
+    uint64_t lanes[2 * N];
+    for (int j = 0; j < N; j++) {
+        lanes[2 * j] = c[0];
+        lanes[2 * j + 1] = c[1];
+    }
+    return Load<V>(lanes);
+}
+
+template <typename V, int N>
+QUARK_INLINE void JHE8(V* h)
+{
+    for (int r = 0; r < 42; r++) {
+        JHSbox(h[0], h[2], h[4], h[6], JHConstant<V, N>(JH_ROUND + 4 * r));
+        JHSbox(h[1], h[3], h[5], h[7], JHConstant<V, N>(JH_ROUND + 4 * r + 2));
+        JHLinear(h[0], h[2], h[4], h[6], h[1], h[3], h[5], h[7]);
+        JHPermute(h[1], r);
+        JHPermute(h[3], r);
+        JHPermute(h[5], r);
+        JHPermute(h[7], r);
+    }
+}
+
+/** JH-512 of N digests at once: the digest is one block, the padding another. */
+template <typename V, int N>
+QUARK_INLINE void JH512(Digest* d, const unsigned int* idx)
+{
+    uint64_t lanes[2 * N];
+    V h[8], m[4];
+    for (int i = 0; i < 8; i++)
+        h[i] = JHConstant<V, N>(JH_IV512 + 2 * i);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < N; j++) {
+            lanes[2 * j] = ReadLE64(d[idx[j]] + 16 * i);
+            lanes[2 * j + 1] = ReadLE64(d[idx[j]] + 16 * i + 8);
+        }
+        m[i] = Load<V>(lanes);
+    }
+    for (int i = 0; i < 4; i++)
+        h[i] ^= m[i];
+    JHE8<V, N>(h);
+    for (int i = 0; i < 4; i++)
+        h[i + 4] ^= m[i];
+
+    // 0x80, zeros and the big-endian bit length of the message (512)
+    static const uint64_t pad0[2] = {0x80, 0}, pad3[2] = {0, 0x0002000000000000ULL};
+    m[0] = JHConstant<V, N>(pad0);
+    m[3] = JHConstant<V, N>(pad3);
+    h[0] ^= m[0];
+    h[3] ^= m[3];
+    JHE8<V, N>(h);
+    h[4] ^= m[0];
+    h[7] ^= m[3];
+
+    for (int i = 0; i < 4; i++) {
+        Store(lanes, h[i + 4]);
+        for (int j = 0; j < N; j++)
+            memcpy(d[idx[j]] + 16 * i, &lanes[2 * j], 16);
+    }
+}
+
+void JH512x1(Digest* d, const unsigned int* idx) { JH512<v2u64, 1>(d, idx); }
+__attribute__((target("avx2"))) void JH512x2(Digest* d, const unsigned int* idx) { JH512<v4u64, 2>(d, idx); }
+
+//// Groestl-512 with AES-NI: one register per row of the 8x16 byte state, so
+//// ShiftBytes and SubBytes are a shuffle and AESENCLAST, MixBytes is row-wise.
+
+/** Multiply every byte by 2 in GF(2^8) modulo the AES polynomial. */
+__attribute__((target("aes,ssse3"))) QUARK_INLINE __m128i GroestlDouble(__m128i x)
+{
+    __m128i carry = _mm_cmpgt_epi8(_mm_setzero_si128(), x);
+    return _mm_xor_si128(_mm_add_epi8(x, x), _mm_and_si128(carry, _mm_set1_epi8(0x1b)));
+}
+
+/** Row shifts of P and Q, for a 1024 bit state. */
+static const int GROESTL_SHIFT[2][8] = {{0, 1, 2, 3, 4, 5, 6, 11}, {1, 3, 5, 11, 0, 2, 4, 6}};
+
+/**
+ * Shuffles to apply before AESENCLAST, whose ShiftRows they undo, combined with
+ * the Groestl ShiftBytes of each row.
+ */
+struct GroestlMasks {
+    unsigned char mask[2][8][16];
+
+    GroestlMasks()
+    {
+        int invShiftRows[16];
+        for (int i = 0; i < 16; i++)
+            invShiftRows[(i & 3) + 4 * (((i >> 2) + (i & 3)) & 3)] = i;
+        for (int q = 0; q < 2; q++)
+            for (int r = 0; r < 8; r++)
+                for (int i = 0; i < 16; i++)
+                    mask[q][r][i] = (invShiftRows[i] + GROESTL_SHIFT[q][r]) & 15;
+    }
+};
+
+// Built on first use: block hashes are computed during static initialization (chainparams genesis)
+static const GroestlMasks& GetGroestlMasks()
+{
+    static const GroestlMasks masks;
+    return masks;
+}
+
+template <int Q>
+__attribute__((target("aes,ssse3"))) QUARK_INLINE void GroestlPermute(__m128i* x)
+{
+    const __m128i ones = _mm_set1_epi8((char)0xff);
+    const __m128i columns = _mm_setr_epi8(0x00, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70,
+                                          (char)0x80, (char)0x90, (char)0xa0, (char)0xb0, (char)0xc0, (char)0xd0, (char)0xe0, (char)0xf0);
+    __m128i mask[8];
+    for (int r = 0; r < 8; r++)
+        mask[r] = _mm_loadu_si128((const __m128i*)GetGroestlMasks().mask[Q][r]);
+
+    for (int round = 0; round < 14; round++) {
+        // AddRoundConstant
+        if (Q) {
+            for (int r = 0; r < 7; r++)
+                x[r] = _mm_xor_si128(x[r], ones);
+            x[7] = _mm_xor_si128(x[7], _mm_xor_si128(columns, _mm_set1_epi8((char)(0xff ^ round))));
+        } else {
+            x[0] = _mm_xor_si128(x[0], _mm_xor_si128(columns, _mm_set1_epi8((char)round)));
+        }
+
+        // ShiftBytes and SubBytes
+        for (int r = 0; r < 8; r++)
+            x[r] = _mm_aesenclast_si128(_mm_shuffle_epi8(x[r], mask[r]), _mm_setzero_si128());
+
+        // MixBytes: row r becomes the sum of rows r + k times {2, 2, 3, 4, 5, 3, 5, 7}[k]
+        __m128i x2[8], x4[8], y[8];
+        for (int r = 0; r < 8; r++) {
+            x2[r] = GroestlDouble(x[r]);
+            x4[r] = GroestlDouble(x2[r]);
+        }
+#define GROESTL_MIX(r)                                                                                                    \
+    y[r] = _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(x[(r + 2) & 7], x[(r + 4) & 7]),                                   \
+                                       _mm_xor_si128(_mm_xor_si128(x[(r + 5) & 7], x[(r + 6) & 7]), x[(r + 7) & 7])),    \
+                         _mm_xor_si128(_mm_xor_si128(_mm_xor_si128(x2[r], x2[(r + 1) & 7]), x2[(r + 2) & 7]),            \
+                                       _mm_xor_si128(_mm_xor_si128(x2[(r + 5) & 7], x2[(r + 7) & 7]),                    \
+                                                     _mm_xor_si128(_mm_xor_si128(x4[(r + 3) & 7], x4[(r + 4) & 7]),      \
+                                                                   _mm_xor_si128(x4[(r + 6) & 7], x4[(r + 7) & 7])))))
+        GROESTL_MIX(0); GROESTL_MIX(1); GROESTL_MIX(2); GROESTL_MIX(3);
+        GROESTL_MIX(4); GROESTL_MIX(5); GROESTL_MIX(6); GROESTL_MIX(7);
+#undef GROESTL_MIX
+        for (int r = 0; r < 8; r++)
+            x[r] = y[r];
+    }
+}
+
+/** Groestl-512 of a 64 byte digest, which pads to a single block. */
+__attribute__((target("aes,ssse3"))) void Groestl512AESNI(Digest* d, const unsigned int* idx, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        unsigned char* data = d[idx[i]];
+
+        // Transpose the column-major message block into rows
+        unsigned char block[128] = {0}, rows[8][16];
+        memcpy(block, data, 64);
+        block[64] = 0x80;
+        block[127] = 1; // number of blocks
+        for (int r = 0; r < 8; r++)
+            for (int c = 0; c < 16; c++)
+                rows[r][c] = block[8 * c + r];
+
+        __m128i h[8], m[8], p[8];
+        for (int r = 0; r < 8; r++) {
+            m[r] = _mm_loadu_si128((const __m128i*)rows[r]);
+            h[r] = _mm_setzero_si128();
+        }
+        h[6] = _mm_insert_epi16(h[6], 0x0200, 7); // the IV encodes the 512 bit output size
+
+        // Compression: h = P(h ^ m) ^ Q(m) ^ h
+        for (int r = 0; r < 8; r++)
+            p[r] = _mm_xor_si128(h[r], m[r]);
+        GroestlPermute<0>(p);
+        GroestlPermute<1>(m);
+        for (int r = 0; r < 8; r++)
+            h[r] = _mm_xor_si128(h[r], _mm_xor_si128(p[r], m[r]));
+
+        // Output transformation: the last 512 bits of P(h) ^ h
+        for (int r = 0; r < 8; r++)
+            p[r] = h[r];
+        GroestlPermute<0>(p);
+        for (int r = 0; r < 8; r++)
+            _mm_storeu_si128((__m128i*)rows[r], _mm_xor_si128(p[r], h[r]));
+        for (int c = 8; c < 16; c++)
+            for (int r = 0; r < 8; r++)
+                data[8 * (c - 8) + r] = rows[r][c];
+    }
+}
+
+void JH512(Digest* d, const unsigned int* idx, size_t n)
+{
+    static const bool fAVX2 = __builtin_cpu_supports("avx2");
+    if (fAVX2) {
+        for (; n >= 2; n -= 2, idx += 2)
+            JH512x2(d, idx);
+    }
+    for (; n > 0; n--, idx++)
+        JH512x1(d, idx);
+}
+
+void Keccak512(Digest* d, const unsigned int* idx, size_t n)
+{
+    static const bool fAVX2 = __builtin_cpu_supports("avx2");
+    if (fAVX2) {
+        for (; n >= 4; n -= 4, idx += 4)
+            Keccak512x4(d, idx);
+    }
+    for (; n >= 2; n -= 2, idx += 2)
+        Keccak512x2(d, idx);
+    for (; n > 0; n--, idx++)
+        Keccak512x1(d, idx);
+}
+
+bool HaveAESNI()
+{
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ecx & bit_AES) && (ecx & bit_SSSE3);
+}
+
+HashGroup Groestl512()
+{
+    return HaveAESNI() ? Groestl512AESNI : Groestl512Ref;
+}
+#else
+HashGroup JH512 = JH512Ref;
+HashGroup Keccak512 = Keccak512Ref;
+
+HashGroup Groestl512()
+{
+    return Groestl512Ref;
+}
+#endif
+
+/**
+ * Hash the digests with fnSet if bit 3 of their first byte is set, with
+ * fnUnset otherwise. Quark branches on that bit three times.
+ */
+void Branch(Digest* d, size_t n, HashGroup fnSet, HashGroup fnUnset)
+{
+    unsigned int set[BATCH], unset[BATCH];
+    size_t nSet = 0, nUnset = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        if (d[i][0] & 8)
+            set[nSet++] = i;
+        else
+            unset[nUnset++] = i;
+    }
+    fnSet(d, set, nSet);
+    fnUnset(d, unset, nUnset);
+}
+
+void Batch(unsigned char* output, const unsigned char* input, size_t len, size_t n)
+{
+    static const HashGroup groestl = Groestl512();
+    static const unsigned char blank[1] = {0};
+    static const unsigned int all[BATCH] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
+    Digest d[BATCH];
+    sph_blake512_context ctx;
+    for (size_t i = 0; i < n; i++) {
+        sph_blake512_init(&ctx);
+        sph_blake512(&ctx, len ? input + i * len : blank, len);
+        sph_blake512_close(&ctx, d[i]);
+    }
+    Bmw512(d, all, n);
+    Branch(d, n, groestl, Skein512);
+    groestl(d, all, n);
+    JH512(d, all, n);
+    Branch(d, n, Blake512, Bmw512);
+    Keccak512(d, all, n);
+    Skein512(d, all, n);
+    Branch(d, n, Keccak512, JH512);
+    for (size_t i = 0; i < n; i++)
+        memcpy(output + 32 * i, d[i], 32);
+}
+
+} // namespace quark
+} // namespace
+
+void QuarkHashMulti(unsigned char* output, const unsigned char* input, size_t len, size_t n)
+{
+    for (; n > 0; input += quark::BATCH * len, output += quark::BATCH * 32) {
+        size_t nBatch = n < quark::BATCH ? n : quark::BATCH;
+        quark::Batch(output, input, len, nBatch);
+        n -= nBatch;
+    }
+}
+
+void QuarkHash(unsigned char* output, const unsigned char* input, size_t len)
+{
+    quark::Batch(output, input, len, 1);
+}
+
+std::string QuarkImplementation()
+{
+#ifdef ENABLE_QUARK_SIMD
+    std::string str = quark::HaveAESNI() ? "groestl(aes-ni)" : "groestl(generic)";
+    str += __builtin_cpu_supports("avx2") ? " jh(avx2) keccak(avx2)" : " jh(sse2) keccak(sse2)";
+    return str;
+#else
+    return "generic";
+#endif
+}
@@ -0,0 +1,27 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_QUARK_H
+#define BITCOIN_CRYPTO_QUARK_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string>
+
+/**
+ * Compute the Quark hash of n messages of len bytes each, stored back to back
+ * in input. Writes n 32-byte hashes to output. The messages are hashed one
+ * primitive at a time, grouped by the branches Quark takes, so that several
+ * of them are hashed at once in vector lanes where the CPU supports it.
+ */
+void QuarkHashMulti(unsigned char* output, const unsigned char* input, size_t len, size_t n);
+
+/** Compute the Quark hash of a single message. */
+void QuarkHash(unsigned char* output, const unsigned char* input, size_t len);
+
+/** Describe the implementations picked for this CPU, for the debug log. */
+std::string QuarkImplementation();
+
+#endif // BITCOIN_CRYPTO_QUARK_H
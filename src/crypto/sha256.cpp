@@ -6,8 +6,15 @@
 
 #include "crypto/common.h"
 
+#include <assert.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ENABLE_SHA256_MULTIWAY
+// The vector helpers are always inlined and take vectors by reference
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
 // Internal implementation code.
 namespace
 {
@@ -127,6 +134,150 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+/**
+ * Multi-way SHA-256, the same rounds on a word type holding one lane per
+ * message: uint32_t for one message, or GCC vector types for several.
+ */
+namespace multiway
+{
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+#ifdef __GNUC__
+#define SHA256_INLINE inline __attribute__((always_inline))
+#else
+#define SHA256_INLINE inline
+#endif
+
+// Vectors are passed by reference, wider vectors have no stable by-value ABI
+template <typename V> static SHA256_INLINE V Rotr(const V& x, int n) { return (x >> n) | (x << (32 - n)); }
+template <typename V> static SHA256_INLINE V Ch(const V& x, const V& y, const V& z) { return z ^ (x & (y ^ z)); }
+template <typename V> static SHA256_INLINE V Maj(const V& x, const V& y, const V& z) { return (x & y) | (z & (x | y)); }
+template <typename V> static SHA256_INLINE V Sigma0(const V& x) { return Rotr(x, 2) ^ Rotr(x, 13) ^ Rotr(x, 22); }
+template <typename V> static SHA256_INLINE V Sigma1(const V& x) { return Rotr(x, 6) ^ Rotr(x, 11) ^ Rotr(x, 25); }
+template <typename V> static SHA256_INLINE V sigma0(const V& x) { return Rotr(x, 7) ^ Rotr(x, 18) ^ (x >> 3); }
+template <typename V> static SHA256_INLINE V sigma1(const V& x) { return Rotr(x, 17) ^ Rotr(x, 19) ^ (x >> 10); }
+
+/** All lanes set to x. */
+template <typename V, int N>
+SHA256_INLINE V Broadcast(uint32_t x)
+{
+    uint32_t lanes[N];
+    for (int i = 0; i < N; i++)
+        lanes[i] = x;
+    V v;
+    memcpy(&v, lanes, sizeof(v));
+    return v;
+}
+
+/** One SHA-256 transformation of the 16 message words w, in every lane. */
+template <typename V>
+SHA256_INLINE void Transform(V* s, V* w)
+{
+    V a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; i++) {
+        if (i >= 16)
+            w[i & 15] += sigma1(w[(i - 2) & 15]) + w[(i - 7) & 15] + sigma0(w[(i - 15) & 15]);
+        V t1 = h + Sigma1(e) + Ch(e, f, g) + K[i] + w[i & 15];
+        V t2 = Sigma0(a) + Maj(a, b, c);
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    s[0] += a;
+    s[1] += b;
+    s[2] += c;
+    s[3] += d;
+    s[4] += e;
+    s[5] += f;
+    s[6] += g;
+    s[7] += h;
+}
+
+/** Double SHA-256 of N single block messages, one per lane. */
+template <typename V, int N>
+SHA256_INLINE void DoubleShort(unsigned char* output, const unsigned char* input, size_t len)
+{
+    // Pad every message into its block and transpose the words into lanes
+    uint32_t lanes[16][N];
+    for (int j = 0; j < N; j++) {
+        unsigned char block[64] = {0};
+        memcpy(block, input + j * len, len);
+        block[len] = 0x80;
+        WriteBE64(block + 56, (uint64_t)len << 3);
+        for (int i = 0; i < 16; i++)
+            lanes[i][j] = ReadBE32(block + 4 * i);
+    }
+
+    V w[16];
+    for (int i = 0; i < 16; i++)
+        memcpy(&w[i], lanes[i], sizeof(V));
+    V s[8];
+    uint32_t init[8];
+    sha256::Initialize(init);
+    for (int i = 0; i < 8; i++)
+        s[i] = Broadcast<V, N>(init[i]);
+    Transform(s, w);
+
+    // The second pass hashes the 32 byte digest, padded
+    for (int i = 0; i < 8; i++)
+        w[i] = s[i];
+    w[8] = Broadcast<V, N>(0x80000000ul);
+    for (int i = 9; i < 15; i++)
+        w[i] = Broadcast<V, N>(0);
+    w[15] = Broadcast<V, N>(256);
+    for (int i = 0; i < 8; i++)
+        s[i] = Broadcast<V, N>(init[i]);
+    Transform(s, w);
+
+    for (int i = 0; i < 8; i++) {
+        uint32_t out[N];
+        memcpy(out, &s[i], sizeof(V));
+        for (int j = 0; j < N; j++)
+            WriteBE32(output + 32 * j + 4 * i, out[j]);
+    }
+}
+
+void DoubleShort1(unsigned char* output, const unsigned char* input, size_t len)
+{
+    DoubleShort<uint32_t, 1>(output, input, len);
+}
+
+#ifdef ENABLE_SHA256_MULTIWAY
+typedef uint32_t v4u32 __attribute__((vector_size(16)));
+typedef uint32_t v8u32 __attribute__((vector_size(32)));
+
+// Four lanes need only SSE2, which every x86_64 CPU has
+void DoubleShort4(unsigned char* output, const unsigned char* input, size_t len)
+{
+    DoubleShort<v4u32, 4>(output, input, len);
+}
+
+__attribute__((target("avx2"))) void DoubleShort8(unsigned char* output, const unsigned char* input, size_t len)
+{
+    DoubleShort<v8u32, 8>(output, input, len);
+}
+
+bool HaveAVX2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+} // namespace multiway
 } // namespace sha256
 } // namespace
 
@@ -187,3 +338,19 @@ CSHA256& CSHA256::Reset()
     sha256::Initialize(s);
     return *this;
 }
+
+void SHA256DShort(unsigned char* output, const unsigned char* input, size_t len, size_t n)
+{
+    assert(len <= 55);
+#ifdef ENABLE_SHA256_MULTIWAY
+    static const bool fAVX2 = sha256::multiway::HaveAVX2();
+    if (fAVX2) {
+        for (; n >= 8; n -= 8, input += 8 * len, output += 8 * 32)
+            sha256::multiway::DoubleShort8(output, input, len);
+    }
+    for (; n >= 4; n -= 4, input += 4 * len, output += 4 * 32)
+        sha256::multiway::DoubleShort4(output, input, len);
+#endif
+    for (; n > 0; n--, input += len, output += 32)
+        sha256::multiway::DoubleShort1(output, input, len);
+}
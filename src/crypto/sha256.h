@@ -25,4 +25,12 @@ public:
     CSHA256& Reset();
 };
 
+/**
+ * Compute the double SHA-256 of n messages of len bytes each (len at most 55,
+ * so a message fits in one block), stored back to back in input. Writes n
+ * 32-byte hashes to output. Several messages are hashed at once in vector
+ * lanes where the CPU supports it.
+ */
+void SHA256DShort(unsigned char* output, const unsigned char* input, size_t len, size_t n);
+
 #endif // BITCOIN_CRYPTO_SHA256_H
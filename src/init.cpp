@@ -17,7 +17,9 @@
 #include "amount.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
+#include "crypto/quark.h"
 #include "key.h"
+#include "logwriter.h"
 #include "main.h"
 #include "servicenode-budget.h"
 #include "servicenode-payments.h"
@@ -26,6 +28,7 @@
 #include "miner.h"
 #include "net.h"
 #include "rpcserver.h"
+#include "script/sigcache.h"
 #include "script/standard.h"
 #include "spork.h"
 #include "txdb.h"
@@ -264,6 +267,7 @@ void Shutdown()
     // ECC_Stop();
 
     LogPrintf("%s: done\n", __func__);
+    StopLogWriters();
 }
 
 /**
@@ -283,10 +287,21 @@ void waitForClose();
 
 void HandleSIGABRT(int)
 {
+    // Shutdown may never get to stop the log writers if this thread holds a lock
+    DrainLogWriters();
     fRequestShutdown = true;
     waitForClose();
 }
 
+#ifndef WIN32
+void HandleFatalSignal(int nSignal)
+{
+    // The handler is reset, so raising the signal again terminates as usual
+    DrainLogWriters();
+    raise(nSignal);
+}
+#endif
+
 bool static InitError(const std::string& str)
 {
     uiInterface.ThreadSafeMessageBox(str, "", CClientUIInterface::MSG_ERROR);
@@ -319,6 +334,7 @@ std::string HelpMessage(HelpMessageMode mode)
     string strUsage = HelpMessageGroup(_("Options:"));
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an index of the transactions and unspent outputs of every address, used by the getaddress* rpc calls and the block explorer (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
@@ -339,6 +355,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "blocknetdxd.pid"));
 #endif
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files") + " " + _("on startup"));
+    strUsage += HelpMessageOpt("-spentindex", strprintf(_("Maintain an index of the inputs spending each output, used by the getspentinfo rpc call and the block explorer (default: %u)"), DEFAULT_SPENTINDEX));
 #if !defined(WIN32)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
@@ -356,10 +373,13 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-dnsseed", _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect)"));
     strUsage += HelpMessageOpt("-externalip=<ip>", _("Specify your own public address"));
     strUsage += HelpMessageOpt("-forcednsseed", strprintf(_("Always query for peer addresses via DNS lookup (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-knownfprate=<n>", strprintf(_("False positive rate of remembered relayed and processed xbridge messages (default: %s)"), "0.000001"));
+    strUsage += HelpMessageOpt("-knownmessages=<n>", strprintf(_("Remember at least the last <n> relayed alert and xbridge messages per connection (default: %u)"), DEFAULT_KNOWN_MESSAGES));
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect)"));
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-msghandthreads=<n>", strprintf(_("Number of threads to handle peer messages, each peer is served by one of them (1 to %d, default: %d)"), MAX_MESSAGE_HANDLER_THREADS, DEFAULT_MESSAGE_HANDLER_THREADS));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
@@ -368,6 +388,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-proxy=<ip:port>", _("Connect through SOCKS5 proxy"));
     strUsage += HelpMessageOpt("-seednode=<ip>", _("Connect to a node to retrieve peer addresses, and disconnect"));
     strUsage += HelpMessageOpt("-timeout=<n>", strprintf(_("Specify connection timeout in milliseconds (minimum: 1, default: %d)"), DEFAULT_CONNECT_TIMEOUT));
+#ifdef HAVE_SYS_EPOLL_H
+    strUsage += HelpMessageOpt("-useepoll", strprintf(_("Wait for network events with epoll instead of select() (default: %u)"), 1));
+#endif
 #ifdef USE_UPNP
 #if USE_UPNP
     strUsage += HelpMessageOpt("-upnp", _("Use UPnP to map the listening port (default: 1 when listening)"));
@@ -378,6 +401,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-whitebind=<addr>", _("Bind to given address and whitelist peers connecting to it. Use [host]:port notation for IPv6"));
     strUsage += HelpMessageOpt("-whitelist=<netmask>", _("Whitelist peers connecting from the given netmask or IP address. Can be specified multiple times.") +
         " " + _("Whitelisted peers cannot be DoS banned and their transactions are always relayed, even if they are already in the mempool, useful e.g. for a gateway"));
+    strUsage += HelpMessageOpt("-xbridgeknownmessages=<n>", strprintf(_("Remember at least the last <n> processed xbridge messages (default: %u)"), 100000));
 
 
 #ifdef ENABLE_WALLET
@@ -441,12 +465,15 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-genproclimit=<n>", strprintf(_("Set the number of threads for coin generation if enabled (-1 = all cores, default: %d)"), 1));
 #endif
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
+    strUsage += HelpMessageOpt("-logasync", strprintf(_("Write debug output from a background thread, in batches (default: %u)"), 1));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-logratelimit=<n>", strprintf(_("Log at most <n> lines per second for each debug category, 0 = unlimited (default: %u)"), 0));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), 1));
     if (GetBoolArg("-help-debug", false)) {
+        strUsage += HelpMessageOpt("-limitancestorcount=<n>", strprintf(_("Do not accept transactions with more than <n> unconfirmed ancestors, themselves included (default: %u)"), DEFAULT_ANCESTOR_LIMIT));
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), 1));
-        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), 50000));
+        strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), DEFAULT_MAX_SIG_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in BLOCK/Kb) smaller than this are considered zero fee for relaying (default: %s)"), FormatMoney(::minRelayTxFee.GetFeePerK())));
     strUsage += HelpMessageOpt("-printtoconsole", strprintf(_("Send trace/debug info to console instead of debug.log file (default: %u)"), 0));
@@ -465,6 +492,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageGroup(_("Staking options:"));
     strUsage += HelpMessageOpt("-staking=<n>", strprintf(_("Enable staking functionality (0-1, default: %u)"), 1));
     strUsage += HelpMessageOpt("-reservebalance=<amt>", _("Keep the specified amount available for spending at all times (default: 0)"));
+    strUsage += HelpMessageOpt("-stakethreads=<n>", strprintf(_("Set the number of threads searching for stake kernels (0 = all cores, default: %d)"), 0));
     if (GetBoolArg("-help-debug", false)) {
         strUsage += HelpMessageOpt("-printstakemodifier", _("Display the stake modifier calculations in the debug.log file."));
         strUsage += HelpMessageOpt("-printcoinstake", _("Display verbose coin stake messages in the debug.log file."));
@@ -510,7 +538,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcpassword=<pw>", _("Password for JSON-RPC connections"));
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 41414, 41419));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
-    strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), 4));
+    strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_RPC_THREADS));
+    strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf(_("Set the depth of the work queue to service RPC calls (default: %d)"), DEFAULT_RPC_WORK_QUEUE));
+    strUsage += HelpMessageOpt("-rpcmethodlimit=<method>:<n>", _("Execute at most <n> calls of RPC <method> at the same time. This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpckeepalive", strprintf(_("RPC support for HTTP persistent connections (default: %d)"), 1));
 
     strUsage += HelpMessageGroup(_("RPC SSL options: (see the Bitcoin Wiki for SSL setup instructions)"));
@@ -698,6 +728,16 @@ bool AppInit2(boost::thread_group& threadGroup)
     sa_abrt.sa_flags = 0;
     sigaction(SIGABRT, &sa_abrt, NULL);
 
+    // Write out queued log lines on a crash
+    struct sigaction sa_fatal;
+    sa_fatal.sa_handler = HandleFatalSignal;
+    sigemptyset(&sa_fatal.sa_mask);
+    sa_fatal.sa_flags = SA_RESETHAND;
+    sigaction(SIGSEGV, &sa_fatal, NULL);
+    sigaction(SIGBUS, &sa_fatal, NULL);
+    sigaction(SIGFPE, &sa_fatal, NULL);
+    sigaction(SIGILL, &sa_fatal, NULL);
+
     // Reopen debug.log on SIGHUP
     struct sigaction sa_hup;
     sa_hup.sa_handler = HandleSIGHUP;
@@ -716,6 +756,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     fPrintToConsole = GetBoolArg("-printtoconsole", false);
     fLogTimestamps = GetBoolArg("-logtimestamps", true);
     fLogIPs = GetBoolArg("-logips", false);
+    nLogRateLimit = GetArg("-logratelimit", 0);
 
     if (mapArgs.count("-bind") || mapArgs.count("-whitebind")) {
         // when specifying an explicit binding address, you want to listen on it
@@ -786,13 +827,22 @@ bool AppInit2(boost::thread_group& threadGroup)
     // Make sure enough file descriptors are available
     int nBind = std::max((int)mapArgs.count("-bind") + (int)mapArgs.count("-whitebind"), 1);
     nMaxConnections = GetArg("-maxconnections", 125);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0);
+    int nMaxSelectable = FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS;
+#ifdef HAVE_SYS_EPOLL_H
+    // epoll is only bounded by the file descriptor limit below
+    if (GetBoolArg("-useepoll", true))
+        nMaxSelectable = nMaxConnections;
+#endif
+    nMaxConnections = std::max(std::min(nMaxConnections, nMaxSelectable), 0);
     int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS)
         return InitError(_("Not enough file descriptors available."));
     if (nFD - MIN_CORE_FILEDESCRIPTORS < nMaxConnections)
         nMaxConnections = nFD - MIN_CORE_FILEDESCRIPTORS;
 
+    nMessageHandlerThreads = GetArg("-msghandthreads", DEFAULT_MESSAGE_HANDLER_THREADS);
+    nMessageHandlerThreads = std::max(std::min(nMessageHandlerThreads, MAX_MESSAGE_HANDLER_THREADS), 1);
+
     // ********************************************************* Step 3: parameter-to-internal-flags
 
     fDebug = !mapMultiArgs["-debug"].empty();
@@ -828,6 +878,10 @@ bool AppInit2(boost::thread_group& threadGroup)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    // The signature cache is allocated in full when first used
+    if (GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) > MAX_MAX_SIG_CACHE_SIZE)
+        return InitError(strprintf(_("-maxsigcachesize can be at most %d entries"), MAX_MAX_SIG_CACHE_SIZE));
+
     fServer = GetBoolArg("-server", false);
     setvbuf(stdout, NULL, _IOLBF, 0); /// ***TODO*** do we still need this after -printtoconsole is gone?
 
@@ -944,6 +998,7 @@ bool AppInit2(boost::thread_group& threadGroup)
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("BlocknetDX version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
     LogPrintf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
+    LogPrintf("Using the '%s' Quark implementation\n", QuarkImplementation());
 #ifdef ENABLE_WALLET
     LogPrintf("Using BerkeleyDB version %s\n", DbEnv::version(0, 0, 0));
 #endif
@@ -1240,12 +1295,12 @@ bool AppInit2(boost::thread_group& threadGroup)
     else if (nTotalCache > (nMaxDbCache << 20))
         nTotalCache = (nMaxDbCache << 20); // total cache cannot be greater than nMaxDbCache
     size_t nBlockTreeDBCache = nTotalCache / 8;
-    if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true))
+    if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", true) && !GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) && !GetBoolArg("-spentindex", DEFAULT_SPENTINDEX))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
     size_t nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
-    nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
+    nCoinCacheUsage = nTotalCache; // the rest is the budget for the in-memory coins cache
 
     bool fLoaded = false;
     while (!fLoaded) {
@@ -1293,6 +1348,16 @@ bool AppInit2(boost::thread_group& threadGroup)
                     break;
                 }
 
+                // Check for changed -addressindex and -spentindex state
+                if (fAddressIndex != GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -addressindex");
+                    break;
+                }
+                if (fSpentIndex != GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)) {
+                    strLoadError = _("You need to rebuild the database using -reindex to change -spentindex");
+                    break;
+                }
+
                 uiInterface.InitMessage(_("Verifying blocks..."));
                 if (!CVerifyDB().VerifyDB(pcoinsdbview, GetArg("-checklevel", 3),
                         GetArg("-checkblocks", 500))) {
@@ -3,9 +3,16 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <atomic>
+
 #include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
+#include "checkqueue.h"
+#include "crypto/common.h"
+#include "crypto/sha256.h"
 #include "db.h"
 #include "kernel.h"
 #include "script/interpreter.h"
@@ -289,11 +296,10 @@ bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTarget
 }
 
 //instead of looping outside and reinitializing variables many times, we will give a nTimeTx and also search interval so that we can do all the hashing here
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, int64_t nValueIn, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
 {
     //assign new variables to make it easier to read
-    int64_t nValueIn = txPrev.vout[prevout.n].nValue;
-    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
+    unsigned int nTimeBlockFrom = pindexFrom->GetBlockTime();
 
     if (nTimeTx < nTimeBlockFrom) // Transaction timestamp violation
         return error("CheckStakeKernelHash() : nTime violation");
@@ -309,7 +315,7 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
     uint64_t nStakeModifier = 0;
     int nStakeModifierHeight = 0;
     int64_t nStakeModifierTime = 0;
-    if (!GetKernelStakeModifier(blockFrom.GetHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake)) {
+    if (!GetKernelStakeModifier(pindexFrom->GetBlockHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake)) {
         LogPrintf("CheckStakeKernelHash(): failed to get kernel stake modifier \n");
         return false;
     }
@@ -344,8 +350,8 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
             LogPrintf("CheckStakeKernelHash() : using modifier %s at height=%d timestamp=%s for block from height=%d timestamp=%s\n",
                 boost::lexical_cast<std::string>(nStakeModifier).c_str(), nStakeModifierHeight,
                 DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nStakeModifierTime).c_str(),
-                mapBlockIndex[blockFrom.GetHash()]->nHeight,
-                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", blockFrom.GetBlockTime()).c_str());
+                pindexFrom->nHeight,
+                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", pindexFrom->GetBlockTime()).c_str());
             LogPrintf("CheckStakeKernelHash() : pass protocol=%s modifier=%s nTimeBlockFrom=%u prevoutHash=%s nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n",
                 "0.3",
                 boost::lexical_cast<std::string>(nStakeModifier).c_str(),
@@ -360,41 +366,238 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTra
     return fSuccess;
 }
 
+int nStakeKernelThreads = 0;
+
+namespace
+{
+/** Shared state of one kernel search, the checks below each hash a chunk of its work */
+class CStakeKernelSearch
+{
+public:
+    const std::vector<CStakeKernelWork>& vWork;
+    unsigned int nTimeMin;
+    unsigned int nTimeTx;
+    unsigned int nHashDrift;
+
+    std::atomic<bool> fFound;
+    std::atomic<uint64_t> nHashes;
+
+    boost::mutex cs;
+    int nFound;
+    unsigned int nTimeFound;
+    uint256 hashFound;
+
+    CStakeKernelSearch(const std::vector<CStakeKernelWork>& vWorkIn, unsigned int nTimeMinIn, unsigned int nTimeTxIn, unsigned int nHashDriftIn) : vWork(vWorkIn), nTimeMin(nTimeMinIn), nTimeTx(nTimeTxIn), nHashDrift(nHashDriftIn), fFound(false), nHashes(0), nFound(-1), nTimeFound(0)
+    {
+    }
+
+    void Run(size_t nBegin, size_t nEnd)
+    {
+        // All drift times of one candidate are hashed in one batch,
+        // latest time first like CheckStakeKernelHash does
+        std::vector<unsigned char> vInput(nHashDrift * KERNEL_SIZE);
+        std::vector<unsigned char> vOutput(nHashDrift * 32);
+        for (size_t n = nBegin; n < nEnd && !fFound; n++) {
+            const CStakeKernelWork& work = vWork[n];
+            for (unsigned int i = 0; i < nHashDrift; i++) {
+                memcpy(&vInput[i * KERNEL_SIZE], work.prefix, KERNEL_PREFIX_SIZE);
+                WriteLE32(&vInput[i * KERNEL_SIZE + KERNEL_PREFIX_SIZE], nTimeTx + nHashDrift - i);
+            }
+            SHA256DShort(&vOutput[0], &vInput[0], KERNEL_SIZE, nHashDrift);
+            nHashes += nHashDrift;
+
+            for (unsigned int i = 0; i < nHashDrift; i++) {
+                uint256 hashProofOfStake;
+                memcpy(hashProofOfStake.begin(), &vOutput[i * 32], 32);
+                unsigned int nTryTime = nTimeTx + nHashDrift - i;
+                if (nTryTime <= nTimeMin || !(hashProofOfStake < work.bnTarget))
+                    continue;
+
+                boost::mutex::scoped_lock lock(cs);
+                if (nFound < 0 || work.nCandidate < nFound) {
+                    nFound = work.nCandidate;
+                    nTimeFound = nTryTime;
+                    hashFound = hashProofOfStake;
+                }
+                fFound = true;
+                break;
+            }
+        }
+    }
+};
+
+/** Closure representing one chunk of a kernel search, run by CCheckQueue */
+class CStakeKernelCheck
+{
+private:
+    CStakeKernelSearch* psearch;
+    size_t nBegin;
+    size_t nEnd;
+
+public:
+    CStakeKernelCheck() : psearch(NULL), nBegin(0), nEnd(0) {}
+    CStakeKernelCheck(CStakeKernelSearch* psearchIn, size_t nBeginIn, size_t nEndIn) : psearch(psearchIn), nBegin(nBeginIn), nEnd(nEndIn) {}
+
+    bool operator()()
+    {
+        psearch->Run(nBegin, nEnd);
+        return true;
+    }
+
+    void swap(CStakeKernelCheck& check)
+    {
+        std::swap(psearch, check.psearch);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+    }
+};
+} // anonymous namespace
+
+static CCheckQueue<CStakeKernelCheck> stakekernelqueue(1);
+
+void ThreadStakeKernelSearch()
+{
+    RenameThread("blocknetdx-stakesearch");
+    stakekernelqueue.Thread();
+}
+
+int SearchStakeKernelWork(const std::vector<CStakeKernelWork>& vWork, unsigned int nTimeMin, unsigned int& nTimeTx, unsigned int nHashDrift, uint256& hashProofOfStake, uint64_t& nHashes)
+{
+    CStakeKernelSearch search(vWork, nTimeMin, nTimeTx, nHashDrift);
+
+    // The chunks go to the persistent stake kernel threads, this thread helps
+    // out while waiting for them
+    std::vector<CStakeKernelCheck> vChecks;
+    for (size_t nBegin = 0; nBegin < vWork.size(); nBegin += KERNEL_SEARCH_CHUNK)
+        vChecks.push_back(CStakeKernelCheck(&search, nBegin, std::min(vWork.size(), nBegin + KERNEL_SEARCH_CHUNK)));
+
+    CCheckQueueControl<CStakeKernelCheck> control(nStakeKernelThreads > 1 && vChecks.size() > 1 ? &stakekernelqueue : NULL);
+    if (nStakeKernelThreads > 1 && vChecks.size() > 1)
+        control.Add(vChecks);
+    else {
+        BOOST_FOREACH (CStakeKernelCheck& check, vChecks)
+            check();
+    }
+    control.Wait();
+
+    nHashes = search.nHashes;
+    if (search.nFound < 0)
+        return -1;
+
+    nTimeTx = search.nTimeFound;
+    hashProofOfStake = search.hashFound;
+    return search.nFound;
+}
+
+int SearchStakeKernel(unsigned int nBits, const std::vector<CStakeKernelCandidate>& vCandidates, unsigned int nTimeMin, unsigned int& nTimeTx, unsigned int nHashDrift, uint256& hashProofOfStake)
+{
+    if (vCandidates.empty() || nHashDrift == 0)
+        return -1;
+
+    int64_t nStart = GetTimeMillis();
+
+    //grab difficulty
+    uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+
+    // Everything that needs the chain is prepared on this thread, the
+    // workers only hash
+    std::vector<CStakeKernelWork> vWork;
+    vWork.reserve(vCandidates.size());
+    for (unsigned int n = 0; n < vCandidates.size(); n++) {
+        const CStakeKernelCandidate& candidate = vCandidates[n];
+        unsigned int nTimeBlockFrom = candidate.pindexFrom->GetBlockTime();
+        if (nTimeTx < nTimeBlockFrom || nTimeBlockFrom + nStakeMinAge > nTimeTx)
+            continue; // timestamp or min age violation
+
+        uint64_t nStakeModifier = 0;
+        int nStakeModifierHeight = 0;
+        int64_t nStakeModifierTime = 0;
+        if (!GetKernelStakeModifier(candidate.pindexFrom->GetBlockHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false))
+            continue;
+
+        // Same serialization as stakeHash(), minus the time
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nStakeModifier << nTimeBlockFrom << candidate.prevout.n << candidate.prevout.hash;
+        assert(ss.size() == KERNEL_PREFIX_SIZE);
+
+        CStakeKernelWork work;
+        work.nCandidate = n;
+        memcpy(work.prefix, &ss[0], KERNEL_PREFIX_SIZE);
+        work.bnTarget = (uint256(candidate.nValueIn) / 100) * bnTargetPerCoinDay;
+        vWork.push_back(work);
+    }
+
+    uint64_t nHashes = 0;
+    int nFound = SearchStakeKernelWork(vWork, nTimeMin, nTimeTx, nHashDrift, hashProofOfStake, nHashes);
+
+    int64_t nElapsed = std::max(GetTimeMillis() - nStart, (int64_t)1);
+    LogPrint("staking", "SearchStakeKernel() : %u kernels of %u coins in %dms (%.0f kernels/s) on %d threads\n",
+        nHashes, vWork.size(), nElapsed, 1000.0 * nHashes / nElapsed, std::max(nStakeKernelThreads, 1));
+
+    mapHashedBlocks.clear();
+    mapHashedBlocks[chainActive.Tip()->nHeight] = GetTime(); //store a time stamp of when we last hashed on this block
+
+    if (nFound < 0)
+        return -1;
+
+    LogPrintf("SearchStakeKernel() : kernel found prevout=%s nTimeTx=%u hashProof=%s\n",
+        vCandidates[nFound].prevout.ToString(), nTimeTx, hashProofOfStake.ToString());
+    return nFound;
+}
+
 // Check kernel hash target and coinstake signature
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
+bool CheckProofOfStake(const CBlock& block, const CBlockIndex* pindexPrev, uint256& hashProofOfStake)
 {
-    const CTransaction tx = block.vtx[1];
+    const CTransaction& tx = block.vtx[1];
     if (!tx.IsCoinStake())
         return error("CheckProofOfStake() : called on non-coinstake %s", tx.GetHash().ToString().c_str());
 
     // Kernel (input 0) must match the stake hash target per coin age (nBits)
     const CTxIn& txin = tx.vin[0];
 
-    // First try finding the previous transaction in database
-    uint256 hashBlock;
-    CTransaction txPrev;
-    if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
-        return error("CheckProofOfStake() : INFO: read txPrev failed");
+    // The staked output is usually unspent at the tip this block builds on,
+    // take its value, script and height from the coins cache instead of reading
+    // the transaction and the block containing it from disk
+    const CBlockIndex* pindexFrom = NULL;
+    CTxOut txoutPrev;
+    {
+        const CCoins* coins = pcoinsTip->AccessCoins(txin.prevout.hash);
+        if (pindexPrev && coins && coins->IsAvailable(txin.prevout.n) && coins->nHeight <= pindexPrev->nHeight) {
+            const CBlockIndex* pindex = pindexPrev->GetAncestor(coins->nHeight);
+            if (pindex && chainActive.Contains(pindex)) {
+                pindexFrom = pindex;
+                txoutPrev = coins->vout[txin.prevout.n];
+            }
+        }
+    }
 
-    //verify signature and script
-    if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
-        return error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString().c_str());
+    if (!pindexFrom) {
+        // Spent or on another branch, find the previous transaction in database
+        uint256 hashBlock;
+        CTransaction txPrev;
+        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+            return error("CheckProofOfStake() : INFO: read txPrev failed");
 
-    CBlockIndex* pindex = NULL;
-    BlockMap::iterator it = mapBlockIndex.find(hashBlock);
-    if (it != mapBlockIndex.end())
-        pindex = it->second;
-    else
-        return error("CheckProofOfStake() : read block failed");
+        if (txin.prevout.n >= txPrev.vout.size())
+            return error("CheckProofOfStake() : invalid prevout index on coinstake %s", tx.GetHash().ToString().c_str());
+
+        BlockMap::iterator it = mapBlockIndex.find(hashBlock);
+        if (it != mapBlockIndex.end())
+            pindexFrom = it->second;
+        else
+            return error("CheckProofOfStake() : read block failed");
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
+        txoutPrev = txPrev.vout[txin.prevout.n];
+    }
+
+    //verify signature and script
+    if (!VerifyScript(txin.scriptSig, txoutPrev.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
+        return error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString().c_str());
 
     unsigned int nInterval = 0;
     unsigned int nTime = block.nTime;
-    if (!CheckStakeKernelHash(block.nBits, blockprev, txPrev, txin.prevout, nTime, nInterval, true, hashProofOfStake, fDebug))
+    if (!CheckStakeKernelHash(block.nBits, pindexFrom, txoutPrev.nValue, txin.prevout, nTime, nInterval, true, hashProofOfStake, fDebug))
         return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", tx.GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str()); // may occur during initial download or if behind on block chain sync
 
     return true;
@@ -24,11 +24,52 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
 // Sets hashProofOfStake on success return
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+// pindexFrom is the block containing the staked output, nValueIn its value
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, int64_t nValueIn, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+
+// A coin to try as stake kernel, pindexFrom is the block containing it
+struct CStakeKernelCandidate {
+    const CBlockIndex* pindexFrom;
+    COutPoint prevout;
+    int64_t nValueIn;
+
+    CStakeKernelCandidate(const CBlockIndex* pindexFromIn, const COutPoint& prevoutIn, int64_t nValueInIn) : pindexFrom(pindexFromIn), prevout(prevoutIn), nValueIn(nValueInIn) {}
+};
+
+// Serialized kernel without the time: modifier, block time, prevout index and hash
+static const size_t KERNEL_PREFIX_SIZE = 48;
+static const size_t KERNEL_SIZE = KERNEL_PREFIX_SIZE + 4;
+
+// Candidates a stake kernel thread takes from the queue at a time
+static const size_t KERNEL_SEARCH_CHUNK = 16;
+
+// Number of threads searching for stake kernels, including the staking thread itself
+extern int nStakeKernelThreads;
+
+// A candidate with its kernel prefix and its weighted target, needs no chain access
+struct CStakeKernelWork {
+    int nCandidate;
+    unsigned char prefix[KERNEL_PREFIX_SIZE];
+    uint256 bnTarget;
+};
+
+// Hash the nHashDrift timestamps up to nTimeTx + nHashDrift of each work item on
+// the stake kernel threads. Returns the lowest nCandidate that meets its target
+// at a time after nTimeMin and sets nTimeTx and hashProofOfStake, or -1
+int SearchStakeKernelWork(const std::vector<CStakeKernelWork>& vWork, unsigned int nTimeMin, unsigned int& nTimeTx, unsigned int nHashDrift, uint256& hashProofOfStake, uint64_t& nHashes);
+
+// Run a stake kernel search worker, see nStakeKernelThreads
+void ThreadStakeKernelSearch();
+
+// Search the nHashDrift timestamps up to nTimeTx + nHashDrift for a kernel of any
+// of the candidates, on the stake kernel threads. Returns the index of the candidate
+// and sets nTimeTx and hashProofOfStake, or returns -1 if none meets the target
+// at a time after nTimeMin
+int SearchStakeKernel(unsigned int nBits, const std::vector<CStakeKernelCandidate>& vCandidates, unsigned int nTimeMin, unsigned int& nTimeTx, unsigned int nHashDrift, uint256& hashProofOfStake);
 
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake);
+bool CheckProofOfStake(const CBlock& block, const CBlockIndex* pindexPrev, uint256& hashProofOfStake);
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
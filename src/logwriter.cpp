@@ -0,0 +1,320 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logwriter.h"
+
+#include "util.h"
+#include "utiltime.h"
+
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+/**
+ * Log writers that StopLogWriters() and DrainLogWriters() visit. Slots are taken
+ * and cleared with pcsLogWriters held; DrainLogWriters() runs in a signal handler,
+ * so it reads them without the lock. pcsLogWriters is never destroyed, see LogPrintStr.
+ */
+static const int MAX_LOG_WRITERS = 16;
+static std::atomic<CLogWriter*> vpLogWriters[MAX_LOG_WRITERS];
+static boost::mutex* pcsLogWriters = NULL;
+static boost::once_flag logWritersInitFlag = BOOST_ONCE_INIT;
+
+static void LogWritersInit()
+{
+    pcsLogWriters = new boost::mutex();
+}
+
+CLogWriter::CLogWriter(const boost::filesystem::path& path, bool fAsyncIn, size_t nQueueSize)
+    : file(NULL), nFileDescriptor(-1), vCells(nQueueSize), nMask(nQueueSize - 1), nEnqueuePos(0), nDequeuePos(0), nWritten(0),
+      fWriterSleeping(false), fAsync(fAsyncIn), fStopping(false), pthreadWriter(NULL), nTimeFormatted(0), fStartedNewLine(true)
+{
+    // The ring indexes cells with a mask
+    assert(nQueueSize >= 2 && (nQueueSize & nMask) == 0);
+    for (size_t i = 0; i < vCells.size(); i++)
+        vCells[i].sequence.store(i, std::memory_order_relaxed);
+
+    file = fopen(path.string().c_str(), "a");
+    if (file)
+        nFileDescriptor = fileno(file);
+    if (file && fAsync)
+        pthreadWriter = new boost::thread(boost::bind(&CLogWriter::ThreadWriter, this));
+    else
+        fAsync = false;
+
+    // A writer without a slot is only left out of the two functions at the bottom
+    boost::call_once(&LogWritersInit, logWritersInitFlag);
+    boost::mutex::scoped_lock lock(*pcsLogWriters);
+    for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+        if (vpLogWriters[i].load() == NULL) {
+            vpLogWriters[i].store(this);
+            break;
+        }
+    }
+}
+
+CLogWriter::~CLogWriter()
+{
+    {
+        boost::mutex::scoped_lock lock(*pcsLogWriters);
+        for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+            if (vpLogWriters[i].load() == this)
+                vpLogWriters[i].store(NULL);
+        }
+    }
+    Stop();
+    nFileDescriptor = -1;
+    if (file)
+        fclose(file);
+}
+
+bool CLogWriter::TryEnqueue(const std::string& str, int64_t nTime)
+{
+    // Bounded multi-producer queue: a producer claims a position with a CAS and
+    // owns its cell until it publishes the cell's next sequence number
+    Cell* cell;
+    size_t pos = nEnqueuePos.load(std::memory_order_relaxed);
+    while (true) {
+        cell = &vCells[pos & nMask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+        if (dif == 0) {
+            // Sequentially consistent, see the check of fAsync in Write()
+            if (nEnqueuePos.compare_exchange_weak(pos, pos + 1))
+                break;
+        } else if (dif < 0) {
+            return false; // full
+        } else {
+            pos = nEnqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    // Cells keep their capacity, so this rarely allocates
+    cell->str.assign(str);
+    cell->nTime = nTime;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t CLogWriter::Dequeue()
+{
+    size_t nLines = 0;
+    size_t pos = nDequeuePos.load(std::memory_order_relaxed);
+    while (true) {
+        Cell& cell = vCells[pos & nMask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+            break; // empty, or the next line is still being copied in
+        AppendLine(strBatch, cell.str, cell.nTime);
+        cell.sequence.store(pos + nMask + 1, std::memory_order_release);
+        pos++;
+        nLines++;
+    }
+    nDequeuePos.store(pos, std::memory_order_relaxed);
+    return nLines;
+}
+
+size_t CLogWriter::WriteQueued()
+{
+    // One write and flush for the whole batch
+    strBatch.clear();
+    size_t nLines = Dequeue();
+    if (nLines > 0) {
+        if (file) {
+            fwrite(strBatch.data(), 1, strBatch.size(), file);
+            fflush(file);
+        }
+        nWritten += nLines;
+    }
+    return nLines;
+}
+
+void CLogWriter::WriteAllQueued()
+{
+    // Some lines may still be being copied in by callers that saw fAsync just
+    // before Stop() changed it
+    while (nDequeuePos.load(std::memory_order_relaxed) != nEnqueuePos.load()) {
+        if (WriteQueued() == 0)
+            boost::this_thread::yield();
+    }
+}
+
+void CLogWriter::WakeWriter()
+{
+    // Pairs with the fence in ThreadWriter: either the writer sees the new
+    // line before it sleeps, or we see it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (fWriterSleeping.load(std::memory_order_relaxed)) {
+        boost::mutex::scoped_lock lock(cs);
+        condWriter.notify_one();
+    }
+}
+
+void CLogWriter::AppendLine(std::string& strOut, const std::string& str, int64_t nTime)
+{
+    // Decided in file order, so partial lines of different threads do not
+    // take each other's timestamps
+    if (nTime && fStartedNewLine) {
+        if (nTime != nTimeFormatted) {
+            strTimeFormatted = DateTimeStrFormat("%Y-%m-%d %H:%M:%S ", nTime);
+            nTimeFormatted = nTime;
+        }
+        strOut += strTimeFormatted;
+    }
+    strOut += str;
+    if (!str.empty())
+        fStartedNewLine = str[str.size() - 1] == '\n';
+}
+
+void CLogWriter::WriteDirect(const std::string& str, int64_t nTime)
+{
+    boost::mutex::scoped_lock lock(csFile);
+    if (!file)
+        return;
+    // Lines a thread queued before Stop() go before its direct ones
+    WriteAllQueued();
+    std::string strLine;
+    AppendLine(strLine, str, nTime);
+    fwrite(strLine.data(), 1, strLine.size(), file);
+    fflush(file);
+}
+
+int CLogWriter::Write(const std::string& str, int64_t nTime)
+{
+    if (!fAsync.load(std::memory_order_relaxed)) {
+        WriteDirect(str, nTime);
+        return str.size();
+    }
+    // Wait for the writer rather than lose lines when the ring is full
+    while (!TryEnqueue(str, nTime)) {
+        WakeWriter();
+        boost::this_thread::yield();
+    }
+    if (!fAsync.load()) {
+        // Stop() turned fAsync off and may have finished writing out the ring
+        // before it saw this line; one of the two sees the other's change
+        boost::mutex::scoped_lock lock(csFile);
+        WriteAllQueued();
+        return str.size();
+    }
+    WakeWriter();
+    return str.size();
+}
+
+void CLogWriter::Reopen(const boost::filesystem::path& path)
+{
+    boost::mutex::scoped_lock lock(csFile);
+    nFileDescriptor = -1;
+    if (file)
+        file = freopen(path.string().c_str(), "a", file);
+    else
+        file = fopen(path.string().c_str(), "a");
+    if (file)
+        nFileDescriptor = fileno(file);
+}
+
+void CLogWriter::Flush()
+{
+    uint64_t nTarget = nEnqueuePos.load();
+    boost::mutex::scoped_lock lock(cs);
+    while (pthreadWriter && nWritten.load() < nTarget) {
+        condWriter.notify_one();
+        condFlushed.timed_wait(lock, boost::posix_time::milliseconds(10));
+    }
+}
+
+void CLogWriter::Stop()
+{
+    boost::thread* pthread;
+    {
+        boost::mutex::scoped_lock lock(cs);
+        if (!pthreadWriter)
+            return;
+        // New lines go straight to the file from now on
+        fAsync = false;
+        fStopping = true;
+        pthread = pthreadWriter;
+        condWriter.notify_one();
+    }
+    pthread->join();
+    {
+        boost::mutex::scoped_lock lock(cs);
+        pthreadWriter = NULL;
+    }
+    delete pthread;
+
+    boost::mutex::scoped_lock lock(csFile);
+    WriteAllQueued();
+}
+
+void CLogWriter::Drain() const
+{
+    // Only atomics, memory that is not freed while the writer lives and write(2)
+    int fd = nFileDescriptor.load();
+    if (fd < 0)
+        return;
+    size_t nEnd = nEnqueuePos.load();
+    for (size_t pos = nDequeuePos.load(); pos != nEnd; pos++) {
+        const Cell& cell = vCells[pos & nMask];
+        if (cell.sequence.load(std::memory_order_acquire) != pos + 1)
+            break;
+        if (write(fd, cell.str.data(), cell.str.size()) < 0)
+            break;
+    }
+}
+
+void CLogWriter::ThreadWriter()
+{
+    RenameThread("blocknetdx-logwriter");
+
+    while (true) {
+        size_t nLines;
+        {
+            boost::mutex::scoped_lock lock(csFile);
+            nLines = WriteQueued();
+        }
+        if (nLines > 0) {
+            condFlushed.notify_all();
+            continue;
+        }
+
+        boost::mutex::scoped_lock lock(cs);
+        fWriterSleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        bool fQueued;
+        {
+            // Drain() may take lines out too
+            boost::mutex::scoped_lock lockFile(csFile);
+            fQueued = vCells[nDequeuePos & nMask].sequence.load(std::memory_order_acquire) == nDequeuePos + 1;
+        }
+        if (fQueued) {
+            fWriterSleeping = false;
+            continue;
+        }
+        if (fStopping)
+            break;
+        // The timeout bounds the delay of a missed wakeup
+        condWriter.timed_wait(lock, boost::posix_time::milliseconds(100));
+        fWriterSleeping = false;
+    }
+}
+
+void StopLogWriters()
+{
+    boost::call_once(&LogWritersInit, logWritersInitFlag);
+    boost::mutex::scoped_lock lock(*pcsLogWriters);
+    for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+        CLogWriter* pwriter = vpLogWriters[i].load();
+        if (pwriter)
+            pwriter->Stop();
+    }
+}
+
+void DrainLogWriters()
+{
+    for (int i = 0; i < MAX_LOG_WRITERS; i++) {
+        CLogWriter* pwriter = vpLogWriters[i].load();
+        if (pwriter)
+            pwriter->Drain();
+    }
+}
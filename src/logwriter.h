@@ -0,0 +1,119 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LOGWRITER_H
+#define BITCOIN_LOGWRITER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace boost
+{
+class thread;
+} // namespace boost
+
+/**
+ * Appends log lines to a file. In asynchronous mode callers only copy the line
+ * into a lock-free ring buffer; a background thread takes the lines out in
+ * batches, formats the timestamps and writes each batch with one buffered
+ * write. When the ring is full callers wait for the writer instead of dropping
+ * lines. In synchronous mode, and after Stop(), lines are written directly to
+ * the unbuffered file under a mutex.
+ */
+class CLogWriter
+{
+public:
+    static const size_t DEFAULT_QUEUE_SIZE = 4096;
+
+    CLogWriter(const boost::filesystem::path& path, bool fAsync, size_t nQueueSize = DEFAULT_QUEUE_SIZE);
+    ~CLogWriter();
+
+    bool IsOpen() const { return file != NULL; }
+
+    /**
+     * Append str, prefixed by the time nTime (seconds since the epoch) when it
+     * is not zero and str starts a new line in the file. Returns the number of
+     * characters queued or written.
+     */
+    int Write(const std::string& str, int64_t nTime = 0);
+
+    /** Continue in a new file, e.g. when the current one was rotated away. */
+    void Reopen(const boost::filesystem::path& path);
+
+    /** Wait until every line written so far is in the file. */
+    void Flush();
+
+    /** Write out the queued lines and stop the writer thread; later lines are written directly. */
+    void Stop();
+
+    /**
+     * Write the queued lines to the file with write(2), for a signal handler of
+     * a process that is about to die. Async-signal-safe: the lines are written
+     * as they were queued, without timestamps, and are left in the ring, so a
+     * line the writer thread was busy with may appear twice.
+     */
+    void Drain() const;
+
+private:
+    /** One queued line; sequence tells producers and the writer whose turn it is. */
+    struct Cell {
+        std::atomic<size_t> sequence;
+        int64_t nTime;
+        std::string str;
+    };
+
+    FILE* file;
+    //! Descriptor of file, for Drain()
+    std::atomic<int> nFileDescriptor;
+    std::vector<Cell> vCells;
+    size_t nMask;
+    std::atomic<size_t> nEnqueuePos;
+    //! Only advanced with csFile held, atomic so that Drain() may read it
+    std::atomic<size_t> nDequeuePos;
+
+    //! Number of lines the writer has taken out of the ring so far
+    std::atomic<uint64_t> nWritten;
+    std::atomic<bool> fWriterSleeping;
+    std::atomic<bool> fAsync;
+    bool fStopping;
+
+    boost::mutex cs;
+    boost::condition_variable condWriter;
+    boost::condition_variable condFlushed;
+    boost::thread* pthreadWriter;
+
+    //! Protects file, the timestamp cache and the state below; held to take lines out of the ring
+    boost::mutex csFile;
+
+    int64_t nTimeFormatted;
+    std::string strTimeFormatted;
+    //! Whether the last text written ended its line, so the next one gets a timestamp
+    bool fStartedNewLine;
+    std::string strBatch;
+
+    bool TryEnqueue(const std::string& str, int64_t nTime);
+    size_t Dequeue();
+    size_t WriteQueued();
+    void WriteAllQueued();
+    void WakeWriter();
+    void AppendLine(std::string& strOut, const std::string& str, int64_t nTime);
+    void WriteDirect(const std::string& str, int64_t nTime);
+    void ThreadWriter();
+};
+
+/** Stop the writer threads of all log writers, as the last step of shutting down. */
+void StopLogWriters();
+
+/** Write out the queued lines of all log writers from a signal handler, see CLogWriter::Drain(). */
+void DrainLogWriters();
+
+#endif // BITCOIN_LOGWRITER_H
@@ -33,6 +33,7 @@
 #include "xbridge/xbridgeapp.h"
 #include "coinvalidator.h"
 
+#include <atomic>
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
@@ -67,9 +68,11 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+bool fAddressIndex = DEFAULT_ADDRESSINDEX;
+bool fSpentIndex = DEFAULT_SPENTINDEX;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
-unsigned int nCoinCacheSize = 5000;
+size_t nCoinCacheUsage = 5000 * 300;
 bool fAlerts = DEFAULT_ALERTS;
 CoinValidator &coinValidator = CoinValidator::instance();
 
@@ -758,12 +761,13 @@ bool IsStandardTx(const CTransaction& tx, string& reason)
 
 bool IsFinalTx(const CTransaction& tx, int nBlockHeight, int64_t nBlockTime)
 {
-    AssertLockHeld(cs_main);
     // Time based nLockTime implemented in 0.1.6
     if (tx.nLockTime == 0)
         return true;
-    if (nBlockHeight == 0)
+    if (nBlockHeight == 0) {
+        AssertLockHeld(cs_main);
         nBlockHeight = chainActive.Height();
+    }
     if (nBlockTime == 0)
         nBlockTime = GetAdjustedTime();
     if ((int64_t)tx.nLockTime < ((int64_t)tx.nLockTime < LOCKTIME_THRESHOLD ? (int64_t)nBlockHeight : nBlockTime))
@@ -1286,6 +1290,14 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                 hash.ToString(),
                 nFees, ::minRelayTxFee.GetFee(nSize) * 10000);
 
+        // Keep unconfirmed chains short, the package totals of every
+        // descendant are updated when a transaction enters or leaves the pool
+        uint64_t nAncestorLimit = std::max(GetArg("-limitancestorcount", DEFAULT_ANCESTOR_LIMIT), (int64_t)1);
+        if (pool.CountAncestors(tx, nAncestorLimit) > nAncestorLimit)
+            return state.DoS(0, error("AcceptToMemoryPool : too many unconfirmed ancestors %s, limit %d",
+                                    hash.ToString(), nAncestorLimit),
+                REJECT_NONSTANDARD, "too-long-mempool-chain");
+
         // Check against previous transactions
         // This is done last to help prevent CPU exhaustion denial-of-service attacks.
         if (!CheckInputs(tx, state, view, true, STANDARD_SCRIPT_VERIFY_FLAGS, true)) {
@@ -1505,6 +1517,36 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
     return true;
 }
 
+bool GetAddressIndex(const uint160& hashBytes, int type, std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, int nStart, int nEnd)
+{
+    if (!fAddressIndex)
+        return error("%s: address index not enabled", __func__);
+
+    if (!pblocktree->ReadAddressIndex(hashBytes, type, addressIndex, nStart, nEnd))
+        return error("%s: unable to get txids for address", __func__);
+
+    return true;
+}
+
+bool GetAddressUnspent(const uint160& hashBytes, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs)
+{
+    if (!fAddressIndex)
+        return error("%s: address index not enabled", __func__);
+
+    if (!pblocktree->ReadAddressUnspentIndex(hashBytes, type, unspentOutputs))
+        return error("%s: unable to get txids for address", __func__);
+
+    return true;
+}
+
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    if (!fSpentIndex)
+        return false;
+
+    return pblocktree->ReadSpentIndex(key, value);
+}
+
 /** Return transaction in tx, and if it was found inside a block, its hash is placed in hashBlock */
 bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock, bool fAllowSlow)
 {
@@ -1979,7 +2021,7 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
     return true;
 }
 
-bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
+bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool* pfClean)
 {
     assert(pindex->GetBlockHash() == view.GetBestBlock());
 
@@ -1998,11 +2040,27 @@ bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pi
     if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("DisconnectBlock() : block and undo data inconsistent");
 
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
+
     // undo transactions in reverse order
     for (int i = block.vtx.size() - 1; i >= 0; i--) {
         const CTransaction& tx = block.vtx[i];
         uint256 hash = tx.GetHash();
 
+        if (fAddressIndex) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                const CTxOut& out = tx.vout[k];
+                int nType;
+                uint160 hashBytes;
+                if (!GetAddressIndexKey(out.scriptPubKey, nType, hashBytes))
+                    continue;
+                addressIndex.push_back(make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, hash, k, false), out.nValue));
+                addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(nType, hashBytes, hash, k), CAddressUnspentValue()));
+            }
+        }
+
         // Check that all outputs are available and match the outputs in the block itself
         // exactly. Note that transactions with only provably unspendable outputs won't
         // have outputs available even in the block itself, so we handle that case
@@ -2051,10 +2109,29 @@ bool DisconnectBlock(CBlock& block, CValidationState& /*state*/, CBlockIndex* pi
                 if (coins->vout.size() < out.n + 1)
                     coins->vout.resize(out.n + 1);
                 coins->vout[out.n] = undo.txout;
+
+                if (fSpentIndex)
+                    spentIndex.push_back(make_pair(CSpentIndexKey(out.hash, out.n), CSpentIndexValue()));
+
+                int nType;
+                uint160 hashBytes;
+                if (fAddressIndex && GetAddressIndexKey(undo.txout.scriptPubKey, nType, hashBytes)) {
+                    addressIndex.push_back(make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, hash, j, true), -undo.txout.nValue));
+                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(nType, hashBytes, out.hash, out.n), CAddressUnspentValue(undo.txout.nValue, undo.txout.scriptPubKey, coins->nHeight)));
+                }
             }
         }
     }
 
+    // The indexes are only updated for real disconnects, not when VerifyDB
+    // disconnects blocks in a scratch view
+    if (pfClean == NULL && (fAddressIndex || fSpentIndex)) {
+        // One batch, so the address RPCs, which run without cs_main, never
+        // see the block half undone
+        if (!pblocktree->DisconnectBlockIndexes(addressIndex, addressUnspentIndex, spentIndex))
+            return state.Abort("Failed to write address and spent indexes");
+    }
+
     // move best block pointer to prevout block
     view.SetBestBlock(pindex->pprev->GetBlockHash());
 
@@ -2219,6 +2296,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CDiskTxPos pos(pindex->GetBlockPos(), GetSizeOfCompactSize(block.vtx.size()));
     std::vector<std::pair<uint256, CDiskTxPos> > vPos;
     vPos.reserve(block.vtx.size());
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > addressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > spentIndex;
     blockundo.vtxundo.reserve(block.vtx.size() - 1);
     int64_t nValueOut = 0;
     int64_t nValueIn = 0;
@@ -2256,6 +2336,37 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         nValueOut += tx.GetValueOut();
 
+        if (!fJustCheck && (fAddressIndex || fSpentIndex)) {
+            const uint256 txhash = tx.GetHash();
+            // The spent outputs are only in the view until UpdateCoins
+            if (!tx.IsCoinBase()) {
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint& prevout = tx.vin[j].prevout;
+                    const CTxOut& out = view.GetOutputFor(tx.vin[j]);
+                    int nType = ADDRESS_INDEX_NONE;
+                    uint160 hashBytes;
+                    bool fIndexed = GetAddressIndexKey(out.scriptPubKey, nType, hashBytes);
+                    if (fAddressIndex && fIndexed) {
+                        addressIndex.push_back(make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, txhash, j, true), -out.nValue));
+                        addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(nType, hashBytes, prevout.hash, prevout.n), CAddressUnspentValue()));
+                    }
+                    if (fSpentIndex)
+                        spentIndex.push_back(make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, out.nValue, fIndexed ? nType : ADDRESS_INDEX_NONE, hashBytes)));
+                }
+            }
+            if (fAddressIndex) {
+                for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                    const CTxOut& out = tx.vout[k];
+                    int nType;
+                    uint160 hashBytes;
+                    if (!GetAddressIndexKey(out.scriptPubKey, nType, hashBytes))
+                        continue;
+                    addressIndex.push_back(make_pair(CAddressIndexKey(nType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+                    addressUnspentIndex.push_back(make_pair(CAddressUnspentKey(nType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+                }
+            }
+        }
+
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2318,9 +2429,14 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         setDirtyBlockIndex.insert(pindex);
     }
 
-    if (fTxIndex)
-        if (!pblocktree->WriteTxIndex(vPos))
-            return state.Abort("Failed to write transaction index");
+    if (fTxIndex || fAddressIndex || fSpentIndex) {
+        // One batch, so the address RPCs, which run without cs_main, never
+        // see the block half indexed
+        if (!fTxIndex)
+            vPos.clear();
+        if (!pblocktree->ConnectBlockIndexes(vPos, addressIndex, addressUnspentIndex, spentIndex))
+            return state.Abort("Failed to write block indexes");
+    }
 
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
@@ -2351,14 +2467,22 @@ enum FlushStateMode {
  * Update the on-disk chain state.
  * The caches and indexes are flushed if either they're too large, forceWrite is set, or
  * fast is not set and it's been a while since the last write.
+ * Except for FLUSH_STATE_ALWAYS the coins cache is not emptied: its modifications are
+ * written in the background and unmodified entries are evicted down to half of
+ * nCoinCacheUsage, so that the coins spent next are mostly still cached.
  */
 bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
 {
     LOCK(cs_main);
     static int64_t nLastWrite = 0;
     try {
-        if ((mode == FLUSH_STATE_ALWAYS) ||
-            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
+        size_t cacheSize = pcoinsTip->DynamicMemoryUsage();
+        // Start writing at three quarters of the budget, so the write can finish
+        // before the cache is full; only then wait for it to evict entries.
+        bool fCacheLarge = (mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) &&
+                           cacheSize > nCoinCacheUsage / 4 * 3 && !pcoinsTip->IsWriting();
+        bool fCacheCritical = (mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && cacheSize > nCoinCacheUsage;
+        if ((mode == FLUSH_STATE_ALWAYS) || fCacheLarge || fCacheCritical ||
             (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
             // Typical CCoins structures on disk are around 100 bytes in size.
             // Pushing a new one to the database can cause it to be written
@@ -2389,8 +2513,16 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
             }
             pblocktree->Sync();
             // Finally flush the chainstate (which may refer to block index entries).
-            if (!pcoinsTip->Flush())
-                return state.Abort("Failed to write to coin database");
+            int64_t nStart = GetTimeMicros();
+            if (mode == FLUSH_STATE_ALWAYS) {
+                if (!pcoinsTip->Flush())
+                    return state.Abort("Failed to write to coin database");
+            } else {
+                if (!pcoinsTip->Sync(nCoinCacheUsage / 2, true))
+                    return state.Abort("Failed to write to coin database");
+            }
+            LogPrint("bench", "    - Coins cache flush: %.2fms (%.1fMiB -> %.1fMiB)\n", 0.001 * (GetTimeMicros() - nStart),
+                cacheSize * (1.0 / (1 << 20)), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)));
             // Update best block in wallet (so we can detect restored wallets).
             if (mode != FLUSH_STATE_IF_NEEDED) {
                 g_signals.SetBestChain(chainActive.GetLocator());
@@ -2418,10 +2550,10 @@ void static UpdateTip(CBlockIndex* pindexNew)
     nTimeBestReceived = GetTime();
     mempool.AddTransactionsUpdated(1);
 
-    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%u\n",
+    LogPrintf("UpdateTip: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s progress=%f  cache=%.1fMiB(%utx)\n",
         chainActive.Tip()->GetBlockHash().ToString(), chainActive.Height(), log(chainActive.Tip()->nChainWork.getdouble()) / log(2.0), (unsigned long)chainActive.Tip()->nChainTx,
         DateTimeStrFormat("%Y-%m-%d %H:%M:%S", chainActive.Tip()->GetBlockTime()),
-              SyncProgress(chainActive.Height()), (unsigned int)pcoinsTip->GetCacheSize());
+              SyncProgress(chainActive.Height()), pcoinsTip->DynamicMemoryUsage() * (1.0 / (1 << 20)), (unsigned int)pcoinsTip->GetCacheSize());
 
     cvBlockChange.notify_all();
 
@@ -3257,7 +3389,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool /*fCheckPOW*/
     return true;
 }
 
-bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
+bool CheckWork(const CBlock& block, CBlockIndex* const pindexPrev)
 {
     if (pindexPrev == NULL)
         return error("%s : null pindexPrev for block %s", __func__, block.GetHash().ToString().c_str());
@@ -3281,7 +3413,7 @@ bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
         uint256 hashProofOfStake;
         uint256 hash = block.GetHash();
 
-        if(!CheckProofOfStake(block, hashProofOfStake)) {
+        if(!CheckProofOfStake(block, pindexPrev, hashProofOfStake)) {
             LogPrintf("WARNING: ProcessBlock(): check proof-of-stake failed for block %s\n", hash.ToString().c_str());
             return false;
         }
@@ -3706,30 +3838,57 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
         throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
 
-    //mark as PoS seen
-    if (pindexNew->IsProofOfStake())
-        setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
     pindexNew->phashBlock = &((*mi).first);
 
     return pindexNew;
 }
 
+/** Block index entries allocated by AllocateBlockIndex, freed as a whole at shutdown */
+static vector<pair<CBlockIndex*, size_t> > vBlockIndexArenas;
+
+CBlockIndex* AllocateBlockIndex(size_t nCount)
+{
+    if (nCount == 0)
+        return NULL;
+    CBlockIndex* pindexFirst = new CBlockIndex[nCount];
+    vBlockIndexArenas.push_back(make_pair(pindexFirst, nCount));
+    return pindexFirst;
+}
+
+static bool IsInBlockIndexArena(const CBlockIndex* pindex)
+{
+    for (unsigned int i = 0; i < vBlockIndexArenas.size(); i++) {
+        const CBlockIndex* pindexFirst = vBlockIndexArenas[i].first;
+        if (pindex >= pindexFirst && pindex < pindexFirst + vBlockIndexArenas[i].second)
+            return true;
+    }
+    return false;
+}
+
 bool static LoadBlockIndexDB()
 {
     if (!pblocktree->LoadBlockIndexGuts())
         return false;
 
     boost::this_thread::interruption_point();
+    int64_t nStart = GetTimeMicros();
 
-    // Calculate nChainWork
-    vector<pair<int, CBlockIndex*> > vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
+    // Order by height; heights are dense, so count them instead of sorting
+    int nMaxHeight = 0;
+    BOOST_FOREACH (const PAIRTYPE(uint256, CBlockIndex*) & item, mapBlockIndex)
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    vector<size_t> vHeightStart(nMaxHeight + 2, 0);
+    BOOST_FOREACH (const PAIRTYPE(uint256, CBlockIndex*) & item, mapBlockIndex)
+        vHeightStart[item.second->nHeight + 1]++;
+    for (int nHeight = 1; nHeight <= nMaxHeight + 1; nHeight++)
+        vHeightStart[nHeight] += vHeightStart[nHeight - 1];
+    vector<pair<int, CBlockIndex*> > vSortedByHeight(mapBlockIndex.size());
     BOOST_FOREACH (const PAIRTYPE(uint256, CBlockIndex*) & item, mapBlockIndex) {
         CBlockIndex* pindex = item.second;
-        vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
+        vSortedByHeight[vHeightStart[pindex->nHeight]++] = make_pair(pindex->nHeight, pindex);
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end());
+
+    // Calculate nChainWork
     BOOST_FOREACH (const PAIRTYPE(int, CBlockIndex*) & item, vSortedByHeight) {
         CBlockIndex* pindex = item.second;
         pindex->nChainWork = (pindex->pprev ? pindex->pprev->nChainWork : 0) + GetBlockProof(*pindex);
@@ -3754,6 +3913,7 @@ bool static LoadBlockIndexDB()
         if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
+    LogPrintf("%s: chain work of %u entries calculated in %dms\n", __func__, vSortedByHeight.size(), (GetTimeMicros() - nStart) / 1000);
 
     // Load block file info
     pblocktree->ReadLastBlockFile(nLastBlockFile);
@@ -3882,6 +4042,14 @@ bool static LoadBlockIndexDB()
     pblocktree->ReadFlag("txindex", fTxIndex);
     LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+    // Check whether we have the address and spent indexes
+    fAddressIndex = false;
+    pblocktree->ReadFlag("addressindex", fAddressIndex);
+    LogPrintf("LoadBlockIndexDB(): address index %s\n", fAddressIndex ? "enabled" : "disabled");
+    fSpentIndex = false;
+    pblocktree->ReadFlag("spentindex", fSpentIndex);
+    LogPrintf("LoadBlockIndexDB(): spent index %s\n", fSpentIndex ? "enabled" : "disabled");
+
     // If this is written true before the next client init, then we know the shutdown process failed
     pblocktree->WriteFlag("shutdown", false);
 
@@ -3951,7 +4119,7 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             bool fClean = true;
             if (!DisconnectBlock(block, state, pindex, coins, &fClean))
                 return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -4015,6 +4183,10 @@ bool InitBlockIndex()
     // Use the provided setting for -txindex in the new database
     fTxIndex = GetBoolArg("-txindex", true);
     pblocktree->WriteFlag("txindex", fTxIndex);
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    pblocktree->WriteFlag("addressindex", fAddressIndex);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    pblocktree->WriteFlag("spentindex", fSpentIndex);
     LogPrintf("Initializing databases...\n");
 
     // Only add the genesis block if not reindexing (in which case we reuse the one already on disk)
@@ -4885,6 +5057,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else if (pfrom->nVersion == 0) {
         // Must have a version message before anything else
+        LOCK(cs_main);
         Misbehaving(pfrom->GetId(), 1);
         return false;
     }
@@ -4909,6 +5082,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         if (pfrom->nVersion < CADDR_TIME_VERSION && addrman.size() > 1000)
             return true;
         if (vAddr.size() > 1000) {
+            LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 20);
             return error("message addr size() = %u", vAddr.size());
         }
@@ -4930,9 +5104,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                     LOCK(cs_vNodes);
                     // Use deterministic randomness to send to the same nodes for 24 hours
                     // at a time so the setAddrKnowns of the chosen nodes prevent repeats
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
+                    static const uint256 hashSalt = GetRandHash();
                     uint64_t hashAddr = addr.GetHash();
                     uint256 hashRand = hashSalt ^ (hashAddr << 32) ^ ((GetTime() + hashAddr) / (24 * 60 * 60));
                     hashRand = Hash(BEGIN(hashRand), END(hashRand));
@@ -4967,10 +5139,24 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         vector<CInv> vInv;
         vRecv >> vInv;
         if (vInv.size() > MAX_INV_SZ) {
+            LOCK(cs_main);
             Misbehaving(pfrom->GetId(), 20);
             return error("message inv size() = %u", vInv.size());
         }
 
+        // Skip transactions and gossip this peer already announced or was sent,
+        // blocks still update its block availability below
+        {
+            LOCK(pfrom->cs_inventory);
+            vector<CInv> vNewInv;
+            vNewInv.reserve(vInv.size());
+            BOOST_FOREACH (const CInv& inv, vInv) {
+                if (inv.type == MSG_BLOCK || !pfrom->setInventoryKnown.count(inv))
+                    vNewInv.push_back(inv);
+            }
+            vInv.swap(vNewInv);
+        }
+
         LOCK(cs_main);
 
         std::vector<CInv> vToFetch;
@@ -5117,7 +5303,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             //these allow servicenodes to publish a limited amount of free transactions
             vRecv >> tx >> vin >> vchSig >> sigTime;
 
-            CServicenode* pmn = mnodeman.Find(vin);
+            CServicenodePtr pmn = mnodeman.Find(vin);
             if (pmn != NULL) {
                 if (!pmn->allowFreeTx) {
                     //multiple peers can send us a valid servicenode transaction
@@ -5266,6 +5452,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // Hash them all at once, before taking cs_main; checks below reuse the cached hashes
+        CBlockHeader::CacheHashes(headers);
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -5352,7 +5541,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     // Making users (which are behind NAT and can only make outgoing connections) ignore
     // getaddr message mitigates the attack.
     else if ((strCommand == "getaddr") && (pfrom->fInbound)) {
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_vAddrToSend);
+            pfrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.GetAddr();
         BOOST_FOREACH (const CAddress& addr, vAddr)
             pfrom->PushAddress(addr);
@@ -5464,10 +5656,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         vRecv >> alert;
 
         uint256 alertHash = alert.GetHash();
-        if (pfrom->setKnown.count(alertHash) == 0) {
+        if (!pfrom->HasKnownMessage(alertHash)) {
             if (alert.ProcessAlert()) {
                 // Relay
-                pfrom->setKnown.insert(alertHash);
+                pfrom->AddKnownMessage(alertHash);
                 {
                     LOCK(cs_vNodes);
                     BOOST_FOREACH (CNode* pnode, vNodes)
@@ -5562,77 +5754,74 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
     else if (strCommand == "xbridge")
     {
-        std::vector<unsigned char> raw;
-        vRecv >> raw;
+        // payload is serialized vector of address, timestamp and packet,
+        // parsed in place and relayed as received
+        static const size_t headerSize = 20 + sizeof(uint64_t);
+
+        const char * pchPayload = vRecv.empty() ? 0 : &vRecv.begin()[0];
+        const size_t nPayloadSize = vRecv.size();
+
+        static bool isEnabled = xbridge::App::isEnabled();
 
-        uint256 hash = Hash(raw.begin(), raw.end());
-        if (!pfrom->setKnown.count(hash))
+        const uint64_t nRawSize = vRecv.empty() ? 0 : ReadCompactSize(vRecv);
+        if (nRawSize < headerSize || nRawSize != vRecv.size())
         {
-            pfrom->setKnown.insert(hash);
+            // bad packet, not relayed, small penalty from nodes
+            // running xbridge only, the others ignore the traffic
+            if (isEnabled)
+            {
+                LOCK(cs_main);
+                Misbehaving(pfrom->GetId(), 10);
+            }
+            return true;
+        }
 
-            // Relay
+        const unsigned char * raw = reinterpret_cast<const unsigned char *>(&vRecv.begin()[0]);
+
+        uint256 hash = Hash(raw, raw + nRawSize);
+        if (pfrom->AddKnownMessage(hash))
+        {
+            // Relay, one buffer for all nodes
             {
+                CSerializeDataPtr msg;
+
                 LOCK(cs_vNodes);
                 for  (CNode * pnode : vNodes)
                 {
-                    if (pnode->setKnown.insert(hash).second)
+                    if (pnode->AddKnownMessage(hash))
                     {
-                        pnode->PushMessage("xbridge", raw);
+                        if (!msg)
+                        {
+                            msg = CNode::MakeMessage("xbridge", pchPayload, nPayloadSize);
+                        }
+                        pnode->PushSharedMessage(msg);
                     }
                 }
             }
 
-            static bool isEnabled = xbridge::App::isEnabled();
             if (isEnabled)
             {
-                if (raw.size() < (20 + sizeof(time_t)))
-                {
-                    // bad packet, small penalty
-                    Misbehaving(pfrom->GetId(), 10);
-                }
-                else
-                {
-                    CValidationState state;
+                std::vector<unsigned char> addr(raw, raw + 20);
+                // packet without addr and timestamp
+                std::vector<unsigned char> packet(raw + headerSize, raw + nRawSize);
 
-                    static std::vector<unsigned char> zero(20, 0);
-                    std::vector<unsigned char> addr(raw.begin(), raw.begin()+20);
-                    // remove addr from raw
-                    raw.erase(raw.begin(), raw.begin()+20);
-                    // remove timestamp from raw
-                    raw.erase(raw.begin(), raw.begin()+sizeof(uint64_t));
-
-                    xbridge::App & app = xbridge::App::instance();
-
-                    if (addr != zero)
-                    {
-                        app.onMessageReceived(addr, raw, state);
-                    }
-                    else
-                    {
-                        app.onBroadcastReceived(raw, state);
-                    }
-
-                    int dos = 0;
-                    if (state.IsInvalid(dos))
-                    {
-                        LogPrint("xbridge", "invalid xbridge packet from peer=%d %s : %s\n",
-                            pfrom->id, pfrom->cleanSubVer,
-                            state.GetRejectReason());
-                        if (dos > 0)
-                        {
-                            Misbehaving(pfrom->GetId(), dos);
-                        }
-                    }
-                    else if (state.IsError())
-                    {
-                        LogPrint("xbridge", "xbridge packet from peer=%d %s processed with error: %s\n",
-                            pfrom->id, pfrom->cleanSubVer,
-                            state.GetRejectReason());
-                        // Misbehaving(pfrom->GetId(), 10);
-                    }
+                // verification and processing on xbridge threads
+                xbridge::App & app = xbridge::App::instance();
+                switch (app.enqueueMessage(pfrom->GetId(), addr, std::move(packet)))
+                {
+                case xbridge::App::ingressNotRunning:
+                    LogPrint("xbridge", "xbridge not running, packet from peer=%d %s dropped\n",
+                        pfrom->id, pfrom->cleanSubVer);
+                    break;
+                case xbridge::App::ingressQueueFull:
+                    LogPrint("xbridge", "xbridge queue full, packet from peer=%d %s dropped\n",
+                        pfrom->id, pfrom->cleanSubVer);
+                    break;
+                default:
+                    break;
                 }
-            }
-        } // if (isEnabled)
+            } // if (isEnabled)
+        }
     }
 
     // messages
@@ -5645,9 +5834,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
 //        // check known
 //        uint256 hash = msg.getNetworkHash();
-//        if (pfrom->setKnown.count(hash) == 0)
+//        if (!pfrom->filterKnown.contains(hash))
 //        {
-//            pfrom->setKnown.insert(hash);
+//            pfrom->filterKnown.insert(hash);
 
 //            bool isForMe = false;
 //            if (!msg.process(isForMe))
@@ -5668,9 +5857,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 //        uint256 hash;
 //        vRecv >> hash;
 
-//        if (pfrom->setKnown.count(hash) == 0)
+//        if (!pfrom->filterKnown.contains(hash))
 //        {
-//            pfrom->setKnown.insert(hash);
+//            pfrom->filterKnown.insert(hash);
 
 //            if (!Message::processReceived(hash))
 //            {
@@ -5710,6 +5899,68 @@ int ActiveProtocol()
     return MIN_PEER_PROTO_VERSION_BEFORE_ENFORCEMENT;
 }
 
+/**
+ * Commands whose handlers only use the sending peer and state with its own
+ * lock (addrman, the address and known message filters of peers, the xbridge
+ * queue). With several message handler threads these run without cs_main,
+ * every other command holds cs_main for its whole handler, so such handlers
+ * never overlap, as with a single message handler thread.
+ */
+static bool IsPeerLocalMessage(const string& strCommand)
+{
+    return strCommand == "ping" || strCommand == "pong" ||
+           strCommand == "addr" || strCommand == "getaddr" ||
+           strCommand == "xbridge";
+}
+
+/**
+ * Checks that drop a message before any cs_main section: gossip this peer
+ * sent before, sporks with a bad signature and repeated sync requests.
+ * Servicenode, winner and budget items are not deduplicated here, they are
+ * counted by servicenodeSync each time a peer sends them.
+ * Returns false if the message needs no further processing.
+ */
+static bool PreCheckMessage(CNode* pfrom, const string& strCommand, CDataStream& vRecv)
+{
+    if (fLiteMode || pfrom->nVersion == 0)
+        return true;
+
+    if (strCommand == "spork" || strCommand == "mnp" || strCommand == "ix" || strCommand == "txlvote") {
+        if (!pfrom->AddKnownMessage(Hash(vRecv.begin(), vRecv.end()))) {
+            LogPrint("net", "%s - already received from peer=%d\n", strCommand, pfrom->id);
+            return false;
+        }
+    }
+
+    if (strCommand == "spork") {
+        CDataStream vMsg(vRecv);
+        CSporkMessage spork;
+        vMsg >> spork;
+        if (!sporkManager.CheckSignature(spork)) {
+            LogPrintf("spork - invalid signature\n");
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 100);
+            return false;
+        }
+    }
+
+    if (Params().NetworkID() == CBaseChainParams::MAIN && (strCommand == "mnget" || strCommand == "mnvs")) {
+        uint256 nProp;
+        if (strCommand == "mnvs") {
+            CDataStream vMsg(vRecv);
+            vMsg >> nProp;
+        }
+        if (nProp == 0 && pfrom->HasFulfilledRequest(strCommand)) {
+            LogPrintf("%s - peer already asked me for the list\n", strCommand);
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), 20);
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode* pfrom)
 {
@@ -5785,7 +6036,14 @@ bool ProcessMessages(CNode* pfrom)
         // Process message
         bool fRet = false;
         try {
-            fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
+            if (!PreCheckMessage(pfrom, strCommand, vRecv))
+                fRet = true;
+            // inv drops entries the peer announced before and then takes cs_main itself
+            else if (nMessageHandlerThreads > 1 && !IsPeerLocalMessage(strCommand) && strCommand != "inv") {
+                LOCK(cs_main);
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
+            } else
+                fRet = ProcessMessage(pfrom, strCommand, vRecv, msg.nTime);
             boost::this_thread::interruption_point();
         } catch (std::ios_base::failure& e) {
             pfrom->PushMessage("reject", strCommand, REJECT_MALFORMED, string("error parsing message"));
@@ -5861,25 +6119,32 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             return true;
 
         // Address refresh broadcast
-        static int64_t nLastRebroadcast;
-        if (!IsInitialBlockDownload() && (GetTime() - nLastRebroadcast > 24 * 60 * 60)) {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH (CNode* pnode, vNodes) {
-                // Periodically clear setAddrKnown to allow refresh broadcasts
-                if (nLastRebroadcast)
-                    pnode->setAddrKnown.clear();
-
-                // Rebroadcast our address
-                AdvertizeLocal(pnode);
+        static std::atomic<int64_t> nLastRebroadcast(0);
+        int64_t nLastRebroadcastSeen = nLastRebroadcast;
+        if (!IsInitialBlockDownload() && (GetTime() - nLastRebroadcastSeen > 24 * 60 * 60)) {
+            // pto->cs_vSend is held here while cs_vNodes is taken before cs_vSend
+            // elsewhere, so only try it and leave the rebroadcast to a later round
+            TRY_LOCK(cs_vNodes, lockNodes);
+            // The handler thread that wins the exchange does the rebroadcast
+            if (lockNodes && !vNodes.empty() && nLastRebroadcast.compare_exchange_strong(nLastRebroadcastSeen, GetTime())) {
+                BOOST_FOREACH (CNode* pnode, vNodes) {
+                    // Periodically clear setAddrKnown to allow refresh broadcasts
+                    if (nLastRebroadcastSeen) {
+                        LOCK(pnode->cs_vAddrToSend);
+                        pnode->setAddrKnown.clear();
+                    }
+
+                    // Rebroadcast our address
+                    AdvertizeLocal(pnode);
+                }
             }
-            if (!vNodes.empty())
-                nLastRebroadcast = GetTime();
         }
 
         //
         // Message: addr
         //
         if (fSendTrickle) {
+            LOCK(pto->cs_vAddrToSend);
             vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             BOOST_FOREACH (const CAddress& addr, pto->vAddrToSend) {
@@ -5956,9 +6221,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
                 // trickle out tx inv to protect privacy
                 if (inv.type == MSG_TX && !fSendTrickle) {
                     // 1/4 of tx invs blast to all immediately
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
+                    static const uint256 hashSalt = GetRandHash();
                     uint256 hashRand = inv.hash ^ hashSalt;
                     hashRand = Hash(BEGIN(hashRand), END(hashRand));
                     bool fTrickleWait = ((hashRand & 3) != 0);
@@ -6115,8 +6378,12 @@ public:
         // block headers
         BlockMap::iterator it1 = mapBlockIndex.begin();
         for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
+            if (!IsInBlockIndexArena((*it1).second))
+                delete (*it1).second;
         mapBlockIndex.clear();
+        for (unsigned int i = 0; i < vBlockIndexArenas.size(); i++)
+            delete[] vBlockIndexArenas[i].first;
+        vBlockIndexArenas.clear();
 
         // orphan transactions
         mapOrphanTransactions.clear();
@@ -13,6 +13,7 @@
 #include "config/blocknetdx-config.h"
 #endif
 
+#include "addressindex.h"
 #include "amount.h"
 #include "chain.h"
 #include "chainparams.h"
@@ -60,6 +61,10 @@ static const unsigned int DEFAULT_BLOCK_MIN_SIZE = 0;
 static const unsigned int DEFAULT_BLOCK_PRIORITY_SIZE = 50000;
 /** Default for accepting alerts from the P2P network. */
 static const bool DEFAULT_ALERTS = true;
+/** Default for -addressindex */
+static const bool DEFAULT_ADDRESSINDEX = false;
+/** Default for -spentindex */
+static const bool DEFAULT_SPENTINDEX = false;
 /** The maximum size for transactions we're willing to relay/mine */
 static const unsigned int MAX_STANDARD_TX_SIZE = 100000;
 /** The maximum allowed number of signature check operations in a block (network rule) */
@@ -70,6 +75,8 @@ static const unsigned int MAX_P2SH_SIGOPS = 15;
 static const unsigned int MAX_TX_SIGOPS = MAX_BLOCK_SIGOPS / 5;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -limitancestorcount, max number of in-mempool ancestors of a transaction, itself included */
+static const unsigned int DEFAULT_ANCESTOR_LIMIT = 25;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -128,9 +135,11 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fSpentIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
-extern unsigned int nCoinCacheSize;
+extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
 
@@ -218,6 +227,12 @@ bool IsInitialBlockDownload();
 std::string GetWarnings(std::string strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock, bool fAllowSlow = false);
+/** Retrieve the outputs paying and inputs spending an address, optionally between two heights (requires -addressindex) */
+bool GetAddressIndex(const uint160& hashBytes, int type, std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex, int nStart = 0, int nEnd = 0);
+/** Retrieve the unspent outputs of an address (requires -addressindex) */
+bool GetAddressUnspent(const uint160& hashBytes, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& unspentOutputs);
+/** Retrieve the input that spent an output (requires -spentindex) */
+bool GetSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
 /** Find the best known block, and make it the tip of the block chain */
 
 bool DisconnectBlocksAndReprocess(int blocks);
@@ -232,6 +247,8 @@ CAmount GetBlockValue(int nHeight);
 
 /** Create a new block index entry for a given block hash */
 CBlockIndex* InsertBlockIndex(uint256 hash);
+/** Allocate nCount block index entries in one piece, to be put into mapBlockIndex by the caller */
+CBlockIndex* AllocateBlockIndex(size_t nCount);
 /** Abort with a message */
 // bool AbortNode(const std::string& msg, const std::string& userMessage = "");
 /** Get statistics from node state */
@@ -432,7 +449,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
-bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev);
+bool CheckWork(const CBlock& block, CBlockIndex* const pindexPrev);
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* pindexPrev);
@@ -0,0 +1,56 @@
+// Copyright (c) 2015 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_MEMUSAGE_H
+#define BITCOIN_MEMUSAGE_H
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+namespace memusage
+{
+/**
+ * Compute the total memory used by allocating alloc bytes on the heap,
+ * including the malloc bookkeeping (measured on glibc on Linux).
+ */
+static inline size_t MallocUsage(size_t alloc)
+{
+    if (alloc == 0)
+        return 0;
+    if (sizeof(void*) == 8) {
+        return ((alloc + 31) >> 4) << 4;
+    } else if (sizeof(void*) == 4) {
+        return ((alloc + 15) >> 3) << 3;
+    } else {
+        assert(0);
+    }
+}
+
+/** Dynamic memory usage of containers, not including the container object itself. */
+
+template <typename X>
+static inline size_t DynamicUsage(const std::vector<X>& v)
+{
+    return MallocUsage(v.capacity() * sizeof(X));
+}
+
+/** Approximation of a boost::unordered_map node: the value and a next pointer. */
+template <typename X>
+struct unordered_node : private X {
+private:
+    void* ptr;
+};
+
+template <typename X, typename Y, typename Z>
+static inline size_t DynamicUsage(const boost::unordered_map<X, Y, Z>& m)
+{
+    return MallocUsage(sizeof(unordered_node<std::pair<const X, Y> >)) * m.size() + MallocUsage(sizeof(void*) * m.bucket_count());
+}
+}
+
+#endif // BITCOIN_MEMUSAGE_H
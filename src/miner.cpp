@@ -36,51 +36,39 @@ using namespace std;
 
 //
 // Unconfirmed transactions in the memory pool often depend on other
-// transactions in the memory pool. When we select transactions from the
-// pool, we select by highest priority or fee rate, so we might consider
-// transactions that depend on transactions that aren't yet in the block.
-// The COrphan class keeps track of these 'temporary orphans' while
-// CreateBlock is figuring out which transactions to include.
+// transactions in the memory pool. The mempool keeps its entries indexed by
+// priority and by the fee rate of their ancestor package, so block assembly
+// walks the top of those indexes and pulls in missing ancestors first,
+// instead of scoring and sorting the whole pool for every template.
 //
-class COrphan
+class CBlockCandidate
 {
 public:
-    const CTransaction* ptx;
-    set<uint256> setDependsOn;
+    CTransaction tx;
     CFeeRate feeRate;
     double dPriority;
 
-    COrphan(const CTransaction* ptxIn) : ptx(ptxIn), feeRate(0), dPriority(0)
+    CBlockCandidate(const CTransaction& txIn, const CFeeRate& feeRateIn, double dPriorityIn) : tx(txIn), feeRate(feeRateIn), dPriority(dPriorityIn)
     {
     }
 };
 
-uint64_t nLastBlockTx = 0;
-uint64_t nLastBlockSize = 0;
-int64_t nLastCoinStakeSearchInterval = 0;
+// Stop walking the fee index after this many packages that did not fit
+static const unsigned int MAX_CONSECUTIVE_FAILURES = 1000;
 
-// We want to sort transactions by priority and fee rate, so:
-typedef boost::tuple<double, CFeeRate, const CTransaction*> TxPriority;
-class TxPriorityCompare
+// A package can only be included if all of its unconfirmed transactions are final
+static bool IsFinalPackage(const std::vector<const CTxMemPoolEntry*>& package, int nHeight, int64_t nLockTimeCutoff)
 {
-    bool byFee;
-
-public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
-
-    bool operator()(const TxPriority& a, const TxPriority& b)
-    {
-        if (byFee) {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
-        } else {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
-        }
+    BOOST_FOREACH (const CTxMemPoolEntry* entry, package) {
+        if (!IsFinalTx(entry->GetTx(), nHeight, nLockTimeCutoff))
+            return false;
     }
-};
+    return true;
+}
+
+uint64_t nLastBlockTx = 0;
+uint64_t nLastBlockSize = 0;
+int64_t nLastCoinStakeSearchInterval = 0;
 
 void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
 {
@@ -160,103 +148,120 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 
     // Collect memory pool transactions into the block
     CAmount nFees = 0;
+    bool fPrintPriority = GetBoolArg("-printpriority", false);
 
+    // Height the template builds on, used for priority aging and lock times
+    // while the candidates are picked
+    unsigned int nNextHeight = 0;
     {
-        LOCK2(cs_main, mempool.cs);
+        LOCK(cs_main);
+        nNextHeight = chainActive.Height() + 1;
+    }
+    const int64_t nLockTimeCutoff = GetAdjustedTime();
 
-        CBlockIndex* pindexPrev = chainActive.Tip();
-        const int nHeight = pindexPrev->nHeight + 1;
-        CCoinsViewCache view(pcoinsTip);
+    // Pick the candidates from the top of the mempool indexes while holding
+    // only the mempool lock, parents always come before their children
+    std::vector<CBlockCandidate> vCandidates;
+    {
+        LOCK(mempool.cs);
+
+        std::set<uint256> setSelected;
+        uint64_t nSelectedSize = 1000;
+        std::vector<const CTxMemPoolEntry*> ancestors;
+
+        // High-priority transactions first, included regardless of the fees they pay
+        CTxMemPool::indexed_by_priority::const_iterator itPriority = mempool.mapTxByPriority.begin();
+        for (; nBlockPrioritySize > 0 && itPriority != mempool.mapTxByPriority.end() && nSelectedSize < nBlockPrioritySize; ++itPriority) {
+            const CTxMemPoolEntry* entry = *itPriority;
+            const uint256& hash = entry->GetTx().GetHash();
+            if (setSelected.count(hash))
+                continue;
 
-        // Priority order to process transactions
-        list<COrphan> vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*> > mapDependers;
-        bool fPrintPriority = GetBoolArg("-printpriority", false);
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->second.GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
+            if (!AllowFree(entry->GetModifiedPriority(std::max(nNextHeight, entry->GetHeight()))))
+                break;
+
+            ancestors.clear();
+            mempool.CalculateAncestors(hash, setSelected, ancestors);
+            if (!IsFinalPackage(ancestors, nNextHeight, nLockTimeCutoff))
                 continue;
 
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                // Read prev transaction
-                if (!view.HaveCoins(txin.prevout.hash)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        if (fDebug) assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
+            BOOST_FOREACH (const CTxMemPoolEntry* ancestor, ancestors) {
+                setSelected.insert(ancestor->GetTx().GetHash());
+                nSelectedSize += ancestor->GetTxSize();
+                vCandidates.push_back(CBlockCandidate(ancestor->GetTx(),
+                    CFeeRate(ancestor->GetModifiedFee(), ancestor->GetTxSize()),
+                    ancestor->GetModifiedPriority(std::max(nNextHeight, ancestor->GetHeight()))));
+            }
+        }
 
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-                    continue;
-                }
-                const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-                assert(coins);
+        // Then by the fee rate of the ancestor package
+        uint64_t nPackageSize = 0;
+        CAmount nPackageFees = 0;
+        bool fPrioritised = false;
+        unsigned int nFailures = 0;
+        CTxMemPool::indexed_by_ancestor_fee::const_iterator itFee = mempool.mapTxByAncestorFee.begin();
+        for (; itFee != mempool.mapTxByAncestorFee.end() && nSelectedSize < nBlockMaxSize; ++itFee) {
+            const CTxMemPoolEntry* entry = *itFee;
+            const uint256& hash = entry->GetTx().GetHash();
+            if (setSelected.count(hash))
+                continue;
 
-                CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
+            ancestors.clear();
+            mempool.CalculateAncestors(hash, setSelected, ancestors);
+            if (!IsFinalPackage(ancestors, nNextHeight, nLockTimeCutoff))
+                continue;
 
-                int nConf = nHeight - coins->nHeight;
+            nPackageSize = 0;
+            nPackageFees = 0;
+            fPrioritised = false;
+            BOOST_FOREACH (const CTxMemPoolEntry* ancestor, ancestors) {
+                nPackageSize += ancestor->GetTxSize();
+                nPackageFees += ancestor->GetModifiedFee();
+                double dPriorityDelta = 0;
+                CAmount nFeeDelta = 0;
+                mempool.ApplyDeltas(ancestor->GetTx().GetHash(), dPriorityDelta, nFeeDelta);
+                if (dPriorityDelta > 0 || nFeeDelta > 0)
+                    fPrioritised = true;
+            }
 
-                dPriority += (double)nValueIn * nConf;
+            if (nSelectedSize + nPackageSize >= nBlockMaxSize) {
+                if (++nFailures > MAX_CONSECUTIVE_FAILURES)
+                    break;
+                continue;
             }
-            if (fMissingInputs) continue;
+            nFailures = 0;
 
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
+            // Skip free transactions if we're past the minimum block size,
+            // the index is sorted so everything after pays even less
+            CFeeRate packageFeeRate(nPackageFees, nPackageSize);
+            if (!fPrioritised && (packageFeeRate < ::minRelayTxFee) && (nSelectedSize + nPackageSize >= nBlockMinSize))
+                break;
 
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
+            BOOST_FOREACH (const CTxMemPoolEntry* ancestor, ancestors) {
+                setSelected.insert(ancestor->GetTx().GetHash());
+                nSelectedSize += ancestor->GetTxSize();
+                vCandidates.push_back(CBlockCandidate(ancestor->GetTx(), packageFeeRate,
+                    ancestor->GetModifiedPriority(std::max(nNextHeight, ancestor->GetHeight()))));
+            }
+        }
+    }
 
-            CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
+    {
+        LOCK(cs_main);
 
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->feeRate = feeRate;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
-        }
+        CBlockIndex* pindexPrev = chainActive.Tip();
+        const int nHeight = pindexPrev->nHeight + 1;
+        CCoinsViewCache view(pcoinsTip);
 
         // Collect transactions into block
         uint64_t nBlockSize = 1000;
         uint64_t nBlockTx = 0;
         int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
 
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
+        BOOST_FOREACH (const CBlockCandidate& candidate, vCandidates) {
+            const CTransaction& tx = candidate.tx;
+            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight))
+                continue;
 
             // Size limits
             unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
@@ -268,23 +273,8 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
                 continue;
 
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
-
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
-
+            // Parents that were skipped, or inputs spent since the candidates
+            // were picked, leave this one without inputs
             if (!view.HaveInputs(tx))
                 continue;
 
@@ -315,20 +305,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 
             if (fPrintPriority) {
                 LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
-            }
-
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                BOOST_FOREACH (COrphan* porphan, mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
+                    candidate.dPriority, candidate.feeRate.ToString(), tx.GetHash().ToString());
             }
         }
 
@@ -15,6 +15,7 @@
 #include "addrman.h"
 #include "chainparams.h"
 #include "clientversion.h"
+#include "kernel.h"
 #include "miner.h"
 #include "obfuscation.h"
 #include "primitives/transaction.h"
@@ -27,6 +28,10 @@
 #include <fcntl.h>
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -34,6 +39,8 @@
 #include <miniupnpc/upnperrors.h>
 #endif
 
+#include <limits>
+
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -85,6 +92,7 @@ uint64_t nLocalHostNonce = 0;
 static std::vector<ListenSocket> vhListenSocket;
 CAddrMan addrman;
 int nMaxConnections = 125;
+int nMessageHandlerThreads = DEFAULT_MESSAGE_HANDLER_THREADS;
 bool fAddressesInitialized = false;
 
 vector<CNode*> vNodes;
@@ -377,6 +385,11 @@ CNode* FindNode(const CService& addr)
     return NULL;
 }
 
+#ifdef HAVE_SYS_EPOLL_H
+// epoll instance ThreadSocketHandler waits on, -1 when select() is used
+static int hSocketEvents = -1;
+#endif
+
 CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool obfuScationMaster)
 {
     if (pszDest == NULL) {
@@ -405,7 +418,12 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest, bool obfuScationMa
     bool proxyConnectionFailed = false;
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), nConnectTimeout, &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, nConnectTimeout, &proxyConnectionFailed)) {
-        if (!IsSelectableSocket(hSocket)) {
+        // epoll is not limited to FD_SETSIZE descriptors
+        bool fSelectable = IsSelectableSocket(hSocket);
+#ifdef HAVE_SYS_EPOLL_H
+        fSelectable = fSelectable || hSocketEvents != -1;
+#endif
+        if (!fSelectable) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NULL;
@@ -590,7 +608,7 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
-            messageHandlerCondition.notify_one();
+            messageHandlerCondition.notify_all();
         }
     }
 
@@ -647,10 +665,10 @@ int CNetMessage::readData(const char* pch, unsigned int nBytes)
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode* pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    std::deque<CSerializeDataPtr>::iterator it = pnode->vSendMsg.begin();
 
     while (it != pnode->vSendMsg.end()) {
-        const CSerializeData& data = *it;
+        const CSerializeData& data = **it;
         assert(data.size() > pnode->nSendOffset);
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
         if (nBytes > 0) {
@@ -689,9 +707,462 @@ void SocketSendData(CNode* pnode)
 
 static list<CNode*> vNodesDisconnected;
 
+static void AcceptConnection(const ListenSocket& hListenSocket)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t len = sizeof(sockaddr);
+    SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
+    CAddress addr;
+    int nInbound = 0;
+
+    if (hSocket != INVALID_SOCKET)
+        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+            LogPrintf("Warning: Unknown socket family\n");
+
+    bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    // epoll is not limited to FD_SETSIZE descriptors
+    bool fSelectable = IsSelectableSocket(hSocket);
+#ifdef HAVE_SYS_EPOLL_H
+    fSelectable = fSelectable || hSocketEvents != -1;
+#endif
+
+    if (hSocket == INVALID_SOCKET) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
+    } else if (!fSelectable) {
+        LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
+        CloseSocket(hSocket);
+    } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
+        LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
+        CloseSocket(hSocket);
+    } else if (CNode::IsBanned(addr) && !whitelisted) {
+        LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
+        CloseSocket(hSocket);
+    } else {
+        CNode* pnode = new CNode(hSocket, addr, "", true);
+        pnode->AddRef();
+        pnode->fWhitelisted = whitelisted;
+
+        {
+            LOCK(cs_vNodes);
+            vNodes.push_back(pnode);
+        }
+    }
+}
+
+/**
+ * Read once from the socket of pnode into its receive buffer. Returns false
+ * when nothing more can be read for now: the socket would block, was closed
+ * or failed.
+ */
+static bool SocketRecvData(CNode* pnode)
+{
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0) {
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
+            pnode->CloseSocketDisconnect();
+        pnode->nLastRecv = GetTime();
+        pnode->nRecvBytes += nBytes;
+        pnode->RecordBytesRecv(nBytes);
+        return pnode->hSocket != INVALID_SOCKET;
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            LogPrint("net", "socket closed\n");
+        pnode->CloseSocketDisconnect();
+    } else if (nBytes < 0) {
+        // error
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+            if (!pnode->fDisconnect)
+                LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
+            pnode->CloseSocketDisconnect();
+        }
+    }
+    return false;
+}
+
+static void InactivityCheck(CNode* pnode, int64_t nTime)
+{
+    if (nTime - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
+            LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
+            pnode->fDisconnect = true;
+        } else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
+            LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
+            pnode->fDisconnect = true;
+        } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
+            LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+static bool ReceiveBufferHasRoom(CNode* pnode)
+{
+    return pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
+           pnode->GetTotalRecvSize() <= ReceiveFloodSize();
+}
+
+/**
+ * Wait up to 50ms for socket activity with select() and service the ready
+ * sockets. Returns the microseconds spent blocked in select().
+ */
+static int64_t SocketHandlerSelect()
+{
+    //
+    // Find which sockets have data to receive
+    //
+    struct timeval timeout;
+    timeout.tv_sec = 0;
+    timeout.tv_usec = 50000; // frequency to poll pnode->vSend
+
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    SOCKET hSocketMax = 0;
+    bool have_fds = false;
+
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+        FD_SET(hListenSocket.socket, &fdsetRecv);
+        hSocketMax = max(hSocketMax, hListenSocket.socket);
+        have_fds = true;
+    }
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes) {
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            FD_SET(pnode->hSocket, &fdsetError);
+            hSocketMax = max(hSocketMax, pnode->hSocket);
+            have_fds = true;
+
+            // Implement the following logic:
+            // * If there is data to send, select() for sending data. As this only
+            //   happens when optimistic write failed, we choose to first drain the
+            //   write buffer in this case before receiving more. This avoids
+            //   needlessly queueing received data, if the remote peer is not themselves
+            //   receiving data. This means properly utilizing TCP flow control signalling.
+            // * Otherwise, if there is no (complete) message in the receive buffer,
+            //   or there is space left in the buffer, select() for receiving data.
+            // * (if neither of the above applies, there is certainly one message
+            //   in the receiver buffer ready to be processed).
+            // Together, that means that at least one of the following is always possible,
+            // so we don't deadlock:
+            // * We send some data.
+            // * We wait for data to be received (and disconnect after timeout).
+            // * We process a message in the buffer (message handler thread).
+            {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend && !pnode->vSendMsg.empty()) {
+                    FD_SET(pnode->hSocket, &fdsetSend);
+                    continue;
+                }
+            }
+            {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                if (lockRecv && ReceiveBufferHasRoom(pnode))
+                    FD_SET(pnode->hSocket, &fdsetRecv);
+            }
+        }
+    }
+
+    int64_t nWaitStart = GetTimeMicros();
+    int nSelect = select(have_fds ? hSocketMax + 1 : 0,
+        &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    int64_t nWaited = GetTimeMicros() - nWaitStart;
+    boost::this_thread::interruption_point();
+
+    if (nSelect == SOCKET_ERROR) {
+        if (have_fds) {
+            int nErr = WSAGetLastError();
+            LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+            for (unsigned int i = 0; i <= hSocketMax; i++)
+                FD_SET(i, &fdsetRecv);
+        }
+        FD_ZERO(&fdsetSend);
+        FD_ZERO(&fdsetError);
+        MilliSleep(timeout.tv_usec / 1000);
+        nWaited += timeout.tv_usec;
+    }
+
+    //
+    // Accept new connections
+    //
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+        if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            AcceptConnection(hListenSocket);
+    }
+
+    //
+    // Service each socket
+    //
+    vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        vNodesCopy = vNodes;
+        BOOST_FOREACH (CNode* pnode, vNodesCopy)
+            pnode->AddRef();
+    }
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        boost::this_thread::interruption_point();
+
+        //
+        // Receive
+        //
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv)
+                SocketRecvData(pnode);
+        }
+
+        //
+        // Send
+        //
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
+            TRY_LOCK(pnode->cs_vSend, lockSend);
+            if (lockSend)
+                SocketSendData(pnode);
+        }
+
+        //
+        // Inactivity checking
+        //
+        InactivityCheck(pnode, GetTime());
+    }
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodesCopy)
+            pnode->Release();
+    }
+
+    return nWaited;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/**
+ * Wait for socket activity with edge-triggered epoll and service the ready
+ * sockets. Returns the microseconds spent blocked in epoll_wait().
+ *
+ * Each node socket is registered once for input and output. Edge triggering
+ * reports a socket again only after its state changed, so the handler keeps
+ * the readiness in CNode::fSocketReadable/fSocketWritable until a recv() or
+ * send() would block. Output readiness is only reported after an optimistic
+ * write left data queued, so idle peers cost no wakeups and no syscalls.
+ */
+static int64_t SocketHandlerEpoll()
+{
+    // Max reads of one socket per wakeup, so that a fast peer can not starve the others
+    static const int MAX_RECV_PER_WAKEUP = 8;
+    static const int MAX_EVENTS = 256;
+    // Set when a socket was left readable without being throttled
+    static bool fMoreReady = false;
+
+    vector<CNode*> vNodesCopy;
+    {
+        LOCK(cs_vNodes);
+        vNodesCopy = vNodes;
+        BOOST_FOREACH (CNode* pnode, vNodesCopy)
+            pnode->AddRef();
+    }
+
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        if (pnode->fSocketRegistered || pnode->hSocket == INVALID_SOCKET)
+            continue;
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.ptr = pnode;
+        if (epoll_ctl(hSocketEvents, EPOLL_CTL_ADD, pnode->hSocket, &event) != 0) {
+            LogPrintf("socket epoll_ctl error %s\n", NetworkErrorString(WSAGetLastError()));
+            pnode->CloseSocketDisconnect();
+            continue;
+        }
+        // The first edge may have happened before registration
+        pnode->fSocketRegistered = true;
+        pnode->fSocketReadable = true;
+        pnode->fSocketWritable = true;
+        fMoreReady = true;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    int64_t nWaitStart = GetTimeMicros();
+    int nEvents = epoll_wait(hSocketEvents, events, MAX_EVENTS, fMoreReady ? 0 : 50);
+    int64_t nWaited = GetTimeMicros() - nWaitStart;
+    boost::this_thread::interruption_point();
+
+    if (nEvents < 0) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR)
+            LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+        nEvents = 0;
+    }
+
+    // A full batch may leave events pending in the kernel
+    fMoreReady = nEvents == MAX_EVENTS;
+    bool fAccept = false;
+    for (int i = 0; i < nEvents; i++) {
+        CNode* pnode = (CNode*)events[i].data.ptr;
+        if (!pnode) {
+            // listen sockets are registered without a node
+            fAccept = true;
+            continue;
+        }
+        // errors and hangups are reported by the next recv()
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            pnode->fSocketReadable = true;
+        if (events[i].events & EPOLLOUT)
+            pnode->fSocketWritable = true;
+    }
+
+    //
+    // Accept new connections
+    //
+    if (fAccept) {
+        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+            if (hListenSocket.socket != INVALID_SOCKET)
+                AcceptConnection(hListenSocket);
+        }
+    }
+
+    //
+    // Service each ready socket, see SocketHandlerSelect for the order of send and receive
+    //
+    int64_t nTime = GetTime();
+    BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+        boost::this_thread::interruption_point();
+
+        //
+        // Send
+        //
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        bool fSendQueued = false;
+        if (pnode->fSocketWritable) {
+            TRY_LOCK(pnode->cs_vSend, lockSend);
+            if (lockSend && !pnode->vSendMsg.empty()) {
+                SocketSendData(pnode);
+                // partial write: the socket buffer is full until EPOLLOUT
+                fSendQueued = !pnode->vSendMsg.empty();
+                if (fSendQueued)
+                    pnode->fSocketWritable = false;
+            }
+        }
+
+        //
+        // Receive
+        //
+        if (pnode->hSocket == INVALID_SOCKET)
+            continue;
+        if (pnode->fSocketReadable && !fSendQueued) {
+            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+            if (lockRecv) {
+                int nRecv = 0;
+                while (ReceiveBufferHasRoom(pnode)) {
+                    if (!SocketRecvData(pnode)) {
+                        pnode->fSocketReadable = false;
+                        break;
+                    }
+                    if (++nRecv == MAX_RECV_PER_WAKEUP) {
+                        fMoreReady = true;
+                        break;
+                    }
+                }
+            }
+        }
+
+        //
+        // Inactivity checking
+        //
+        InactivityCheck(pnode, nTime);
+    }
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodesCopy)
+            pnode->Release();
+    }
+
+    return nWaited;
+}
+
+void StartSocketEvents()
+{
+    if (!GetBoolArg("-useepoll", true) || hSocketEvents != -1)
+        return;
+
+    hSocketEvents = epoll_create1(EPOLL_CLOEXEC);
+    if (hSocketEvents == -1) {
+        LogPrintf("epoll_create1 failed with error %s, using select()\n", NetworkErrorString(WSAGetLastError()));
+        return;
+    }
+
+    BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
+        if (hListenSocket.socket == INVALID_SOCKET)
+            continue;
+        // level-triggered, AcceptConnection takes one connection per wakeup
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = NULL;
+        if (epoll_ctl(hSocketEvents, EPOLL_CTL_ADD, hListenSocket.socket, &event) != 0) {
+            LogPrintf("epoll_ctl(hListenSocket) failed with error %s, using select()\n", NetworkErrorString(WSAGetLastError()));
+            close(hSocketEvents);
+            hSocketEvents = -1;
+            return;
+        }
+    }
+    LogPrintf("Using epoll for network events\n");
+}
+#else
+void StartSocketEvents() {}
+#endif
+
+void StopSocketEvents()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (hSocketEvents != -1) {
+        close(hSocketEvents);
+        hSocketEvents = -1;
+    }
+#endif
+}
+
+int64_t SocketHandlerWait()
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (hSocketEvents != -1)
+        return SocketHandlerEpoll();
+#endif
+    return SocketHandlerSelect();
+}
+
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    int64_t nWakeups = 0;
+    int64_t nWakeupTime = 0;
+
+    StartSocketEvents();
+
     while (true) {
         //
         // Disconnect nodes
@@ -749,217 +1220,15 @@ void ThreadSocketHandler()
             uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
         }
 
-        //
-        // Find which sockets have data to receive
-        //
-        struct timeval timeout;
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-
-        fd_set fdsetRecv;
-        fd_set fdsetSend;
-        fd_set fdsetError;
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
-        SOCKET hSocketMax = 0;
-        bool have_fds = false;
-
-        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
-        }
-
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH (CNode* pnode, vNodes) {
-                if (pnode->hSocket == INVALID_SOCKET)
-                    continue;
-                FD_SET(pnode->hSocket, &fdsetError);
-                hSocketMax = max(hSocketMax, pnode->hSocket);
-                have_fds = true;
-
-                // Implement the following logic:
-                // * If there is data to send, select() for sending data. As this only
-                //   happens when optimistic write failed, we choose to first drain the
-                //   write buffer in this case before receiving more. This avoids
-                //   needlessly queueing received data, if the remote peer is not themselves
-                //   receiving data. This means properly utilizing TCP flow control signalling.
-                // * Otherwise, if there is no (complete) message in the receive buffer,
-                //   or there is space left in the buffer, select() for receiving data.
-                // * (if neither of the above applies, there is certainly one message
-                //   in the receiver buffer ready to be processed).
-                // Together, that means that at least one of the following is always possible,
-                // so we don't deadlock:
-                // * We send some data.
-                // * We wait for data to be received (and disconnect after timeout).
-                // * We process a message in the buffer (message handler thread).
-                {
-                    TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
-                    }
-                }
-                {
-                    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                    if (lockRecv && (pnode->vRecvMsg.empty() || !pnode->vRecvMsg.front().complete() ||
-                                        pnode->GetTotalRecvSize() <= ReceiveFloodSize()))
-                        FD_SET(pnode->hSocket, &fdsetRecv);
-                }
-            }
-        }
-
-        int nSelect = select(have_fds ? hSocketMax + 1 : 0,
-            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
-        boost::this_thread::interruption_point();
-
-        if (nSelect == SOCKET_ERROR) {
-            if (have_fds) {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
-        }
-
-        //
-        // Accept new connections
-        //
-        BOOST_FOREACH (const ListenSocket& hListenSocket, vhListenSocket) {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv)) {
-                struct sockaddr_storage sockaddr;
-                socklen_t len = sizeof(sockaddr);
-                SOCKET hSocket = accept(hListenSocket.socket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        LogPrintf("Warning: Unknown socket family\n");
-
-                bool whitelisted = hListenSocket.whitelisted || CNode::IsWhitelistedRange(addr);
-                {
-                    LOCK(cs_vNodes);
-                    BOOST_FOREACH (CNode* pnode, vNodes)
-                        if (pnode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET) {
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-                } else if (!IsSelectableSocket(hSocket)) {
-                    LogPrintf("connection from %s dropped: non-selectable socket\n", addr.ToString());
-                    CloseSocket(hSocket);
-                } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
-                    LogPrint("net", "connection from %s dropped (full)\n", addr.ToString());
-                    CloseSocket(hSocket);
-                } else if (CNode::IsBanned(addr) && !whitelisted) {
-                    LogPrintf("connection from %s dropped (banned)\n", addr.ToString());
-                    CloseSocket(hSocket);
-                } else {
-                    CNode* pnode = new CNode(hSocket, addr, "", true);
-                    pnode->AddRef();
-                    pnode->fWhitelisted = whitelisted;
-
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pnode);
-                    }
-                }
-            }
-        }
-
-        //
-        // Service each socket
-        //
-        vector<CNode*> vNodesCopy;
-        {
-            LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy)
-                pnode->AddRef();
-        }
-        BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-            boost::this_thread::interruption_point();
-
-            //
-            // Receive
-            //
-            if (pnode->hSocket == INVALID_SOCKET)
-                continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
-                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                            pnode->nRecvBytes += nBytes;
-                            pnode->RecordBytesRecv(nBytes);
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                LogPrint("net", "socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    LogPrintf("socket recv error %s\n", NetworkErrorString(nErr));
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
-            }
-
-            //
-            // Send
-            //
-            if (pnode->hSocket == INVALID_SOCKET)
-                continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetSend)) {
-                TRY_LOCK(pnode->cs_vSend, lockSend);
-                if (lockSend)
-                    SocketSendData(pnode);
-            }
+        int64_t nStart = GetTimeMicros();
+        int64_t nWaited = SocketHandlerWait();
 
-            //
-            // Inactivity checking
-            //
-            int64_t nTime = GetTime();
-            if (nTime - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    LogPrint("net", "socket no message in first 60 seconds, %d %d from %d\n", pnode->nLastRecv != 0, pnode->nLastSend != 0, pnode->id);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastSend > TIMEOUT_INTERVAL) {
-                    LogPrintf("socket sending timeout: %is\n", nTime - pnode->nLastSend);
-                    pnode->fDisconnect = true;
-                } else if (nTime - pnode->nLastRecv > (pnode->nVersion > BIP0031_VERSION ? TIMEOUT_INTERVAL : 90 * 60)) {
-                    LogPrintf("socket receive timeout: %is\n", nTime - pnode->nLastRecv);
-                    pnode->fDisconnect = true;
-                } else if (pnode->nPingNonceSent && pnode->nPingUsecStart + TIMEOUT_INTERVAL * 1000000 < GetTimeMicros()) {
-                    LogPrintf("ping timeout: %fs\n", 0.000001 * (GetTimeMicros() - pnode->nPingUsecStart));
-                    pnode->fDisconnect = true;
-                }
-            }
-        }
-        {
-            LOCK(cs_vNodes);
-            BOOST_FOREACH (CNode* pnode, vNodesCopy)
-                pnode->Release();
+        // Cost of a wakeup outside of the wait itself, by peer count
+        nWakeupTime += GetTimeMicros() - nStart - nWaited;
+        if (++nWakeups == 1000) {
+            LogPrint("bench", "Socket handler: %.3fms per wakeup with %u peers\n", 0.001 * nWakeupTime / nWakeups, nPrevNodeCount);
+            nWakeups = 0;
+            nWakeupTime = 0;
         }
     }
 }
@@ -1335,29 +1604,39 @@ bool OpenNetworkConnection(const CAddress& addrConnect, CSemaphoreGrant* grantOu
 }
 
 
-void ThreadMessageHandler()
+/**
+ * Handle the peers whose id modulo nMessageHandlerThreads is nThread, so
+ * that the messages of a peer are always processed in order by one thread.
+ */
+void ThreadMessageHandler(int nThread)
 {
     boost::mutex condition_mutex;
     boost::unique_lock<boost::mutex> lock(condition_mutex);
 
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
+    int64_t nBusyTime = 0;
+    int64_t nStatsStart = GetTimeMicros();
     while (true) {
+        int64_t nStart = GetTimeMicros();
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
+            BOOST_FOREACH (CNode* pnode, vNodes) {
+                if (pnode->id % nMessageHandlerThreads != nThread)
+                    continue;
+                vNodesCopy.push_back(pnode);
                 pnode->AddRef();
             }
         }
 
         // Poll the connected nodes for messages
+        bool fSleep = true;
+
+        // Each thread trickles inventory to one of its own peers per round
         CNode* pnodeTrickle = NULL;
         if (!vNodesCopy.empty())
             pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
 
-        bool fSleep = true;
-
         BOOST_FOREACH (CNode* pnode, vNodesCopy) {
             if (pnode->fDisconnect)
                 continue;
@@ -1394,6 +1673,15 @@ void ThreadMessageHandler()
                 pnode->Release();
         }
 
+        // Share of the time spent handling messages, to compare -msghandthreads settings under load
+        int64_t nNow = GetTimeMicros();
+        nBusyTime += nNow - nStart;
+        if (nNow - nStatsStart > 60 * 1000000) {
+            LogPrint("bench", "Message handler %d/%d: %u peers, %.1f%% busy\n", nThread + 1, nMessageHandlerThreads, vNodesCopy.size(), 100.0 * nBusyTime / (nNow - nStatsStart));
+            nBusyTime = 0;
+            nStatsStart = nNow;
+        }
+
         if (fSleep)
             messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(100));
     }
@@ -1594,14 +1882,23 @@ void StartNode(boost::thread_group& threadGroup)
     threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "opencon", &ThreadOpenConnections));
 
     // Process messages
-    threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "msghand", &ThreadMessageHandler));
+    for (int i = 0; i < nMessageHandlerThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "msghand", boost::function<void()>(boost::bind(&ThreadMessageHandler, i))));
 
     // Dump network addresses
     threadGroup.create_thread(boost::bind(&LoopForever<void (*)()>, "dumpaddr", &DumpAddresses, DUMP_ADDRESSES_INTERVAL * 1000));
 
     // ppcoin:mint proof-of-stake blocks in the background
-    if (GetBoolArg("-staking", true))
+    if (GetBoolArg("-staking", true)) {
+        // The minter searches for kernels too, it gets -stakethreads - 1 helpers
+        nStakeKernelThreads = GetArg("-stakethreads", 0);
+        if (nStakeKernelThreads <= 0)
+            nStakeKernelThreads = boost::thread::hardware_concurrency();
+        LogPrintf("Using %d threads for stake kernel search\n", nStakeKernelThreads);
+        for (int i = 0; i < nStakeKernelThreads - 1; i++)
+            threadGroup.create_thread(&ThreadStakeKernelSearch);
         threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "stakemint", &ThreadStakeMinter));
+    }
 }
 
 bool StopNode()
@@ -1635,6 +1932,7 @@ public:
             if (hListenSocket.socket != INVALID_SOCKET)
                 if (!CloseSocket(hListenSocket.socket))
                     LogPrintf("CloseSocket(hListenSocket) failed with error %s\n", NetworkErrorString(WSAGetLastError()));
+        StopSocketEvents();
 
         // clean up some globals (to help leak detection)
         BOOST_FOREACH (CNode* pnode, vNodes)
@@ -1876,6 +2174,12 @@ bool CAddrDB::Read(CAddrMan& addr)
 
 unsigned int ReceiveFloodSize() { return 1000 * GetArg("-maxreceivebuffer", 5 * 1000); }
 unsigned int SendBufferSize() { return 1000 * GetArg("-maxsendbuffer", 1 * 1000); }
+unsigned int KnownMessagesSize() { return std::max(GetArg("-knownmessages", DEFAULT_KNOWN_MESSAGES), (int64_t)1); }
+double KnownMessagesFPRate()
+{
+    double rate = mapArgs.count("-knownfprate") ? atof(mapArgs["-knownfprate"].c_str()) : DEFAULT_KNOWN_FPRATE;
+    return (rate > 0 && rate < 1) ? rate : DEFAULT_KNOWN_FPRATE;
+}
 
 CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000)
 {
@@ -1898,6 +2202,9 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     fNetworkNode = false;
     fSuccessfullyConnected = false;
     fDisconnect = false;
+    fSocketRegistered = false;
+    fSocketReadable = false;
+    fSocketWritable = false;
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
@@ -2016,13 +2323,46 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
 
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+    boost::shared_ptr<CSerializeData> data(new CSerializeData());
+    ssSend.GetAndClear(*data);
+    nSendSize += data->size();
+    vSendMsg.push_back(data);
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (vSendMsg.size() == 1)
         SocketSendData(this);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
+
+CSerializeDataPtr CNode::MakeMessage(const char* pszCommand, const char* pchPayload, size_t nPayloadSize)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << CMessageHeader(pszCommand, nPayloadSize);
+    ss.write(pchPayload, nPayloadSize);
+
+    // Set the checksum
+    uint256 hash = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    assert(ss.size() >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
+    memcpy((char*)&ss[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+
+    boost::shared_ptr<CSerializeData> data(new CSerializeData());
+    ss.GetAndClear(*data);
+    return data;
+}
+
+void CNode::PushSharedMessage(const CSerializeDataPtr& msg)
+{
+    LOCK(cs_vSend);
+
+    LogPrint("net", "sending: shared message (%d bytes) peer=%d\n", msg->size() - CMessageHeader::HEADER_SIZE, id);
+
+    nSendSize += msg->size();
+    vSendMsg.push_back(msg);
+
+    // If write queue empty, attempt "optimistic write"
+    if (vSendMsg.size() == 1)
+        SocketSendData(this);
+}
@@ -20,6 +20,7 @@
 #include "utilstrencodings.h"
 
 #include <deque>
+#include <limits>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -28,6 +29,8 @@
 
 #include <boost/filesystem/path.hpp>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/signals2/signal.hpp>
 
 class CAddrMan;
@@ -49,8 +52,16 @@ static const unsigned int MAX_INV_SZ = 50000;
 static const unsigned int MAX_ADDR_TO_SEND = 1000;
 /** Maximum length of incoming protocol messages (no message over 2 MiB is currently acceptable). */
 static const unsigned int MAX_PROTOCOL_MESSAGE_LENGTH = 2 * 1024 * 1024;
+/** The number of relayed message hashes remembered per peer, see -knownmessages */
+static const unsigned int DEFAULT_KNOWN_MESSAGES = 10000;
+/** The false positive rate of the remembered message hashes, see -knownfprate */
+static const double DEFAULT_KNOWN_FPRATE = 0.000001;
 /** -listen default */
 static const bool DEFAULT_LISTEN = true;
+/** -msghandthreads default, a single thread handles every peer */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 1;
+/** Maximum number of message handler threads */
+static const int MAX_MESSAGE_HANDLER_THREADS = 16;
 /** -upnp default */
 #ifdef USE_UPNP
 static const bool DEFAULT_UPNP = USE_UPNP;
@@ -60,8 +71,13 @@ static const bool DEFAULT_UPNP = false;
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 
+/** Serialized message shared by send queues of nodes */
+typedef boost::shared_ptr<const CSerializeData> CSerializeDataPtr;
+
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
+unsigned int KnownMessagesSize();
+double KnownMessagesFPRate();
 
 void AddOneShot(std::string strDest);
 bool RecvLine(SOCKET hSocket, std::string& strLine);
@@ -77,6 +93,11 @@ bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup);
 bool StopNode();
 void SocketSendData(CNode* pnode);
+/** Wait for network events with epoll where available unless -useepoll=0, select() otherwise */
+void StartSocketEvents();
+void StopSocketEvents();
+/** Wait up to 50ms for activity on the node and listen sockets and service it, returns the microseconds waited */
+int64_t SocketHandlerWait();
 
 typedef int NodeId;
 
@@ -125,6 +146,7 @@ extern uint64_t nLocalServices;
 extern uint64_t nLocalHostNonce;
 extern CAddrMan addrman;
 extern int nMaxConnections;
+extern int nMessageHandlerThreads;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
@@ -221,7 +243,7 @@ public:
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSerializeDataPtr> vSendMsg;
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -249,6 +271,10 @@ public:
     bool fNetworkNode;
     bool fSuccessfullyConnected;
     bool fDisconnect;
+    // Socket readiness kept by the epoll socket handler, only used by ThreadSocketHandler
+    bool fSocketRegistered;
+    bool fSocketReadable;
+    bool fSocketWritable;
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in their version message that we should not relay tx invs
@@ -273,6 +299,7 @@ protected:
     static CCriticalSection cs_setBanned;
 
     std::vector<std::string> vecRequestsFulfilled; //keep track of what client has asked for
+    CCriticalSection cs_vecRequestsFulfilled;
 
     // Whitelisted ranges. Any node connecting from these is automatically
     // whitelisted (as well as those connecting to whitelisted binds).
@@ -289,8 +316,11 @@ public:
     // flood relay
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
+    CCriticalSection cs_vAddrToSend;
     bool fGetAddr;
-    std::set<uint256> setKnown;
+    // allocated on first use, most peers never relay alert or xbridge messages
+    boost::scoped_ptr<CRollingBloomFilter> pfilterKnown;
+    CCriticalSection cs_filterKnown;
 
     // inventory based relay
     mruset<CInv> setInventoryKnown;
@@ -368,11 +398,13 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
+        LOCK(cs_vAddrToSend);
         setAddrKnown.insert(addr);
     }
 
     void PushAddress(const CAddress& addr)
     {
+        LOCK(cs_vAddrToSend);
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
@@ -385,6 +417,23 @@ public:
         }
     }
 
+    bool HasKnownMessage(const uint256& hash)
+    {
+        LOCK(cs_filterKnown);
+        return pfilterKnown && pfilterKnown->contains(hash);
+    }
+
+    // Returns false if the relayed message was already known
+    bool AddKnownMessage(const uint256& hash)
+    {
+        LOCK(cs_filterKnown);
+        if (!pfilterKnown)
+            pfilterKnown.reset(new CRollingBloomFilter(KnownMessagesSize(), KnownMessagesFPRate(), GetRand(std::numeric_limits<unsigned int>::max())));
+        else if (pfilterKnown->contains(hash))
+            return false;
+        pfilterKnown->insert(hash);
+        return true;
+    }
 
     void AddInventoryKnown(const CInv& inv)
     {
@@ -416,6 +465,13 @@ public:
 
     void PushVersion();
 
+    /** Build complete wire message (header, payload, checksum) from serialized payload,
+     *  the result can be pushed to many nodes without copying. */
+    static CSerializeDataPtr MakeMessage(const char* pszCommand, const char* pchPayload, size_t nPayloadSize);
+
+    /** Queue message built by MakeMessage, the buffer is shared, not copied. */
+    void PushSharedMessage(const CSerializeDataPtr& msg);
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -586,6 +642,7 @@ public:
 
     bool HasFulfilledRequest(std::string strRequest)
     {
+        LOCK(cs_vecRequestsFulfilled);
         BOOST_FOREACH (std::string& type, vecRequestsFulfilled) {
             if (type == strRequest) return true;
         }
@@ -594,6 +651,7 @@ public:
 
     void ClearFulfilledRequest(std::string strRequest)
     {
+        LOCK(cs_vecRequestsFulfilled);
         std::vector<std::string>::iterator it = vecRequestsFulfilled.begin();
         while (it != vecRequestsFulfilled.end()) {
             if ((*it) == strRequest) {
@@ -606,6 +664,7 @@ public:
 
     void FulfilledRequest(std::string strRequest)
     {
+        LOCK(cs_vecRequestsFulfilled);
         if (HasFulfilledRequest(strRequest)) return;
         vecRequestsFulfilled.push_back(strRequest);
     }
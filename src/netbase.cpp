@@ -24,6 +24,7 @@
 #include <arpa/inet.h>
 #endif
 #include <fcntl.h>
+#include <poll.h>
 #endif
 
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
@@ -230,6 +231,7 @@ bool LookupNumeric(const char* pszName, CService& addr, int portDefault)
     return Lookup(pszName, addr, portDefault, false);
 }
 
+#ifdef WIN32
 /**
  * Convert milliseconds to a struct timeval for select.
  */
@@ -240,6 +242,32 @@ struct timeval static MillisToTimeval(int64_t nTimeout)
     timeout.tv_usec = (nTimeout % 1000) * 1000;
     return timeout;
 }
+#endif
+
+/**
+ * Wait until hSocket is readable, or writable if fWrite is set, for at most
+ * nTimeout milliseconds. Returns a positive value when it is ready, 0 on
+ * timeout and SOCKET_ERROR on error.
+ *
+ * poll() is used outside Windows because it is not limited to FD_SETSIZE
+ * descriptors like select(), with epoll there can be more connections than that.
+ */
+int static WaitForSocket(SOCKET hSocket, bool fWrite, int64_t nTimeout)
+{
+#ifdef WIN32
+    struct timeval timeout = MillisToTimeval(nTimeout);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(hSocket, &fdset);
+    return select(hSocket + 1, fWrite ? NULL : &fdset, fWrite ? &fdset : NULL, NULL, &timeout);
+#else
+    struct pollfd pfd;
+    pfd.fd = hSocket;
+    pfd.events = fWrite ? POLLOUT : POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, nTimeout);
+#endif
+}
 
 /**
  * Read bytes from socket. This will either read the full number of bytes requested
@@ -256,7 +284,7 @@ bool static InterruptibleRecv(char* data, size_t len, int timeout, SOCKET& hSock
 {
     int64_t curTime = GetTimeMillis();
     int64_t endTime = curTime + timeout;
-    // Maximum time to wait in one select call. It will take up until this time (in millis)
+    // Maximum time to wait in one WaitForSocket call. It will take up until this time (in millis)
     // to break off in case of an interruption.
     const int64_t maxWait = 1000;
     while (len > 0 && curTime < endTime) {
@@ -269,14 +297,7 @@ bool static InterruptibleRecv(char* data, size_t len, int timeout, SOCKET& hSock
         } else { // Other error or blocking
             int nErr = WSAGetLastError();
             if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL) {
-                if (!IsSelectableSocket(hSocket)) {
-                    return false;
-                }
-                struct timeval tval = MillisToTimeval(std::min(endTime - curTime, maxWait));
-                fd_set fdset;
-                FD_ZERO(&fdset);
-                FD_SET(hSocket, &fdset);
-                int nRet = select(hSocket + 1, &fdset, NULL, NULL, &tval);
+                int nRet = WaitForSocket(hSocket, false, std::min(endTime - curTime, maxWait));
                 if (nRet == SOCKET_ERROR) {
                     return false;
                 }
@@ -425,11 +446,7 @@ bool static ConnectSocketDirectly(const CService& addrConnect, SOCKET& hSocketRe
         int nErr = WSAGetLastError();
         // WSAEINVAL is here because some legacy version of winsock uses it
         if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK || nErr == WSAEINVAL) {
-            struct timeval timeout = MillisToTimeval(nTimeout);
-            fd_set fdset;
-            FD_ZERO(&fdset);
-            FD_SET(hSocket, &fdset);
-            int nRet = select(hSocket + 1, NULL, &fdset, NULL, &timeout);
+            int nRet = WaitForSocket(hSocket, true, nTimeout);
             if (nRet == 0) {
                 LogPrint("net", "connection to %s timeout\n", addrConnect.ToString());
                 CloseSocket(hSocket);
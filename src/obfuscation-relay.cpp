@@ -96,7 +96,7 @@ void CObfuScationRelay::Relay()
 
 void CObfuScationRelay::RelayThroughNode(int nRank)
 {
-    CServicenode* pmn = mnodeman.GetServicenodeByRank(nRank, nBlockHeight, ActiveProtocol());
+    CServicenodePtr pmn = mnodeman.GetServicenodeByRank(nRank, nBlockHeight, ActiveProtocol());
 
     if (pmn != NULL) {
         //printf("RelayThroughNode %s\n", pmn->addr.ToString().c_str());
@@ -73,7 +73,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
         CTransaction txCollateral;
         vRecv >> nDenom >> txCollateral;
 
-        CServicenode* pmn = mnodeman.Find(activeServicenode.vin);
+        CServicenodePtr pmn = mnodeman.Find(activeServicenode.vin);
         if (pmn == NULL) {
             errorID = ERR_MN_LIST;
             pfrom->PushMessage("dssu", sessionID, GetState(), GetEntriesCount(), SERVICENODE_REJECTED, errorID);
@@ -117,7 +117,7 @@ void CObfuscationPool::ProcessMessageObfuscation(CNode* pfrom, std::string& strC
 
         if (dsq.IsExpired()) return;
 
-        CServicenode* pmn = mnodeman.Find(dsq.vin);
+        CServicenodePtr pmn = mnodeman.Find(dsq.vin);
         if (pmn == NULL) return;
 
         // if the queue is ready, submit if we can
@@ -1561,7 +1561,7 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
                     continue;
                 }
 
-                CServicenode* pmn = mnodeman.Find(dsq.vin);
+                CServicenodePtr pmn = mnodeman.Find(dsq.vin);
                 if (pmn == NULL) {
                     LogPrintf("DoAutomaticDenominating --- dsq vin %s is not in servicenode list!", dsq.vin.ToString());
                     continue;
@@ -1598,7 +1598,7 @@ bool CObfuscationPool::DoAutomaticDenominating(bool fDryRun)
 
         // otherwise, try one randomly
         while (i < 10) {
-            CServicenode* pmn = mnodeman.FindRandomNotInVec(vecServicenodesUsed, ActiveProtocol());
+            CServicenodePtr pmn = mnodeman.FindRandomNotInVec(vecServicenodesUsed, ActiveProtocol());
             if (pmn == NULL) {
                 LogPrintf("DoAutomaticDenominating --- Can't find random servicenode!\n");
                 strAutoDenomResult = _("Can't find random Servicenode.");
@@ -2220,7 +2220,7 @@ bool CObfuscationQueue::Relay()
 
 bool CObfuscationQueue::CheckSignature()
 {
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
 
     if (pmn != NULL) {
         std::string strMessage = vin.ToString() + boost::lexical_cast<std::string>(nDenom) + boost::lexical_cast<std::string>(time) + boost::lexical_cast<std::string>(ready);
@@ -192,7 +192,7 @@ public:
 
     bool GetAddress(CService& addr)
     {
-        CServicenode* pmn = mnodeman.Find(vin);
+        CServicenodePtr pmn = mnodeman.Find(vin);
         if (pmn != NULL) {
             addr = pmn->addr;
             return true;
@@ -203,7 +203,7 @@ public:
     /// Get the protocol version
     bool GetProtocolVersion(int& protocolVersion)
     {
-        CServicenode* pmn = mnodeman.Find(vin);
+        CServicenodePtr pmn = mnodeman.Find(vin);
         if (pmn != NULL) {
             protocolVersion = pmn->protocolVersion;
             return true;
@@ -327,7 +327,7 @@ public:
     // where collateral should be made out to
     CScript collateralPubKey;
 
-    CServicenode* pSubmittedToServicenode;
+    CServicenodePtr pSubmittedToServicenode;
     int sessionDenom;    //Users must submit an denom matching this
     int cachedNumBlocks; //used for the overview screen
 
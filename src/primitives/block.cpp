@@ -5,6 +5,7 @@
 
 #include "primitives/block.h"
 
+#include "crypto/quark.h"
 #include "hash.h"
 #include "script/standard.h"
 #include "script/sign.h"
@@ -12,9 +13,74 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+CBlockHeader& CBlockHeader::operator=(const CBlockHeader& other)
+{
+    if (this == &other)
+        return *this;
+    nVersion = other.nVersion;
+    hashPrevBlock = other.hashPrevBlock;
+    hashMerkleRoot = other.hashMerkleRoot;
+    nTime = other.nTime;
+    nBits = other.nBits;
+    nNonce = other.nNonce;
+    uint256 hash;
+    if (other.ReadCachedHash(hash))
+        WriteCachedHash(hash);
+    return *this;
+}
+
+/**
+ * Return the cached hash if it was computed from the current fields. The cache
+ * is never waited for: if another thread is writing it the caller just hashes.
+ */
+bool CBlockHeader::ReadCachedHash(uint256& hash) const
+{
+    if (fCacheBusy.test_and_set(std::memory_order_acquire))
+        return false;
+    bool fMatch = fHashCached && memcmp(vchHashedFields, BEGIN(nVersion), HASHED_SIZE) == 0;
+    if (fMatch)
+        hash = hashCached;
+    fCacheBusy.clear(std::memory_order_release);
+    return fMatch;
+}
+
+void CBlockHeader::WriteCachedHash(const uint256& hash) const
+{
+    if (fCacheBusy.test_and_set(std::memory_order_acquire))
+        return;
+    hashCached = hash;
+    memcpy(vchHashedFields, BEGIN(nVersion), HASHED_SIZE);
+    fHashCached = true;
+    fCacheBusy.clear(std::memory_order_release);
+}
+
 uint256 CBlockHeader::GetHash() const
 {
-    return HashQuark(BEGIN(nVersion), END(nNonce));
+    assert(END(nNonce) - BEGIN(nVersion) == HASHED_SIZE);
+    uint256 hash;
+    if (ReadCachedHash(hash))
+        return hash;
+    hash = HashQuark(BEGIN(nVersion), END(nNonce));
+    WriteCachedHash(hash);
+    return hash;
+}
+
+void CBlockHeader::SetCachedHash(const uint256& hash) const
+{
+    WriteCachedHash(hash);
+}
+
+void CBlockHeader::CacheHashes(const std::vector<CBlockHeader>& vHeaders)
+{
+    if (vHeaders.empty())
+        return;
+    std::vector<unsigned char> vchFields(vHeaders.size() * HASHED_SIZE);
+    for (size_t i = 0; i < vHeaders.size(); i++)
+        memcpy(&vchFields[i * HASHED_SIZE], BEGIN(vHeaders[i].nVersion), HASHED_SIZE);
+    std::vector<uint256> vHashes(vHeaders.size());
+    QuarkHashMulti(vHashes[0].begin(), &vchFields[0], HASHED_SIZE, vHeaders.size());
+    for (size_t i = 0; i < vHeaders.size(); i++)
+        vHeaders[i].SetCachedHash(vHashes[i]);
 }
 
 uint256 CBlock::BuildMerkleTree(bool* fMutated) const
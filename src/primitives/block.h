@@ -11,6 +11,8 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <atomic>
+
 /** The maximum allowed size for a serialized block, in bytes (network rule) */
 static const unsigned int MAX_BLOCK_SIZE = 1000000;
 
@@ -33,11 +35,37 @@ public:
     uint32_t nBits;
     uint32_t nNonce;
 
+    //! Size of the fields the block hash covers, nVersion through nNonce
+    static const size_t HASHED_SIZE = 80;
+
+private:
+    // memory only: the last hash computed and the fields it was computed from,
+    // guarded by fCacheBusy so that threads sharing a const header may hash it
+    mutable std::atomic_flag fCacheBusy;
+    mutable uint256 hashCached;
+    mutable unsigned char vchHashedFields[HASHED_SIZE];
+    mutable bool fHashCached;
+
+    bool ReadCachedHash(uint256& hash) const;
+    void WriteCachedHash(const uint256& hash) const;
+
+public:
     CBlockHeader()
     {
+        fCacheBusy.clear();
+        fHashCached = false;
         SetNull();
     }
 
+    CBlockHeader(const CBlockHeader& other)
+    {
+        fCacheBusy.clear();
+        fHashCached = false;
+        *this = other;
+    }
+
+    CBlockHeader& operator=(const CBlockHeader& other);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -66,8 +94,19 @@ public:
         return (nBits == 0);
     }
 
+    /**
+     * The Quark hash of the header. It is computed once and returned again until
+     * one of the hashed fields changes, so callers need not keep their own copy.
+     * Safe to call from several threads as long as none of them changes a field.
+     */
     uint256 GetHash() const;
 
+    /** Remember a hash already known to match the current fields, e.g. from the block index. */
+    void SetCachedHash(const uint256& hash) const;
+
+    /** Compute the hashes of many headers at once, several per vector where the CPU supports it. */
+    static void CacheHashes(const std::vector<CBlockHeader>& vHeaders);
+
     int64_t GetBlockTime() const
     {
         return (int64_t)nTime;
@@ -120,14 +159,8 @@ public:
 
     CBlockHeader GetBlockHeader() const
     {
-        CBlockHeader block;
-        block.nVersion       = nVersion;
-        block.hashPrevBlock  = hashPrevBlock;
-        block.hashMerkleRoot = hashMerkleRoot;
-        block.nTime          = nTime;
-        block.nBits          = nBits;
-        block.nNonce         = nNonce;
-        return block;
+        // Keeps the cached hash
+        return *this;
     }
 
     // ppcoin: two types of block: proof-of-work or proof-of-stake
@@ -95,7 +95,7 @@ static std::string makeHTMLTable(const std::string* pCells, int nRows, int nColu
     return Table;
 }
 
-static std::string TxToRow(const CTransaction& tx, const CScript& Highlight = CScript(), const std::string& Prepend = std::string(), int64_t* pSum = NULL)
+static std::string TxToRow(const CTransaction& tx, const CScript& Highlight = CScript(), const std::string& Prepend = std::string(), int64_t* pSum = NULL, const int64_t* pDelta = NULL)
 {
     std::string InAmounts, InAddresses, OutAmounts, OutAddresses;
     int64_t Delta = 0;
@@ -141,6 +141,9 @@ static std::string TxToRow(const CTransaction& tx, const CScript& Highlight = CS
     int n = sizeof(List) / sizeof(std::string) - 2;
 
     if (!Highlight.empty()) {
+        // The address index also counts pay-to-pubkey outputs of the address
+        if (pDelta)
+            Delta = *pDelta;
         List[n++] = std::string("<font color=\"") + ((Delta > 0) ? "green" : "red") + "\">" + ValueToString(Delta, true) + "</font>";
         *pSum += Delta;
         List[n++] = ValueToString(*pSum);
@@ -158,12 +161,15 @@ CTxOut getPrevOut(const COutPoint& out)
     return CTxOut();
 }
 
-void getNextIn(const COutPoint& /*Out*/, uint256& /*Hash*/, unsigned int& /*n*/)
+void getNextIn(const COutPoint& Out, uint256& Hash, unsigned int& n)
 {
-    // Hash = 0;
-    // n = 0;
-    // if (paddressmap)
-    //    paddressmap->ReadNextIn(Out, Hash, n);
+    Hash = 0;
+    n = 0;
+    CSpentIndexValue value;
+    if (GetSpentIndex(CSpentIndexKey(Out.hash, Out.n), value)) {
+        Hash = value.txid;
+        n = value.inputIndex;
+    }
 }
 
 const CBlockIndex* getexplorerBlockIndex(int64_t height)
@@ -324,7 +330,7 @@ std::string TxToString(uint256 BlockHash, const CTransaction& tx)
         const CTxOut& Out = tx.vout[i];
         uint256 HashNext = uint256S("0");
         unsigned int nNext = 0;
-        bool fAddrIndex = false;
+        bool fAddrIndex = fSpentIndex;
         getNextIn(COutPoint(TxHash, i), HashNext, nNext);
         std::string OutputsContentCells[] =
             {
@@ -386,37 +392,33 @@ std::string AddressToString(const CBitcoinAddress& Address)
             _("Balance")};
     std::string TxContent = table + makeHTMLTableRow(TxLabels, sizeof(TxLabels) / sizeof(std::string));
 
-    std::set<COutPoint> PrevOuts;
-    /*
-    CScript AddressScript;
-    AddressScript.SetDestination(Address.Get());
+    CScript AddressScript = GetScriptForDestination(Address.Get());
 
-    int64_t Sum = 0;
-    bool fAddrIndex = false;
+    int nType;
+    uint160 hashBytes;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+    if (!fAddressIndex || !GetAddressIndexKey(Address.Get(), nType, hashBytes) ||
+        !GetAddressIndex(hashBytes, nType, addressIndex))
+        return ""; // it would take too long to find transactions by address without -addressindex
 
-    if (!fAddrIndex)
-        return ""; // it will take too long to find transactions by address
-    else
-    {
-        std::vector<CDiskTxPos> Txs;
-        paddressmap->GetTxs(Txs, AddressScript.GetID());
-        BOOST_FOREACH (const CDiskTxPos& pos, Txs)
-        {
-            CTransaction tx;
-            CBlock block;
-            uint256 bhash = block.GetHash();
-            GetTransaction(pos.nTxOffset, tx, bhash);
-            std::map<uint256, CBlockIndex*>::iterator mi = mapBlockIndex.find(block.GetHash());
-            if (mi == mapBlockIndex.end())
-                continue;
-            CBlockIndex* pindex = (*mi).second;
-            if (!pindex || !chainActive.Contains(pindex))
-                continue;
-            std::string Prepend = "<a href=\"" + itostr(pindex->nHeight) + "\">" + TimeToString(pindex->nTime) + "</a>";
-            TxContent += TxToRow(tx, AddressScript, Prepend, &Sum);
-        }
+    // The entries of a transaction are next to each other, in chain order
+    int64_t Sum = 0;
+    for (size_t i = 0; i < addressIndex.size();) {
+        const CAddressIndexKey& key = addressIndex[i].first;
+        int64_t Delta = 0;
+        for (; i < addressIndex.size() && addressIndex[i].first.txhash == key.txhash; i++)
+            Delta += addressIndex[i].second;
+
+        CTransaction tx;
+        uint256 hashBlock;
+        if (!GetTransaction(key.txhash, tx, hashBlock, true))
+            continue;
+        const CBlockIndex* pindex = chainActive[key.blockHeight];
+        if (!pindex)
+            continue;
+        std::string Prepend = "<a href=\"" + itostr(pindex->nHeight) + "\">" + TimeToString(pindex->nTime) + "</a>";
+        TxContent += TxToRow(tx, AddressScript, Prepend, &Sum, &Delta);
     }
-    */
     TxContent += "</table>";
 
     std::string Content;
@@ -137,7 +137,7 @@ void ServicenodeList::StartAll(std::string strCommand)
             continue;
 
         CTxIn txin = CTxIn(uint256S(mne.getTxHash()), uint32_t(nIndex));
-        CServicenode* pmn = mnodeman.Find(txin);
+        CServicenodePtr pmn = mnodeman.Find(txin);
 
         if (strCommand == "start-missing" && pmn)
         {
@@ -230,9 +230,9 @@ void ServicenodeList::updateMyNodeList(bool fForce)
             continue;
 
         CTxIn txin = CTxIn(uint256S(mne.getTxHash()), uint32_t(nIndex));
-        CServicenode* pmn = mnodeman.Find(txin);
+        CServicenodePtr pmn = mnodeman.Find(txin);
 
-        updateMyServicenodeInfo(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), pmn);
+        updateMyServicenodeInfo(QString::fromStdString(mne.getAlias()), QString::fromStdString(mne.getIp()), pmn.get());
     }
     ui->tableWidgetMyServicenodes->setSortingEnabled(true);
 
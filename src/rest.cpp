@@ -43,6 +43,7 @@ public:
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, Object& entry);
 extern Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, JSONWriter& writer, bool txDetails);
 
 static RestErr RESTERR(enum HTTPStatusCode status, string message)
 {
@@ -132,6 +133,14 @@ static bool rest_block(AcceptedConnection* conn,
     }
 
     case RF_JSON: {
+        if (conn->begin_chunked(HTTP_OK, fRun, "application/json")) {
+            // Serialize the block straight to the connection instead of building it as a Value
+            JSONStreamWriter writer(conn->stream(), 0);
+            blockToJSON(block, pblockindex, writer, showTxDetails);
+            conn->stream() << "\n" << std::flush;
+            return true;
+        }
+
         Object objBlock = blockToJSON(block, pblockindex, showTxDetails);
         string strJSON = write_string(Value(objBlock), false) + "\n";
         conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
@@ -244,6 +253,8 @@ bool HTTPReq_REST(AcceptedConnection* conn,
             }
         }
     } catch (RestErr& re) {
+        if (!conn->abort_chunked())
+            return false;
         conn->stream() << HTTPReply(re.status, re.message + "\r\n", false, false, "text/plain") << std::flush;
         return false;
     }
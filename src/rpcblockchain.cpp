@@ -51,41 +51,49 @@ double GetDifficulty(const CBlockIndex* blockindex)
 }
 
 
-Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, JSONWriter& writer, bool txDetails)
 {
-    Object result;
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    writer.BeginObject();
+    writer.WritePair("hash", block.GetHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    Array txs;
+    writer.WritePair("confirmations", confirmations);
+    writer.WritePair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.WritePair("height", blockindex->nHeight);
+    writer.WritePair("version", block.nVersion);
+    writer.WritePair("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.Key("tx");
+    writer.BeginArray();
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
         if (txDetails) {
             Object objTx;
             TxToJSON(tx, uint256(), objTx);
-            txs.push_back(objTx);
+            writer.Write(objTx);
         } else
-            txs.push_back(tx.GetHash().GetHex());
+            writer.Write(tx.GetHash().GetHex());
     }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    writer.EndArray();
+    writer.WritePair("time", block.GetBlockTime());
+    writer.WritePair("nonce", (uint64_t)block.nNonce);
+    writer.WritePair("bits", strprintf("%08x", block.nBits));
+    writer.WritePair("difficulty", GetDifficulty(blockindex));
+    writer.WritePair("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        writer.WritePair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     CBlockIndex* pnext = chainActive.Next(blockindex);
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
-    return result;
+        writer.WritePair("nextblockhash", pnext->GetBlockHash().GetHex());
+    writer.EndObject();
+}
+
+Object blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    JSONValueWriter writer;
+    blockToJSON(block, blockindex, writer, txDetails);
+    return writer.GetValue().get_obj();
 }
 
 
@@ -146,7 +154,7 @@ Value getdifficulty(const Array& params, bool fHelp)
 }
 
 
-Value getrawmempool(const Array& params, bool fHelp)
+void getrawmempool(const Array& params, bool fHelp, JSONWriter& writer)
 {
     if (fHelp || params.size() > 1)
         throw runtime_error(
@@ -182,7 +190,7 @@ Value getrawmempool(const Array& params, bool fHelp)
 
     if (fVerbose) {
         LOCK(mempool.cs);
-        Object o;
+        writer.BeginObject();
         BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
             const uint256& hash = entry.first;
             const CTxMemPoolEntry& e = entry.second;
@@ -201,21 +209,27 @@ Value getrawmempool(const Array& params, bool fHelp)
             }
             Array depends(setDepends.begin(), setDepends.end());
             info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
+            writer.WritePair(hash.ToString(), info);
         }
-        return o;
+        writer.EndObject();
     } else {
         vector<uint256> vtxid;
         mempool.queryHashes(vtxid);
 
-        Array a;
+        writer.BeginArray();
         BOOST_FOREACH (const uint256& hash, vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+            writer.Write(hash.ToString());
+        writer.EndArray();
     }
 }
 
+Value getrawmempool(const Array& params, bool fHelp)
+{
+    JSONValueWriter writer;
+    getrawmempool(params, fHelp, writer);
+    return writer.GetValue();
+}
+
 Value getblockhash(const Array& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -461,6 +461,231 @@ Value setmocktime(const Array& params, bool fHelp)
     return Value::null;
 }
 
+/** Parse the address argument of the getaddress* calls: an address or {"addresses": [...]} */
+static std::vector<std::pair<uint160, int> > ParseIndexAddresses(const Value& param)
+{
+    std::vector<std::pair<uint160, int> > vAddresses;
+    Array addresses;
+    if (param.type() == str_type) {
+        addresses.push_back(param);
+    } else if (param.type() == obj_type) {
+        const Value& value = find_value(param.get_obj(), "addresses");
+        if (value.type() != array_type)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Addresses is expected to be an array");
+        addresses = value.get_array();
+    } else {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Expected an address or an object with an addresses array");
+    }
+
+    BOOST_FOREACH (const Value& address, addresses) {
+        if (address.type() != str_type)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
+        CBitcoinAddress bitcoinAddress(address.get_str());
+        int nType;
+        uint160 hashBytes;
+        if (!bitcoinAddress.IsValid() || !GetAddressIndexKey(bitcoinAddress.Get(), nType, hashBytes))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, string("Invalid address: ") + address.get_str());
+        vAddresses.push_back(std::make_pair(hashBytes, nType));
+    }
+    return vAddresses;
+}
+
+static std::string IndexAddressToString(const uint160& hashBytes, int type)
+{
+    return CBitcoinAddress(GetAddressIndexDestination(type, hashBytes)).ToString();
+}
+
+Value getaddresstxids(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddresstxids {\"addresses\": [\"address\", ...], \"start\": n, \"end\": n}\n"
+            "\nReturns the txids of the transactions paying to or spending from the addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"         (string) A blocknetdx address, or an object:\n"
+            "  {\n"
+            "    \"addresses\": [   (array) The blocknetdx addresses\n"
+            "      \"address\",     (string) A blocknetdx address\n"
+            "      ...\n"
+            "    ],\n"
+            "    \"start\": n,      (numeric, optional) The first block height\n"
+            "    \"end\": n         (numeric, optional) The last block height\n"
+            "  }\n"
+            "\nResult:\n"
+            "[\n"
+            "  \"transactionid\"  (string) The transaction id, in chain order\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"BoWcezn6TfFBnVtVJLBJmUW2RydfuG8Pf1\"]}'") +
+            HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"BoWcezn6TfFBnVtVJLBJmUW2RydfuG8Pf1\"]}"));
+
+    std::vector<std::pair<uint160, int> > vAddresses = ParseIndexAddresses(params[0]);
+
+    int nStart = 0;
+    int nEnd = 0;
+    if (params[0].type() == obj_type) {
+        const Value& start = find_value(params[0].get_obj(), "start");
+        const Value& end = find_value(params[0].get_obj(), "end");
+        if (start.type() == int_type && end.type() == int_type) {
+            nStart = start.get_int();
+            nEnd = end.get_int();
+            if (nEnd < nStart)
+                throw JSONRPCError(RPC_INVALID_PARAMETER, "End value is expected to be greater than start");
+        }
+    }
+
+    // Keyed by height and position in the block, which orders the
+    // transactions of several addresses and removes duplicates
+    std::map<std::pair<int, unsigned int>, uint256> mapTxids;
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = vAddresses.begin(); it != vAddresses.end(); it++) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndex(it->first, it->second, addressIndex, nStart, nEnd))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator itIndex = addressIndex.begin(); itIndex != addressIndex.end(); itIndex++)
+            mapTxids[std::make_pair(itIndex->first.blockHeight, itIndex->first.txindex)] = itIndex->first.txhash;
+    }
+
+    Array result;
+    for (std::map<std::pair<int, unsigned int>, uint256>::const_iterator it = mapTxids.begin(); it != mapTxids.end(); it++)
+        result.push_back(it->second.GetHex());
+    return result;
+}
+
+Value getaddressbalance(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressbalance {\"addresses\": [\"address\", ...]}\n"
+            "\nReturns the balance of the addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"         (string) A blocknetdx address, or an object:\n"
+            "  {\n"
+            "    \"addresses\": [   (array) The blocknetdx addresses\n"
+            "      \"address\",     (string) A blocknetdx address\n"
+            "      ...\n"
+            "    ]\n"
+            "  }\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": n,      (numeric) The current balance in satoshis\n"
+            "  \"received\": n      (numeric) The total number of satoshis received, including change\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressbalance", "'{\"addresses\": [\"BoWcezn6TfFBnVtVJLBJmUW2RydfuG8Pf1\"]}'") +
+            HelpExampleRpc("getaddressbalance", "{\"addresses\": [\"BoWcezn6TfFBnVtVJLBJmUW2RydfuG8Pf1\"]}"));
+
+    std::vector<std::pair<uint160, int> > vAddresses = ParseIndexAddresses(params[0]);
+
+    CAmount nBalance = 0;
+    CAmount nReceived = 0;
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = vAddresses.begin(); it != vAddresses.end(); it++) {
+        std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
+        if (!GetAddressIndex(it->first, it->second, addressIndex))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator itIndex = addressIndex.begin(); itIndex != addressIndex.end(); itIndex++) {
+            if (itIndex->second > 0)
+                nReceived += itIndex->second;
+            nBalance += itIndex->second;
+        }
+    }
+
+    Object result;
+    result.push_back(Pair("balance", nBalance));
+    result.push_back(Pair("received", nReceived));
+    return result;
+}
+
+Value getaddressutxos(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "getaddressutxos {\"addresses\": [\"address\", ...]}\n"
+            "\nReturns the unspent outputs of the addresses (requires -addressindex).\n"
+            "\nArguments:\n"
+            "1. \"address\"         (string) A blocknetdx address, or an object:\n"
+            "  {\n"
+            "    \"addresses\": [   (array) The blocknetdx addresses\n"
+            "      \"address\",     (string) A blocknetdx address\n"
+            "      ...\n"
+            "    ]\n"
+            "  }\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",  (string) The address\n"
+            "    \"txid\": \"transactionid\", (string) The output txid\n"
+            "    \"outputIndex\": n,      (numeric) The output index\n"
+            "    \"script\": \"hex\",       (string) The script hex encoded\n"
+            "    \"satoshis\": n,         (numeric) The number of satoshis of the output\n"
+            "    \"height\": n            (numeric) The block height\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getaddressutxos", "'{\"addresses\": [\"BoWcezn6TfFBnVtVJLBJmUW2RydfuG8Pf1\"]}'") +
+            HelpExampleRpc("getaddressutxos", "{\"addresses\": [\"BoWcezn6TfFBnVtVJLBJmUW2RydfuG8Pf1\"]}"));
+
+    std::vector<std::pair<uint160, int> > vAddresses = ParseIndexAddresses(params[0]);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > unspentOutputs;
+    for (std::vector<std::pair<uint160, int> >::const_iterator it = vAddresses.begin(); it != vAddresses.end(); it++) {
+        if (!GetAddressUnspent(it->first, it->second, unspentOutputs))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+    }
+
+    Array result;
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = unspentOutputs.begin(); it != unspentOutputs.end(); it++) {
+        Object output;
+        output.push_back(Pair("address", IndexAddressToString(it->first.hashBytes, it->first.type)));
+        output.push_back(Pair("txid", it->first.txhash.GetHex()));
+        output.push_back(Pair("outputIndex", (int)it->first.index));
+        output.push_back(Pair("script", HexStr(it->second.script.begin(), it->second.script.end())));
+        output.push_back(Pair("satoshis", it->second.satoshis));
+        output.push_back(Pair("height", it->second.blockHeight));
+        result.push_back(output);
+    }
+    return result;
+}
+
+Value getspentinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1 || params[0].type() != obj_type)
+        throw runtime_error(
+            "getspentinfo {\"txid\": \"transactionid\", \"index\": n}\n"
+            "\nReturns the txid and input index where an output is spent (requires -spentindex).\n"
+            "\nArguments:\n"
+            "{\n"
+            "  \"txid\": \"transactionid\", (string) The hex string of the txid\n"
+            "  \"index\": n              (numeric) The output index\n"
+            "}\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txid\": \"transactionid\", (string) The transaction id of the spending transaction\n"
+            "  \"index\": n,             (numeric) The spending input index\n"
+            "  \"height\": n             (numeric) The height of the spending block\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getspentinfo", "'{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}'") +
+            HelpExampleRpc("getspentinfo", "{\"txid\": \"0437cd7f8525ceed2324359c2d0ba26006d92d856a9c20fa0241106ee5a597c9\", \"index\": 0}"));
+
+    const Value& txidValue = find_value(params[0].get_obj(), "txid");
+    const Value& indexValue = find_value(params[0].get_obj(), "index");
+    if (txidValue.type() != str_type || indexValue.type() != int_type)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid txid or index");
+
+    CSpentIndexKey key(ParseHashV(txidValue, "txid"), indexValue.get_int());
+    CSpentIndexValue value;
+    if (!GetSpentIndex(key, value))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
+
+    Object result;
+    result.push_back(Pair("txid", value.txid.GetHex()));
+    result.push_back(Pair("index", (int)value.inputIndex));
+    result.push_back(Pair("height", value.blockHeight));
+    return result;
+}
+
 #ifdef ENABLE_WALLET
 Value getstakingstatus(const Array& params, bool fHelp)
 {
@@ -43,7 +43,7 @@ const size_t POST_READ_SIZE = 256 * 1024;
  * and to be compatible with other JSON-RPC implementations.
  */
 
-string HTTPPost(const string& strMsg, const map<string, string>& mapRequestHeaders)
+string HTTPPost(const string& strMsg, const map<string, string>& mapRequestHeaders, bool fKeepAlive)
 {
     ostringstream s;
     s << "POST / HTTP/1.1\r\n"
@@ -51,7 +51,7 @@ string HTTPPost(const string& strMsg, const map<string, string>& mapRequestHeade
       << "Host: 127.0.0.1\r\n"
       << "Content-Type: application/json\r\n"
       << "Content-Length: " << strMsg.size() << "\r\n"
-      << "Connection: close\r\n"
+      << "Connection: " << (fKeepAlive ? "keep-alive" : "close") << "\r\n"
       << "Accept: application/json\r\n";
     BOOST_FOREACH (const PAIRTYPE(string, string) & item, mapRequestHeaders)
         s << item.first << ": " << item.second << "\r\n";
@@ -79,6 +79,8 @@ static const char* httpStatusDescription(int nStatus)
         return "Not Found";
     case HTTP_INTERNAL_SERVER_ERROR:
         return "Internal Server Error";
+    case HTTP_SERVICE_UNAVAILABLE:
+        return "Service Unavailable";
     default:
         return "";
     }
@@ -128,6 +130,24 @@ string HTTPReplyHeader(int nStatus, bool keepalive, size_t contentLength, const
         FormatFullVersion());
 }
 
+string HTTPReplyHeaderChunked(int nStatus, bool keepalive, const char* contentType)
+{
+    return strprintf(
+        "HTTP/1.1 %d %s\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Content-Type: %s\r\n"
+        "Server: blocknetdx-json-rpc/%s\r\n"
+        "\r\n",
+        nStatus,
+        httpStatusDescription(nStatus),
+        rfc1123Time(),
+        keepalive ? "keep-alive" : "close",
+        contentType,
+        FormatFullVersion());
+}
+
 string HTTPReply(int nStatus, const string& strMsg, bool keepalive, bool headersOnly, const char* contentType)
 {
     if (headersOnly) {
@@ -248,6 +268,83 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string, string>& mapHe
     return HTTP_OK;
 }
 
+HTTPReplyQueue::HTTPReplyQueue(size_t nMaxSizeIn) : nSize(0),
+                                                    nMaxSize(nMaxSizeIn),
+                                                    fSending(false),
+                                                    fLast(false),
+                                                    fKeepAlive(false),
+                                                    fFailed(false)
+{
+}
+
+bool HTTPReplyQueue::Push(const std::string& data, bool fLastIn, bool fKeepAliveIn)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (nSize >= nMaxSize && !fFailed) {
+        fFailed = true;
+        // The data being sent is dropped by EndSend
+        vSend.erase(vSend.begin() + (fSending ? 1 : 0), vSend.end());
+        nSize = fSending ? vSend.front().size() : 0;
+    }
+    if (fFailed)
+        return false;
+    if (!data.empty()) {
+        vSend.push_back(data);
+        nSize += data.size();
+    }
+    if (fLastIn) {
+        fLast = true;
+        fKeepAlive = fKeepAliveIn;
+    }
+    return true;
+}
+
+const std::string* HTTPReplyQueue::BeginSend()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fSending || fFailed || vSend.empty())
+        return NULL;
+    fSending = true;
+    return &vSend.front();
+}
+
+void HTTPReplyQueue::EndSend(bool fError)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    fSending = false;
+    if (fError)
+        fFailed = true;
+    if (fFailed) {
+        vSend.clear();
+        nSize = 0;
+    } else {
+        nSize -= vSend.front().size();
+        vSend.pop_front();
+    }
+}
+
+bool HTTPReplyQueue::TakeFinished(bool& fKeepAliveRet)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fSending || fFailed || !vSend.empty() || !fLast)
+        return false;
+    fLast = false;
+    fKeepAliveRet = fKeepAlive;
+    return true;
+}
+
+bool HTTPReplyQueue::IsFailed() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return fFailed;
+}
+
+size_t HTTPReplyQueue::Size() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return nSize;
+}
+
 /**
  * JSON-RPC protocol.  BlocknetDX speaks version 1.0 for maximum compatibility,
  * but uses JSON-RPC 1.1/2.0 standards for parts of the 1.0 standard that were
@@ -292,3 +389,96 @@ Object JSONRPCError(int code, const string& message)
     error.push_back(Pair("message", message));
     return error;
 }
+
+void JSONStreamWriter::Separator()
+{
+    if (!fFirst)
+        stream << ',';
+    fFirst = false;
+}
+
+void JSONStreamWriter::BeginArray()
+{
+    Separator();
+    stream << '[';
+    fFirst = true;
+}
+
+void JSONStreamWriter::EndArray()
+{
+    stream << ']';
+    fFirst = false;
+}
+
+void JSONStreamWriter::BeginObject()
+{
+    Separator();
+    stream << '{';
+    fFirst = true;
+}
+
+void JSONStreamWriter::EndObject()
+{
+    stream << '}';
+    fFirst = false;
+}
+
+void JSONStreamWriter::Key(const string& strKey)
+{
+    Separator();
+    write_stream(Value(strKey), stream, json_spirit::none, nPrecision);
+    stream << ':';
+    fFirst = true;
+}
+
+void JSONStreamWriter::Write(const Value& value)
+{
+    Separator();
+    write_stream(value, stream, json_spirit::none, nPrecision);
+}
+
+Value* JSONValueWriter::Add(const Value& value)
+{
+    if (vOpen.empty()) {
+        result = value;
+        return &result;
+    }
+    // The parent does not grow while a child is open, so the returned pointer stays valid
+    Value& parent = *vOpen.back();
+    if (parent.type() == array_type) {
+        parent.get_array().push_back(value);
+        return &parent.get_array().back();
+    }
+    parent.get_obj().push_back(Pair(strNextKey, value));
+    return &parent.get_obj().back().value_;
+}
+
+void JSONValueWriter::BeginArray()
+{
+    vOpen.push_back(Add(Array()));
+}
+
+void JSONValueWriter::EndArray()
+{
+    vOpen.pop_back();
+}
+
+void JSONValueWriter::BeginObject()
+{
+    vOpen.push_back(Add(Object()));
+}
+
+void JSONValueWriter::EndObject()
+{
+    vOpen.pop_back();
+}
+
+void JSONValueWriter::Key(const string& strKey)
+{
+    strNextKey = strKey;
+}
+
+void JSONValueWriter::Write(const Value& value)
+{
+    Add(value);
+}
@@ -10,6 +10,8 @@
 #include <boost/asio/ssl.hpp>
 #include <boost/iostreams/concepts.hpp>
 #include <boost/iostreams/stream.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
 #include <list>
 #include <map>
 #include <stdint.h>
@@ -144,17 +146,127 @@ private:
     boost::asio::ssl::stream<typename Protocol::socket>& stream;
 };
 
-std::string HTTPPost(const std::string& strMsg, const std::map<std::string, std::string>& mapRequestHeaders);
+std::string HTTPPost(const std::string& strMsg, const std::map<std::string, std::string>& mapRequestHeaders, bool fKeepAlive = false);
 std::string HTTPError(int nStatus, bool keepalive, bool headerOnly = false);
 std::string HTTPReplyHeader(int nStatus, bool keepalive, size_t contentLength, const char* contentType = "application/json");
+std::string HTTPReplyHeaderChunked(int nStatus, bool keepalive, const char* contentType = "application/json");
 std::string HTTPReply(int nStatus, const std::string& strMsg, bool keepalive, bool headerOnly = false, const char* contentType = "application/json");
 bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int& proto, std::string& http_method, std::string& http_uri);
 int ReadHTTPStatus(std::basic_istream<char>& stream, int& proto);
 int ReadHTTPHeaders(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet);
 int ReadHTTPMessage(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet, std::string& strMessageRet, int nProto, size_t max_size);
+
+/**
+ * Reply data queued by RPC workers for one connection and written out by the
+ * I/O thread. Push never waits for the client: workers may hold cs_main,
+ * cs_wallet or mempool.cs while writing. A client that falls more than
+ * nMaxSize bytes behind fails the reply instead, and its data is dropped.
+ */
+class HTTPReplyQueue
+{
+public:
+    explicit HTTPReplyQueue(size_t nMaxSizeIn);
+
+    /**
+     * Queue data, after which the reply is complete if fLast. Returns false if
+     * the reply failed, because nMaxSize bytes were still queued or a send failed.
+     */
+    bool Push(const std::string& data, bool fLast, bool fKeepAlive);
+    //! Data to send next, or NULL while a send is in progress or nothing is queued
+    const std::string* BeginSend();
+    //! The data of BeginSend was sent, or could not be if fError
+    void EndSend(bool fError);
+    //! True once, when the complete reply was sent, with the keep-alive flag of the last Push
+    bool TakeFinished(bool& fKeepAlive);
+
+    bool IsFailed() const;
+    size_t Size() const;
+
+private:
+    mutable boost::mutex cs;
+    // Elements of a deque stay in place while others are appended
+    std::deque<std::string> vSend;
+    size_t nSize;
+    size_t nMaxSize;
+    bool fSending;
+    bool fLast;
+    bool fKeepAlive;
+    bool fFailed;
+};
+
 std::string JSONRPCRequest(const std::string& strMethod, const json_spirit::Array& params, const json_spirit::Value& id);
 json_spirit::Object JSONRPCReplyObj(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
 std::string JSONRPCReply(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
 json_spirit::Object JSONRPCError(int code, const std::string& message);
 
+/**
+ * Incremental JSON output for RPC results that can be large. The same code then either
+ * serializes the result straight to a connection (JSONStreamWriter) or builds the
+ * json_spirit::Value tree (JSONValueWriter) for callers that need one.
+ */
+class JSONWriter
+{
+public:
+    virtual ~JSONWriter() {}
+
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    //! Name of the next member of the current object
+    virtual void Key(const std::string& strKey) = 0;
+    //! Complete value: an array element, the member named by Key(), or the whole result
+    virtual void Write(const json_spirit::Value& value) = 0;
+
+    void WritePair(const std::string& strKey, const json_spirit::Value& value)
+    {
+        Key(strKey);
+        Write(value);
+    }
+};
+
+/** Writes compact JSON text, identical to write_string() of the equivalent Value */
+class JSONStreamWriter : public JSONWriter
+{
+public:
+    JSONStreamWriter(std::ostream& streamIn, unsigned int nPrecisionIn) : stream(streamIn), nPrecision(nPrecisionIn), fFirst(true) {}
+
+    void BeginArray();
+    void EndArray();
+    void BeginObject();
+    void EndObject();
+    void Key(const std::string& strKey);
+    void Write(const json_spirit::Value& value);
+
+private:
+    void Separator();
+
+    std::ostream& stream;
+    unsigned int nPrecision;
+    //! No separator needed before the next value
+    bool fFirst;
+};
+
+/** Builds the json_spirit::Value of the written JSON */
+class JSONValueWriter : public JSONWriter
+{
+public:
+    void BeginArray();
+    void EndArray();
+    void BeginObject();
+    void EndObject();
+    void Key(const std::string& strKey);
+    void Write(const json_spirit::Value& value);
+
+    const json_spirit::Value& GetValue() const { return result; }
+
+private:
+    json_spirit::Value* Add(const json_spirit::Value& value);
+
+    json_spirit::Value result;
+    //! Open arrays and objects, pointing into result
+    std::vector<json_spirit::Value*> vOpen;
+    std::string strNextKey;
+};
+
 #endif // BITCOIN_RPCPROTOCOL_H
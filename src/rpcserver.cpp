@@ -22,6 +22,7 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/iostreams/concepts.hpp>
@@ -29,6 +30,8 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include <deque>
+
 using namespace boost;
 using namespace boost::asio;
 using namespace json_spirit;
@@ -50,6 +53,10 @@ static boost::asio::io_service::work* rpc_dummy_work = NULL;
 static std::vector<CSubNet> rpc_allow_subnets; //!< List of subnets to allow RPC connections from
 static std::vector<boost::shared_ptr<ip::tcp::acceptor> > rpc_acceptors;
 
+class RPCWorkQueue;
+static RPCWorkQueue* rpc_work_queue = NULL;
+static Object GetRPCWorkQueueInfo();
+
 void RPCTypeCheck(const Array& params,
                   const list<Value_type>& typesExpected,
                   bool fAllowNull)
@@ -230,154 +237,195 @@ Value stop(const Array& params, bool fHelp)
     return "BlocknetDX server stopping";
 }
 
+Value getrpcinfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getrpcinfo\n"
+            "\nReturns the state of the RPC work queue and per-method call statistics.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"threads\": n,           (numeric) Number of worker threads executing calls\n"
+            "  \"queued\": n,            (numeric) Requests waiting for a worker\n"
+            "  \"queue_max\": n,         (numeric) Maximum number of waiting requests (-rpcworkqueue)\n"
+            "  \"active\": n,            (numeric) Calls being executed\n"
+            "  \"rejected\": n,          (numeric) Requests refused because the queue was full\n"
+            "  \"methods\": {\n"
+            "    \"method\": {\n"
+            "      \"calls\": n,         (numeric) Completed calls\n"
+            "      \"active\": n,        (numeric) Calls being executed\n"
+            "      \"limit\": n,         (numeric, optional) Concurrency limit (-rpcmethodlimit)\n"
+            "      \"avg_wait_ms\": x.x, (numeric) Average time spent in the queue\n"
+            "      \"avg_ms\": x.x,      (numeric) Average execution time\n"
+            "      \"max_ms\": x.x       (numeric) Longest execution time\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrpcinfo", "") + HelpExampleRpc("getrpcinfo", ""));
+
+    if (rpc_work_queue == NULL)
+        throw JSONRPCError(RPC_MISC_ERROR, "RPC server is not running");
+
+    return GetRPCWorkQueueInfo();
+}
+
 
 /**
  * Call Table
  */
 static const CRPCCommand vRPCCommands[] =
     {
-        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet
-        //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
+        //  category              name                      actor (function)         okSafeMode threadSafe reqWallet streamActor
+        //  --------------------- ------------------------  -----------------------  ---------- ---------- --------- -----------
         /* Overall control/query calls */
-        {"control", "getinfo", &getinfo, true, false, false}, /* uses wallet if enabled */
-        {"control", "help", &help, true, true, false},
-        {"control", "stop", &stop, true, true, false},
+        {"control", "getinfo", &getinfo, true, false, false, NULL}, /* uses wallet if enabled */
+        {"control", "help", &help, true, true, false, NULL},
+        {"control", "stop", &stop, true, true, false, NULL},
+        {"control", "getrpcinfo", &getrpcinfo, true, true, false, NULL},
 
         /* P2P networking */
-        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false},
-        {"network", "addnode", &addnode, true, true, false},
-        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false},
-        {"network", "getconnectioncount", &getconnectioncount, true, false, false},
-        {"network", "getnettotals", &getnettotals, true, true, false},
-        {"network", "getpeerinfo", &getpeerinfo, true, false, false},
-        {"network", "ping", &ping, true, false, false},
+        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false, NULL},
+        {"network", "addnode", &addnode, true, true, false, NULL},
+        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false, NULL},
+        {"network", "getconnectioncount", &getconnectioncount, true, false, false, NULL},
+        {"network", "getnettotals", &getnettotals, true, true, false, NULL},
+        {"network", "getpeerinfo", &getpeerinfo, true, false, false, NULL},
+        {"network", "ping", &ping, true, false, false, NULL},
 
         /* Block chain and UTXO */
-        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false},
-        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false},
-        {"blockchain", "getblockcount", &getblockcount, true, false, false},
-        {"blockchain", "getblock", &getblock, true, false, false},
-        {"blockchain", "getblockhash", &getblockhash, true, false, false},
-        {"blockchain", "getblockheader", &getblockheader, false, false, false},
-        {"blockchain", "getchaintips", &getchaintips, true, false, false},
-        {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
-        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
-        {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
-        {"blockchain", "gettxout", &gettxout, true, false, false},
-        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
-        {"blockchain", "verifychain", &verifychain, true, false, false},
-        {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
-        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
+        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false, NULL},
+        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false, NULL},
+        {"blockchain", "getblockcount", &getblockcount, true, false, false, NULL},
+        {"blockchain", "getblock", &getblock, true, false, false, NULL},
+        {"blockchain", "getblockhash", &getblockhash, true, false, false, NULL},
+        {"blockchain", "getblockheader", &getblockheader, false, false, false, NULL},
+        {"blockchain", "getchaintips", &getchaintips, true, false, false, NULL},
+        {"blockchain", "getdifficulty", &getdifficulty, true, false, false, NULL},
+        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false, NULL},
+        {"blockchain", "getrawmempool", &getrawmempool, true, false, false, &getrawmempool},
+        {"blockchain", "gettxout", &gettxout, true, false, false, NULL},
+        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false, NULL},
+        {"blockchain", "verifychain", &verifychain, true, false, false, NULL},
+        {"blockchain", "invalidateblock", &invalidateblock, true, true, false, NULL},
+        {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false, NULL},
+        {"blockchain", "getspentinfo", &getspentinfo, true, true, false, NULL},
+
+        /* Address index */
+        {"addressindex", "getaddresstxids", &getaddresstxids, true, true, false, NULL},
+        {"addressindex", "getaddressbalance", &getaddressbalance, true, true, false, NULL},
+        {"addressindex", "getaddressutxos", &getaddressutxos, true, true, false, NULL},
 
         /* Mining */
-        {"mining", "getblocktemplate", &getblocktemplate, true, false, false},
-        {"mining", "getmininginfo", &getmininginfo, true, false, false},
-        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false},
-        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false},
-        {"mining", "submitblock", &submitblock, true, true, false},
-        {"mining", "reservebalance", &reservebalance, true, true, false},
+        {"mining", "getblocktemplate", &getblocktemplate, true, false, false, NULL},
+        {"mining", "getmininginfo", &getmininginfo, true, false, false, NULL},
+        {"mining", "getnetworkhashps", &getnetworkhashps, true, false, false, NULL},
+        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false, NULL},
+        {"mining", "submitblock", &submitblock, true, true, false, NULL},
+        {"mining", "reservebalance", &reservebalance, true, true, false, NULL},
 
 #ifdef ENABLE_WALLET
         /* Coin generation */
-        {"generating", "getgenerate", &getgenerate, true, false, false},
-        {"generating", "gethashespersec", &gethashespersec, true, false, false},
-        {"generating", "setgenerate", &setgenerate, true, true, false},
+        {"generating", "getgenerate", &getgenerate, true, false, false, NULL},
+        {"generating", "gethashespersec", &gethashespersec, true, false, false, NULL},
+        {"generating", "setgenerate", &setgenerate, true, true, false, NULL},
 #endif
 
         /* Raw transactions */
-        {"rawtransactions", "createrawtransaction", &createrawtransaction, true,  false, false},
-        {"rawtransactions", "fundrawtransaction",   &fundrawtransaction,   false, false, false },
-        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true,  false, false},
-        {"rawtransactions", "decodescript",         &decodescript,         true,  false, false},
-        {"rawtransactions", "getrawtransaction",    &getrawtransaction,    true,  false, false},
-        {"rawtransactions", "sendrawtransaction",   &sendrawtransaction,   false, false, false},
-        {"rawtransactions", "signrawtransaction",   &signrawtransaction,   false, false, false}, /* uses wallet if enabled */
+        {"rawtransactions", "createrawtransaction", &createrawtransaction, true,  false, false, NULL},
+        {"rawtransactions", "fundrawtransaction",   &fundrawtransaction,   false, false, false, NULL},
+        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true,  false, false, NULL},
+        {"rawtransactions", "decodescript",         &decodescript,         true,  false, false, NULL},
+        {"rawtransactions", "getrawtransaction",    &getrawtransaction,    true,  false, false, NULL},
+        {"rawtransactions", "sendrawtransaction",   &sendrawtransaction,   false, false, false, NULL},
+        {"rawtransactions", "signrawtransaction",   &signrawtransaction,   false, false, false, NULL}, /* uses wallet if enabled */
 
         /* Utility functions */
-        {"util", "createmultisig", &createmultisig, true, true, false},
-        {"util", "validateaddress", &validateaddress, true, false, false}, /* uses wallet if enabled */
-        {"util", "verifymessage", &verifymessage, true, false, false},
-        {"util", "estimatefee", &estimatefee, true, true, false},
-        {"util", "estimatepriority", &estimatepriority, true, true, false},
+        {"util", "createmultisig", &createmultisig, true, true, false, NULL},
+        {"util", "validateaddress", &validateaddress, true, false, false, NULL}, /* uses wallet if enabled */
+        {"util", "verifymessage", &verifymessage, true, false, false, NULL},
+        {"util", "estimatefee", &estimatefee, true, true, false, NULL},
+        {"util", "estimatepriority", &estimatepriority, true, true, false, NULL},
 
         /* Not shown in help */
-        {"hidden", "invalidateblock", &invalidateblock, true, true, false},
-        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false},
-        {"hidden", "setmocktime", &setmocktime, true, false, false},
+        {"hidden", "invalidateblock", &invalidateblock, true, true, false, NULL},
+        {"hidden", "reconsiderblock", &reconsiderblock, true, true, false, NULL},
+        {"hidden", "setmocktime", &setmocktime, true, false, false, NULL},
 
         /* Blocknetdx features */
-        {"blocknetdx", "servicenode", &servicenode, true, true, false},
-        {"blocknetdx", "servicenodelist", &servicenodelist, true, true, false},
-        {"blocknetdx", "mnbudget", &mnbudget, true, true, false},
-        {"blocknetdx", "mnbudgetvoteraw", &mnbudgetvoteraw, true, true, false},
-        {"blocknetdx", "mnfinalbudget", &mnfinalbudget, true, true, false},
-        {"blocknetdx", "mnsync", &mnsync, true, true, false},
-        {"blocknetdx", "spork", &spork, true, true, false},
+        {"blocknetdx", "servicenode", &servicenode, true, true, false, NULL},
+        {"blocknetdx", "servicenodelist", &servicenodelist, true, true, false, &servicenodelist},
+        {"blocknetdx", "mnbudget", &mnbudget, true, true, false, NULL},
+        {"blocknetdx", "mnbudgetvoteraw", &mnbudgetvoteraw, true, true, false, NULL},
+        {"blocknetdx", "mnfinalbudget", &mnfinalbudget, true, true, false, NULL},
+        {"blocknetdx", "mnsync", &mnsync, true, true, false, NULL},
+        {"blocknetdx", "spork", &spork, true, true, false, NULL},
 #ifdef ENABLE_WALLET
-        {"blocknetdx", "obfuscation", &obfuscation, false, false, true}, /* not threadSafe because of SendMoney */
+        {"blocknetdx", "obfuscation", &obfuscation, false, false, true, NULL}, /* not threadSafe because of SendMoney */
 
         /* Wallet */
-        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true},
-        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true},
-        {"wallet", "backupwallet", &backupwallet, true, false, true},
-        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true},
-        {"wallet", "dumpwallet", &dumpwallet, true, false, true},
-        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true},
-        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true},
-        {"wallet", "encryptwallet", &encryptwallet, true, false, true},
-        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true},
-        {"wallet", "getaccount", &getaccount, true, false, true},
-        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true},
-        {"wallet", "getbalance", &getbalance, false, false, true},
-        {"wallet", "getnewaddress", &getnewaddress, true, false, true},
-        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true},
-        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true},
-        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true},
-        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true},
-        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true},
-        {"wallet", "gettransaction", &gettransaction, false, false, true},
-        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true},
-        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true},
-        {"wallet", "importprivkey", &importprivkey, true, false, true},
-        {"wallet", "importwallet", &importwallet, true, false, true},
-        {"wallet", "importaddress", &importaddress, true, false, true},
-        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true},
-        {"wallet", "listaccounts", &listaccounts, false, false, true},
-        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true},
-        {"wallet", "listlockunspent", &listlockunspent, false, false, true},
-        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true},
-        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true},
-        {"wallet", "listsinceblock", &listsinceblock, false, false, true},
-        {"wallet", "listtransactions", &listtransactions, false, false, true},
-        {"wallet", "listunspent", &listunspent, false, false, true},
-        {"wallet", "lockunspent", &lockunspent, true, false, true},
-        {"wallet", "move", &movecmd, false, false, true},
-        {"wallet", "multisend", &multisend, false, false, true},
-        {"wallet", "sendfrom", &sendfrom, false, false, true},
-        {"wallet", "sendmany", &sendmany, false, false, true},
-        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true},
-        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true},
-        {"wallet", "setaccount", &setaccount, true, false, true},
-        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true},
-        {"wallet", "settxfee", &settxfee, true, false, true},
-        {"wallet", "signmessage", &signmessage, true, false, true},
-        {"wallet", "walletlock", &walletlock, true, false, true},
-        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true},
-        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true},
-
-        {"xbridge", "dxGetOrderFills",                      &dxGetOrderFills,            true, true, true},
-        {"xbridge", "dxGetOrders",                          &dxGetOrders,                true, true, true},
-        {"xbridge", "dxGetOrder",                           &dxGetOrder,                 true, true, true},
-        {"xbridge", "dxGetLocalTokens",                     &dxGetLocalTokens,           true, true, true},
-        {"xbridge", "dxGetNetworkTokens",                   &dxGetNetworkTokens,         true, true, true},
-        {"xbridge", "dxMakeOrder",                          &dxMakeOrder,                true, true, true},
-        {"xbridge", "dxTakeOrder",                          &dxTakeOrder,                true, true, true},
-        {"xbridge", "dxCancelOrder",                        &dxCancelOrder,              true, true, true},
-        {"xbridge", "dxGetOrderHistory",                    &dxGetOrderHistory,          true, true, true},
-        {"xbridge", "dxGetOrderBook",                       &dxGetOrderBook,             true, true, true},
-        {"xbridge", "dxGetTokenBalances",                   &dxGetTokenBalances,         true, true, true},
-        {"xbridge", "dxGetMyOrders",                        &dxGetMyOrders,              true, true, true},
-        {"xbridge", "dxGetLockedUtxos",                     &dxGetLockedUtxos,           true, true, true}
+        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true, NULL},
+        {"wallet", "autocombinerewards", &autocombinerewards, false, false, true, NULL},
+        {"wallet", "backupwallet", &backupwallet, true, false, true, NULL},
+        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true, NULL},
+        {"wallet", "dumpwallet", &dumpwallet, true, false, true, NULL},
+        {"wallet", "bip38encrypt", &bip38encrypt, true, false, true, NULL},
+        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true, NULL},
+        {"wallet", "encryptwallet", &encryptwallet, true, false, true, NULL},
+        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true, NULL},
+        {"wallet", "getaccount", &getaccount, true, false, true, NULL},
+        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true, NULL},
+        {"wallet", "getbalance", &getbalance, false, false, true, NULL},
+        {"wallet", "getnewaddress", &getnewaddress, true, false, true, NULL},
+        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true, NULL},
+        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true, NULL},
+        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true, NULL},
+        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true, NULL},
+        {"wallet", "getstakesplitthreshold", &getstakesplitthreshold, false, false, true, NULL},
+        {"wallet", "gettransaction", &gettransaction, false, false, true, NULL},
+        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true, NULL},
+        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true, NULL},
+        {"wallet", "importprivkey", &importprivkey, true, false, true, NULL},
+        {"wallet", "importwallet", &importwallet, true, false, true, NULL},
+        {"wallet", "importaddress", &importaddress, true, false, true, NULL},
+        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true, NULL},
+        {"wallet", "listaccounts", &listaccounts, false, false, true, NULL},
+        {"wallet", "listaddressgroupings", &listaddressgroupings, false, false, true, NULL},
+        {"wallet", "listlockunspent", &listlockunspent, false, false, true, NULL},
+        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true, NULL},
+        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true, NULL},
+        {"wallet", "listsinceblock", &listsinceblock, false, false, true, NULL},
+        {"wallet", "listtransactions", &listtransactions, false, false, true, &listtransactions},
+        {"wallet", "listunspent", &listunspent, false, false, true, NULL},
+        {"wallet", "lockunspent", &lockunspent, true, false, true, NULL},
+        {"wallet", "move", &movecmd, false, false, true, NULL},
+        {"wallet", "multisend", &multisend, false, false, true, NULL},
+        {"wallet", "sendfrom", &sendfrom, false, false, true, NULL},
+        {"wallet", "sendmany", &sendmany, false, false, true, NULL},
+        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true, NULL},
+        {"wallet", "sendtoaddressix", &sendtoaddressix, false, false, true, NULL},
+        {"wallet", "setaccount", &setaccount, true, false, true, NULL},
+        {"wallet", "setstakesplitthreshold", &setstakesplitthreshold, false, false, true, NULL},
+        {"wallet", "settxfee", &settxfee, true, false, true, NULL},
+        {"wallet", "signmessage", &signmessage, true, false, true, NULL},
+        {"wallet", "walletlock", &walletlock, true, false, true, NULL},
+        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true, NULL},
+        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true, NULL},
+
+        {"xbridge", "dxGetOrderFills",                      &dxGetOrderFills,            true, true, true, NULL},
+        {"xbridge", "dxGetOrders",                          &dxGetOrders,                true, true, true, NULL},
+        {"xbridge", "dxGetOrder",                           &dxGetOrder,                 true, true, true, NULL},
+        {"xbridge", "dxGetLocalTokens",                     &dxGetLocalTokens,           true, true, true, NULL},
+        {"xbridge", "dxGetNetworkTokens",                   &dxGetNetworkTokens,         true, true, true, NULL},
+        {"xbridge", "dxGetConnectorStats",                  &dxGetConnectorStats,        true, true, true, NULL},
+        {"xbridge", "dxMakeOrder",                          &dxMakeOrder,                true, true, true, NULL},
+        {"xbridge", "dxTakeOrder",                          &dxTakeOrder,                true, true, true, NULL},
+        {"xbridge", "dxCancelOrder",                        &dxCancelOrder,              true, true, true, NULL},
+        {"xbridge", "dxGetOrderHistory",                    &dxGetOrderHistory,          true, true, true, &dxGetOrderHistory},
+        {"xbridge", "dxGetOrderBook",                       &dxGetOrderBook,             true, true, true, NULL},
+        {"xbridge", "dxGetTokenBalances",                   &dxGetTokenBalances,         true, true, true, NULL},
+        {"xbridge", "dxGetMyOrders",                        &dxGetMyOrders,              true, true, true, NULL},
+        {"xbridge", "dxGetLockedUtxos",                     &dxGetLockedUtxos,           true, true, true, NULL}
     #endif // ENABLE_WALLET
 };
 
@@ -451,16 +499,39 @@ bool ClientAllowed(const boost::asio::ip::address& address)
     return false;
 }
 
-template <typename Protocol>
-class AcceptedConnectionImpl : public AcceptedConnection
+/** Client connection as seen by the workers */
+class RPCConnection
 {
 public:
-    AcceptedConnectionImpl(
-        asio::io_service& io_service,
-        ssl::context& context,
-        bool fUseSSL) : sslStream(io_service, context),
-                        _d(sslStream, fUseSSL),
-                        _stream(_d)
+    virtual ~RPCConnection() {}
+
+    virtual std::string peer_address_to_string() const = 0;
+    /**
+     * Queue data for sending, from any thread, without waiting for the client. After
+     * the data of the fLast call is sent the next request is read if fKeepAlive,
+     * otherwise the connection is closed. Returns false if the client fell too far
+     * behind, the connection is then closed and the rest of the reply can be dropped.
+     */
+    virtual bool Write(const std::string& data, bool fLast, bool fKeepAlive) = 0;
+};
+
+/**
+ * Connection handed to the request handlers by a worker. The reply written to stream()
+ * is passed to the I/O thread when the handler is done, or chunk by chunk while it is
+ * written after begin_chunked().
+ */
+class BufferedConnection : public AcceptedConnection, private std::streambuf
+{
+public:
+    BufferedConnection(const boost::shared_ptr<RPCConnection>& connIn, int nProtoIn) : conn(connIn),
+                                                                                        nProto(nProtoIn),
+                                                                                        _stream(this),
+                                                                                        fChunked(false),
+                                                                                        fChunkSent(false),
+                                                                                        fChunkAborted(false),
+                                                                                        nChunkStatus(0),
+                                                                                        fChunkKeepAlive(false),
+                                                                                        fWriteFailed(false)
     {
     }
 
@@ -471,30 +542,508 @@ public:
 
     virtual std::string peer_address_to_string() const
     {
-        return peer.address().to_string();
+        return conn->peer_address_to_string();
     }
 
     virtual void close()
     {
-        _stream.close();
+    }
+
+    virtual bool begin_chunked(int nStatus, bool keepalive, const char* contentType)
+    {
+        // HTTP/1.0 clients do not understand chunked transfer encoding
+        if (nProto < 1 || fChunked || !strBuffer.empty())
+            return false;
+        fChunked = true;
+        nChunkStatus = nStatus;
+        fChunkKeepAlive = keepalive;
+        strChunkContentType = contentType;
+        return true;
+    }
+
+    virtual bool abort_chunked()
+    {
+        if (!fChunked)
+            return true;
+        fChunked = false;
+        fChunkAborted = fChunkSent;
+        strBuffer.clear();
+        return !fChunkSent;
+    }
+
+    //! Hand the rest of the reply to the I/O thread, the connection is closed afterwards unless fKeepAlive
+    void Finish(bool fKeepAlive)
+    {
+        if (fWriteFailed) {
+            // The connection is being closed
+        } else if (fChunkAborted) {
+            // No terminating chunk, so the client sees the reply was cut short
+            conn->Write("", true, false);
+        } else if (fChunkSent) {
+            SendChunk();
+            conn->Write("0\r\n\r\n", true, fKeepAlive);
+        } else if (fChunked) {
+            // Small enough to be sent with its length after all
+            conn->Write(HTTPReplyHeader(nChunkStatus, fChunkKeepAlive, strBuffer.size(), strChunkContentType.c_str()) + strBuffer, true, fKeepAlive);
+        } else {
+            conn->Write(strBuffer, true, fKeepAlive && !strBuffer.empty());
+        }
+    }
+
+private:
+    //! Amount of chunked reply buffered before it is sent
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    int overflow(int c)
+    {
+        if (c != traits_type::eof()) {
+            char ch = c;
+            xsputn(&ch, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n)
+    {
+        // Once the client fell behind the rest of the reply is dropped
+        if (fWriteFailed)
+            return n;
+        strBuffer.append(s, n);
+        if (fChunked && strBuffer.size() >= CHUNK_SIZE)
+            SendChunk();
+        return n;
+    }
+
+    void SendChunk()
+    {
+        if (strBuffer.empty())
+            return;
+        std::string strChunk;
+        if (!fChunkSent)
+            strChunk = HTTPReplyHeaderChunked(nChunkStatus, fChunkKeepAlive, strChunkContentType.c_str());
+        strChunk += strprintf("%x\r\n", strBuffer.size());
+        strChunk += strBuffer;
+        strChunk += "\r\n";
+        strBuffer.clear();
+        fChunkSent = true;
+        fWriteFailed = !conn->Write(strChunk, false, false);
+    }
+
+    boost::shared_ptr<RPCConnection> conn;
+    int nProto;
+    std::iostream _stream;
+    std::string strBuffer;
+    bool fChunked;
+    bool fChunkSent;
+    bool fChunkAborted;
+    int nChunkStatus;
+    bool fChunkKeepAlive;
+    std::string strChunkContentType;
+    bool fWriteFailed;
+};
+
+/** A request read by the I/O thread, waiting for a worker */
+class RPCWorkItem
+{
+public:
+    boost::shared_ptr<RPCConnection> conn;
+    string strURI;
+    map<string, string> mapHeaders;
+    //! JSON-RPC body, parsed into valRequest by the worker that takes the request
+    string strRequest;
+    Value valRequest;
+    bool fParsed;
+    int nProto;
+    //! Method name for limits and metrics: the JSON-RPC method, "batch" or "rest"
+    string strMethod;
+    //! Whether the connection stays open after the reply
+    bool fKeepAlive;
+    int64_t nTimeQueued;
+
+    RPCWorkItem() : fParsed(false), nProto(0), fKeepAlive(false), nTimeQueued(0) {}
+
+    //! Parse strRequest and find the method it calls
+    void Parse()
+    {
+        string strBody;
+        strBody.swap(strRequest);
+        fParsed = read_string(strBody, valRequest);
+        if (fParsed && valRequest.type() == array_type)
+            strMethod = "batch";
+        else if (fParsed && valRequest.type() == obj_type) {
+            const Value& valMethod = find_value(valRequest.get_obj(), "method");
+            if (valMethod.type() == str_type && tableRPC[valMethod.get_str()])
+                strMethod = valMethod.get_str();
+        }
+    }
+};
+
+struct RPCMethodStats {
+    int64_t nCalls;
+    int nActive;
+    int64_t nTimeWait;
+    int64_t nTimeExec;
+    int64_t nTimeExecMax;
+
+    RPCMethodStats() : nCalls(0), nActive(0), nTimeWait(0), nTimeExec(0), nTimeExecMax(0) {}
+};
+
+/**
+ * Bounded queue of requests, served by -rpcthreads workers. A worker takes the
+ * oldest request whose method is below its -rpcmethodlimit, so a burst of one slow
+ * call cannot occupy every worker while other requests wait. A request's method is
+ * only known once a worker has parsed it; if that method is at its limit the request
+ * goes back to the front of the queue.
+ */
+class RPCWorkQueue
+{
+public:
+    RPCWorkQueue(size_t nMaxDepthIn, int nWorkersIn) : nMaxDepth(nMaxDepthIn), nWorkers(nWorkersIn), fRunning(true), nRejected(0)
+    {
+    }
+
+    void SetLimit(const std::string& strMethod, int nLimit)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        mapLimits[strMethod] = nLimit;
+    }
+
+    //! Returns false if the queue is full
+    bool Enqueue(const boost::shared_ptr<RPCWorkItem>& item)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (queue.size() >= nMaxDepth) {
+            nRejected++;
+            return false;
+        }
+        queue.push_back(item);
+        cond.notify_all();
+        return true;
+    }
+
+    void Interrupt()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fRunning = false;
+        cond.notify_all();
+    }
+
+    //! Worker thread
+    void Run();
+
+    Object GetInfo()
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        Object obj;
+        Object methods;
+        int nActive = 0;
+        BOOST_FOREACH (const PAIRTYPE(std::string, RPCMethodStats) & item, mapStats) {
+            const RPCMethodStats& stats = item.second;
+            nActive += stats.nActive;
+            if (item.first.empty())
+                continue;
+            Object method;
+            method.push_back(Pair("calls", stats.nCalls));
+            method.push_back(Pair("active", stats.nActive));
+            if (mapLimits.count(item.first))
+                method.push_back(Pair("limit", mapLimits[item.first]));
+            method.push_back(Pair("avg_wait_ms", stats.nCalls ? stats.nTimeWait * 0.001 / stats.nCalls : 0.0));
+            method.push_back(Pair("avg_ms", stats.nCalls ? stats.nTimeExec * 0.001 / stats.nCalls : 0.0));
+            method.push_back(Pair("max_ms", stats.nTimeExecMax * 0.001));
+            methods.push_back(Pair(item.first, method));
+        }
+        obj.push_back(Pair("threads", nWorkers));
+        obj.push_back(Pair("queued", (int)queue.size()));
+        obj.push_back(Pair("queue_max", (int)nMaxDepth));
+        obj.push_back(Pair("active", nActive));
+        obj.push_back(Pair("rejected", nRejected));
+        obj.push_back(Pair("methods", methods));
+        return obj;
+    }
+
+private:
+    //! Oldest request allowed to run now, queue.end() if none. cs must be held.
+    std::deque<boost::shared_ptr<RPCWorkItem> >::iterator FindRunnable()
+    {
+        std::deque<boost::shared_ptr<RPCWorkItem> >::iterator it;
+        for (it = queue.begin(); it != queue.end(); ++it) {
+            std::map<std::string, int>::const_iterator limit = mapLimits.find((*it)->strMethod);
+            if (limit == mapLimits.end() || mapStats[(*it)->strMethod].nActive < limit->second)
+                break;
+        }
+        return it;
+    }
+
+    boost::mutex cs;
+    boost::condition_variable cond;
+    std::deque<boost::shared_ptr<RPCWorkItem> > queue;
+    std::map<std::string, int> mapLimits;
+    std::map<std::string, RPCMethodStats> mapStats;
+    size_t nMaxDepth;
+    int nWorkers;
+    bool fRunning;
+    int64_t nRejected;
+};
+
+static Object GetRPCWorkQueueInfo()
+{
+    return rpc_work_queue->GetInfo();
+}
+
+/**
+ * Asynchronous HTTP connection. All socket operations run on the RPC I/O thread:
+ * requests are read there and handed to the work queue, one at a time per
+ * connection, so pipelined requests are answered in order. The body of a JSON-RPC
+ * request is only read once its headers carry valid credentials.
+ */
+template <typename Protocol>
+class RPCConnectionImpl : public RPCConnection, public boost::enable_shared_from_this<RPCConnectionImpl<Protocol> >
+{
+public:
+    RPCConnectionImpl(
+        asio::io_service& io_service,
+        ssl::context& context,
+        bool fUseSSLIn) : sslStream(io_service, context),
+                          authTimer(io_service),
+                          fUseSSL(fUseSSLIn),
+                          buf(MAX_SIZE + MAX_HEADERS_SIZE),
+                          nContentLength(0),
+                          replyQueue(MAX_SEND_SIZE)
+    {
+    }
+
+    virtual std::string peer_address_to_string() const
+    {
+        return peer.address().to_string();
+    }
+
+    virtual bool Write(const std::string& data, bool fLast, bool fKeepAlive)
+    {
+        if (!replyQueue.Push(data, fLast, fKeepAlive)) {
+            LogPrint("rpc", "ThreadRPCServer reply to %s dropped, the client is %u bytes behind\n", peer_address_to_string(), MAX_SEND_SIZE);
+            sslStream.get_io_service().post(boost::bind(&RPCConnectionImpl::Close, this->shared_from_this()));
+            return false;
+        }
+        sslStream.get_io_service().post(boost::bind(&RPCConnectionImpl::SendNext, this->shared_from_this()));
+        return true;
+    }
+
+    void Start()
+    {
+        if (fUseSSL)
+            sslStream.async_handshake(ssl::stream_base::server,
+                boost::bind(&RPCConnectionImpl::HandleHandshake, this->shared_from_this(), asio::placeholders::error));
+        else
+            ReadRequest();
+    }
+
+    void Close()
+    {
+        boost::system::error_code ec;
+        sslStream.lowest_layer().shutdown(socket_base::shutdown_both, ec);
+        sslStream.lowest_layer().close(ec);
     }
 
     typename Protocol::endpoint peer;
     asio::ssl::stream<typename Protocol::socket> sslStream;
 
 private:
-    SSLIOStreamDevice<Protocol> _d;
-    iostreams::stream<SSLIOStreamDevice<Protocol> > _stream;
-};
+    //! Limit on the request line and headers of a request
+    static const size_t MAX_HEADERS_SIZE = 64 * 1024;
+    //! Reply bytes queued for the client before a streamed reply is dropped
+    static const size_t MAX_SEND_SIZE = 64 * 1024 * 1024;
+
+    typedef asio::buffers_iterator<asio::streambuf::const_buffers_type> BufIterator;
+
+    //! Match the end of the headers, or stop after MAX_HEADERS_SIZE bytes without one
+    static std::pair<BufIterator, bool> MatchHeadersEnd(BufIterator begin, BufIterator end)
+    {
+        static const char* pszEnd = "\r\n\r\n";
+        BufIterator it = std::search(begin, end, pszEnd, pszEnd + 4);
+        if (it != end)
+            return std::make_pair(it + 4, true);
+        if ((size_t)(end - begin) > MAX_HEADERS_SIZE)
+            return std::make_pair(end, true);
+        return std::make_pair(begin, false);
+    }
+
+    void HandleHandshake(const boost::system::error_code& error)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+        ReadRequest();
+    }
+
+    void ReadRequest()
+    {
+        if (ShutdownRequested()) {
+            Close();
+            return;
+        }
+        // Completes immediately if a pipelined request is already buffered
+        if (fUseSSL)
+            asio::async_read_until(sslStream, buf, &RPCConnectionImpl::MatchHeadersEnd,
+                boost::bind(&RPCConnectionImpl::HandleHeaders, this->shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
+        else
+            asio::async_read_until(sslStream.next_layer(), buf, &RPCConnectionImpl::MatchHeadersEnd,
+                boost::bind(&RPCConnectionImpl::HandleHeaders, this->shared_from_this(), asio::placeholders::error, asio::placeholders::bytes_transferred));
+    }
+
+    void HandleHeaders(const boost::system::error_code& error, size_t nHeadersSize)
+    {
+        if (error || nHeadersSize > MAX_HEADERS_SIZE) {
+            Close();
+            return;
+        }
+
+        std::istream stream(&buf);
+        string strMethod;
+        item.reset(new RPCWorkItem());
+        if (!ReadHTTPRequestLine(stream, item->nProto, strMethod, item->strURI)) {
+            Close();
+            return;
+        }
+        nContentLength = ReadHTTPHeaders(stream, item->mapHeaders);
+        if (nContentLength < 0 || (size_t)nContentLength > MAX_SIZE) {
+            Close();
+            return;
+        }
+
+        string& strConnection = item->mapHeaders["connection"];
+        if (strConnection != "close" && strConnection != "keep-alive")
+            strConnection = item->nProto >= 1 ? "keep-alive" : "close";
+
+        // HTTP Keep-Alive is false; close connection after the reply
+        item->fKeepAlive = strConnection != "close" && GetBoolArg("-rpckeepalive", true);
+
+        // Without valid credentials the body is never read: this thread answers
+        // with HTTP_UNAUTHORIZED and the connection is closed
+        if (item->strURI == "/" && !HTTPAuthorized(item->mapHeaders)) {
+            bool fAttempt = item->mapHeaders.count("authorization") != 0;
+            item.reset();
+            if (!fAttempt) {
+                Write(HTTPError(HTTP_UNAUTHORIZED, false), true, false);
+                return;
+            }
+            LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", peer_address_to_string());
+            /* Deter brute-forcing
+               If this results in a DoS the user really
+               shouldn't have their RPC port exposed. */
+            authTimer.expires_from_now(posix_time::milliseconds(250));
+            authTimer.async_wait(boost::bind(&RPCConnectionImpl::HandleUnauthorized, this->shared_from_this(), asio::placeholders::error));
+            return;
+        }
+
+        if (buf.size() >= (size_t)nContentLength)
+            HandleBody(boost::system::error_code());
+        else if (fUseSSL)
+            asio::async_read(sslStream, buf, asio::transfer_exactly(nContentLength - buf.size()),
+                boost::bind(&RPCConnectionImpl::HandleBody, this->shared_from_this(), asio::placeholders::error));
+        else
+            asio::async_read(sslStream.next_layer(), buf, asio::transfer_exactly(nContentLength - buf.size()),
+                boost::bind(&RPCConnectionImpl::HandleBody, this->shared_from_this(), asio::placeholders::error));
+    }
+
+    void HandleUnauthorized(const boost::system::error_code& error)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+        Write(HTTPError(HTTP_UNAUTHORIZED, false), true, false);
+    }
+
+    void HandleBody(const boost::system::error_code& error)
+    {
+        if (error) {
+            Close();
+            return;
+        }
+
+        string strRequest(nContentLength, '\0');
+        if (nContentLength > 0) {
+            std::istream stream(&buf);
+            stream.read(&strRequest[0], nContentLength);
+        }
+
+        if (item->strURI == "/") {
+            // The worker parses it
+            item->strRequest.swap(strRequest);
+        } else if (item->strURI.substr(0, 6) == "/rest/" && GetBoolArg("-rest", false)) {
+            item->strMethod = "rest";
+        } else {
+            item.reset();
+            Write(HTTPError(HTTP_NOT_FOUND, false), true, false);
+            return;
+        }
+        Dispatch();
+    }
+
+    //! Hand the request read so far to the work queue
+    void Dispatch()
+    {
+        boost::shared_ptr<RPCWorkItem> request;
+        request.swap(item);
+
+        request->conn = this->shared_from_this();
+        request->nTimeQueued = GetTimeMicros();
+        if (!rpc_work_queue->Enqueue(request)) {
+            LogPrint("rpc", "ThreadRPCServer work queue full, rejecting request from %s\n", peer_address_to_string());
+            Write(HTTPError(HTTP_SERVICE_UNAVAILABLE, request->fKeepAlive), true, request->fKeepAlive);
+        }
+    }
+
+    //! Start writing the next queued data, or finish the reply once all is sent
+    void SendNext()
+    {
+        const std::string* pdata = replyQueue.BeginSend();
+        if (pdata) {
+            if (fUseSSL)
+                asio::async_write(sslStream, asio::buffer(*pdata),
+                    boost::bind(&RPCConnectionImpl::HandleWrite, this->shared_from_this(), asio::placeholders::error));
+            else
+                asio::async_write(sslStream.next_layer(), asio::buffer(*pdata),
+                    boost::bind(&RPCConnectionImpl::HandleWrite, this->shared_from_this(), asio::placeholders::error));
+            return;
+        }
+        bool fKeepAlive;
+        if (!replyQueue.TakeFinished(fKeepAlive))
+            return;
+        if (fKeepAlive)
+            ReadRequest();
+        else
+            Close();
+    }
+
+    void HandleWrite(const boost::system::error_code& error)
+    {
+        replyQueue.EndSend(!!error);
+        if (error) {
+            Close();
+            return;
+        }
+        SendNext();
+    }
 
-void ServiceConnection(AcceptedConnection* conn);
+    //! Delays the reply to bad credentials
+    deadline_timer authTimer;
+    bool fUseSSL;
+    asio::streambuf buf;
+    boost::shared_ptr<RPCWorkItem> item;
+    int nContentLength;
+
+    //! Reply data queued by the workers
+    HTTPReplyQueue replyQueue;
+};
 
 //! Forward declaration required for RPCListen
 template <typename Protocol, typename SocketAcceptorService>
 static void RPCAcceptHandler(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
     ssl::context& context,
     bool fUseSSL,
-    boost::shared_ptr<AcceptedConnection> conn,
+    boost::shared_ptr<RPCConnectionImpl<Protocol> > conn,
     const boost::system::error_code& error);
 
 /**
@@ -506,7 +1055,7 @@ static void RPCListen(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAc
     const bool fUseSSL)
 {
     // Accept connection
-    boost::shared_ptr<AcceptedConnectionImpl<Protocol> > conn(new AcceptedConnectionImpl<Protocol>(acceptor->get_io_service(), context, fUseSSL));
+    boost::shared_ptr<RPCConnectionImpl<Protocol> > conn(new RPCConnectionImpl<Protocol>(acceptor->get_io_service(), context, fUseSSL));
 
     acceptor->async_accept(
         conn->sslStream.lowest_layer(),
@@ -527,30 +1076,28 @@ template <typename Protocol, typename SocketAcceptorService>
 static void RPCAcceptHandler(boost::shared_ptr<basic_socket_acceptor<Protocol, SocketAcceptorService> > acceptor,
     ssl::context& context,
     const bool fUseSSL,
-    boost::shared_ptr<AcceptedConnection> conn,
+    boost::shared_ptr<RPCConnectionImpl<Protocol> > conn,
     const boost::system::error_code& error)
 {
     // Immediately start accepting new connections, except when we're cancelled or our socket is closed.
     if (error != asio::error::operation_aborted && acceptor->is_open())
         RPCListen(acceptor, context, fUseSSL);
 
-    AcceptedConnectionImpl<ip::tcp>* tcp_conn = dynamic_cast<AcceptedConnectionImpl<ip::tcp>*>(conn.get());
-
     if (error) {
         // TODO: Actually handle errors
         LogPrintf("%s: Error: %s\n", __func__, error.message());
     }
     // Restrict callers by IP.  It is important to
-    // do this before starting client thread, to filter out
+    // do this before reading the request, to filter out
     // certain DoS and misbehaving clients.
-    else if (tcp_conn && !ClientAllowed(tcp_conn->peer.address())) {
+    else if (!ClientAllowed(conn->peer.address())) {
         // Only send a 403 if we're not using SSL to prevent a DoS during the SSL handshake.
         if (!fUseSSL)
-            conn->stream() << HTTPError(HTTP_FORBIDDEN, false) << std::flush;
-        conn->close();
+            conn->Write(HTTPError(HTTP_FORBIDDEN, false), true, false);
+        else
+            conn->Close();
     } else {
-        ServiceConnection(conn.get());
-        conn->close();
+        conn->Start();
     }
 }
 
@@ -610,6 +1157,20 @@ void StartRPCThreads()
         return;
     }
 
+    std::map<std::string, int> mapMethodLimits;
+    BOOST_FOREACH (const std::string& strLimit, mapMultiArgs["-rpcmethodlimit"]) {
+        size_t nColon = strLimit.rfind(':');
+        int32_t nLimit = 0;
+        if (nColon == string::npos || nColon == 0 || !ParseInt32(strLimit.substr(nColon + 1), &nLimit) || nLimit < 1) {
+            uiInterface.ThreadSafeMessageBox(
+                strprintf(_("Invalid -rpcmethodlimit value %s, expected <method>:<n>"), strLimit),
+                "", CClientUIInterface::MSG_ERROR);
+            StartShutdown();
+            return;
+        }
+        mapMethodLimits[strLimit.substr(0, nColon)] = nLimit;
+    }
+
     assert(rpc_io_service == NULL);
     rpc_io_service = new asio::io_service();
     rpc_ssl_context = new ssl::context(*rpc_io_service, ssl::context::sslv23);
@@ -710,9 +1271,17 @@ void StartRPCThreads()
         return;
     }
 
+    const int nWorkers = std::max((int)GetArg("-rpcthreads", DEFAULT_RPC_THREADS), 1);
+    rpc_work_queue = new RPCWorkQueue(std::max((int)GetArg("-rpcworkqueue", DEFAULT_RPC_WORK_QUEUE), 1), nWorkers);
+    BOOST_FOREACH (const PAIRTYPE(std::string, int) & limit, mapMethodLimits)
+        rpc_work_queue->SetLimit(limit.first, limit.second);
+
+    // A single thread drives all sockets; calls are executed by the queue workers,
+    // so idle keep-alive connections no longer hold a thread.
     rpc_worker_group = new boost::thread_group();
-    for (int i = 0; i < GetArg("-rpcthreads", 4); i++)
-        rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    rpc_worker_group->create_thread(boost::bind(&asio::io_service::run, rpc_io_service));
+    for (int i = 0; i < nWorkers; i++)
+        rpc_worker_group->create_thread(boost::bind(&RPCWorkQueue::Run, rpc_work_queue));
     fRPCRunning = true;
 }
 
@@ -752,10 +1321,15 @@ void StopRPCThreads()
     }
     deadlineTimers.clear();
 
+    if (rpc_work_queue != NULL)
+        rpc_work_queue->Interrupt();
     rpc_io_service->stop();
     cvBlockChange.notify_all();
     if (rpc_worker_group != NULL)
         rpc_worker_group->join_all();
+    // Queued requests reference sockets of the io_service, release them first
+    delete rpc_work_queue;
+    rpc_work_queue = NULL;
     delete rpc_dummy_work;
     rpc_dummy_work = NULL;
     delete rpc_worker_group;
@@ -882,7 +1456,8 @@ static string JSONRPCExecBatch(const Array& vReq)
 }
 
 static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
-    string& strRequest,
+    const Value& valRequest,
+    bool fParsed,
     map<string, string>& mapHeaders,
     bool fRun)
 {
@@ -892,22 +1467,16 @@ static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
         return false;
     }
 
+    // Bad credentials are answered by the connection, after a delay, before the request is queued
     if (!HTTPAuthorized(mapHeaders)) {
-        LogPrintf("ThreadRPCServer incorrect password attempt from %s\n", conn->peer_address_to_string());
-        /* Deter brute-forcing
-           If this results in a DoS the user really
-           shouldn't have their RPC port exposed. */
-        MilliSleep(250);
-
         conn->stream() << HTTPError(HTTP_UNAUTHORIZED, false) << std::flush;
         return false;
     }
 
     JSONRequest jreq;
     try {
-        // Parse request
-        Value valRequest;
-        if (!read_string(strRequest, valRequest))
+        // Request was parsed by RPCWorkQueue::Run
+        if (!fParsed)
             throw JSONRPCError(RPC_PARSE_ERROR, "Parse error");
 
         // Return immediately if in warmup
@@ -923,6 +1492,16 @@ static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
         if (valRequest.type() == obj_type) {
             jreq.parse(valRequest);
 
+            if (tableRPC.isStreaming(jreq.strMethod) && conn->begin_chunked(HTTP_OK, fRun, "application/json")) {
+                // Serialize the result straight to the connection, same text as JSONRPCReply
+                conn->stream() << "{\"result\":";
+                JSONStreamWriter writer(conn->stream(), 8);
+                tableRPC.execute(jreq.strMethod, jreq.params, writer);
+                conn->stream() << ",\"error\":null,\"id\":" << write_string(jreq.id, json_spirit::none, 8) << "}\n"
+                               << std::flush;
+                return true;
+            }
+
             Value result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -936,52 +1515,107 @@ static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
 
         conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, strReply.size()) << strReply << std::flush;
     } catch (Object& objError) {
-        ErrorReply(conn->stream(), objError, jreq.id);
+        if (conn->abort_chunked())
+            ErrorReply(conn->stream(), objError, jreq.id);
         return false;
     } catch (std::exception& e) {
-        ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
+        if (conn->abort_chunked())
+            ErrorReply(conn->stream(), JSONRPCError(RPC_PARSE_ERROR, e.what()), jreq.id);
         return false;
     }
     return true;
 }
 
-void ServiceConnection(AcceptedConnection* conn)
+void RPCWorkQueue::Run()
 {
-    bool fRun = true;
-    while (fRun && !ShutdownRequested()) {
-        int nProto = 0;
-        map<string, string> mapHeaders;
-        string strRequest, strMethod, strURI;
-
-        // Read HTTP request line
-        if (!ReadHTTPRequestLine(conn->stream(), nProto, strMethod, strURI))
-            break;
-
-        // Read HTTP message headers and body
-        ReadHTTPMessage(conn->stream(), mapHeaders, strRequest, nProto, MAX_SIZE);
+    while (true) {
+        boost::shared_ptr<RPCWorkItem> item;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            std::deque<boost::shared_ptr<RPCWorkItem> >::iterator it;
+            while (fRunning && (it = FindRunnable()) == queue.end())
+                cond.wait(lock);
+            if (!fRunning)
+                return;
+            item = *it;
+            queue.erase(it);
+            if (item->strRequest.empty())
+                mapStats[item->strMethod].nActive++;
+        }
 
-        // HTTP Keep-Alive is false; close connection immediately
-        if ((mapHeaders["connection"] == "close") || (!GetBoolArg("-rpckeepalive", true)))
-            fRun = false;
+        if (!item->strRequest.empty()) {
+            item->Parse();
 
-        // Process via JSON-RPC API
-        if (strURI == "/") {
-            if (!HTTPReq_JSONRPC(conn, strRequest, mapHeaders, fRun))
-                break;
+            boost::unique_lock<boost::mutex> lock(cs);
+            std::map<std::string, int>::const_iterator limit = mapLimits.find(item->strMethod);
+            if (limit != mapLimits.end() && mapStats[item->strMethod].nActive >= limit->second) {
+                queue.push_front(item);
+                continue;
+            }
+            mapStats[item->strMethod].nActive++;
+        }
 
-            // Process via HTTP REST API
-        } else if (strURI.substr(0, 6) == "/rest/" && GetBoolArg("-rest", false)) {
-            if (!HTTPReq_REST(conn, strURI, mapHeaders, fRun))
-                break;
+        int64_t nStart = GetTimeMicros();
+        BufferedConnection conn(item->conn, item->nProto);
+        bool fKeepAlive = false;
+        try {
+            if (item->strURI == "/")
+                fKeepAlive = HTTPReq_JSONRPC(&conn, item->valRequest, item->fParsed, item->mapHeaders, item->fKeepAlive);
+            else
+                fKeepAlive = HTTPReq_REST(&conn, item->strURI, item->mapHeaders, item->fKeepAlive);
+        } catch (std::exception& e) {
+            LogPrintf("ThreadRPCServer %s: %s\n", SanitizeString(item->strMethod), e.what());
+            conn.abort_chunked();
+        }
+        int64_t nTimeExec = GetTimeMicros() - nStart;
+        int64_t nTimeWait = nStart - item->nTimeQueued;
 
-        } else {
-            conn->stream() << HTTPError(HTTP_NOT_FOUND, false) << std::flush;
-            break;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            RPCMethodStats& stats = mapStats[item->strMethod];
+            stats.nActive--;
+            stats.nCalls++;
+            stats.nTimeWait += nTimeWait;
+            stats.nTimeExec += nTimeExec;
+            stats.nTimeExecMax = std::max(stats.nTimeExecMax, nTimeExec);
+            // A request held back by its method limit may run now
+            cond.notify_all();
         }
+        LogPrint("rpc", "ThreadRPCServer %s: %.2fms (queued %.2fms)\n", item->strMethod, nTimeExec * 0.001, nTimeWait * 0.001);
+
+        conn.Finish(item->fKeepAlive && fKeepAlive);
     }
 }
 
 json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params) const
+{
+    Value result;
+    execute(strMethod, params, &result, NULL);
+    return result;
+}
+
+void CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params, JSONWriter& writer) const
+{
+    execute(strMethod, params, NULL, &writer);
+}
+
+bool CRPCTable::isStreaming(const std::string& strMethod) const
+{
+    const CRPCCommand* pcmd = tableRPC[strMethod];
+    return pcmd && pcmd->streamActor;
+}
+
+static void CallCommand(const CRPCCommand* pcmd, const Array& params, Value* pResult, JSONWriter* pWriter)
+{
+    if (!pWriter)
+        *pResult = pcmd->actor(params, false);
+    else if (pcmd->streamActor)
+        pcmd->streamActor(params, false, *pWriter);
+    else
+        pWriter->Write(pcmd->actor(params, false));
+}
+
+void CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params, Value* pResult, JSONWriter* pWriter) const
 {
     // Find method
     const CRPCCommand* pcmd = tableRPC[strMethod];
@@ -1000,14 +1634,13 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
 
     try {
         // Execute
-        Value result;
         {
             if (pcmd->threadSafe)
-                result = pcmd->actor(params, false);
+                CallCommand(pcmd, params, pResult, pWriter);
 #ifdef ENABLE_WALLET
             else if (!pwalletMain) {
                 LOCK(cs_main);
-                result = pcmd->actor(params, false);
+                CallCommand(pcmd, params, pResult, pWriter);
             } else {
                 while (true) {
                     TRY_LOCK(cs_main, lockMain);
@@ -1021,7 +1654,7 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
                             MilliSleep(50);
                             continue;
                         }
-                        result = pcmd->actor(params, false);
+                        CallCommand(pcmd, params, pResult, pWriter);
                         break;
                     }
                     break;
@@ -1030,11 +1663,10 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
 #else  // ENABLE_WALLET
             else {
                 LOCK(cs_main);
-                result = pcmd->actor(params, false);
+                CallCommand(pcmd, params, pResult, pWriter);
             }
 #endif // !ENABLE_WALLET
         }
-        return result;
     } catch (std::exception& e) {
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
     }
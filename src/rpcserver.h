@@ -34,8 +34,25 @@ public:
     virtual std::iostream& stream() = 0;
     virtual std::string peer_address_to_string() const = 0;
     virtual void close() = 0;
+
+    /**
+     * Send the reply written to stream() from now on with chunked transfer encoding,
+     * so a large reply is not held in memory. Returns false if the connection cannot
+     * do that; the reply must then be written with its Content-Length as usual.
+     */
+    virtual bool begin_chunked(int nStatus, bool keepalive, const char* contentType) { return false; }
+    /**
+     * Discard a chunked reply after an error, so that an error reply can be written.
+     * Returns false if part of it was already sent; the connection must then be closed.
+     */
+    virtual bool abort_chunked() { return true; }
 };
 
+/** Default number of threads executing RPC calls */
+static const int DEFAULT_RPC_THREADS = 4;
+/** Default number of parsed RPC requests that may wait for a thread */
+static const int DEFAULT_RPC_WORK_QUEUE = 64;
+
 /** Start RPC threads */
 void StartRPCThreads();
 /**
@@ -86,6 +103,7 @@ void RPCRunLater(const std::string& name, boost::function<void(void)> func, int6
 extern CNetAddr BoostAsioToCNetAddr(boost::asio::ip::address address);
 
 typedef json_spirit::Value (*rpcfn_type)(const json_spirit::Array& params, bool fHelp);
+typedef void (*rpcstreamfn_type)(const json_spirit::Array& params, bool fHelp, JSONWriter& writer);
 
 class CRPCCommand
 {
@@ -96,6 +114,8 @@ public:
     bool okSafeMode;
     bool threadSafe;
     bool reqWallet;
+    //! Optional, writes large results incrementally instead of returning a Value
+    rpcstreamfn_type streamActor;
 };
 
 /**
@@ -119,6 +139,16 @@ public:
      * @throws an exception (json_spirit::Value) when an error happens.
      */
     json_spirit::Value execute(const std::string& method, const json_spirit::Array& params) const;
+    /**
+     * Execute a method, writing the result to writer. Methods with a streamActor
+     * never build the result as a json_spirit::Value.
+     */
+    void execute(const std::string& method, const json_spirit::Array& params, JSONWriter& writer) const;
+    //! Whether the method writes its result incrementally
+    bool isStreaming(const std::string& method) const;
+
+private:
+    void execute(const std::string& method, const json_spirit::Array& params, json_spirit::Value* pResult, JSONWriter* pWriter) const;
 };
 
 extern const CRPCTable tableRPC;
@@ -195,6 +225,7 @@ extern json_spirit::Value createmultisig(const json_spirit::Array& params, bool
 extern json_spirit::Value listreceivedbyaddress(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listreceivedbyaccount(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listtransactions(const json_spirit::Array& params, bool fHelp);
+extern void listtransactions(const json_spirit::Array& params, bool fHelp, JSONWriter& writer);
 extern json_spirit::Value listaddressgroupings(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listaccounts(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value listsinceblock(const json_spirit::Array& params, bool fHelp);
@@ -206,7 +237,12 @@ extern json_spirit::Value walletpassphrasechange(const json_spirit::Array& param
 extern json_spirit::Value walletlock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value encryptwallet(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value validateaddress(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddresstxids(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressbalance(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressutxos(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getspentinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getinfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getrpcinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getwalletinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockchaininfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getnetworkinfo(const json_spirit::Array& params, bool fHelp);
@@ -233,6 +269,7 @@ extern json_spirit::Value getdifficulty(const json_spirit::Array& params, bool f
 extern json_spirit::Value settxfee(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getmempoolinfo(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getrawmempool(const json_spirit::Array& params, bool fHelp);
+extern void getrawmempool(const json_spirit::Array& params, bool fHelp, JSONWriter& writer);
 extern json_spirit::Value getblockhash(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value getblockheader(const json_spirit::Array& params, bool fHelp);
@@ -246,6 +283,7 @@ extern json_spirit::Value obfuscation(const json_spirit::Array& params, bool fHe
 extern json_spirit::Value spork(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value servicenode(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value servicenodelist(const json_spirit::Array& params, bool fHelp);
+extern void servicenodelist(const json_spirit::Array& params, bool fHelp, JSONWriter& writer);
 extern json_spirit::Value mnbudget(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value mnbudgetvoteraw(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value mnfinalbudget(const json_spirit::Array& params, bool fHelp);
@@ -401,6 +439,28 @@ extern json_spirit::Value dxGetLocalTokens(const json_spirit::Array& params, boo
  */
 extern json_spirit::Value dxGetNetworkTokens(const json_spirit::Array& params, bool fHelp);
 
+/**
+ * @brief Returns rpc call counters and latency of the connected wallets
+ * @param params The list of input params, should be empty
+ * @param fHelp If is true then an exception with parameter description message will be thrown
+ * @return Counters by currency as a JSON value
+ * * Example:<br>
+ * \verbatim
+    {
+        "LTC" : {
+            "calls" : 1520,
+            "errors" : 0,
+            "reconnects" : 3,
+            "idle_connections" : 2,
+            "avg_latency_ms" : 1.21,
+            "max_latency_ms" : 35.4,
+            "last_latency_ms" : 0.87
+        }
+    }
+ * \endverbatim
+ */
+extern json_spirit::Value dxGetConnectorStats(const json_spirit::Array& params, bool fHelp);
+
 /**
  * @brief Creates a new transaction
  * @param params The list of input params:<br>
@@ -505,6 +565,7 @@ extern json_spirit::Value dxCancelOrder(const json_spirit::Array& params, bool f
  * \endverbatim
  */
 extern json_spirit::Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp);
+extern void dxGetOrderHistory(const json_spirit::Array& params, bool fHelp, JSONWriter& writer);
 
 /**
  * @brief Returns transactions list in a form of 'order book'
@@ -235,7 +235,7 @@ Value mnbudget(const Array& params, bool fHelp)
                 continue;
             }
 
-            CServicenode* pmn = mnodeman.Find(pubKeyServicenode);
+            CServicenodePtr pmn = mnodeman.Find(pubKeyServicenode);
             if (pmn == NULL) {
                 failed++;
                 statusObj.push_back(Pair("result", "failed"));
@@ -323,7 +323,7 @@ if(strCommand == "vote-alias")
                 continue;
             }
 
-            CServicenode* pmn = mnodeman.Find(pubKeyServicenode);
+            CServicenodePtr pmn = mnodeman.Find(pubKeyServicenode);
             if(pmn == NULL)
             {
                 failed++;
@@ -383,7 +383,7 @@ if(strCommand == "vote-alias")
         if (!obfuScationSigner.SetKey(strServiceNodePrivKey, errorMessage, keyServicenode, pubKeyServicenode))
             return "Error upon calling SetKey";
 
-        CServicenode* pmn = mnodeman.Find(activeServicenode.vin);
+        CServicenodePtr pmn = mnodeman.Find(activeServicenode.vin);
         if (pmn == NULL) {
             return "Failure to find servicenode in list : " + activeServicenode.vin.ToString();
         }
@@ -597,7 +597,7 @@ Value mnbudgetvoteraw(const Array& params, bool fHelp)
     if (fInvalid)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Malformed base64 encoding");
 
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
     if (pmn == NULL) {
         return "Failure to find servicenode in list : " + vin.ToString();
     }
@@ -669,7 +669,7 @@ Value mnfinalbudget(const Array& params, bool fHelp)
                 continue;
             }
 
-            CServicenode* pmn = mnodeman.Find(pubKeyServicenode);
+            CServicenodePtr pmn = mnodeman.Find(pubKeyServicenode);
             if (pmn == NULL) {
                 failed++;
                 statusObj.push_back(Pair("result", "failed"));
@@ -723,7 +723,7 @@ Value mnfinalbudget(const Array& params, bool fHelp)
         if (!obfuScationSigner.SetKey(strServiceNodePrivKey, errorMessage, keyServicenode, pubKeyServicenode))
             return "Error upon calling SetKey";
 
-        CServicenode* pmn = mnodeman.Find(activeServicenode.vin);
+        CServicenodePtr pmn = mnodeman.Find(activeServicenode.vin);
         if (pmn == NULL) {
             return "Failure to find servicenode in list : " + activeServicenode.vin.ToString();
         }
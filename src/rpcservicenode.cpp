@@ -205,7 +205,7 @@ Value servicenode(const Array& params, bool fHelp)
     }
 
     if (strCommand == "current") {
-        CServicenode* winner = mnodeman.GetCurrentServiceNode(1);
+        CServicenodePtr winner = mnodeman.GetCurrentServiceNode(1);
         if (winner) {
             Object obj;
 
@@ -391,7 +391,7 @@ Value servicenode(const Array& params, bool fHelp)
             if(!mne.castOutputIndex(nIndex))
                 continue;
             CTxIn vin = CTxIn(uint256(mne.getTxHash()), uint32_t(nIndex));
-            CServicenode* pmn = mnodeman.Find(vin);
+            CServicenodePtr pmn = mnodeman.Find(vin);
 
             if (strCommand == "start-missing" && pmn) continue;
             if (strCommand == "start-disabled" && pmn && pmn->IsEnabled()) continue;
@@ -482,7 +482,7 @@ Value servicenode(const Array& params, bool fHelp)
             if(!mne.castOutputIndex(nIndex))
                 continue;
             CTxIn vin = CTxIn(uint256(mne.getTxHash()), uint32_t(nIndex));
-            CServicenode* pmn = mnodeman.Find(vin);
+            CServicenodePtr pmn = mnodeman.Find(vin);
 
             std::string strStatus = pmn ? pmn->Status() : "MISSING";
 
@@ -517,7 +517,7 @@ Value servicenode(const Array& params, bool fHelp)
     if (strCommand == "status") {
         if (!fServiceNode) throw runtime_error("This is not a servicenode\n");
 
-        CServicenode* pmn = mnodeman.Find(activeServicenode.vin);
+        CServicenodePtr pmn = mnodeman.Find(activeServicenode.vin);
 
         if (pmn) {
             Object mnObj;
@@ -633,7 +633,7 @@ Value servicenode(const Array& params, bool fHelp)
     return Value::null;
 }
 
-Value servicenodelist(const Array& params, bool fHelp)
+void servicenodelist(const Array& params, bool fHelp, JSONWriter& writer)
 {
     std::string strFilter = "";
 
@@ -667,22 +667,25 @@ Value servicenodelist(const Array& params, bool fHelp)
             HelpExampleCli("servicenodelist", "") + HelpExampleRpc("servicenodelist", ""));
     }
 
-    Array ret;
     int nHeight;
     {
         LOCK(cs_main);
         CBlockIndex* pindex = chainActive.Tip();
-        if(!pindex) return 0;
+        if(!pindex) {
+            writer.Write(0);
+            return;
+        }
         nHeight = pindex->nHeight;
     }
     std::vector<pair<int, CServicenode> > vServicenodeRanks = mnodeman.GetServicenodeRanks(nHeight);
+    writer.BeginArray();
     BOOST_FOREACH (PAIRTYPE(int, CServicenode) & s, vServicenodeRanks) {
         Object obj;
         std::string strVin = s.second.vin.prevout.ToStringShort();
         std::string strTxHash = s.second.vin.prevout.hash.ToString();
         uint32_t oIdx = s.second.vin.prevout.n;
 
-        CServicenode* mn = mnodeman.Find(s.second.vin);
+        CServicenodePtr mn = mnodeman.Find(s.second.vin);
 
         if (strFilter != "" && strTxHash.find(strFilter) == string::npos &&
             mn->Status().find(strFilter) == string::npos &&
@@ -701,8 +704,14 @@ Value servicenodelist(const Array& params, bool fHelp)
         obj.push_back(Pair("lastpaid", (int64_t)mn->GetLastPaid()));
         obj.push_back(Pair("xwallets", mn->GetConnectedWalletsStr()));
 
-        ret.push_back(obj);
+        writer.Write(obj);
     }
+    writer.EndArray();
+}
 
-    return ret;
+Value servicenodelist(const Array& params, bool fHelp)
+{
+    JSONValueWriter writer;
+    servicenodelist(params, fHelp, writer);
+    return writer.GetValue();
 }
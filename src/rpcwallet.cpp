@@ -1206,7 +1206,7 @@ void AcentryToJSON(const CAccountingEntry& acentry, const string& strAccount, Ar
     }
 }
 
-Value listtransactions(const Array& params, bool fHelp)
+void listtransactions(const Array& params, bool fHelp, JSONWriter& writer)
 {
     if (fHelp || params.size() > 4)
         throw runtime_error(
@@ -1302,17 +1302,19 @@ Value listtransactions(const Array& params, bool fHelp)
         nFrom = ret.size();
     if ((nFrom + nCount) > (int)ret.size())
         nCount = ret.size() - nFrom;
-    Array::iterator first = ret.begin();
-    std::advance(first, nFrom);
-    Array::iterator last = ret.begin();
-    std::advance(last, nFrom + nCount);
-
-    if (last != ret.end()) ret.erase(last, ret.end());
-    if (first != ret.begin()) ret.erase(ret.begin(), first);
 
-    std::reverse(ret.begin(), ret.end()); // Return oldest to newest
+    // Return oldest to newest
+    writer.BeginArray();
+    for (int i = nFrom + nCount - 1; i >= nFrom; i--)
+        writer.Write(ret[i]);
+    writer.EndArray();
+}
 
-    return ret;
+Value listtransactions(const Array& params, bool fHelp)
+{
+    JSONValueWriter writer;
+    listtransactions(params, fHelp, writer);
+    return writer.GetValue();
 }
 
 Value listaccounts(const Array& params, bool fHelp)
@@ -5,13 +5,16 @@
 
 #include "sigcache.h"
 
+#include "crypto/sha256.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
+#include <atomic>
+
+#include <boost/scoped_array.hpp>
 #include <boost/thread.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 
 namespace {
 
@@ -19,56 +22,137 @@ namespace {
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
  * twice for every transaction (once when accepted into memory pool, and
  * again when accepted into the block chain)
+ *
+ * Entries are the salted SHA256 of (signature hash, signature, public key),
+ * 32 bytes each, in open addressed buckets of four adjacent slots. The table
+ * is split in shards, writers take the mutex of one shard while readers
+ * never lock. The salt keeps the slot of an entry unpredictable, so nobody
+ * can fill a bucket on purpose.
  */
 class CSignatureCache
 {
 private:
-     //! sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, CPubKey> sigdata_type;
-    std::set< sigdata_type> setValid;
-    boost::shared_mutex cs_sigcache;
+    static const unsigned int SHARDS = 16;
+    static const unsigned int BUCKET_SIZE = 4;
+
+    //! Four words of the salted hash, w[0] == 0 marks an empty slot
+    struct Entry {
+        std::atomic<uint64_t> w[4];
+    };
+
+    struct Shard {
+        boost::mutex cs;
+        boost::scoped_array<Entry> entries;
+        size_t nBuckets;
+    };
+
+    unsigned char salt[32];
+    Shard shards[SHARDS];
+
+    void ComputeEntry(uint64_t (&key)[4], const uint256& hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey) const
+    {
+        unsigned char buf[CSHA256::OUTPUT_SIZE];
+        CSHA256().Write(salt, sizeof(salt)).Write(hash.begin(), 32).Write(vchSig.data(), vchSig.size()).Write(pubKey.begin(), pubKey.size()).Finalize(buf);
+        memcpy(key, buf, sizeof(key));
+        if (key[0] == 0)
+            key[0] = 1;
+    }
+
+    Entry* Bucket(const uint64_t (&key)[4], Shard*& shard)
+    {
+        // Word 1 picks the shard, word 2 the bucket, word 0 is the marker
+        shard = &shards[key[1] % SHARDS];
+        if (!shard->nBuckets)
+            return NULL;
+        return &shard->entries[(key[2] % shard->nBuckets) * BUCKET_SIZE];
+    }
+
+    static bool Matches(const Entry& entry, const uint64_t (&key)[4])
+    {
+        // Read the marker again after the body, a slot rewritten meanwhile
+        // does not match even if the words in between happened to
+        if (entry.w[0].load(std::memory_order_acquire) != key[0])
+            return false;
+        if (entry.w[1].load(std::memory_order_relaxed) != key[1] ||
+            entry.w[2].load(std::memory_order_relaxed) != key[2] ||
+            entry.w[3].load(std::memory_order_relaxed) != key[3])
+            return false;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return entry.w[0].load(std::memory_order_relaxed) == key[0];
+    }
 
 public:
+    CSignatureCache()
+    {
+        GetRandBytes(salt, sizeof(salt));
+
+        // Read the limit once, -maxsigcachesize is in entries
+        int64_t nMaxCacheSize = std::min(GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE), MAX_MAX_SIG_CACHE_SIZE);
+        size_t nBuckets = 0;
+        if (nMaxCacheSize > 0)
+            nBuckets = (size_t)((nMaxCacheSize + SHARDS * BUCKET_SIZE - 1) / (SHARDS * BUCKET_SIZE));
+        for (unsigned int i = 0; i < SHARDS; i++) {
+            shards[i].nBuckets = nBuckets;
+            if (nBuckets) {
+                shards[i].entries.reset(new Entry[nBuckets * BUCKET_SIZE]);
+                for (size_t j = 0; j < nBuckets * BUCKET_SIZE; j++)
+                    for (unsigned int k = 0; k < 4; k++)
+                        shards[i].entries[j].w[k].store(0, std::memory_order_relaxed);
+            }
+        }
+        LogPrintf("Using %u entries, %u KiB for the signature cache\n", nBuckets * BUCKET_SIZE * SHARDS, (nBuckets * BUCKET_SIZE * SHARDS * sizeof(Entry)) >> 10);
+    }
+
     bool
     Get(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-
-        sigdata_type k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
+        uint64_t key[4];
+        ComputeEntry(key, hash, vchSig, pubKey);
+
+        Shard* shard;
+        Entry* bucket = Bucket(key, shard);
+        if (!bucket)
+            return false;
+        for (unsigned int i = 0; i < BUCKET_SIZE; i++) {
+            if (Matches(bucket[i], key))
+                return true;
+        }
         return false;
     }
 
     void Set(const uint256 &hash, const std::vector<unsigned char>& vchSig, const CPubKey& pubKey)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize)
-        {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256 randomHash = GetRandHash();
-            std::vector<unsigned char> unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, CPubKey(unused)));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
+        uint64_t key[4];
+        ComputeEntry(key, hash, vchSig, pubKey);
+
+        Shard* shard;
+        Entry* bucket = Bucket(key, shard);
+        if (!bucket)
+            return;
+
+        boost::unique_lock<boost::mutex> lock(shard->cs);
+
+        // Take an empty slot, or evict one of the full bucket picked by the
+        // salted hash, so it is unpredictable to would-be DoS attackers who
+        // might try to pre-generate and re-use a set of valid signatures.
+        Entry* slot = NULL;
+        for (unsigned int i = 0; i < BUCKET_SIZE && !slot; i++) {
+            uint64_t w0 = bucket[i].w[0].load(std::memory_order_relaxed);
+            if (w0 == key[0] && Matches(bucket[i], key))
+                return;
+            if (w0 == 0)
+                slot = &bucket[i];
         }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        if (!slot)
+            slot = &bucket[key[3] % BUCKET_SIZE];
+
+        // Clear the marker first so readers never match a half written slot
+        slot->w[0].store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot->w[1].store(key[1], std::memory_order_relaxed);
+        slot->w[2].store(key[2], std::memory_order_relaxed);
+        slot->w[3].store(key[3], std::memory_order_relaxed);
+        slot->w[0].store(key[0], std::memory_order_release);
     }
 };
 
@@ -12,6 +12,11 @@
 
 class CPubKey;
 
+//! Default for -maxsigcachesize, in entries of 32 bytes
+static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 50000;
+//! Largest -maxsigcachesize accepted, 512 MiB of entries
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 16 * 1024 * 1024;
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
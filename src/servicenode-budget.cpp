@@ -19,6 +19,8 @@
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include <limits>
+
 CBudgetManager budget;
 CCriticalSection cs_budget;
 
@@ -439,6 +441,7 @@ bool CBudgetManager::AddProposal(CBudgetProposal& budgetProposal)
     }
 
     mapProposals.insert(make_pair(budgetProposal.GetHash(), budgetProposal));
+    nProposalUpdates++;
     LogPrintf("CBudgetManager::AddProposal - proposal %s added\n", budgetProposal.GetName ().c_str ());
     return true;
 }
@@ -468,7 +471,11 @@ void CBudgetManager::CheckAndRemove()
     std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
     while (it2 != mapProposals.end()) {
         CBudgetProposal* pbudgetProposal = &((*it2).second);
-        pbudgetProposal->fValid = pbudgetProposal->IsValid(strError);
+        bool fProposalValid = pbudgetProposal->IsValid(strError);
+        if (fProposalValid != pbudgetProposal->fValid) {
+            pbudgetProposal->fValid = fProposalValid;
+            nProposalUpdates++;
+        }
         if (!strError.empty ()) {
             LogPrintf("CBudgetManager::CheckAndRemove - invalid budget proposal %s - %s\n", pbudgetProposal->GetName().c_str (), strError);
             strError = "";
@@ -699,7 +706,8 @@ std::vector<CBudgetProposal*> CBudgetManager::GetAllProposals()
 
     std::map<uint256, CBudgetProposal>::iterator it = mapProposals.begin();
     while (it != mapProposals.end()) {
-        (*it).second.CleanAndRemove(false);
+        if ((*it).second.CleanAndRemove(false))
+            nProposalUpdates++;
 
         CBudgetProposal* pbudgetProposal = &((*it).second);
         vBudgetProposalRet.push_back(pbudgetProposal);
@@ -725,6 +733,10 @@ struct sortProposalsByVotes {
 /**
  * Returns the budget proposals that meet the requirements for the next superblock. This method locks cs_main
  * critical section as it accesses chainActive.Tip
+ *
+ * The result is cached and only recomputed when the chain height, the enabled servicenode count, the proposals
+ * or their votes change, or when a proposal that was left out for being too young becomes established. Votes are
+ * revalidated against the servicenode list once per height rather than on every call.
  * @return
  */
 std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
@@ -745,12 +757,20 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
         return vBudgetProposalsRet;
     
     LOCK(cs);
-    
+
+    int nEnabled = mnodeman.CountEnabled(ActiveProtocol());
+    int64_t nNow = GetTime();
+    if (chainHeight == nBudgetCacheHeight && nEnabled == nBudgetCacheEnabled &&
+        nProposalUpdates == nBudgetCacheUpdates && nNow < nBudgetCacheExpires)
+        return vBudgetCache;
+
     // Sort budgets by votes
     std::vector<std::pair<CBudgetProposal*, int>> vBudgetProposalsSort;
+    vBudgetProposalsSort.reserve(mapProposals.size());
     for (auto &item : mapProposals) {
         CBudgetProposal *proposal = &(item.second);
-        proposal->CleanAndRemove(false);
+        if (chainHeight != nBudgetCacheHeight || nEnabled != nBudgetCacheEnabled)
+            proposal->CleanAndRemove(false);
         vBudgetProposalsSort.emplace_back(proposal, proposal->Votes());
     }
     std::sort(vBudgetProposalsSort.begin(), vBudgetProposalsSort.end(), sortProposalsByVotes());
@@ -763,13 +783,18 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
     CAmount nTotalBudget = CBudgetManager::GetTotalBudget(nBlockStart);
     CAmount nBudgetAllocated = 0;
     
+    // The projection stays valid until the first young proposal becomes established
+    int64_t nExpires = std::numeric_limits<int64_t>::max();
+
     // Get valid proposals for the next superblock
     for (auto &item : vBudgetProposalsSort) {
         CBudgetProposal *pbudgetProposal = item.first;
+        if (!pbudgetProposal->IsEstablished())
+            nExpires = std::min(nExpires, pbudgetProposal->GetEstablishedTime());
         if (pbudgetProposal->fValid &&                                      // valid proposal
             pbudgetProposal->nBlockStart <= nBlockStart &&                  // valid start
             pbudgetProposal->nBlockEnd >= nNextSuperblock &&                // valid end must be at some point after the next superblock
-            pbudgetProposal->Votes() > (double)mnodeman.CountEnabled(ActiveProtocol()) / 10 && // at least 10% consensus
+            item.second > (double)nEnabled / 10 &&                          // at least 10% consensus
             pbudgetProposal->IsEstablished()) {
             // If the proposal amount fits in the superblock budget proceed
             if (pbudgetProposal->GetAmount() + nBudgetAllocated <= nTotalBudget) {
@@ -782,6 +807,12 @@ std::vector<CBudgetProposal*> CBudgetManager::GetBudget() {
         }
     }
 
+    vBudgetCache = vBudgetProposalsRet;
+    nBudgetCacheHeight = chainHeight;
+    nBudgetCacheEnabled = nEnabled;
+    nBudgetCacheExpires = nExpires;
+    nBudgetCacheUpdates = nProposalUpdates;
+
     return vBudgetProposalsRet;
 }
 
@@ -956,7 +987,8 @@ void CBudgetManager::NewBlock()
     LogPrintf("CBudgetManager::NewBlock - mapProposals cleanup - size: %d\n", mapProposals.size());
     std::map<uint256, CBudgetProposal>::iterator it2 = mapProposals.begin();
     while (it2 != mapProposals.end()) {
-        (*it2).second.CleanAndRemove(false);
+        if ((*it2).second.CleanAndRemove(false))
+            nProposalUpdates++;
         ++it2;
     }
 
@@ -1093,7 +1125,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        CServicenode* pmn = mnodeman.Find(vote.vin);
+        CServicenodePtr pmn = mnodeman.Find(vote.vin);
         if (pmn == NULL) {
             LogPrintf("mvote - unknown servicenode - vin: %s\n", vote.vin.prevout.hash.ToString());
             mnodeman.AskForMN(pfrom, vote.vin);
@@ -1166,7 +1198,7 @@ void CBudgetManager::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             return;
         }
 
-        CServicenode* pmn = mnodeman.Find(vote.vin);
+        CServicenodePtr pmn = mnodeman.Find(vote.vin);
         if (pmn == NULL) {
             LogPrint("mnbudget", "fbvote - unknown servicenode - vin: %s\n", vote.vin.prevout.hash.ToString());
             mnodeman.AskForMN(pfrom, vote.vin);
@@ -1368,7 +1400,11 @@ bool CBudgetManager::UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string
         return false;
     }
 
-    return mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError);
+    if (!mapProposals[vote.nProposalHash].AddOrUpdateVote(vote, strError))
+        return false;
+
+    nProposalUpdates++;
+    return true;
 }
 
 bool CBudgetManager::UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError)
@@ -1405,6 +1441,7 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1417,6 +1454,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1430,6 +1468,8 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nTime = other.nTime;
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
+    std::copy(other.nVoteCount, other.nVoteCount + VOTE_NO + 1, nVoteCount);
+    std::copy(other.nValidVoteCount, other.nValidVoteCount + VOTE_NO + 1, nValidVoteCount);
     fValid = true;
 }
 
@@ -1512,33 +1552,60 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.find(hash);
+    if (it != mapVotes.end())
+        TallyVote((*it).second, -1);
+
     mapVotes[hash] = vote;
+    TallyVote(vote, 1);
     return true;
 }
 
 // If servicenode voted for a proposal, but is now invalid -- remove the vote
-void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
+// Returns true if any vote changed state
+bool CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
 {
+    bool fChanged = false;
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        bool fVoteValid = (*it).second.SignatureValid(fSignatureCheck);
+        if (fVoteValid != (*it).second.fValid) {
+            TallyVote((*it).second, -1);
+            (*it).second.fValid = fVoteValid;
+            TallyVote((*it).second, 1);
+            fChanged = true;
+        }
         ++it;
     }
+
+    return fChanged;
 }
 
-double CBudgetProposal::GetRatio()
+void CBudgetProposal::TallyVote(const CBudgetVote& vote, int nDelta)
 {
-    int yeas = 0;
-    int nays = 0;
+    if (vote.nVote < VOTE_ABSTAIN || vote.nVote > VOTE_NO) return;
 
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
+    nVoteCount[vote.nVote] += nDelta;
+    if (vote.fValid) nValidVoteCount[vote.nVote] += nDelta;
+}
 
+void CBudgetProposal::RecountVotes()
+{
+    std::fill(nVoteCount, nVoteCount + VOTE_NO + 1, 0);
+    std::fill(nValidVoteCount, nValidVoteCount + VOTE_NO + 1, 0);
+
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
     while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
+        TallyVote((*it).second, 1);
         ++it;
     }
+}
+
+double CBudgetProposal::GetRatio()
+{
+    int yeas = nVoteCount[VOTE_YES];
+    int nays = nVoteCount[VOTE_NO];
 
     if (yeas + nays == 0) return 0.0f;
 
@@ -1547,41 +1614,17 @@ double CBudgetProposal::GetRatio()
 
 int CBudgetProposal::GetYeas()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return nValidVoteCount[VOTE_YES];
 }
 
 int CBudgetProposal::GetNays()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return nValidVoteCount[VOTE_NO];
 }
 
 int CBudgetProposal::GetAbstains()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return nValidVoteCount[VOTE_ABSTAIN];
 }
 
 int CBudgetProposal::GetBlockStartCycle()
@@ -1706,7 +1749,7 @@ bool CBudgetVote::SignatureValid(bool fSignatureCheck)
     std::string errorMessage;
     std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
 
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
 
     if (pmn == NULL) {
         LogPrintf("CBudgetVote::SignatureValid() - Unknown Servicenode - %s\n", vin.prevout.hash.ToString());
@@ -2143,7 +2186,7 @@ bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
 
     std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
 
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
 
     if (pmn == NULL) {
         LogPrintf("CFinalizedBudgetVote::SignatureValid() - Unknown Servicenode\n");
@@ -182,6 +182,16 @@ private:
     map<uint256, uint256> mapCollateralTxids;
     bool allValidFinalPayees(std::vector<CTxBudgetPayment> &approvedPayees, int superblock);
 
+    // GetBudget() projection, reused until the chain height, the enabled servicenode count,
+    // the proposals or their votes change, or a skipped proposal becomes established
+    std::vector<CBudgetProposal*> vBudgetCache;
+    int nBudgetCacheHeight;
+    int nBudgetCacheEnabled;
+    int64_t nBudgetCacheExpires;
+    uint64_t nBudgetCacheUpdates;
+    // bumped whenever mapProposals or the votes of a proposal change
+    uint64_t nProposalUpdates;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -201,6 +211,17 @@ public:
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
+        nProposalUpdates = 0;
+        InvalidateBudgetCache();
+    }
+
+    void InvalidateBudgetCache()
+    {
+        vBudgetCache.clear();
+        nBudgetCacheHeight = -1;
+        nBudgetCacheEnabled = -1;
+        nBudgetCacheExpires = 0;
+        nBudgetCacheUpdates = 0;
     }
 
     void ClearSeen()
@@ -254,6 +275,8 @@ public:
         mapSeenFinalizedBudgetVotes.clear();
         mapOrphanServicenodeBudgetVotes.clear();
         mapOrphanFinalizedBudgetVotes.clear();
+        nProposalUpdates++;
+        InvalidateBudgetCache();
     }
     void CheckAndRemove();
     std::string ToString() const;
@@ -273,6 +296,11 @@ public:
 
         READWRITE(mapProposals);
         READWRITE(mapFinalizedBudgets);
+
+        if (ser_action.ForRead()) {
+            nProposalUpdates++;
+            InvalidateBudgetCache();
+        }
     }
 };
 
@@ -442,6 +470,15 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+protected:
+    // running tallies of mapVotes by nVote, over all votes (GetRatio) and over the
+    // counted (fValid) ones; kept up to date by AddOrUpdateVote and CleanAndRemove
+    int nVoteCount[VOTE_NO + 1];
+    int nValidVoteCount[VOTE_NO + 1];
+
+    void TallyVote(const CBudgetVote& vote, int nDelta);
+    void RecountVotes();
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -469,12 +506,17 @@ public:
     bool IsValid(std::string& strError, bool fCheckCollateral = true);
 
     bool IsEstablished()
+    {
+        return GetEstablishedTime() < GetTime();
+    }
+
+    int64_t GetEstablishedTime()
     {
         //Proposals must be at least a day old to make it into a budget
-        if (Params().NetworkID() == CBaseChainParams::MAIN) return (nTime < GetTime() - (60 * 60 * 24));
+        if (Params().NetworkID() == CBaseChainParams::MAIN) return nTime + (60 * 60 * 24);
 
         //for testing purposes - 4 hours
-        return (nTime < GetTime() - (60 * 5));
+        return nTime + (60 * 5);
     }
 
     std::string GetName() { return strProposalName; }
@@ -500,7 +542,7 @@ public:
         return GetYeas() - GetNays();
     }
 
-    void CleanAndRemove(bool fSignatureCheck);
+    bool CleanAndRemove(bool fSignatureCheck);
 
     uint256 GetHash()
     {
@@ -534,6 +576,9 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -562,6 +607,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        swap(first.nVoteCount, second.nVoteCount);
+        swap(first.nValidVoteCount, second.nValidVoteCount);
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
@@ -289,7 +289,7 @@ void CServicenodePayments::FillBlockPayee(CMutableTransaction& txNew, int64_t /*
     //spork
     if (!servicenodePayments.GetBlockPayee(pindexPrev->nHeight + 1, payee)) {
         //no servicenode detected
-        CServicenode* winningNode = mnodeman.GetCurrentServiceNode(1);
+        CServicenodePtr winningNode = mnodeman.GetCurrentServiceNode(1);
         if (winningNode) {
             payee = GetScriptForDestination(winningNode->pubKeyCollateralAddress.GetID());
         } else {
@@ -631,7 +631,7 @@ void CServicenodePayments::CleanPaymentList()
 
 bool CServicenodePaymentWinner::IsValid(CNode* pnode, std::string& strError)
 {
-    CServicenode* pmn = mnodeman.Find(vinServicenode);
+    CServicenodePtr pmn = mnodeman.Find(vinServicenode);
 
     if (!pmn) {
         strError = strprintf("Unknown Servicenode %s", vinServicenode.prevout.hash.ToString());
@@ -691,7 +691,7 @@ bool CServicenodePayments::ProcessBlock(int nBlockHeight)
 
         // pay to the oldest MN that still had no payment but its input is old enough and it was active long enough
         int nCount = 0;
-        CServicenode* pmn = mnodeman.GetNextServicenodeInQueueForPayment(nBlockHeight, true, nCount);
+        CServicenodePtr pmn = mnodeman.GetNextServicenodeInQueueForPayment(nBlockHeight, true, nCount);
 
         if (pmn != NULL) {
             LogPrintf("CServicenodePayments::ProcessBlock() Found by FindOldestNotInVec \n");
@@ -742,7 +742,7 @@ void CServicenodePaymentWinner::Relay()
 
 bool CServicenodePaymentWinner::SignatureValid()
 {
-    CServicenode* pmn = mnodeman.Find(vinServicenode);
+    CServicenodePtr pmn = mnodeman.Find(vinServicenode);
 
     if (pmn != NULL) {
         std::string strMessage = vinServicenode.prevout.ToStringShort() +
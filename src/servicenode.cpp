@@ -576,7 +576,7 @@ bool CServicenodeBroadcast::CheckAndUpdate(int& nDos)
         return false;
 
     //search existing Servicenode list, this is where we update existing Servicenodes with new mnb broadcasts
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
 
     // no such servicenode, nothing to update
     if (pmn == NULL)
@@ -598,6 +598,7 @@ bool CServicenodeBroadcast::CheckAndUpdate(int& nDos)
         //take the newest entry
         LogPrint("servicenode", "mnb - Got updated entry for %s\n", vin.prevout.hash.ToString());
         if (pmn->UpdateFromNewBroadcast((*this))) {
+            mnodeman.UpdateIndexes(vin);
             pmn->Check();
             if (pmn->IsEnabled()) Relay();
         }
@@ -615,7 +616,7 @@ bool CServicenodeBroadcast::CheckInputsAndAdd(int& nDoS)
         return true;
 
     // search existing Servicenode list
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
 
     if (pmn != NULL) {
         // nothing to do here if we already know about this servicenode and it's enabled
@@ -771,7 +772,7 @@ bool CServicenodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled)
     LogPrint("servicenode", "CServicenodePing::CheckAndUpdate - New Ping - %s - %lli\n", blockHash.ToString(), sigTime);
 
     // see if we have this Servicenode
-    CServicenode* pmn = mnodeman.Find(vin);
+    CServicenodePtr pmn = mnodeman.Find(vin);
     if (pmn != NULL && pmn->protocolVersion >= servicenodePayments.GetMinServicenodePaymentsProto()) {
         if (fRequireEnabled && !pmn->IsEnabled()) return false;
 
@@ -33,14 +33,6 @@ struct CompareScoreTxIn {
     }
 };
 
-struct CompareScoreMN {
-    bool operator()(const pair<int64_t, CServicenode>& t1,
-        const pair<int64_t, CServicenode>& t2) const
-    {
-        return t1.first < t2.first;
-    }
-};
-
 //
 // CServicenodeDB
 //
@@ -195,6 +187,7 @@ void DumpServicenodes()
 CServicenodeMan::CServicenodeMan()
 {
     nDsqCount = 0;
+    nListVersion = 0;
 }
 
 bool CServicenodeMan::Add(CServicenode& mn)
@@ -204,10 +197,12 @@ bool CServicenodeMan::Add(CServicenode& mn)
     if (!mn.IsEnabled())
         return false;
 
-    CServicenode* pmn = Find(mn.vin);
+    CServicenodePtr pmn = Find(mn.vin);
     if (pmn == NULL) {
         LogPrint("servicenode", "CServicenodeMan: Adding new Servicenode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
-        vServicenodes.push_back(mn);
+        listServicenodes.push_back(CServicenodePtr(new CServicenode(mn)));
+        AddToIndexes(--listServicenodes.end());
+        InvalidateRanks();
         return true;
     }
 
@@ -234,8 +229,8 @@ void CServicenodeMan::Check()
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        mn.Check();
+    BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+        pmn->Check();
     }
 }
 
@@ -246,20 +241,20 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
-    vector<CServicenode>::iterator it = vServicenodes.begin();
-    while (it != vServicenodes.end()) {
-        if ((*it).activeState == CServicenode::SERVICENODE_REMOVE ||
-            (*it).activeState == CServicenode::SERVICENODE_VIN_SPENT ||
-            (forceExpiredRemoval && (*it).activeState == CServicenode::SERVICENODE_EXPIRED) ||
-            (*it).protocolVersion < servicenodePayments.GetMinServicenodePaymentsProto()) {
-            LogPrint("servicenode", "CServicenodeMan: Removing inactive Servicenode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+    ServicenodeIt it = listServicenodes.begin();
+    while (it != listServicenodes.end()) {
+        if ((*it)->activeState == CServicenode::SERVICENODE_REMOVE ||
+            (*it)->activeState == CServicenode::SERVICENODE_VIN_SPENT ||
+            (forceExpiredRemoval && (*it)->activeState == CServicenode::SERVICENODE_EXPIRED) ||
+            (*it)->protocolVersion < servicenodePayments.GetMinServicenodePaymentsProto()) {
+            LogPrint("servicenode", "CServicenodeMan: Removing inactive Servicenode %s - %i now\n", (*it)->vin.prevout.hash.ToString(), size() - 1);
 
             //erase all of the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new mnb
             map<uint256, CServicenodeBroadcast>::iterator it3 = mapSeenServicenodeBroadcast.begin();
             while (it3 != mapSeenServicenodeBroadcast.end()) {
-                if ((*it3).second.vin == (*it).vin) {
+                if ((*it3).second.vin == (*it)->vin) {
                     servicenodeSync.mapSeenSyncMNB.erase((*it3).first);
                     mapSeenServicenodeBroadcast.erase(it3++);
                 } else {
@@ -270,14 +265,16 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
             // allow us to ask for this servicenode again if we see another ping
             map<COutPoint, int64_t>::iterator it2 = mWeAskedForServicenodeListEntry.begin();
             while (it2 != mWeAskedForServicenodeListEntry.end()) {
-                if ((*it2).first == (*it).vin.prevout) {
+                if ((*it2).first == (*it)->vin.prevout) {
                     mWeAskedForServicenodeListEntry.erase(it2++);
                 } else {
                     ++it2;
                 }
             }
 
-            it = vServicenodes.erase(it);
+            RemoveFromIndexes((*it)->vin.prevout);
+            it = listServicenodes.erase(it);
+            InvalidateRanks();
         } else {
             ++it;
         }
@@ -338,7 +335,11 @@ void CServicenodeMan::CheckAndRemove(bool forceExpiredRemoval)
 void CServicenodeMan::Clear()
 {
     LOCK(cs);
-    vServicenodes.clear();
+    listServicenodes.clear();
+    mapServicenodesByVin.clear();
+    setServicenodesByPayee.clear();
+    setServicenodesByPubKey.clear();
+    InvalidateRanks();
     mAskedUsForServicenodeList.clear();
     mWeAskedForServicenodeList.clear();
     mWeAskedForServicenodeListEntry.clear();
@@ -352,7 +353,8 @@ int CServicenodeMan::CountEnabled(int protocolVersion)
     int i = 0;
     protocolVersion = protocolVersion == -1 ? servicenodePayments.GetMinServicenodePaymentsProto() : protocolVersion;
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+        CServicenode& mn = *pmn;
         mn.Check();
         if (mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
         i++;
@@ -382,50 +384,45 @@ void CServicenodeMan::DsegUpdate(CNode* pnode)
     mWeAskedForServicenodeList[pnode->addr] = askAgain;
 }
 
-CServicenode* CServicenodeMan::Find(const CScript& payee)
+CServicenodePtr CServicenodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
-    CScript payee2;
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        payee2 = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
-        if (payee2 == payee)
-            return &mn;
-    }
-    return NULL;
+    std::set<std::pair<CScript, COutPoint> >::iterator it = setServicenodesByPayee.lower_bound(make_pair(payee, COutPoint(uint256(), 0)));
+    if (it == setServicenodesByPayee.end() || it->first != payee)
+        return CServicenodePtr();
+    return *mapServicenodesByVin[it->second].it;
 }
 
-CServicenode* CServicenodeMan::Find(const CTxIn& vin)
+CServicenodePtr CServicenodeMan::Find(const CTxIn& vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    std::map<COutPoint, CServicenodeIndexEntry>::iterator it = mapServicenodesByVin.find(vin.prevout);
+    if (it == mapServicenodesByVin.end())
+        return CServicenodePtr();
+    return *it->second.it;
 }
 
 
-CServicenode* CServicenodeMan::Find(const CPubKey& pubKeyServicenode)
+CServicenodePtr CServicenodeMan::Find(const CPubKey& pubKeyServicenode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.pubKeyServicenode == pubKeyServicenode)
-            return &mn;
-    }
-    return NULL;
+    std::set<std::pair<CPubKey, COutPoint> >::iterator it = setServicenodesByPubKey.lower_bound(make_pair(pubKeyServicenode, COutPoint(uint256(), 0)));
+    if (it == setServicenodesByPubKey.end() || it->first != pubKeyServicenode)
+        return CServicenodePtr();
+    return *mapServicenodesByVin[it->second].it;
 }
 
 //
 // Deterministically select the oldest/best servicenode to pay on the network
 //
-CServicenode* CServicenodeMan::GetNextServicenodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount)
+CServicenodePtr CServicenodeMan::GetNextServicenodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount)
 {
     LOCK(cs);
 
-    CServicenode* pBestServicenode = NULL;
+    CServicenodePtr pBestServicenode;
     std::vector<pair<int64_t, CTxIn> > vecServicenodeLastPaid;
 
     /*
@@ -433,7 +430,8 @@ CServicenode* CServicenodeMan::GetNextServicenodeInQueueForPayment(int nBlockHei
     */
 
     int nMnCount = CountEnabled();
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+        CServicenode& mn = *pmn;
         mn.Check();
         if (!mn.IsEnabled()) continue;
 
@@ -468,7 +466,7 @@ CServicenode* CServicenodeMan::GetNextServicenodeInQueueForPayment(int nBlockHei
     int nCountTenth = 0;
     uint256 nHigh = 0;
     BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecServicenodeLastPaid) {
-        CServicenode* pmn = Find(s.second);
+        CServicenodePtr pmn = Find(s.second);
         if (!pmn) break;
 
         uint256 n = pmn->CalculateScore(1, nBlockHeight - 100);
@@ -482,7 +480,7 @@ CServicenode* CServicenodeMan::GetNextServicenodeInQueueForPayment(int nBlockHei
     return pBestServicenode;
 }
 
-CServicenode* CServicenodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclude, int protocolVersion)
+CServicenodePtr CServicenodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclude, int protocolVersion)
 {
     LOCK(cs);
 
@@ -490,13 +488,14 @@ CServicenode* CServicenodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclu
 
     int nCountEnabled = CountEnabled(protocolVersion);
     LogPrint("servicenode", "CServicenodeMan::FindRandomNotInVec - nCountEnabled - vecToExclude.size() %d\n", nCountEnabled - vecToExclude.size());
-    if (nCountEnabled - vecToExclude.size() < 1) return NULL;
+    if (nCountEnabled - vecToExclude.size() < 1) return CServicenodePtr();
 
     int rand = GetRandInt(nCountEnabled - vecToExclude.size());
     LogPrint("servicenode", "CServicenodeMan::FindRandomNotInVec - rand %d\n", rand);
     bool found;
 
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+        CServicenode& mn = *pmn;
         if (mn.protocolVersion < protocolVersion || !mn.IsEnabled()) continue;
         found = false;
         BOOST_FOREACH (CTxIn& usedVin, vecToExclude) {
@@ -507,20 +506,21 @@ CServicenode* CServicenodeMan::FindRandomNotInVec(std::vector<CTxIn>& vecToExclu
         }
         if (found) continue;
         if (--rand < 1) {
-            return &mn;
+            return pmn;
         }
     }
 
-    return NULL;
+    return CServicenodePtr();
 }
 
-CServicenode* CServicenodeMan::GetCurrentServiceNode(int mod, int64_t nBlockHeight, int minProtocol)
+CServicenodePtr CServicenodeMan::GetCurrentServiceNode(int mod, int64_t nBlockHeight, int minProtocol)
 {
     int64_t score = 0;
-    CServicenode* winner = NULL;
+    CServicenodePtr winner;
 
     // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+    BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+        CServicenode& mn = *pmn;
         mn.Check();
         if (mn.protocolVersion < minProtocol || !mn.IsEnabled()) continue;
 
@@ -531,113 +531,146 @@ CServicenode* CServicenodeMan::GetCurrentServiceNode(int mod, int64_t nBlockHeig
         // determine the winner
         if (n2 > score) {
             score = n2;
-            winner = &mn;
+            winner = pmn;
         }
     }
 
     return winner;
 }
 
-int CServicenodeMan::GetServicenodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+int CServicenodeRanks::GetRank(const CTxIn& vin) const
 {
-    std::vector<pair<int64_t, CTxIn> > vecServicenodeScores;
+    std::map<COutPoint, int>::const_iterator it = mapRank.find(vin.prevout);
+    return it == mapRank.end() ? -1 : it->second;
+}
 
+CServicenodeRanksPtr CServicenodeMan::GetRanks(int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
     //make sure we know about this block
     uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+    if (!GetBlockHash(hash, nBlockHeight)) return CServicenodeRanksPtr();
 
-    // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.protocolVersion < minProtocol) continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
+    const std::pair<int64_t, std::pair<int, bool> > key = make_pair(nBlockHeight, make_pair(minProtocol, fOnlyActive));
+    const int64_t nNow = GetTime();
+
+    unsigned int nVersion;
+    {
+        LOCK(cs_ranks);
+        nVersion = nListVersion;
+
+        // servicenode states are checked once per SERVICENODE_CHECK_SECONDS,
+        // reuse the table for the same block within that time
+        std::map<std::pair<int64_t, std::pair<int, bool> >, CServicenodeRanksPtr>::const_iterator it = mapRanks.find(key);
+        if (it != mapRanks.end() && it->second->blockHash == hash &&
+            it->second->nTimeCreated + SERVICENODE_CHECK_SECONDS > nNow) {
+            return it->second;
         }
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
+    }
 
-        vecServicenodeScores.push_back(make_pair(n2, mn.vin));
+    std::vector<pair<int64_t, CTxIn> > vecServicenodeScores;
+    {
+        LOCK(cs);
+
+        BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+            CServicenode& mn = *pmn;
+            if (mn.protocolVersion < minProtocol) continue;
+            if (fOnlyActive) {
+                mn.Check();
+                if (!mn.IsEnabled()) continue;
+            }
+            uint256 n = mn.CalculateScore(1, nBlockHeight);
+            int64_t n2 = n.GetCompact(false);
+
+            vecServicenodeScores.push_back(make_pair(n2, mn.vin));
+        }
     }
 
     sort(vecServicenodeScores.rbegin(), vecServicenodeScores.rend(), CompareScoreTxIn());
 
+    boost::shared_ptr<CServicenodeRanks> ranks(new CServicenodeRanks());
+    ranks->blockHash = hash;
+    ranks->nTimeCreated = nNow;
+    ranks->vecRanked.reserve(vecServicenodeScores.size());
+
     int rank = 0;
     BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecServicenodeScores) {
         rank++;
-        if (s.second.prevout == vin.prevout) {
-            return rank;
+        ranks->vecRanked.push_back(s.second);
+        ranks->mapRank.insert(make_pair(s.second.prevout, rank));
+    }
+
+    LOCK(cs_ranks);
+    if (nVersion == nListVersion) {
+        // forget tables of old blocks
+        std::map<std::pair<int64_t, std::pair<int, bool> >, CServicenodeRanksPtr>::iterator it = mapRanks.begin();
+        while (it != mapRanks.end()) {
+            if (it->second->nTimeCreated + SERVICENODE_CHECK_SECONDS <= nNow) {
+                mapRanks.erase(it++);
+            } else {
+                ++it;
+            }
         }
+        mapRanks[key] = ranks;
     }
 
-    return -1;
+    return ranks;
+}
+
+void CServicenodeMan::InvalidateRanks()
+{
+    LOCK(cs_ranks);
+    ++nListVersion;
+    mapRanks.clear();
+}
+
+int CServicenodeMan::GetServicenodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    CServicenodeRanksPtr ranks = GetRanks(nBlockHeight, minProtocol, fOnlyActive);
+    if (!ranks) return -1;
+
+    return ranks->GetRank(vin);
 }
 
 std::vector<pair<int, CServicenode> > CServicenodeMan::GetServicenodeRanks(int64_t nBlockHeight, int minProtocol)
 {
-    std::vector<pair<int64_t, CServicenode> > vecServicenodeScores;
     std::vector<pair<int, CServicenode> > vecServicenodeRanks;
 
-    //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return vecServicenodeRanks;
+    CServicenodeRanksPtr ranks = GetRanks(nBlockHeight, minProtocol, false);
+    if (!ranks) return vecServicenodeRanks;
 
-    // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        mn.Check();
+    LOCK(cs);
 
-        if (mn.protocolVersion < minProtocol) continue;
+    // enabled servicenodes by score, disabled at the end
+    std::vector<CServicenode> vecDisabled;
+    int rank = 0;
+    BOOST_FOREACH (const CTxIn& vin, ranks->vecRanked) {
+        CServicenodePtr pmn = Find(vin);
+        if (pmn == NULL) continue;
 
-        if (!mn.IsEnabled()) {
-            vecServicenodeScores.push_back(make_pair(9999, mn));
+        pmn->Check();
+        if (!pmn->IsEnabled()) {
+            vecDisabled.push_back(*pmn);
             continue;
         }
 
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecServicenodeScores.push_back(make_pair(n2, mn));
+        rank++;
+        vecServicenodeRanks.push_back(make_pair(rank, *pmn));
     }
 
-    sort(vecServicenodeScores.rbegin(), vecServicenodeScores.rend(), CompareScoreMN());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CServicenode) & s, vecServicenodeScores) {
+    BOOST_FOREACH (const CServicenode& mn, vecDisabled) {
         rank++;
-        vecServicenodeRanks.push_back(make_pair(rank, s.second));
+        vecServicenodeRanks.push_back(make_pair(rank, mn));
     }
 
     return vecServicenodeRanks;
 }
 
-CServicenode* CServicenodeMan::GetServicenodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+CServicenodePtr CServicenodeMan::GetServicenodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CTxIn> > vecServicenodeScores;
+    CServicenodeRanksPtr ranks = GetRanks(nBlockHeight, minProtocol, fOnlyActive);
+    if (!ranks || nRank < 1 || nRank > (int)ranks->vecRanked.size()) return CServicenodePtr();
 
-    // scan for winner
-    BOOST_FOREACH (CServicenode& mn, vServicenodes) {
-        if (mn.protocolVersion < minProtocol) continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecServicenodeScores.push_back(make_pair(n2, mn.vin));
-    }
-
-    sort(vecServicenodeScores.rbegin(), vecServicenodeScores.rend(), CompareScoreTxIn());
-
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecServicenodeScores) {
-        rank++;
-        if (rank == nRank) {
-            return Find(s.second);
-        }
-    }
-
-    return NULL;
+    return Find(ranks->vecRanked[nRank - 1]);
 }
 
 void CServicenodeMan::ProcessServicenodeConnections()
@@ -721,7 +754,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
             Misbehaving(pfrom->GetId(), nDoS);
         } else {
             // if nothing significant failed, search existing Servicenode list
-            CServicenode* pmn = Find(mnp.vin);
+            CServicenodePtr pmn = Find(mnp.vin);
             // if it's known, don't ask for the mnb, just return
             if (pmn != NULL) return;
         }
@@ -757,7 +790,8 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 
         int nInvCount = 0;
 
-        BOOST_FOREACH (CServicenode& mn, vServicenodes) {
+        BOOST_FOREACH (CServicenodePtr& pmn, listServicenodes) {
+            CServicenode& mn = *pmn;
             if (mn.addr.IsRFC1918()) continue; //local network
 
             if (mn.IsEnabled()) {
@@ -864,7 +898,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
             return;
 
         //search existing Servicenode list, this is where we update existing Servicenodes with new dsee broadcasts
-        CServicenode* pmn = this->Find(vin);
+        CServicenodePtr pmn = this->Find(vin);
         if (pmn != NULL) {
             // count == -1 when it's a new entry
             //   e.g. We don't want the entry relayed/time updated when we're syncing the list
@@ -882,6 +916,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
                         pmn->addr = addr;
                         //fake ping
                         pmn->lastPing = CServicenodePing(vin);
+                        UpdateIndexes(vin);
                     }
                     pmn->nLastDsee = sigTime;
                     pmn->Check();
@@ -1025,7 +1060,7 @@ void CServicenodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
         }
 
         // see if we have this Servicenode
-        CServicenode* pmn = this->Find(vin);
+        CServicenodePtr pmn = this->Find(vin);
         if (pmn != NULL && pmn->protocolVersion >= servicenodePayments.GetMinServicenodePaymentsProto()) {
             // LogPrintf("dseep - Found corresponding mn for vin: %s\n", vin.ToString().c_str());
             // take this only if it's newer
@@ -1069,14 +1104,13 @@ void CServicenodeMan::Remove(CTxIn vin)
 {
     LOCK(cs);
 
-    vector<CServicenode>::iterator it = vServicenodes.begin();
-    while (it != vServicenodes.end()) {
-        if ((*it).vin == vin) {
-            LogPrint("servicenode", "CServicenodeMan: Removing Servicenode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
-            vServicenodes.erase(it);
-            break;
-        }
-        ++it;
+    std::map<COutPoint, CServicenodeIndexEntry>::iterator it = mapServicenodesByVin.find(vin.prevout);
+    if (it != mapServicenodesByVin.end() && (*it->second.it)->vin == vin) {
+        LogPrint("servicenode", "CServicenodeMan: Removing Servicenode %s - %i now\n", vin.prevout.hash.ToString(), size() - 1);
+        ServicenodeIt itMN = it->second.it;
+        RemoveFromIndexes(vin.prevout);
+        listServicenodes.erase(itMN);
+        InvalidateRanks();
     }
 }
 
@@ -1088,22 +1122,93 @@ void CServicenodeMan::UpdateServicenodeList(CServicenodeBroadcast mnb)
 
     LogPrintf("CServicenodeMan::UpdateServicenodeList -- servicenode=%s\n", mnb.vin.prevout.ToStringShort());
 
-    CServicenode* pmn = Find(mnb.vin);
+    CServicenodePtr pmn = Find(mnb.vin);
     if (pmn == NULL) {
         CServicenode mn(mnb);
         if (Add(mn)) {
             servicenodeSync.AddedServicenodeList(mnb.GetHash());
         }
     } else if (pmn->UpdateFromNewBroadcast(mnb)) {
+        UpdateIndexes(mnb.vin);
         servicenodeSync.AddedServicenodeList(mnb.GetHash());
     }
 }
 
+void CServicenodeMan::UpdateIndexes(const CTxIn& vin)
+{
+    LOCK(cs);
+
+    std::map<COutPoint, CServicenodeIndexEntry>::iterator it = mapServicenodesByVin.find(vin.prevout);
+    if (it == mapServicenodesByVin.end()) return;
+
+    ServicenodeIt itMN = it->second.it;
+    RemoveFromIndexes(vin.prevout);
+    AddToIndexes(itMN);
+    InvalidateRanks();
+}
+
+std::vector<CServicenode> CServicenodeMan::GetServicenodeVector() const
+{
+    LOCK(cs);
+
+    std::vector<CServicenode> vServicenodes;
+    vServicenodes.reserve(listServicenodes.size());
+    BOOST_FOREACH (const CServicenodePtr& pmn, listServicenodes)
+        vServicenodes.push_back(*pmn);
+    return vServicenodes;
+}
+
+void CServicenodeMan::AddToIndexes(ServicenodeIt it)
+{
+    const COutPoint& outpoint = (*it)->vin.prevout;
+
+    CServicenodeIndexEntry entry;
+    entry.it = it;
+    entry.payee = GetScriptForDestination((*it)->pubKeyCollateralAddress.GetID());
+    entry.pubKeyServicenode = (*it)->pubKeyServicenode;
+
+    mapServicenodesByVin[outpoint] = entry;
+    setServicenodesByPayee.insert(make_pair(entry.payee, outpoint));
+    setServicenodesByPubKey.insert(make_pair(entry.pubKeyServicenode, outpoint));
+}
+
+void CServicenodeMan::RemoveFromIndexes(const COutPoint& outpoint)
+{
+    std::map<COutPoint, CServicenodeIndexEntry>::iterator it = mapServicenodesByVin.find(outpoint);
+    if (it == mapServicenodesByVin.end()) return;
+
+    const CServicenodeIndexEntry& entry = it->second;
+    setServicenodesByPayee.erase(make_pair(entry.payee, outpoint));
+    setServicenodesByPubKey.erase(make_pair(entry.pubKeyServicenode, outpoint));
+
+    mapServicenodesByVin.erase(it);
+}
+
+void CServicenodeMan::RebuildIndexes()
+{
+    mapServicenodesByVin.clear();
+    setServicenodesByPayee.clear();
+    setServicenodesByPubKey.clear();
+
+    // keep the first entry of duplicated outpoints, as Find did
+    ServicenodeIt it = listServicenodes.begin();
+    while (it != listServicenodes.end()) {
+        if (mapServicenodesByVin.count((*it)->vin.prevout)) {
+            it = listServicenodes.erase(it);
+            continue;
+        }
+        AddToIndexes(it);
+        ++it;
+    }
+
+    InvalidateRanks();
+}
+
 std::string CServicenodeMan::ToString() const
 {
     std::ostringstream info;
 
-    info << "Servicenodes: " << (int)vServicenodes.size() << ", peers who asked us for Servicenode list: " << (int)mAskedUsForServicenodeList.size() << ", peers we asked for Servicenode list: " << (int)mWeAskedForServicenodeList.size() << ", entries in Servicenode list we asked for: " << (int)mWeAskedForServicenodeListEntry.size() << ", nDsqCount: " << (int)nDsqCount;
+    info << "Servicenodes: " << (int)listServicenodes.size() << ", peers who asked us for Servicenode list: " << (int)mAskedUsForServicenodeList.size() << ", peers we asked for Servicenode list: " << (int)mWeAskedForServicenodeList.size() << ", entries in Servicenode list we asked for: " << (int)mWeAskedForServicenodeListEntry.size() << ", nDsqCount: " << (int)nDsqCount;
 
     return info.str();
 }
@@ -15,6 +15,11 @@
 #include "sync.h"
 #include "util.h"
 
+#include <list>
+#include <set>
+
+#include <boost/shared_ptr.hpp>
+
 #define SERVICENODES_DUMP_SECONDS (15 * 60)
 #define SERVICENODES_DSEG_SECONDS (3 * 60 * 60)
 
@@ -49,6 +54,27 @@ public:
     ReadResult Read(CServicenodeMan& mnodemanToLoad, bool fDryRun = false);
 };
 
+/** Servicenodes of a block ordered by score, shared by all rank queries
+ */
+class CServicenodeRanks
+{
+public:
+    uint256 blockHash;
+    int64_t nTimeCreated;
+    //! rank is position + 1
+    std::vector<CTxIn> vecRanked;
+    std::map<COutPoint, int> mapRank;
+
+    /// Rank of the servicenode or -1 if it is not ranked
+    int GetRank(const CTxIn& vin) const;
+};
+
+typedef boost::shared_ptr<const CServicenodeRanks> CServicenodeRanksPtr;
+
+/** Handle to a servicenode entry, stays valid after the entry is removed from the list
+ */
+typedef boost::shared_ptr<CServicenode> CServicenodePtr;
+
 class CServicenodeMan
 {
 private:
@@ -58,8 +84,23 @@ private:
     // critical section to protect the inner data structures specifically on messaging
     mutable CCriticalSection cs_process_message;
 
-    // map to hold all MNs
-    std::vector<CServicenode> vServicenodes;
+    // list to hold all MNs
+    std::list<CServicenodePtr> listServicenodes;
+
+    typedef std::list<CServicenodePtr>::iterator ServicenodeIt;
+
+    struct CServicenodeIndexEntry {
+        ServicenodeIt it;
+        // keys the entry is indexed by
+        CScript payee;
+        CPubKey pubKeyServicenode;
+    };
+
+    // indexes by collateral outpoint, payee script and servicenode pubkey,
+    // entries sharing a payee or pubkey are ordered by outpoint
+    std::map<COutPoint, CServicenodeIndexEntry> mapServicenodesByVin;
+    std::set<std::pair<CScript, COutPoint> > setServicenodesByPayee;
+    std::set<std::pair<CPubKey, COutPoint> > setServicenodesByPubKey;
     // who's asked for the Servicenode list and the last time
     std::map<CNetAddr, int64_t> mAskedUsForServicenodeList;
     // who we asked for the Servicenode list and the last time
@@ -67,6 +108,19 @@ private:
     // which Servicenodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForServicenodeListEntry;
 
+    // critical section to protect the rank tables
+    mutable CCriticalSection cs_ranks;
+    // rank tables by block height, min protocol and only active flag
+    std::map<std::pair<int64_t, std::pair<int, bool> >, CServicenodeRanksPtr> mapRanks;
+    // changed on every update of the Servicenode list
+    unsigned int nListVersion;
+
+    std::vector<CServicenode> GetServicenodeVector() const;
+
+    void AddToIndexes(ServicenodeIt it);
+    void RemoveFromIndexes(const COutPoint& outpoint);
+    void RebuildIndexes();
+
 public:
     // Keep track of all broadcasts I've seen
     map<uint256, CServicenodeBroadcast> mapSeenServicenodeBroadcast;
@@ -82,7 +136,16 @@ public:
     inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
     {
         LOCK(cs);
+        std::vector<CServicenode> vServicenodes;
+        if (!ser_action.ForRead())
+            vServicenodes = GetServicenodeVector();
         READWRITE(vServicenodes);
+        if (ser_action.ForRead()) {
+            listServicenodes.clear();
+            BOOST_FOREACH (const CServicenode& mn, vServicenodes)
+                listServicenodes.push_back(CServicenodePtr(new CServicenode(mn)));
+            RebuildIndexes();
+        }
         READWRITE(mAskedUsForServicenodeList);
         READWRITE(mWeAskedForServicenodeList);
         READWRITE(mWeAskedForServicenodeListEntry);
@@ -114,36 +177,42 @@ public:
 
     void DsegUpdate(CNode* pnode);
 
-    /// Find an entry
-    CServicenode* Find(const CScript& payee);
-    CServicenode* Find(const CTxIn& vin);
-    CServicenode* Find(const CPubKey& pubKeyServicenode);
+    /// Find an entry, of several entries with the same payee or pubkey the one with the lowest outpoint
+    CServicenodePtr Find(const CScript& payee);
+    CServicenodePtr Find(const CTxIn& vin);
+    CServicenodePtr Find(const CPubKey& pubKeyServicenode);
 
     /// Find an entry in the servicenode list that is next to be paid
-    CServicenode* GetNextServicenodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
+    CServicenodePtr GetNextServicenodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
 
     /// Find a random entry
-    CServicenode* FindRandomNotInVec(std::vector<CTxIn>& vecToExclude, int protocolVersion = -1);
+    CServicenodePtr FindRandomNotInVec(std::vector<CTxIn>& vecToExclude, int protocolVersion = -1);
 
     /// Get the current winner for this block
-    CServicenode* GetCurrentServiceNode(int mod = 1, int64_t nBlockHeight = 0, int minProtocol = 0);
+    CServicenodePtr GetCurrentServiceNode(int mod = 1, int64_t nBlockHeight = 0, int minProtocol = 0);
 
     std::vector<CServicenode> GetFullServicenodeVector()
     {
         Check();
-        return vServicenodes;
+        return GetServicenodeVector();
     }
 
+    /// Servicenodes ranked by score for this block, computed once per list version and
+    /// reused for SERVICENODE_CHECK_SECONDS, NULL if the block is unknown
+    CServicenodeRanksPtr GetRanks(int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    /// Drop the rank tables, call on every change of the Servicenode list
+    void InvalidateRanks();
+
     std::vector<pair<int, CServicenode> > GetServicenodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetServicenodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
-    CServicenode* GetServicenodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    CServicenodePtr GetServicenodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
 
     void ProcessServicenodeConnections();
 
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     /// Return the number of (unique) Servicenodes
-    int size() { return vServicenodes.size(); }
+    int size() { return listServicenodes.size(); }
 
     std::string ToString() const;
 
@@ -151,6 +220,9 @@ public:
 
     /// Update servicenode list and maps using provided CServicenodeBroadcast
     void UpdateServicenodeList(CServicenodeBroadcast mnb);
+
+    /// Reindex an entry after its payee or servicenode pubkey changed
+    void UpdateIndexes(const CTxIn& vin);
 };
 
 #endif
@@ -0,0 +1,171 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addressindex.h"
+#include "pubkey.h"
+#include "random.h"
+#include "script/script.h"
+#include "script/standard.h"
+#include "txdb.h"
+#include "utilstrencodings.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+BOOST_AUTO_TEST_CASE(addressindex_script_keys)
+{
+    vector<unsigned char> vchPubKey = ParseHex("0279be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798");
+    CPubKey pubkey(vchPubKey.begin(), vchPubKey.end());
+    CKeyID keyID = pubkey.GetID();
+    CScriptID scriptID(CScript() << OP_TRUE);
+
+    int nType;
+    uint160 hashBytes;
+
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForDestination(keyID), nType, hashBytes));
+    BOOST_CHECK_EQUAL(nType, ADDRESS_INDEX_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == keyID);
+
+    // Pay-to-pubkey outputs count for the key's address
+    BOOST_CHECK(GetAddressIndexKey(CScript() << vchPubKey << OP_CHECKSIG, nType, hashBytes));
+    BOOST_CHECK_EQUAL(nType, ADDRESS_INDEX_PUBKEYHASH);
+    BOOST_CHECK(hashBytes == keyID);
+
+    BOOST_CHECK(GetAddressIndexKey(GetScriptForDestination(scriptID), nType, hashBytes));
+    BOOST_CHECK_EQUAL(nType, ADDRESS_INDEX_SCRIPTHASH);
+    BOOST_CHECK(hashBytes == scriptID);
+    BOOST_CHECK(GetAddressIndexDestination(nType, hashBytes) == CTxDestination(scriptID));
+
+    BOOST_CHECK(!GetAddressIndexKey(CScript() << OP_RETURN << vchPubKey, nType, hashBytes));
+    BOOST_CHECK(!GetAddressIndexKey(CScript(), nType, hashBytes));
+    BOOST_CHECK(!GetAddressIndexKey(CTxDestination(CNoDestination()), nType, hashBytes));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_db)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashA = uint160(ParseHex("00112233445566778899aabbccddeeff00112233"));
+    uint160 hashB = uint160(ParseHex("ffeeddccbbaa99887766554433221100ffeeddcc"));
+    uint256 txid1 = GetRandHash(), txid2 = GetRandHash(), txid3 = GetRandHash();
+
+    // Heights whose little-endian encodings would sort differently
+    vector<pair<CAddressIndexKey, CAmount> > vIndex;
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashA, 70000, 1, txid3, 0, true), -5));
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashA, 300, 2, txid2, 1, false), 5));
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashA, 255, 0, txid1, 0, false), 7));
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_SCRIPTHASH, hashA, 256, 0, txid1, 1, false), 9));
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashB, 1, 0, txid1, 2, false), 11));
+    BOOST_CHECK(db.WriteAddressIndex(vIndex));
+
+    vector<pair<CAddressIndexKey, CAmount> > vRead;
+    BOOST_CHECK(db.ReadAddressIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vRead));
+    BOOST_CHECK_EQUAL(vRead.size(), 3U);
+    BOOST_CHECK_EQUAL(vRead[0].first.blockHeight, 255);
+    BOOST_CHECK(vRead[0].first.txhash == txid1);
+    BOOST_CHECK_EQUAL(vRead[0].second, 7);
+    BOOST_CHECK_EQUAL(vRead[1].first.blockHeight, 300);
+    BOOST_CHECK_EQUAL(vRead[1].first.index, 1U);
+    BOOST_CHECK_EQUAL(vRead[2].first.blockHeight, 70000);
+    BOOST_CHECK(vRead[2].first.spending);
+    BOOST_CHECK_EQUAL(vRead[2].second, -5);
+
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vRead, 256, 300));
+    BOOST_CHECK_EQUAL(vRead.size(), 1U);
+    BOOST_CHECK(vRead[0].first.txhash == txid2);
+
+    BOOST_CHECK(db.EraseAddressIndex(vector<pair<CAddressIndexKey, CAmount> >(vIndex.begin(), vIndex.begin() + 1)));
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vRead));
+    BOOST_CHECK_EQUAL(vRead.size(), 2U);
+
+    // A null value erases the unspent output, and the last update wins
+    vector<pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid1, 0), CAddressUnspentValue(7, CScript() << OP_TRUE, 255)));
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid2, 1), CAddressUnspentValue(5, CScript(), 300)));
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid2, 1), CAddressUnspentValue()));
+    BOOST_CHECK(db.UpdateAddressUnspentIndex(vUnspent));
+    vector<pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspentRead;
+    BOOST_CHECK(db.ReadAddressUnspentIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vUnspentRead));
+    BOOST_CHECK_EQUAL(vUnspentRead.size(), 1U);
+    BOOST_CHECK(vUnspentRead[0].first.txhash == txid1);
+    BOOST_CHECK_EQUAL(vUnspentRead[0].second.satoshis, 7);
+    BOOST_CHECK(vUnspentRead[0].second.script == CScript() << OP_TRUE);
+
+    vector<pair<CSpentIndexKey, CSpentIndexValue> > vSpent;
+    vSpent.push_back(make_pair(CSpentIndexKey(txid1, 0), CSpentIndexValue(txid3, 2, 70000, 7, ADDRESS_INDEX_PUBKEYHASH, hashA)));
+    BOOST_CHECK(db.UpdateSpentIndex(vSpent));
+    CSpentIndexValue value;
+    BOOST_CHECK(db.ReadSpentIndex(CSpentIndexKey(txid1, 0), value));
+    BOOST_CHECK(value.txid == txid3);
+    BOOST_CHECK_EQUAL(value.inputIndex, 2U);
+    BOOST_CHECK_EQUAL(value.blockHeight, 70000);
+    BOOST_CHECK(!db.ReadSpentIndex(CSpentIndexKey(txid1, 1), value));
+
+    vSpent[0].second.SetNull();
+    BOOST_CHECK(db.UpdateSpentIndex(vSpent));
+    BOOST_CHECK(!db.ReadSpentIndex(CSpentIndexKey(txid1, 0), value));
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_block_batch)
+{
+    CBlockTreeDB db(1 << 20, true);
+    uint160 hashA = uint160(ParseHex("00112233445566778899aabbccddeeff00112233"));
+    uint256 txidPrev = GetRandHash(), txid = GetRandHash();
+
+    // The unspent output txidPrev:0 before the block
+    vector<pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspent;
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txidPrev, 0), CAddressUnspentValue(7, CScript() << OP_TRUE, 10)));
+    BOOST_CHECK(db.UpdateAddressUnspentIndex(vUnspent));
+
+    // A block at height 11 whose transaction spends it and pays the address again
+    vector<pair<uint256, CDiskTxPos> > vTxIndex;
+    vTxIndex.push_back(make_pair(txid, CDiskTxPos(CDiskBlockPos(0, 100), 80)));
+    vector<pair<CAddressIndexKey, CAmount> > vIndex;
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashA, 11, 1, txid, 0, true), -7));
+    vIndex.push_back(make_pair(CAddressIndexKey(ADDRESS_INDEX_PUBKEYHASH, hashA, 11, 1, txid, 0, false), 6));
+    vUnspent.clear();
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txidPrev, 0), CAddressUnspentValue()));
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid, 0), CAddressUnspentValue(6, CScript() << OP_TRUE, 11)));
+    vector<pair<CSpentIndexKey, CSpentIndexValue> > vSpent;
+    vSpent.push_back(make_pair(CSpentIndexKey(txidPrev, 0), CSpentIndexValue(txid, 0, 11, 7, ADDRESS_INDEX_PUBKEYHASH, hashA)));
+    BOOST_CHECK(db.ConnectBlockIndexes(vTxIndex, vIndex, vUnspent, vSpent));
+
+    CDiskTxPos pos;
+    BOOST_CHECK(db.ReadTxIndex(txid, pos));
+    BOOST_CHECK_EQUAL(pos.nTxOffset, 80U);
+    vector<pair<CAddressIndexKey, CAmount> > vRead;
+    BOOST_CHECK(db.ReadAddressIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vRead));
+    BOOST_CHECK_EQUAL(vRead.size(), 2U);
+    vector<pair<CAddressUnspentKey, CAddressUnspentValue> > vUnspentRead;
+    BOOST_CHECK(db.ReadAddressUnspentIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vUnspentRead));
+    BOOST_CHECK_EQUAL(vUnspentRead.size(), 1U);
+    BOOST_CHECK(vUnspentRead[0].first.txhash == txid);
+    CSpentIndexValue value;
+    BOOST_CHECK(db.ReadSpentIndex(CSpentIndexKey(txidPrev, 0), value));
+    BOOST_CHECK(value.txid == txid);
+
+    // Disconnecting it restores the records of before the block
+    vUnspent.clear();
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txid, 0), CAddressUnspentValue()));
+    vUnspent.push_back(make_pair(CAddressUnspentKey(ADDRESS_INDEX_PUBKEYHASH, hashA, txidPrev, 0), CAddressUnspentValue(7, CScript() << OP_TRUE, 10)));
+    vSpent[0].second.SetNull();
+    BOOST_CHECK(db.DisconnectBlockIndexes(vIndex, vUnspent, vSpent));
+
+    vRead.clear();
+    BOOST_CHECK(db.ReadAddressIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vRead));
+    BOOST_CHECK(vRead.empty());
+    vUnspentRead.clear();
+    BOOST_CHECK(db.ReadAddressUnspentIndex(hashA, ADDRESS_INDEX_PUBKEYHASH, vUnspentRead));
+    BOOST_CHECK_EQUAL(vUnspentRead.size(), 1U);
+    BOOST_CHECK(vUnspentRead[0].first.txhash == txidPrev);
+    BOOST_CHECK(!db.ReadSpentIndex(CSpentIndexKey(txidPrev, 0), value));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "random.h"
+#include "servicenode-budget.h"
+#include "servicenodeman.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+class CBudgetProposalTest : public CBudgetProposal
+{
+public:
+    CBudgetProposalTest() : CBudgetProposal() {}
+
+    void AddVote(CBudgetVote vote)
+    {
+        mapVotes[vote.vin.prevout.GetHash()] = vote;
+        TallyVote(vote, 1);
+    }
+
+    void Recount()
+    {
+        RecountVotes();
+    }
+};
+
+CBudgetVote RandomVote(int64_t nTime)
+{
+    CBudgetVote vote(CTxIn(COutPoint(GetRandHash(), insecure_rand() % 4)), GetRandHash(), insecure_rand() % 3);
+    vote.nTime = nTime;
+    return vote;
+}
+
+/** Compare the running tallies with a count of mapVotes. */
+void CheckTallies(CBudgetProposal& proposal)
+{
+    int nYeas = 0, nNays = 0, nAbstains = 0;
+    int nAllYeas = 0, nAllNays = 0;
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CBudgetVote) & item, proposal.mapVotes) {
+        const CBudgetVote& vote = item.second;
+        if (vote.nVote == VOTE_YES) nAllYeas++;
+        if (vote.nVote == VOTE_NO) nAllNays++;
+        if (!vote.fValid) continue;
+        if (vote.nVote == VOTE_YES) nYeas++;
+        if (vote.nVote == VOTE_NO) nNays++;
+        if (vote.nVote == VOTE_ABSTAIN) nAbstains++;
+    }
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), nYeas);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), nNays);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), nAbstains);
+    BOOST_CHECK_EQUAL(proposal.GetRatio(), nAllYeas + nAllNays == 0 ? 0.0 : (double)nAllYeas / (nAllYeas + nAllNays));
+}
+}
+
+BOOST_AUTO_TEST_SUITE(budget_tests)
+
+BOOST_AUTO_TEST_CASE(budget_proposal_tally)
+{
+    int64_t nTimeFirst = GetTime() - 2 * BUDGET_VOTE_UPDATE_MIN;
+
+    CBudgetProposalTest proposal;
+    CheckTallies(proposal);
+
+    // TallyVote, and a recount that finds the same
+    std::vector<CBudgetVote> vVotes;
+    for (int i = 0; i < 100; i++) {
+        CBudgetVote vote = RandomVote(nTimeFirst);
+        vote.fValid = insecure_rand() % 4 != 0;
+        proposal.AddVote(vote);
+        vVotes.push_back(vote);
+    }
+    CheckTallies(proposal);
+    proposal.Recount();
+    CheckTallies(proposal);
+
+    // AddOrUpdateVote replacing the votes of half the servicenodes
+    std::string strError;
+    for (int i = 0; i < 50; i++) {
+        CBudgetVote vote = vVotes[i];
+        vote.nVote = (vote.nVote + 1 + insecure_rand() % 2) % 3;
+        vote.nTime = GetTime();
+        vote.fValid = insecure_rand() % 2;
+        BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+        CheckTallies(proposal);
+    }
+    // A replacement that is too soon is refused and changes nothing
+    CBudgetVote voteSoon = vVotes[0];
+    voteSoon.nVote = (voteSoon.nVote + 1) % 3;
+    voteSoon.nTime = GetTime();
+    BOOST_CHECK(!proposal.AddOrUpdateVote(voteSoon, strError));
+    CheckTallies(proposal);
+
+    // CleanAndRemove: votes of unknown servicenodes stop counting, and count
+    // again once their servicenode is known
+    mnodeman.Clear();
+    proposal.CleanAndRemove(false);
+    CheckTallies(proposal);
+    BOOST_CHECK_EQUAL(proposal.GetYeas() + proposal.GetNays() + proposal.GetAbstains(), 0);
+    for (int i = 0; i < 100; i += 3) {
+        CServicenode mn;
+        mn.vin = vVotes[i].vin;
+        BOOST_CHECK(mnodeman.Add(mn));
+    }
+    BOOST_CHECK(proposal.CleanAndRemove(false));
+    CheckTallies(proposal);
+    BOOST_CHECK(!proposal.CleanAndRemove(false));
+    mnodeman.Clear();
+
+    // Unserialize recounts; fValid is not serialized, so every vote counts again
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal proposalRead;
+    ss >> proposalRead;
+    BOOST_CHECK_EQUAL(proposalRead.mapVotes.size(), 100U);
+    CheckTallies(proposalRead);
+
+    // Copy, and the copy-and-swap assignment of the broadcast
+    CBudgetProposal proposalCopy(proposal);
+    CheckTallies(proposalCopy);
+    BOOST_CHECK_EQUAL(proposalCopy.GetYeas(), proposal.GetYeas());
+
+    CBudgetProposalBroadcast broadcast(proposal);
+    CheckTallies(broadcast);
+    CBudgetProposalBroadcast broadcastAssigned;
+    broadcastAssigned = broadcast;
+    CheckTallies(broadcastAssigned);
+    BOOST_CHECK_EQUAL(broadcastAssigned.GetNays(), proposal.GetNays());
+    BOOST_CHECK_EQUAL(broadcastAssigned.GetRatio(), proposal.GetRatio());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
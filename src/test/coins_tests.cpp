@@ -58,6 +58,22 @@ public:
 
     bool GetStats(CCoinsStats& stats) const { return false; }
 };
+
+class CCoinsViewCacheTest : public CCoinsViewCache
+{
+public:
+    CCoinsViewCacheTest(CCoinsView* base) : CCoinsViewCache(base) {}
+
+    void SelfTest() const
+    {
+        // Manually recompute the dynamic usage of the whole data, and compare it.
+        size_t ret = memusage::DynamicUsage(cacheCoins);
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
+            ret += it->second.coins.DynamicMemoryUsage();
+        }
+        BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
+    }
+};
 }
 
 BOOST_AUTO_TEST_SUITE(coins_tests)
@@ -175,4 +191,108 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+// Modify entries through a child cache on top of a CCoinsViewCache, and Sync()
+// the latter to a random memory target from time to time. The cache has to keep
+// representing the same data, and to account its memory usage exactly.
+BOOST_AUTO_TEST_CASE(coins_cache_sync_test)
+{
+    bool evicted_an_entry = false;
+    bool kept_an_entry = false;
+
+    std::map<uint256, CCoins> result;
+
+    CCoinsViewTest base;
+    CCoinsViewCacheTest cache(&base);
+
+    std::vector<uint256> txids;
+    txids.resize(NUM_SIMULATION_ITERATIONS / 16);
+    for (unsigned int i = 0; i < txids.size(); i++) {
+        txids[i] = GetRandHash();
+    }
+
+    CCoinsViewCache* child = new CCoinsViewCache(&cache);
+    for (unsigned int i = 0; i < NUM_SIMULATION_ITERATIONS / 4; i++) {
+        {
+            uint256 txid = txids[insecure_rand() % txids.size()];
+            CCoins& coins = result[txid];
+            CCoinsViewCache* view = child;
+            if (insecure_rand() % 2) {
+                // The child would keep stale copies of entries modified below it.
+                child->Flush();
+                view = &cache;
+            }
+            CCoinsModifier entry = view->ModifyCoins(txid);
+            BOOST_CHECK(coins == *entry);
+            if (insecure_rand() % 3 == 0 || coins.IsPruned()) {
+                coins.nVersion = insecure_rand();
+                coins.vout.resize(1 + insecure_rand() % 4);
+                for (unsigned int n = 0; n < coins.vout.size(); n++) {
+                    coins.vout[n].nValue = insecure_rand();
+                    coins.vout[n].scriptPubKey.assign(insecure_rand() % 64, OP_TRUE);
+                }
+                *entry = coins;
+            } else {
+                coins.Clear();
+                entry->Clear();
+            }
+        }
+
+        if (insecure_rand() % 50 == 0) {
+            child->Flush();
+            delete child;
+            child = new CCoinsViewCache(&cache);
+            cache.SelfTest();
+        }
+
+        if (insecure_rand() % 200 == 0) {
+            child->Flush();
+            unsigned int nBefore = cache.GetCacheSize();
+            size_t nTarget = cache.DynamicMemoryUsage() / (1 + insecure_rand() % 4);
+            bool fBackground = insecure_rand() % 2;
+            BOOST_CHECK(cache.Sync(nTarget, fBackground));
+            // The test view is not safe for concurrent reads.
+            if (fBackground) {
+                // The entries handed to the write count until it is done
+                size_t nUsage = cache.DynamicMemoryUsage();
+                BOOST_CHECK(cache.WaitForWrite());
+                BOOST_CHECK(nUsage > cache.DynamicMemoryUsage());
+            }
+            cache.SelfTest();
+            if (cache.GetCacheSize() < nBefore) {
+                evicted_an_entry = true;
+            }
+            if (cache.GetCacheSize() > 0) {
+                kept_an_entry = true;
+            }
+            for (std::map<uint256, CCoins>::iterator it = result.begin(); it != result.end(); it++) {
+                const CCoins* coins = cache.AccessCoins(it->first);
+                if (coins) {
+                    BOOST_CHECK(*coins == it->second);
+                } else {
+                    BOOST_CHECK(it->second.IsPruned());
+                }
+            }
+            cache.SelfTest();
+        }
+    }
+    child->Flush();
+    delete child;
+
+    // Everything must have reached the base after a full flush.
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0);
+    cache.SelfTest();
+    for (std::map<uint256, CCoins>::iterator it = result.begin(); it != result.end(); it++) {
+        CCoins coins;
+        if (base.GetCoins(it->first, coins)) {
+            BOOST_CHECK(coins == it->second);
+        } else {
+            BOOST_CHECK(it->second.IsPruned());
+        }
+    }
+
+    BOOST_CHECK(evicted_an_entry);
+    BOOST_CHECK(kept_an_entry);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
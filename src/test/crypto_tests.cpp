@@ -2,6 +2,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "crypto/quark.h"
 #include "crypto/rfc6979_hmac_sha256.h"
 #include "crypto/ripemd160.h"
 #include "crypto/sha1.h"
@@ -9,6 +10,12 @@
 #include "crypto/sha512.h"
 #include "crypto/hmac_sha256.h"
 #include "crypto/hmac_sha512.h"
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_skein.h"
 #include "random.h"
 #include "utilstrencodings.h"
 
@@ -131,6 +138,95 @@ BOOST_AUTO_TEST_CASE(sha256_testvectors) {
     TestSHA256(test1, "a316d55510b49662420f49d145d42fb83f31ef8dc016aa4e32df049991a91e26");
 }
 
+BOOST_AUTO_TEST_CASE(sha256d_short) {
+    // Every batch size and message length must match hashing one message at a time
+    for (size_t len = 0; len <= 55; len += 13) {
+        for (size_t n = 1; n <= 17; n++) {
+            std::vector<unsigned char> in(len * n);
+            for (size_t i = 0; i < in.size(); i++)
+                in[i] = insecure_rand();
+            std::vector<unsigned char> out(32 * n);
+            SHA256DShort(&out[0], in.empty() ? NULL : &in[0], len, n);
+            for (size_t j = 0; j < n; j++) {
+                unsigned char hash[32];
+                CSHA256().Write(in.empty() ? NULL : &in[j * len], len).Finalize(hash);
+                CSHA256().Write(hash, 32).Finalize(hash);
+                BOOST_CHECK(memcmp(hash, &out[32 * j], 32) == 0);
+            }
+        }
+    }
+}
+
+#define QUARK_STEP(algo, in, out)          \
+    {                                      \
+        sph_##algo##_context ctx;          \
+        sph_##algo##_init(&ctx);           \
+        sph_##algo(&ctx, in, 64);          \
+        sph_##algo##_close(&ctx, out);     \
+    }
+
+/** Quark computed one sphlib primitive at a time. */
+void QuarkReference(unsigned char* output, const unsigned char* input, size_t len)
+{
+    static unsigned char blank[1];
+    unsigned char hash[9][64];
+    sph_blake512_context ctx;
+    sph_blake512_init(&ctx);
+    sph_blake512(&ctx, len ? input : blank, len);
+    sph_blake512_close(&ctx, hash[0]);
+    QUARK_STEP(bmw512, hash[0], hash[1]);
+    if (hash[1][0] & 8)
+        QUARK_STEP(groestl512, hash[1], hash[2])
+    else
+        QUARK_STEP(skein512, hash[1], hash[2])
+    QUARK_STEP(groestl512, hash[2], hash[3]);
+    QUARK_STEP(jh512, hash[3], hash[4]);
+    if (hash[4][0] & 8)
+        QUARK_STEP(blake512, hash[4], hash[5])
+    else
+        QUARK_STEP(bmw512, hash[4], hash[5])
+    QUARK_STEP(keccak512, hash[5], hash[6]);
+    QUARK_STEP(skein512, hash[6], hash[7]);
+    if (hash[7][0] & 8)
+        QUARK_STEP(keccak512, hash[7], hash[8])
+    else
+        QUARK_STEP(jh512, hash[7], hash[8])
+    memcpy(output, hash[8], 32);
+}
+
+#undef QUARK_STEP
+
+BOOST_AUTO_TEST_CASE(quark_testvectors) {
+    BOOST_TEST_MESSAGE("Quark implementation: " + QuarkImplementation());
+
+    // Main network genesis block header
+    std::vector<unsigned char> header = ParseHex("01000000000000000000000000000000000000000000000000000000000000000000"
+                                                 "0000f26bb5a8606ca026d9c17f12b6e215812bbe33ab19073ac2f45af56d3fe9f0b1"
+                                                 "b9f78959ffff0f1ef7360b00");
+    std::vector<unsigned char> hash(32);
+    QuarkHash(&hash[0], &header[0], header.size());
+    BOOST_CHECK_EQUAL(HexStr(hash.rbegin(), hash.rend()), "00000eb7919102da5a07dc90905651664e6ebf0811c28f06573b9a0fd84ab7b8");
+
+    // Every batch size and message length must match the reference, batches
+    // mix messages taking both sides of each branch
+    for (size_t len = 0; len <= 80; len += 16) {
+        for (size_t n = 1; n <= 37; n += 3) {
+            std::vector<unsigned char> in(len * n);
+            for (size_t i = 0; i < in.size(); i++)
+                in[i] = insecure_rand();
+            std::vector<unsigned char> out(32 * n);
+            QuarkHashMulti(&out[0], in.empty() ? NULL : &in[0], len, n);
+            for (size_t j = 0; j < n; j++) {
+                unsigned char expected[32], single[32];
+                QuarkReference(expected, in.empty() ? NULL : &in[j * len], len);
+                QuarkHash(single, in.empty() ? NULL : &in[j * len], len);
+                BOOST_CHECK(memcmp(expected, &out[32 * j], 32) == 0);
+                BOOST_CHECK(memcmp(expected, single, 32) == 0);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE(sha512_testvectors) {
     TestSHA512("",
                "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce"
@@ -6,9 +6,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "chainparams.h"
+#include "hash.h"
 #include "main.h"
+#include "streams.h"
 
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 BOOST_AUTO_TEST_SUITE(main_tests)
 
@@ -49,4 +53,61 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(block_header_hash_cache)
+{
+    CBlock genesis = Params().GenesisBlock();
+    CBlockHeader header = genesis.GetBlockHeader();
+    BOOST_CHECK(header.GetHash() == Params().HashGenesisBlock());
+
+    // Changing any hashed field must invalidate the cached hash
+    header.nNonce++;
+    BOOST_CHECK(header.GetHash() == HashQuark(BEGIN(header.nVersion), END(header.nNonce)));
+    BOOST_CHECK(header.GetHash() != Params().HashGenesisBlock());
+    header.nNonce--;
+    BOOST_CHECK(header.GetHash() == Params().HashGenesisBlock());
+    header.hashMerkleRoot = uint256(1);
+    BOOST_CHECK(header.GetHash() == HashQuark(BEGIN(header.nVersion), END(header.nNonce)));
+
+    // So must deserializing into an object that already has one
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << genesis.GetBlockHeader();
+    ss >> header;
+    BOOST_CHECK(header.GetHash() == Params().HashGenesisBlock());
+
+    // Copies keep it, batches fill it
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == Params().HashGenesisBlock());
+    std::vector<CBlockHeader> headers(17, header);
+    for (size_t i = 0; i < headers.size(); i++)
+        headers[i].nNonce += i;
+    CBlockHeader::CacheHashes(headers);
+    for (size_t i = 0; i < headers.size(); i++)
+        BOOST_CHECK(headers[i].GetHash() == HashQuark(BEGIN(headers[i].nVersion), END(headers[i].nNonce)));
+}
+
+static void HashHeaderRepeatedly(const CBlockHeader* pheader, bool* pfAllMatch)
+{
+    for (int i = 0; i < 1000; i++) {
+        if (pheader->GetHash() != Params().HashGenesisBlock())
+            *pfAllMatch = false;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_header_hash_threads)
+{
+    // Threads sharing a const header, e.g. through the same CBlock, all get the right hash
+    for (int nRound = 0; nRound < 20; nRound++) {
+        CBlockHeader header = Params().GenesisBlock().GetBlockHeader();
+        header.nNonce++;
+        header.nNonce--;
+        bool fAllMatch[4] = {true, true, true, true};
+        boost::thread_group threads;
+        for (int i = 0; i < 4; i++)
+            threads.create_thread(boost::bind(&HashHeaderRepeatedly, &header, &fAllMatch[i]));
+        threads.join_all();
+        for (int i = 0; i < 4; i++)
+            BOOST_CHECK(fAllMatch[i]);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
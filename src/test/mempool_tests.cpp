@@ -99,4 +99,151 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolAncestorIndexTest)
+{
+    // Test the cached ancestor package totals and the fee index
+
+    // Zero fee parent with a high fee child, and an unrelated mid fee transaction:
+    CMutableTransaction txParent;
+    txParent.vin.resize(1);
+    txParent.vin[0].scriptSig = CScript() << OP_11;
+    txParent.vout.resize(1);
+    txParent.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txParent.vout[0].nValue = 33000LL;
+
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout.hash = txParent.GetHash();
+    txChild.vin[0].prevout.n = 0;
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 11000LL;
+
+    CMutableTransaction txOther;
+    txOther.vin.resize(1);
+    txOther.vin[0].scriptSig = CScript() << OP_12;
+    txOther.vout.resize(1);
+    txOther.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txOther.vout[0].nValue = 11000LL;
+
+    CTxMemPool testPool(CFeeRate(0));
+    testPool.addUnchecked(txParent.GetHash(), CTxMemPoolEntry(txParent, 0, 0, 0.0, 1));
+    testPool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 20000LL, 0, 0.0, 1));
+    testPool.addUnchecked(txOther.GetHash(), CTxMemPoolEntry(txOther, 5000LL, 0, 0.0, 1));
+
+    const CTxMemPoolEntry& parent = testPool.mapTx[txParent.GetHash()];
+    const CTxMemPoolEntry& child = testPool.mapTx[txChild.GetHash()];
+    BOOST_CHECK_EQUAL(parent.GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(child.GetCountWithAncestors(), 2);
+    BOOST_CHECK_EQUAL(child.GetSizeWithAncestors(), parent.GetTxSize() + child.GetTxSize());
+    BOOST_CHECK_EQUAL(child.GetModFeesWithAncestors(), 20000LL);
+
+    // The child pays for its parent, so its package comes first:
+    BOOST_CHECK_EQUAL(testPool.mapTxByAncestorFee.size(), 3);
+    BOOST_CHECK((*testPool.mapTxByAncestorFee.begin())->GetTx().GetHash() == txChild.GetHash());
+    BOOST_CHECK((*testPool.mapTxByAncestorFee.rbegin())->GetTx().GetHash() == txParent.GetHash());
+
+    // Ancestors come parents first:
+    std::vector<const CTxMemPoolEntry*> ancestors;
+    testPool.CalculateAncestors(txChild.GetHash(), std::set<uint256>(), ancestors);
+    BOOST_CHECK_EQUAL(ancestors.size(), 2);
+    BOOST_CHECK(ancestors[0] == &parent);
+    BOOST_CHECK(ancestors[1] == &child);
+
+    // Prioritising the parent raises the package of the child as well:
+    testPool.PrioritiseTransaction(txParent.GetHash(), txParent.GetHash().ToString(), 0, 1000LL);
+    BOOST_CHECK_EQUAL(parent.GetModFeesWithAncestors(), 1000LL);
+    BOOST_CHECK_EQUAL(child.GetModFeesWithAncestors(), 21000LL);
+
+    // Priority deltas move an entry in the priority index:
+    testPool.PrioritiseTransaction(txOther.GetHash(), txOther.GetHash().ToString(), 1e9, 0);
+    BOOST_CHECK_EQUAL(testPool.mapTxByPriority.size(), 3);
+    BOOST_CHECK((*testPool.mapTxByPriority.begin())->GetTx().GetHash() == txOther.GetHash());
+    BOOST_CHECK_EQUAL((*testPool.mapTxByPriority.begin())->GetModifiedPriority(1), 1e9);
+
+    // Parent mined, the child is on its own:
+    std::list<CTransaction> removed;
+    testPool.remove(txParent, removed, false);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK_EQUAL(child.GetCountWithAncestors(), 1);
+    BOOST_CHECK_EQUAL(child.GetSizeWithAncestors(), child.GetTxSize());
+    BOOST_CHECK_EQUAL(child.GetModFeesWithAncestors(), 20000LL);
+    BOOST_CHECK_EQUAL(testPool.mapTxByAncestorFee.size(), 2);
+    BOOST_CHECK_EQUAL(testPool.mapTxByPriority.size(), 2);
+
+    testPool.clear();
+    BOOST_CHECK_EQUAL(testPool.mapTxByAncestorFee.size(), 0);
+    BOOST_CHECK_EQUAL(testPool.mapTxByPriority.size(), 0);
+}
+
+static void CheckAncestorState(CTxMemPool& pool)
+{
+    // Cached totals against a full walk of the ancestors
+    for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = pool.mapTx.begin(); it != pool.mapTx.end(); ++it) {
+        std::vector<const CTxMemPoolEntry*> ancestors;
+        pool.CalculateAncestors(it->first, std::set<uint256>(), ancestors);
+        uint64_t nSize = 0;
+        CAmount nFees = 0;
+        BOOST_FOREACH (const CTxMemPoolEntry* ancestor, ancestors) {
+            nSize += ancestor->GetTxSize();
+            nFees += ancestor->GetModifiedFee();
+        }
+        BOOST_CHECK_EQUAL(it->second.GetCountWithAncestors(), ancestors.size());
+        BOOST_CHECK_EQUAL(it->second.GetSizeWithAncestors(), nSize);
+        BOOST_CHECK_EQUAL(it->second.GetModFeesWithAncestors(), nFees);
+    }
+    BOOST_CHECK_EQUAL(pool.mapTxByAncestorFee.size(), pool.mapTx.size());
+    BOOST_CHECK_EQUAL(pool.mapTxByPriority.size(), pool.mapTx.size());
+}
+
+BOOST_AUTO_TEST_CASE(MempoolAncestorChainTest)
+{
+    // A chain of four, each spending the previous one, and a second child of the last
+    std::vector<CMutableTransaction> txs(5);
+    for (unsigned int i = 0; i < txs.size(); i++) {
+        txs[i].vin.resize(1);
+        txs[i].vin[0].scriptSig = CScript() << OP_11;
+        if (i > 0) {
+            txs[i].vin[0].prevout.hash = txs[i == 4 ? 3 : i - 1].GetHash();
+            txs[i].vin[0].prevout.n = i == 4 ? 1 : 0;
+        }
+        txs[i].vout.resize(2);
+        txs[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txs[i].vout[0].nValue = 1000LL;
+        txs[i].vout[1].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        txs[i].vout[1].nValue = 1000LL;
+    }
+
+    CTxMemPool testPool(CFeeRate(0));
+    for (unsigned int i = 0; i < txs.size(); i++)
+        testPool.addUnchecked(txs[i].GetHash(), CTxMemPoolEntry(txs[i], 1000LL * (i + 1), 0, 0.0, 1));
+    CheckAncestorState(testPool);
+    BOOST_CHECK_EQUAL(testPool.mapTx[txs[3].GetHash()].GetCountWithAncestors(), 4);
+    BOOST_CHECK_EQUAL(testPool.CountAncestors(CTransaction(txs[3]), 25), 4);
+    BOOST_CHECK_EQUAL(testPool.CountAncestors(CTransaction(txs[3]), 2), 3);
+
+    testPool.PrioritiseTransaction(txs[1].GetHash(), txs[1].GetHash().ToString(), 0, 500LL);
+    CheckAncestorState(testPool);
+
+    // Mined parents first, as in a block
+    std::list<CTransaction> removed;
+    testPool.remove(txs[0], removed, false);
+    CheckAncestorState(testPool);
+    testPool.remove(txs[1], removed, false);
+    CheckAncestorState(testPool);
+
+    // Removed with its parent still in the pool, the child is recounted
+    testPool.remove(txs[3], removed, false);
+    CheckAncestorState(testPool);
+    BOOST_CHECK_EQUAL(testPool.mapTx[txs[4].GetHash()].GetCountWithAncestors(), 1);
+
+    // Blocks disconnected, parents come back with their children in the pool
+    testPool.addUnchecked(txs[1].GetHash(), CTxMemPoolEntry(txs[1], 2000LL, 0, 0.0, 1));
+    CheckAncestorState(testPool);
+    testPool.addUnchecked(txs[0].GetHash(), CTxMemPoolEntry(txs[0], 1000LL, 0, 0.0, 1));
+    CheckAncestorState(testPool);
+    BOOST_CHECK_EQUAL(testPool.mapTx[txs[2].GetHash()].GetCountWithAncestors(), 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
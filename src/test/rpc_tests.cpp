@@ -6,10 +6,13 @@
 #include "rpcclient.h"
 
 #include "base58.h"
+#include "main.h"
 #include "netbase.h"
+#include "utiltime.h"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 using namespace json_spirit;
@@ -157,6 +160,48 @@ BOOST_AUTO_TEST_CASE(json_parse_errors)
     BOOST_CHECK_EQUAL(read_string(std::string("3J98t1WpEZ73CNmQviecrnyiWrnqRhWNL"), value), false);
 }
 
+static void WriteSample(JSONWriter& writer)
+{
+    writer.BeginObject();
+    writer.WritePair("hash", "00ff");
+    writer.WritePair("amount", 1.5);
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.Key("tx");
+    writer.BeginArray();
+    writer.Write(1);
+    writer.BeginObject();
+    writer.WritePair("quote\"d", Value::null);
+    writer.EndObject();
+    writer.Write(true);
+    writer.EndArray();
+    writer.WritePair("last", (int64_t)-7);
+    writer.EndObject();
+}
+
+BOOST_AUTO_TEST_CASE(json_stream_writer)
+{
+    JSONValueWriter valueWriter;
+    WriteSample(valueWriter);
+    const Value& value = valueWriter.GetValue();
+    BOOST_CHECK_EQUAL(value.type(), obj_type);
+    BOOST_CHECK_EQUAL(find_value(value.get_obj(), "tx").get_array().size(), 3U);
+
+    // Streamed text must match the serialized tree for both precisions in use
+    for (unsigned int nPrecision = 0; nPrecision <= 8; nPrecision += 8) {
+        std::ostringstream stream;
+        JSONStreamWriter streamWriter(stream, nPrecision);
+        WriteSample(streamWriter);
+        BOOST_CHECK_EQUAL(stream.str(), write_string(value, json_spirit::none, nPrecision));
+    }
+
+    // Scalar result
+    JSONValueWriter scalarWriter;
+    scalarWriter.Write(0);
+    BOOST_CHECK_EQUAL(scalarWriter.GetValue().get_int(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(rpc_boostasiotocnetaddr)
 {
     // Check IPv4 addresses
@@ -172,4 +217,88 @@ BOOST_AUTO_TEST_CASE(rpc_boostasiotocnetaddr)
     BOOST_CHECK_EQUAL(BoostAsioToCNetAddr(boost::asio::ip::address::from_string("::ffff:127.0.0.1")).ToString(), "127.0.0.1");
 }
 
+static const size_t REPLY_CHUNK_SIZE = 64 * 1024;
+
+// Stands in for the I/O thread of a client that reads one chunk every 50ms
+static void SlowReader(HTTPReplyQueue& queue)
+{
+    while (true) {
+        if (queue.BeginSend()) {
+            MilliSleep(50);
+            queue.EndSend(false);
+        } else
+            MilliSleep(1);
+    }
+}
+
+// Streams a reply of 64 chunks under cs_main, as listtransactions does
+static void StreamUnderMainLock(HTTPReplyQueue& queue, int64_t& nTime)
+{
+    int64_t nStart = GetTimeMillis();
+    LOCK(cs_main);
+    std::string strChunk(REPLY_CHUNK_SIZE, 'x');
+    for (int i = 0; i < 64 && queue.Push(strChunk, false, false); i++)
+        MilliSleep(1);
+    nTime = GetTimeMillis() - nStart;
+}
+
+BOOST_AUTO_TEST_CASE(rpc_reply_queue_slow_reader)
+{
+    HTTPReplyQueue queue(8 * REPLY_CHUNK_SIZE);
+    boost::thread reader(boost::bind(&SlowReader, boost::ref(queue)));
+    int64_t nWriterTime = 0;
+    boost::thread writer(boost::bind(&StreamUnderMainLock, boost::ref(queue), boost::ref(nWriterTime)));
+
+    // The reader needs more than 3s for the reply, cs_main must be free long before
+    MilliSleep(10);
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK(cs_main);
+    }
+    BOOST_CHECK(GetTimeMillis() - nStart < 1000);
+    writer.join();
+    BOOST_CHECK(nWriterTime < 1000);
+
+    // The client fell too far behind, so the reply failed and its data was dropped
+    BOOST_CHECK(queue.IsFailed());
+    BOOST_CHECK(!queue.Push("0\r\n\r\n", true, false));
+    // Let the reader finish the chunk it was sending
+    MilliSleep(100);
+    BOOST_CHECK_EQUAL(queue.Size(), 0U);
+    reader.interrupt();
+    reader.join();
+    bool fKeepAlive;
+    BOOST_CHECK(!queue.TakeFinished(fKeepAlive));
+}
+
+BOOST_AUTO_TEST_CASE(rpc_reply_queue_order)
+{
+    HTTPReplyQueue queue(1024);
+    BOOST_CHECK(queue.Push("a", false, false));
+    BOOST_CHECK(queue.Push("bc", true, true));
+    BOOST_CHECK_EQUAL(queue.Size(), 3U);
+
+    bool fKeepAlive = false;
+    BOOST_CHECK(!queue.TakeFinished(fKeepAlive));
+    const std::string* pdata = queue.BeginSend();
+    BOOST_REQUIRE(pdata);
+    BOOST_CHECK_EQUAL(*pdata, "a");
+    // One send at a time
+    BOOST_CHECK(!queue.BeginSend());
+    queue.EndSend(false);
+    pdata = queue.BeginSend();
+    BOOST_REQUIRE(pdata);
+    BOOST_CHECK_EQUAL(*pdata, "bc");
+    queue.EndSend(false);
+
+    BOOST_CHECK(queue.TakeFinished(fKeepAlive));
+    BOOST_CHECK(fKeepAlive);
+    BOOST_CHECK(!queue.TakeFinished(fKeepAlive));
+    BOOST_CHECK_EQUAL(queue.Size(), 0U);
+
+    // A single reply larger than the limit is accepted while nothing is queued
+    BOOST_CHECK(queue.Push(std::string(4096, 'x'), true, false));
+    BOOST_CHECK(!queue.IsFailed());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
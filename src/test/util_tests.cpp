@@ -5,6 +5,7 @@
 #include "util.h"
 
 #include "clientversion.h"
+#include "logwriter.h"
 #include "primitives/transaction.h"
 #include "random.h"
 #include "sync.h"
@@ -12,9 +13,12 @@
 #include "utilmoneystr.h"
 
 #include <stdint.h>
+#include <fstream>
 #include <vector>
 
+#include <boost/filesystem/operations.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 
 using namespace std;
 
@@ -424,4 +428,101 @@ BOOST_AUTO_TEST_CASE(test_FormatSubVersion)
     BOOST_CHECK_EQUAL(FormatSubVersion("Test", 99900, comments),std::string("/Test:0.9.99(comment1)/"));
     BOOST_CHECK_EQUAL(FormatSubVersion("Test", 99900, comments2),std::string("/Test:0.9.99(comment1; comment2)/"));
 }
+static void WriteLogLines(CLogWriter* pwriter, int nThread, int nLines)
+{
+    for (int i = 0; i < nLines; i++)
+        pwriter->Write(strprintf("%d %d\n", nThread, i));
+}
+
+BOOST_AUTO_TEST_CASE(util_logwriter)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("test_logwriter_%d.log", GetTimeMicros());
+    {
+        // A small ring, so that the threads have to wait for the writer
+        CLogWriter writer(path, true, 16);
+        BOOST_CHECK(writer.IsOpen());
+        writer.Write("first\n", 1234567890);
+        // Only the start of a line gets a timestamp
+        writer.Write("sec", 1234567890);
+        writer.Write("ond\n", 1234567891);
+
+        boost::thread_group threads;
+        for (int i = 0; i < 4; i++)
+            threads.create_thread(boost::bind(&WriteLogLines, &writer, i, 1000));
+        threads.join_all();
+        writer.Flush();
+
+        // Lines written after Stop() go straight to the file
+        writer.Stop();
+        writer.Write("last\n");
+    }
+
+    std::ifstream file(path.string().c_str());
+    std::string strLine;
+    BOOST_CHECK(std::getline(file, strLine));
+    BOOST_CHECK_EQUAL(strLine, DateTimeStrFormat("%Y-%m-%d %H:%M:%S ", 1234567890) + "first");
+    BOOST_CHECK(std::getline(file, strLine));
+    BOOST_CHECK_EQUAL(strLine, DateTimeStrFormat("%Y-%m-%d %H:%M:%S ", 1234567890) + "second");
+
+    // Nothing is lost, and each thread's lines keep their order
+    std::vector<int> vNext(4, 0);
+    int nLines = 0;
+    while (std::getline(file, strLine) && strLine != "last") {
+        int nThread = atoi(strLine);
+        BOOST_CHECK_EQUAL(strLine, strprintf("%d %d", nThread, vNext[nThread]++));
+        nLines++;
+    }
+    BOOST_CHECK_EQUAL(nLines, 4000);
+    BOOST_CHECK_EQUAL(strLine, "last");
+    file.close();
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(util_logwriter_stop)
+{
+    // Stopping while threads are still writing loses no line, whether it was
+    // queued before, during or after the stop
+    for (int nRound = 0; nRound < 10; nRound++) {
+        boost::filesystem::path path = GetTempPath() / strprintf("test_logwriter_stop_%d.log", GetTimeMicros());
+        {
+            CLogWriter writer(path, true, 16);
+            boost::thread_group threads;
+            for (int i = 0; i < 4; i++)
+                threads.create_thread(boost::bind(&WriteLogLines, &writer, i, 500));
+            MilliSleep(nRound);
+            writer.Stop();
+            threads.join_all();
+        }
+
+        std::ifstream file(path.string().c_str());
+        std::string strLine;
+        std::vector<int> vNext(4, 0);
+        int nLines = 0;
+        while (std::getline(file, strLine)) {
+            int nThread = atoi(strLine);
+            BOOST_CHECK_EQUAL(strLine, strprintf("%d %d", nThread, vNext[nThread]++));
+            nLines++;
+        }
+        BOOST_CHECK_EQUAL(nLines, 2000);
+        file.close();
+        boost::filesystem::remove(path);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(util_logratelimit)
+{
+    // Off by default
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(LogAcceptRate("ratetest"));
+
+    nLogRateLimit = 3;
+    int nAccepted = 0;
+    for (int i = 0; i < 100; i++)
+        nAccepted += LogAcceptRate("ratetest");
+    nLogRateLimit = 0;
+
+    // At most two one second windows can be involved
+    BOOST_CHECK(nAccepted >= 3 && nAccepted <= 6);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,6 +4,10 @@
 
 #include "wallet.h"
 
+#include "key.h"
+#include "main.h"
+#include "script/standard.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -305,4 +309,130 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+// Balances the way they were computed before setUnspentTxs, over all of mapWallet
+static CAmount FullWalkBalance(const CWallet& w)
+{
+    CAmount nTotal = 0;
+    LOCK2(cs_main, w.cs_wallet);
+    for (map<uint256, CWalletTx>::const_iterator it = w.mapWallet.begin(); it != w.mapWallet.end(); ++it) {
+        if (it->second.IsTrusted())
+            nTotal += it->second.GetAvailableCredit();
+    }
+    return nTotal;
+}
+
+static CAmount FullWalkUnconfirmedBalance(const CWallet& w)
+{
+    CAmount nTotal = 0;
+    LOCK2(cs_main, w.cs_wallet);
+    for (map<uint256, CWalletTx>::const_iterator it = w.mapWallet.begin(); it != w.mapWallet.end(); ++it) {
+        if (!IsFinalTx(it->second) || (!it->second.IsTrusted() && it->second.GetDepthInMainChain() == 0))
+            nTotal += it->second.GetAvailableCredit();
+    }
+    return nTotal;
+}
+
+static void CheckUnspentTxs(const CWallet& w, CAmount nExpected)
+{
+    BOOST_CHECK_EQUAL(w.GetBalance(), FullWalkBalance(w));
+    BOOST_CHECK_EQUAL(w.GetUnconfirmedBalance(), FullWalkUnconfirmedBalance(w));
+    BOOST_CHECK_EQUAL(w.GetBalance(), nExpected);
+}
+
+// A block with the single transaction tx on top of the active chain
+static CBlockIndex* ConnectTestBlock(CBlock& block, const CTransaction& tx)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    block.vtx.push_back(tx);
+    block.hashPrevBlock = pindexPrev->GetBlockHash();
+    block.nTime = pindexPrev->nTime + 1;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+
+    CBlockIndex* pindex = new CBlockIndex(block);
+    pindex->pprev = pindexPrev;
+    pindex->nHeight = pindexPrev->nHeight + 1;
+    pindex->phashBlock = &mapBlockIndex.insert(make_pair(block.GetHash(), pindex)).first->first;
+    chainActive.SetTip(pindex);
+    return pindex;
+}
+
+BOOST_AUTO_TEST_CASE(unspent_txs_balance)
+{
+    CWallet w("wallet_unspent_test.dat");
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    BOOST_CHECK(w.AddKeyPubKey(key, key.GetPubKey()));
+    CScript scriptMine = GetScriptForDestination(key.GetPubKey().GetID());
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+
+    CBlockIndex* pindexGenesis;
+    {
+        LOCK(cs_main);
+        pindexGenesis = chainActive.Tip();
+    }
+
+    // Receive 10 in a block
+    CMutableTransaction txReceive;
+    txReceive.vin.resize(1);
+    txReceive.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txReceive.vout.resize(1);
+    txReceive.vout[0].nValue = 10 * COIN;
+    txReceive.vout[0].scriptPubKey = scriptMine;
+    CBlock block1;
+    CBlockIndex* pindex1 = ConnectTestBlock(block1, txReceive);
+    w.SyncTransaction(txReceive, &block1);
+    CheckUnspentTxs(w, 10 * COIN);
+
+    // Spend the 10, 4 back as change
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(txReceive.GetHash(), 0);
+    txSpend.vout.resize(2);
+    txSpend.vout[0].nValue = 4 * COIN;
+    txSpend.vout[0].scriptPubKey = scriptMine;
+    txSpend.vout[1].nValue = 6 * COIN;
+    txSpend.vout[1].scriptPubKey = scriptOther;
+    CBlock block2;
+    CBlockIndex* pindex2 = ConnectTestBlock(block2, txSpend);
+    w.SyncTransaction(txSpend, &block2);
+    CheckUnspentTxs(w, 4 * COIN);
+
+    // Reorg: the spend leaves the chain and the 10 is available again
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(pindex1);
+    }
+    w.SyncTransaction(txSpend, NULL);
+    CheckUnspentTxs(w, 10 * COIN);
+
+    // Connected again
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(pindex2);
+    }
+    w.SyncTransaction(txSpend, &block2);
+    CheckUnspentTxs(w, 4 * COIN);
+
+    // A new key makes the other output ours
+    BOOST_CHECK(w.AddKeyPubKey(keyOther, keyOther.GetPubKey()));
+    w.MarkDirty();
+    CheckUnspentTxs(w, 10 * COIN);
+
+    // Erasing the spend gives back the 10
+    w.EraseFromWallet(txSpend.GetHash());
+    CheckUnspentTxs(w, 10 * COIN);
+    BOOST_CHECK_EQUAL(w.mapWallet.size(), 1U);
+
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(pindexGenesis);
+        mapBlockIndex.erase(block2.GetHash());
+        mapBlockIndex.erase(block1.GetHash());
+    }
+    delete pindex2;
+    delete pindex1;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+// Copyright (c) 2018 The Blocknet developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "random.h"
+#include "util.h"
+#include "xbridge/xbridgeorderhistory.h"
+#include "xbridge/xbridgetransactiondescr.h"
+
+#include <limits>
+
+#include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+
+static xbridge::TransactionDescrPtr FinishedOrder(const uint256& id, const boost::posix_time::ptime& txtime)
+{
+    xbridge::TransactionDescrPtr ptr(new xbridge::TransactionDescr);
+    ptr->id = id;
+    ptr->fromCurrency = "BLOCK";
+    ptr->fromAmount = 2 * xbridge::TransactionDescr::COIN;
+    ptr->toCurrency = "LTC";
+    ptr->toAmount = 1 * xbridge::TransactionDescr::COIN;
+    ptr->state = xbridge::TransactionDescr::trFinished;
+    ptr->txtime = txtime;
+    return ptr;
+}
+
+static double Volume(const xbridge::OrderHistory& history, const string& from, const string& to, uint32_t granularity)
+{
+    double volume = 0;
+    BOOST_FOREACH(const xbridge::Candle& candle, history.candles(from, to, granularity, 0, numeric_limits<uint32_t>::max()))
+        volume += candle.volume;
+    return volume;
+}
+
+BOOST_AUTO_TEST_SUITE(xbridge_orderhistory_tests)
+
+BOOST_AUTO_TEST_CASE(orderhistory_append_once)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("test_xbridgehistory_%i", (int)GetRand(100000));
+    const boost::posix_time::ptime txtime(boost::gregorian::date(2018, 1, 1));
+    uint256 idA = GetRandHash(), idB = GetRandHash();
+
+    {
+        xbridge::OrderHistory history;
+        BOOST_CHECK(history.open(path));
+        history.append(FinishedOrder(idA, txtime));
+        history.append(FinishedOrder(idA, txtime));
+        BOOST_FOREACH(uint32_t granularity, xbridge::OrderHistory::granularities()) {
+            BOOST_CHECK_EQUAL(Volume(history, "BLOCK", "LTC", granularity), 2);
+            BOOST_CHECK_EQUAL(Volume(history, "LTC", "BLOCK", granularity), 1);
+        }
+    }
+
+    // Restart: the order is announced again with a later time
+    {
+        xbridge::OrderHistory history;
+        BOOST_CHECK(history.open(path));
+        history.append(FinishedOrder(idA, txtime + boost::posix_time::hours(1)));
+        history.append(FinishedOrder(idB, txtime + boost::posix_time::hours(1)));
+        BOOST_FOREACH(uint32_t granularity, xbridge::OrderHistory::granularities()) {
+            BOOST_CHECK_EQUAL(Volume(history, "BLOCK", "LTC", granularity), 4);
+            BOOST_CHECK_EQUAL(Volume(history, "LTC", "BLOCK", granularity), 2);
+            size_t nOrders = 0;
+            BOOST_FOREACH(const xbridge::Candle& candle, history.candles("BLOCK", "LTC", granularity, 0, numeric_limits<uint32_t>::max()))
+                nOrders += candle.orderIds.size();
+            BOOST_CHECK_EQUAL(nOrders, 2U);
+        }
+    }
+
+    boost::filesystem::remove_all(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 
 #include "txdb.h"
 
+#include "crypto/quark.h"
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
@@ -173,54 +174,235 @@ bool CBlockTreeDB::ReadTxIndex(const uint256& txid, CDiskTxPos& pos)
     return Read(make_pair('t', txid), pos);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect)
+static void BatchWriteTxIndex(CLevelDBBatch& batch, const std::vector<std::pair<uint256, CDiskTxPos> >& vect)
 {
-    CLevelDBBatch batch;
     for (std::vector<std::pair<uint256, CDiskTxPos> >::const_iterator it = vect.begin(); it != vect.end(); it++)
         batch.Write(make_pair('t', it->first), it->second);
+}
+
+static void BatchWriteAddressIndex(CLevelDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Write(make_pair('a', it->first), it->second);
+}
+
+static void BatchEraseAddressIndex(CLevelDBBatch& batch, const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
+{
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it = vect.begin(); it != vect.end(); it++)
+        batch.Erase(make_pair('a', it->first));
+}
+
+static void BatchUpdateAddressUnspentIndex(CLevelDBBatch& batch, const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect)
+{
+    // Later entries win, so an output created and spent in the same block ends up erased
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('u', it->first));
+        else
+            batch.Write(make_pair('u', it->first), it->second);
+    }
+}
+
+static void BatchUpdateSpentIndex(CLevelDBBatch& batch, const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect)
+{
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it = vect.begin(); it != vect.end(); it++) {
+        if (it->second.IsNull())
+            batch.Erase(make_pair('p', it->first));
+        else
+            batch.Write(make_pair('p', it->first), it->second);
+    }
+}
+
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& vect)
+{
+    CLevelDBBatch batch;
+    BatchWriteTxIndex(batch, vect);
     return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
+bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
 {
-    return Write(std::make_pair('F', name), fValue ? '1' : '0');
+    CLevelDBBatch batch;
+    BatchWriteAddressIndex(batch, vect);
+    return WriteBatch(batch);
 }
 
-bool CBlockTreeDB::ReadFlag(const std::string& name, bool& fValue)
+bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect)
 {
-    char ch;
-    if (!Read(std::make_pair('F', name), ch))
-        return false;
-    fValue = ch == '1';
+    CLevelDBBatch batch;
+    BatchEraseAddressIndex(batch, vect);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ConnectBlockIndexes(const std::vector<std::pair<uint256, CDiskTxPos> >& vTxIndex,
+    const std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+    const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vAddressUnspentIndex,
+    const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex)
+{
+    CLevelDBBatch batch;
+    BatchWriteTxIndex(batch, vTxIndex);
+    BatchWriteAddressIndex(batch, vAddressIndex);
+    BatchUpdateAddressUnspentIndex(batch, vAddressUnspentIndex);
+    BatchUpdateSpentIndex(batch, vSpentIndex);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::DisconnectBlockIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+    const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vAddressUnspentIndex,
+    const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex)
+{
+    CLevelDBBatch batch;
+    BatchEraseAddressIndex(batch, vAddressIndex);
+    BatchUpdateAddressUnspentIndex(batch, vAddressUnspentIndex);
+    BatchUpdateSpentIndex(batch, vSpentIndex);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressIndex(const uint160& hashBytes, int type, std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, int nStart, int nEnd)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    // Entries are ordered by height, so a range starts with a seek and ends
+    // at the first entry past it
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    if (nStart > 0)
+        ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, hashBytes, nStart));
+    else
+        ssKeySet << make_pair('a', CAddressIndexIteratorKey(type, hashBytes));
+    pcursor->Seek(ssKeySet.str());
+
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            CAddressIndexKey key;
+            ssKey >> chType;
+            if (chType != 'a')
+                break;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes || (nEnd > 0 && key.blockHeight > nEnd))
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAmount nValue;
+            ssValue >> nValue;
+            vect.push_back(make_pair(key, nValue));
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
     return true;
 }
 
-bool CBlockTreeDB::LoadBlockIndexGuts()
+bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect)
+{
+    CLevelDBBatch batch;
+    BatchUpdateAddressUnspentIndex(batch, vect);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadAddressUnspentIndex(const uint160& hashBytes, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect)
 {
     boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
 
     CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
-    ssKeySet << make_pair('b', uint256());
+    ssKeySet << make_pair('u', CAddressIndexIteratorKey(type, hashBytes));
     pcursor->Seek(ssKeySet.str());
 
-    // Load mapBlockIndex
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
             leveldb::Slice slKey = pcursor->key();
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
+            CAddressUnspentKey key;
             ssKey >> chType;
-            if (chType == 'b') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            if (chType != 'u')
+                break;
+            ssKey >> key;
+            if (key.type != type || key.hashBytes != hashBytes)
+                break;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CAddressUnspentValue value;
+            ssValue >> value;
+            vect.push_back(make_pair(key, value));
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect)
+{
+    CLevelDBBatch batch;
+    BatchUpdateSpentIndex(batch, vect);
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value)
+{
+    return Read(make_pair('p', key), value);
+}
+
+bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
+{
+    return Write(std::make_pair('F', name), fValue ? '1' : '0');
+}
+
+bool CBlockTreeDB::ReadFlag(const std::string& name, bool& fValue)
+{
+    char ch;
+    if (!Read(std::make_pair('F', name), ch))
+        return false;
+    fValue = ch == '1';
+    return true;
+}
+
+namespace
+{
+/** Links of a block index entry, resolved once all entries are decoded */
+struct CBlockIndexLinks {
+    CBlockIndex* pindex;
+    uint256 hashBlock;
+    uint256 hashPrev;
+    uint256 hashNext;
+};
+}
+
+/**
+ * Decode the serialized entries [nBegin, nEnd) into the preallocated block index
+ * entries. Run on several threads at once, as computing the block hash is the
+ * most expensive part of loading the block index. The headers are hashed in
+ * batches, which lets QuarkHashMulti hash several of them at once.
+ */
+void static DecodeBlockIndexRange(const vector<string>* pvValues, CBlockIndex* pindexFirst, vector<CBlockIndexLinks>* pvLinks, size_t nBegin, size_t nEnd, string* pstrError)
+{
+    static const size_t HASH_BATCH = 256;
+    static const size_t HEADER_SIZE = 80;
+
+    try {
+        vector<unsigned char> vchHeaders(HASH_BATCH * HEADER_SIZE);
+        vector<uint256> vHashes(HASH_BATCH);
+        for (size_t nBatch = nBegin; nBatch < nEnd; nBatch += HASH_BATCH) {
+            size_t nBatchEnd = std::min(nEnd, nBatch + HASH_BATCH);
+            for (size_t i = nBatch; i < nBatchEnd; i++) {
+                const string& strValue = (*pvValues)[i];
+                CDataStream ssValue(strValue.data(), strValue.data() + strValue.size(), SER_DISK, CLIENT_VERSION);
                 CDiskBlockIndex diskindex;
                 ssValue >> diskindex;
 
+                CBlockIndexLinks& links = (*pvLinks)[i];
+                links.hashPrev = diskindex.hashPrev;
+                links.hashNext = diskindex.hashNext;
+
                 // Construct block index object
-                CBlockIndex* pindexNew = InsertBlockIndex(diskindex.GetBlockHash());
-                pindexNew->pprev = InsertBlockIndex(diskindex.hashPrev);
-                pindexNew->pnext = InsertBlockIndex(diskindex.hashNext);
+                CBlockIndex* pindexNew = pindexFirst + i;
                 pindexNew->nHeight = diskindex.nHeight;
                 pindexNew->nFile = diskindex.nFile;
                 pindexNew->nDataPos = diskindex.nDataPos;
@@ -242,14 +424,59 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
                 pindexNew->nStakeTime = diskindex.nStakeTime;
                 pindexNew->hashProofOfStake = diskindex.hashProofOfStake;
 
+                // Same bytes as CBlockHeader::GetHash hashes
+                CBlockHeader header;
+                header.nVersion = diskindex.nVersion;
+                header.hashPrevBlock = diskindex.hashPrev;
+                header.hashMerkleRoot = diskindex.hashMerkleRoot;
+                header.nTime = diskindex.nTime;
+                header.nBits = diskindex.nBits;
+                header.nNonce = diskindex.nNonce;
+                assert(END(header.nNonce) - BEGIN(header.nVersion) == HEADER_SIZE);
+                memcpy(&vchHeaders[(i - nBatch) * HEADER_SIZE], BEGIN(header.nVersion), HEADER_SIZE);
+            }
+
+            QuarkHashMulti(vHashes[0].begin(), &vchHeaders[0], HEADER_SIZE, nBatchEnd - nBatch);
+
+            for (size_t i = nBatch; i < nBatchEnd; i++) {
+                CBlockIndexLinks& links = (*pvLinks)[i];
+                links.hashBlock = vHashes[i - nBatch];
+
+                CBlockIndex* pindexNew = pindexFirst + i;
                 if (pindexNew->nHeight <= Params().LAST_POW_BLOCK()) {
-                    if (!CheckProofOfWork(pindexNew->GetBlockHash(), pindexNew->nBits))
-                        return error("LoadBlockIndex() : CheckProofOfWork failed: %s", pindexNew->ToString());
+                    if (!CheckProofOfWork(links.hashBlock, pindexNew->nBits)) {
+                        *pstrError = strprintf("LoadBlockIndex() : CheckProofOfWork failed: block %s height %d", links.hashBlock.ToString(), pindexNew->nHeight);
+                        return;
+                    }
                 }
-                // ppcoin: build setStakeSeen
-                if (pindexNew->IsProofOfStake())
-                    setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+            }
+        }
+    } catch (std::exception& e) {
+        *pstrError = strprintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+}
+
+bool CBlockTreeDB::LoadBlockIndexGuts()
+{
+    int64_t nStart = GetTimeMicros();
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('b', uint256());
+    pcursor->Seek(ssKeySet.str());
 
+    // Read the serialized entries
+    vector<string> vValues;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType == 'b') {
+                leveldb::Slice slValue = pcursor->value();
+                vValues.push_back(slValue.ToString());
                 pcursor->Next();
             } else {
                 break; // if shutdown requested or finished loading block index
@@ -258,6 +485,61 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
+    pcursor.reset();
+    int64_t nRead = GetTimeMicros();
+
+    // Decode them in parallel into entries allocated in one piece
+    size_t nEntries = vValues.size();
+    CBlockIndex* pindexFirst = AllocateBlockIndex(nEntries);
+    vector<CBlockIndexLinks> vLinks(nEntries);
+    int nThreads = std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS));
+    if (nEntries < 1000)
+        nThreads = 1;
+    vector<string> vErrors(nThreads);
+    boost::thread_group threadGroup;
+    for (int n = 0; n < nThreads; n++) {
+        size_t nBegin = nEntries * n / nThreads;
+        size_t nEnd = nEntries * (n + 1) / nThreads;
+        if (n == nThreads - 1)
+            DecodeBlockIndexRange(&vValues, pindexFirst, &vLinks, nBegin, nEnd, &vErrors[n]);
+        else
+            threadGroup.create_thread(boost::bind(&DecodeBlockIndexRange, &vValues, pindexFirst, &vLinks, nBegin, nEnd, &vErrors[n]));
+    }
+    threadGroup.join_all();
+    BOOST_FOREACH (const string& strError, vErrors) {
+        if (!strError.empty())
+            return error("%s", strError);
+    }
+    vector<string>().swap(vValues);
+    boost::this_thread::interruption_point();
+    int64_t nDecode = GetTimeMicros();
+
+    // Load mapBlockIndex
+    mapBlockIndex.rehash((mapBlockIndex.size() + nEntries) / mapBlockIndex.max_load_factor() + 1);
+    for (size_t i = 0; i < nEntries; i++) {
+        CBlockIndex* pindexNew = pindexFirst + i;
+        pair<BlockMap::iterator, bool> ret = mapBlockIndex.insert(make_pair(vLinks[i].hashBlock, pindexNew));
+        if (!ret.second) {
+            // Already referenced by an entry inserted before loading
+            *ret.first->second = *pindexNew;
+            pindexNew = ret.first->second;
+        }
+        pindexNew->phashBlock = &ret.first->first;
+        vLinks[i].pindex = pindexNew;
+    }
+    for (size_t i = 0; i < nEntries; i++) {
+        CBlockIndex* pindexNew = vLinks[i].pindex;
+        pindexNew->pprev = InsertBlockIndex(vLinks[i].hashPrev);
+        pindexNew->pnext = InsertBlockIndex(vLinks[i].hashNext);
+
+        // ppcoin: build setStakeSeen
+        if (pindexNew->IsProofOfStake())
+            setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+    }
+    int64_t nLink = GetTimeMicros();
+
+    LogPrintf("%s: %u entries, read %dms, decoded %dms (%d threads), linked %dms\n", __func__, nEntries,
+        (nRead - nStart) / 1000, (nDecode - nRead) / 1000, nThreads, (nLink - nDecode) / 1000);
 
     return true;
 }
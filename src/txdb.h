@@ -6,6 +6,7 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "addressindex.h"
 #include "leveldbwrapper.h"
 #include "main.h"
 
@@ -60,6 +61,22 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect);
+    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vect);
+    bool ReadAddressIndex(const uint160& hashBytes, int type, std::vector<std::pair<CAddressIndexKey, CAmount> >& vect, int nStart = 0, int nEnd = 0);
+    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect);
+    bool ReadAddressUnspentIndex(const uint160& hashBytes, int type, std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vect);
+    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vect);
+    bool ReadSpentIndex(const CSpentIndexKey& key, CSpentIndexValue& value);
+    /** Write the index records of a connected block in one batch, so that readers see all of them or none. */
+    bool ConnectBlockIndexes(const std::vector<std::pair<uint256, CDiskTxPos> >& vTxIndex,
+        const std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+        const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vAddressUnspentIndex,
+        const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex);
+    /** Undo the index records of a disconnected block in one batch. */
+    bool DisconnectBlockIndexes(const std::vector<std::pair<CAddressIndexKey, CAmount> >& vAddressIndex,
+        const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >& vAddressUnspentIndex,
+        const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >& vSpentIndex);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool LoadBlockIndexGuts();
@@ -16,7 +16,8 @@
 
 using namespace std;
 
-CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nTime(0), dPriority(0.0)
+CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nTime(0), dPriority(0.0),
+                                     nFeeDelta(0), dPriorityDelta(0.0), nCountWithAncestors(1), nSizeWithAncestors(0), nModFeesWithAncestors(0)
 {
     nHeight = MEMPOOL_HEIGHT;
 }
@@ -26,6 +27,12 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
     nModSize = tx.CalculateModifiedSize(nTxSize);
+
+    nFeeDelta = 0;
+    dPriorityDelta = 0.0;
+    nCountWithAncestors = 1;
+    nSizeWithAncestors = nTxSize;
+    nModFeesWithAncestors = nFee;
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -401,6 +408,131 @@ void CTxMemPool::AddTransactionsUpdated(unsigned int n)
 }
 
 
+void CTxMemPool::AddToIndexes(const CTxMemPoolEntry* entry)
+{
+    mapTxByAncestorFee.insert(entry);
+    mapTxByPriority.insert(entry);
+}
+
+void CTxMemPool::RemoveFromIndexes(const CTxMemPoolEntry* entry)
+{
+    mapTxByAncestorFee.erase(entry);
+    mapTxByPriority.erase(entry);
+}
+
+void CTxMemPool::CalculateAncestors(const uint256& hash, const std::set<uint256>& setExclude, std::vector<const CTxMemPoolEntry*>& ancestors) const
+{
+    std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.find(hash);
+    if (it == mapTx.end() || setExclude.count(hash))
+        return;
+
+    // Depth first over the inputs, an entry is emitted once all its parents are
+    std::set<uint256> setVisited;
+    setVisited.insert(hash);
+    std::vector<std::pair<const CTxMemPoolEntry*, unsigned int> > stack;
+    stack.push_back(std::make_pair(&it->second, 0));
+    while (!stack.empty()) {
+        const CTxMemPoolEntry* entry = stack.back().first;
+        const CTransaction& tx = entry->GetTx();
+        if (stack.back().second < tx.vin.size()) {
+            const uint256& hashParent = tx.vin[stack.back().second++].prevout.hash;
+            if (setExclude.count(hashParent) || !setVisited.insert(hashParent).second)
+                continue;
+            std::map<uint256, CTxMemPoolEntry>::const_iterator itParent = mapTx.find(hashParent);
+            if (itParent != mapTx.end())
+                stack.push_back(std::make_pair(&itParent->second, 0));
+            continue;
+        }
+        ancestors.push_back(entry);
+        stack.pop_back();
+    }
+}
+
+void CTxMemPool::UpdateAncestorState(CTxMemPoolEntry& entry)
+{
+    // The index keys depend on the package totals
+    RemoveFromIndexes(&entry);
+
+    std::vector<const CTxMemPoolEntry*> ancestors;
+    CalculateAncestors(entry.GetTx().GetHash(), std::set<uint256>(), ancestors);
+    entry.nCountWithAncestors = ancestors.size();
+    entry.nSizeWithAncestors = 0;
+    entry.nModFeesWithAncestors = 0;
+    BOOST_FOREACH (const CTxMemPoolEntry* ancestor, ancestors) {
+        entry.nSizeWithAncestors += ancestor->GetTxSize();
+        entry.nModFeesWithAncestors += ancestor->GetModifiedFee();
+    }
+
+    AddToIndexes(&entry);
+}
+
+void CTxMemPool::CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const
+{
+    // Every in-mempool transaction that spends hash directly or indirectly
+    std::deque<uint256> queue;
+    queue.push_back(hash);
+    while (!queue.empty()) {
+        uint256 hashParent = queue.front();
+        queue.pop_front();
+        std::map<COutPoint, CInPoint>::const_iterator it = mapNextTx.lower_bound(COutPoint(hashParent, 0));
+        for (; it != mapNextTx.end() && it->first.hash == hashParent; ++it) {
+            const uint256& hashChild = it->second.ptx->GetHash();
+            if (setDescendants.insert(hashChild).second)
+                queue.push_back(hashChild);
+        }
+    }
+}
+
+void CTxMemPool::UpdateDescendants(const uint256& hash, int64_t nCountDelta, int64_t nSizeDelta, CAmount nFeesDelta)
+{
+    // Each descendant counts hash exactly once, so its package totals move by
+    // the same amounts. Callers fall back to RecalculateDescendants when more
+    // than hash itself enters or leaves the packages.
+    std::set<uint256> setDescendants;
+    CalculateDescendants(hash, setDescendants);
+    BOOST_FOREACH (const uint256& hashChild, setDescendants) {
+        std::map<uint256, CTxMemPoolEntry>::iterator it = mapTx.find(hashChild);
+        if (it == mapTx.end())
+            continue;
+        CTxMemPoolEntry& entry = it->second;
+        RemoveFromIndexes(&entry);
+        entry.nCountWithAncestors += nCountDelta;
+        entry.nSizeWithAncestors += nSizeDelta;
+        entry.nModFeesWithAncestors += nFeesDelta;
+        AddToIndexes(&entry);
+    }
+}
+
+void CTxMemPool::RecalculateDescendants(const uint256& hash)
+{
+    std::set<uint256> setDescendants;
+    CalculateDescendants(hash, setDescendants);
+    BOOST_FOREACH (const uint256& hashChild, setDescendants) {
+        std::map<uint256, CTxMemPoolEntry>::iterator it = mapTx.find(hashChild);
+        if (it != mapTx.end())
+            UpdateAncestorState(it->second);
+    }
+}
+
+uint64_t CTxMemPool::CountAncestors(const CTransaction& tx, uint64_t nLimit) const
+{
+    LOCK(cs);
+
+    std::set<uint256> setVisited;
+    std::vector<const CTransaction*> stack;
+    stack.push_back(&tx);
+    while (!stack.empty() && setVisited.size() < nLimit) {
+        const CTransaction* ptx = stack.back();
+        stack.pop_back();
+        BOOST_FOREACH (const CTxIn& txin, ptx->vin) {
+            std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.find(txin.prevout.hash);
+            if (it != mapTx.end() && setVisited.insert(txin.prevout.hash).second)
+                stack.push_back(&it->second.GetTx());
+        }
+    }
+    return setVisited.size() + 1;
+}
+
 bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
 {
     // Add to memory pool without checking anything.
@@ -408,12 +540,29 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
     // all the appropriate checks.
     LOCK(cs);
     {
-        mapTx[hash] = entry;
-        const CTransaction& tx = mapTx[hash].GetTx();
+        std::pair<std::map<uint256, CTxMemPoolEntry>::iterator, bool> ret = mapTx.insert(std::make_pair(hash, entry));
+        if (!ret.second)
+            return false;
+        CTxMemPoolEntry& newEntry = ret.first->second;
+        const CTransaction& tx = newEntry.GetTx();
         for (unsigned int i = 0; i < tx.vin.size(); i++)
             mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
         nTransactionsUpdated++;
         totalTxSize += entry.GetTxSize();
+
+        double dPriorityDelta = 0;
+        CAmount nFeeDelta = 0;
+        ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+        newEntry.nFeeDelta = nFeeDelta;
+        newEntry.dPriorityDelta = dPriorityDelta;
+        UpdateAncestorState(newEntry);
+
+        // Children may already be in the pool when a block is disconnected,
+        // their packages gain this one and, unless it has none, its ancestors
+        if (newEntry.nCountWithAncestors == 1)
+            UpdateDescendants(hash, 1, newEntry.GetTxSize(), newEntry.GetModifiedFee());
+        else
+            RecalculateDescendants(hash);
     }
     return true;
 }
@@ -456,9 +605,24 @@ void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& rem
                 mapNextTx.erase(txin.prevout);
 
             removed.push_back(tx);
-            totalTxSize -= mapTx[hash].GetTxSize();
+            const CTxMemPoolEntry& entry = mapTx[hash];
+            const uint64_t nCountWithAncestors = entry.GetCountWithAncestors();
+            const int64_t nTxSize = entry.GetTxSize();
+            const CAmount nModFee = entry.GetModifiedFee();
+            totalTxSize -= nTxSize;
+            RemoveFromIndexes(&entry);
             mapTx.erase(hash);
             nTransactionsUpdated++;
+
+            // Children left in the pool no longer count this one as an ancestor.
+            // Block transactions are removed parents first, so normally this
+            // one has no ancestors left and the totals are adjusted in place.
+            if (!fRecursive) {
+                if (nCountWithAncestors == 1)
+                    UpdateDescendants(hash, -1, -nTxSize, -nModFee);
+                else
+                    RecalculateDescendants(hash);
+            }
         }
     }
 }
@@ -534,6 +698,8 @@ void CTxMemPool::clear()
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    mapTxByAncestorFee.clear();
+    mapTxByPriority.clear();
     totalTxSize = 0;
     ++nTransactionsUpdated;
 }
@@ -610,6 +776,25 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     }
 
     assert(totalTxSize == checkTotal);
+
+    // Check the block assembly indexes and the cached package totals
+    assert(mapTxByAncestorFee.size() == mapTx.size());
+    assert(mapTxByPriority.size() == mapTx.size());
+    for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+        std::vector<const CTxMemPoolEntry*> ancestors;
+        CalculateAncestors(it->first, std::set<uint256>(), ancestors);
+        uint64_t nSize = 0;
+        CAmount nModFees = 0;
+        BOOST_FOREACH (const CTxMemPoolEntry* ancestor, ancestors) {
+            nSize += ancestor->GetTxSize();
+            nModFees += ancestor->GetModifiedFee();
+        }
+        assert(it->second.GetCountWithAncestors() == ancestors.size());
+        assert(it->second.GetSizeWithAncestors() == nSize);
+        assert(it->second.GetModFeesWithAncestors() == nModFees);
+        assert(mapTxByAncestorFee.count(&it->second));
+        assert(mapTxByPriority.count(&it->second));
+    }
 }
 
 void CTxMemPool::queryHashes(vector<uint256>& vtxid)
@@ -680,6 +865,17 @@ void CTxMemPool::PrioritiseTransaction(const uint256 hash, const string strHash,
         std::pair<double, CAmount>& deltas = mapDeltas[hash];
         deltas.first += dPriorityDelta;
         deltas.second += nFeeDelta;
+
+        // Reposition the entry and its descendants in the fee and priority indexes
+        std::map<uint256, CTxMemPoolEntry>::iterator it = mapTx.find(hash);
+        if (it != mapTx.end()) {
+            const CAmount nFeesDelta = deltas.second - it->second.nFeeDelta;
+            RemoveFromIndexes(&it->second);
+            it->second.nFeeDelta = deltas.second;
+            it->second.dPriorityDelta = deltas.first;
+            UpdateAncestorState(it->second);
+            UpdateDescendants(hash, 0, 0, nFeesDelta);
+        }
     }
     LogPrintf("PrioritiseTransaction: %s priority += %f, fee += %d\n", strHash, dPriorityDelta, FormatMoney(nFeeDelta));
 }
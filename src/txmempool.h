@@ -7,6 +7,7 @@
 #define BITCOIN_TXMEMPOOL_H
 
 #include <list>
+#include <set>
 
 #include "amount.h"
 #include "coins.h"
@@ -45,6 +46,16 @@ private:
     double dPriority;     //! Priority when entering the mempool
     unsigned int nHeight; //! Chain height when entering the mempool
 
+    // Maintained by CTxMemPool, cached so block assembly does not have to
+    // resolve in-mempool parents for every transaction
+    CAmount nFeeDelta;              //! Fee delta from PrioritiseTransaction
+    double dPriorityDelta;          //! Priority delta from PrioritiseTransaction
+    uint64_t nCountWithAncestors;   //! Number of in-mempool ancestors, including this one
+    uint64_t nSizeWithAncestors;    //! ... and their total size
+    CAmount nModFeesWithAncestors;  //! ... and their total fees including deltas
+
+    friend class CTxMemPool;
+
 public:
     CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee, int64_t _nTime, double _dPriority, unsigned int _nHeight);
     CTxMemPoolEntry();
@@ -56,6 +67,40 @@ public:
     size_t GetTxSize() const { return nTxSize; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return nHeight; }
+
+    CAmount GetModifiedFee() const { return nFee + nFeeDelta; }
+    double GetModifiedPriority(unsigned int currentHeight) const { return GetPriority(currentHeight) + dPriorityDelta; }
+    uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    CAmount GetModFeesWithAncestors() const { return nModFeesWithAncestors; }
+};
+
+/** Sort entries by the fee rate of their ancestor package, highest first */
+class CompareTxMemPoolEntryByAncestorFee
+{
+public:
+    bool operator()(const CTxMemPoolEntry* a, const CTxMemPoolEntry* b) const
+    {
+        double f1 = (double)a->GetModFeesWithAncestors() * b->GetSizeWithAncestors();
+        double f2 = (double)b->GetModFeesWithAncestors() * a->GetSizeWithAncestors();
+        if (f1 == f2)
+            return a->GetTx().GetHash() < b->GetTx().GetHash();
+        return f1 > f2;
+    }
+};
+
+/** Sort entries by the priority they had when entering the mempool including deltas, highest first */
+class CompareTxMemPoolEntryByPriority
+{
+public:
+    bool operator()(const CTxMemPoolEntry* a, const CTxMemPoolEntry* b) const
+    {
+        double p1 = a->GetModifiedPriority(a->GetHeight());
+        double p2 = b->GetModifiedPriority(b->GetHeight());
+        if (p1 == p2)
+            return a->GetTx().GetHash() < b->GetTx().GetHash();
+        return p1 > p2;
+    }
 };
 
 class CMinerPolicyEstimator;
@@ -101,12 +146,26 @@ private:
     CFeeRate minRelayFee; //! Passed to constructor to avoid dependency on main
     uint64_t totalTxSize; //! sum of all mempool tx' byte sizes
 
+    void AddToIndexes(const CTxMemPoolEntry* entry);
+    void RemoveFromIndexes(const CTxMemPoolEntry* entry);
+    void UpdateAncestorState(CTxMemPoolEntry& entry);
+    void UpdateDescendants(const uint256& hash, int64_t nCountDelta, int64_t nSizeDelta, CAmount nFeesDelta);
+    void RecalculateDescendants(const uint256& hash);
+    void CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const;
+
 public:
+    typedef std::set<const CTxMemPoolEntry*, CompareTxMemPoolEntryByAncestorFee> indexed_by_ancestor_fee;
+    typedef std::set<const CTxMemPoolEntry*, CompareTxMemPoolEntryByPriority> indexed_by_priority;
+
     mutable CCriticalSection cs;
     std::map<uint256, CTxMemPoolEntry> mapTx;
     std::map<COutPoint, CInPoint> mapNextTx;
     std::map<uint256, std::pair<double, CAmount> > mapDeltas;
 
+    //! Entries of mapTx ordered for block assembly, kept up to date by addUnchecked/remove
+    indexed_by_ancestor_fee mapTxByAncestorFee;
+    indexed_by_priority mapTxByPriority;
+
     CTxMemPool(const CFeeRate& _minRelayFee);
     ~CTxMemPool();
 
@@ -154,6 +213,18 @@ public:
 
     bool lookup(uint256 hash, CTransaction& result) const;
 
+    /**
+     * Collect hash and its in-mempool ancestors that are not in setExclude,
+     * parents before their children, so hash itself comes last. Requires cs.
+     */
+    void CalculateAncestors(const uint256& hash, const std::set<uint256>& setExclude, std::vector<const CTxMemPoolEntry*>& ancestors) const;
+
+    /**
+     * Count the in-mempool ancestors tx would have, including itself. Counting
+     * stops early once nLimit is exceeded.
+     */
+    uint64_t CountAncestors(const CTransaction& tx, uint64_t nLimit) const;
+
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
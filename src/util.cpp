@@ -14,6 +14,7 @@
 
 #include "allocators.h"
 #include "chainparamsbase.h"
+#include "logwriter.h"
 #include "random.h"
 #include "serialize.h"
 #include "sync.h"
@@ -22,6 +23,8 @@
 
 #include <stdarg.h>
 
+#include <atomic>
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <openssl/bio.h>
 #include <openssl/buffer.h>
@@ -134,6 +137,7 @@ bool fServer = false;
 string strMiscWarning;
 bool fLogTimestamps = false;
 bool fLogIPs = false;
+int nLogRateLimit = 0;
 volatile bool fReopenDebugLog = false;
 
 /** Init OpenSSL library multithreading support */
@@ -199,22 +203,17 @@ public:
 
 static boost::once_flag debugPrintInitFlag = BOOST_ONCE_INIT;
 /**
- * We use boost::call_once() to make sure these are initialized
- * in a thread-safe manner the first time called:
+ * We use boost::call_once() to make sure the writer is initialized
+ * in a thread-safe manner the first time called; it is never destroyed:
  */
-static FILE* fileout = NULL;
-static boost::mutex* mutexDebugLog = NULL;
+static CLogWriter* pwriterDebugLog = NULL;
 
 static void DebugPrintInit()
 {
-    assert(fileout == NULL);
-    assert(mutexDebugLog == NULL);
+    assert(pwriterDebugLog == NULL);
 
     boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-    fileout = fopen(pathDebug.string().c_str(), "a");
-    if (fileout) setbuf(fileout, NULL); // unbuffered
-
-    mutexDebugLog = new boost::mutex();
+    pwriterDebugLog = new CLogWriter(pathDebug, GetBoolArg("-logasync", true));
 }
 
 bool LogAcceptCategory(const char* category)
@@ -252,6 +251,63 @@ bool LogAcceptCategory(const char* category)
     return true;
 }
 
+namespace
+{
+/** Lines a -debug category logged in the current one second window */
+struct CLogRateWindow {
+    std::atomic<int64_t> nWindow;
+    std::atomic<int> nLines;
+    std::atomic<int> nSuppressed;
+
+    CLogRateWindow() : nWindow(0), nLines(0), nSuppressed(0) {}
+};
+}
+
+static boost::once_flag logRateInitFlag = BOOST_ONCE_INIT;
+/** One window per category, shared by all threads and never destroyed */
+static boost::mutex* mutexLogRate = NULL;
+static map<string, CLogRateWindow*>* pmapLogRate = NULL;
+
+static void LogRateInit()
+{
+    mutexLogRate = new boost::mutex();
+    pmapLogRate = new map<string, CLogRateWindow*>();
+}
+
+bool LogAcceptRate(const char* category)
+{
+    if (category == NULL || nLogRateLimit <= 0)
+        return true;
+
+    // Like the -debug settings, each thread remembers the windows it has used,
+    // so that the shared map is only locked the first time
+    static boost::thread_specific_ptr<map<const char*, CLogRateWindow*> > ptrWindows;
+    if (ptrWindows.get() == NULL)
+        ptrWindows.reset(new map<const char*, CLogRateWindow*>());
+    CLogRateWindow*& pwindow = (*ptrWindows)[category];
+    if (pwindow == NULL) {
+        boost::call_once(&LogRateInit, logRateInitFlag);
+        boost::mutex::scoped_lock lock(*mutexLogRate);
+        CLogRateWindow*& pshared = (*pmapLogRate)[category];
+        if (pshared == NULL)
+            pshared = new CLogRateWindow();
+        pwindow = pshared;
+    }
+
+    int64_t nNow = GetTimeMillis() / 1000;
+    int64_t nWindow = pwindow->nWindow.load();
+    if (nNow != nWindow && pwindow->nWindow.compare_exchange_strong(nWindow, nNow)) {
+        pwindow->nLines = 0;
+        int nSuppressed = pwindow->nSuppressed.exchange(0);
+        if (nSuppressed > 0)
+            LogPrintStr(strprintf("%s: %d lines suppressed by -logratelimit\n", category, nSuppressed));
+    }
+    if (++pwindow->nLines <= nLogRateLimit)
+        return true;
+    pwindow->nSuppressed++;
+    return false;
+}
+
 int LogPrintStr(const std::string& str)
 {
     int ret = 0; // Returns total number of characters written
@@ -260,31 +316,19 @@ int LogPrintStr(const std::string& str)
         ret = fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
     } else if (fPrintToDebugLog && AreBaseParamsConfigured()) {
-        static bool fStartedNewLine = true;
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
 
-        if (fileout == NULL)
+        if (!pwriterDebugLog->IsOpen())
             return ret;
 
-        boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
-
         // reopen the log file, if requested
         if (fReopenDebugLog) {
             fReopenDebugLog = false;
-            boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
-            if (freopen(pathDebug.string().c_str(), "a", fileout) != NULL)
-                setbuf(fileout, NULL); // unbuffered
+            pwriterDebugLog->Reopen(GetDataDir() / "debug.log");
         }
 
         // Debug print useful for profiling
-        if (fLogTimestamps && fStartedNewLine)
-            ret += fprintf(fileout, "%s ", DateTimeStrFormat("%Y-%m-%d %H:%M:%S", GetTime()).c_str());
-        if (!str.empty() && str[str.size() - 1] == '\n')
-            fStartedNewLine = true;
-        else
-            fStartedNewLine = false;
-
-        ret = fwrite(str.data(), 1, str.size(), fileout);
+        ret = pwriterDebugLog->Write(str, fLogTimestamps ? GetTime() : 0);
     }
 
     return ret;
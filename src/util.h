@@ -56,12 +56,15 @@ extern bool fServer;
 extern std::string strMiscWarning;
 extern bool fLogTimestamps;
 extern bool fLogIPs;
+extern int nLogRateLimit;
 extern volatile bool fReopenDebugLog;
 
 void SetupEnvironment();
 
 /** Return true if log accepts specified category */
 bool LogAcceptCategory(const char* category);
+/** Return true if the category has not used up its -logratelimit lines in this second */
+bool LogAcceptRate(const char* category);
 /** Send a string to the log output */
 int LogPrintStr(const std::string& str);
 
@@ -76,7 +79,7 @@ int LogPrintStr(const std::string& str);
     template <TINYFORMAT_ARGTYPES(n)>                                                           \
     static inline int LogPrint(const char* category, const char* format, TINYFORMAT_VARARGS(n)) \
     {                                                                                           \
-        if (!LogAcceptCategory(category)) return 0;                                             \
+        if (!LogAcceptCategory(category) || !LogAcceptRate(category)) return 0;                 \
         return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)));                        \
     }                                                                                           \
     /**   Log error and return false */                                                         \
@@ -95,7 +98,7 @@ TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
  */
 static inline int LogPrint(const char* category, const char* format)
 {
-    if (!LogAcceptCategory(category)) return 0;
+    if (!LogAcceptCategory(category) || !LogAcceptRate(category)) return 0;
     return LogPrintStr(format);
 }
 static inline bool error(const char* format)
@@ -621,6 +621,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
+        // Ownership of outputs may have changed
+        fUnspentTxsBuilt = false;
     }
 }
 
@@ -632,6 +634,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
         mapWallet[hash] = wtxIn;
         mapWallet[hash].BindWallet(this);
         AddToSpends(hash);
+        if (fUnspentTxsBuilt)
+            setUnspentTxs.insert(hash);
     } else {
         LOCK(cs_wallet);
         // Inserts only if not already there, returns tx inserted or tx found
@@ -682,6 +686,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
                         wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            if (fUnspentTxsBuilt)
+                setUnspentTxs.insert(hash);
         }
 
         bool fUpdated = false;
@@ -759,9 +765,15 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     // available of the outputs it spends. So force those to be
     // recomputed, also:
     BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-        if (mapWallet.count(txin.prevout.hash))
+        if (mapWallet.count(txin.prevout.hash)) {
             mapWallet[txin.prevout.hash].MarkDirty();
+            // A spend that left the chain makes the outputs available again
+            if (!pblock && fUnspentTxsBuilt)
+                setUnspentTxs.insert(txin.prevout.hash);
+        }
     }
+    if (pblock)
+        PruneUnspentTxs(tx);
 }
 
 void CWallet::EraseFromWallet(const uint256& hash)
@@ -770,12 +782,89 @@ void CWallet::EraseFromWallet(const uint256& hash)
         return;
     {
         LOCK(cs_wallet);
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+        if (mi != mapWallet.end() && fUnspentTxsBuilt) {
+            BOOST_FOREACH (const CTxIn& txin, mi->second.vin) {
+                if (mapWallet.count(txin.prevout.hash))
+                    setUnspentTxs.insert(txin.prevout.hash);
+            }
+            setUnspentTxs.erase(hash);
+        }
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
     }
     return;
 }
 
+/**
+ * True if some output of wtx is ours and not spent by a wallet transaction
+ * that is in the main chain. Outputs spent only by unconfirmed transactions
+ * still count, as those spends can be conflicted away.
+ */
+bool CWallet::HasUnspentOutputs(const CWalletTx& wtx) const
+{
+    AssertLockHeld(cs_wallet);
+    const uint256& hash = wtx.GetHash();
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+
+        bool fSpentInChain = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpentInChain; ++it) {
+            map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            fSpentInChain = mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) >= 1;
+        }
+        if (!fSpentInChain)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Drop the transactions spent by a newly confirmed tx from setUnspentTxs
+ * once none of their outputs can be spent any more.
+ */
+void CWallet::PruneUnspentTxs(const CTransaction& tx)
+{
+    AssertLockHeld(cs_wallet);
+    if (!fUnspentTxsBuilt)
+        return;
+
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(txin.prevout.hash);
+        if (mi != mapWallet.end() && !HasUnspentOutputs(mi->second))
+            setUnspentTxs.erase(txin.prevout.hash);
+    }
+}
+
+/**
+ * Wallet transactions that may still contribute to a balance, in mapWallet
+ * order. Requires cs_main and cs_wallet.
+ */
+void CWallet::GetUnspentTxs(std::vector<const CWalletTx*>& vTxs) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    if (!fUnspentTxsBuilt) {
+        setUnspentTxs.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+            if (HasUnspentOutputs(it->second))
+                setUnspentTxs.insert(it->first);
+        }
+        fUnspentTxsBuilt = true;
+        LogPrint("wallet", "%s : %u of %u wallet transactions have unspent outputs\n", __func__, setUnspentTxs.size(), mapWallet.size());
+    }
+
+    vTxs.clear();
+    vTxs.reserve(setUnspentTxs.size());
+    BOOST_FOREACH (const uint256& hash, setUnspentTxs) {
+        map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+        if (mi != mapWallet.end())
+            vTxs.push_back(&mi->second);
+    }
+}
+
 
 isminetype CWallet::IsMine(const CTxIn& txin) const
 {
@@ -1226,8 +1315,9 @@ CAmount CWallet::GetBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -1243,9 +1333,9 @@ CAmount CWallet::GetAnonymizableBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAnonymizableCredit();
         }
@@ -1261,9 +1351,9 @@ CAmount CWallet::GetAnonymizedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAnonymizedCredit();
         }
@@ -1283,10 +1373,10 @@ double CWallet::GetAverageAnonymizedRounds() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            uint256 hash = (*it).first;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
+            uint256 hash = pcoin->GetHash();
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 CTxIn vin = CTxIn(hash, i);
@@ -1315,10 +1405,10 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            uint256 hash = (*it).first;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
+            uint256 hash = pcoin->GetHash();
 
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
                 CTxIn vin = CTxIn(hash, i);
@@ -1342,9 +1432,9 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             nTotal += pcoin->GetDenominatedCredit(unconfirmed);
         }
     }
@@ -1357,8 +1447,9 @@ CAmount CWallet::GetUnconfirmedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
                 nTotal += pcoin->GetAvailableCredit();
         }
@@ -1371,8 +1462,9 @@ CAmount CWallet::GetImmatureBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             nTotal += pcoin->GetImmatureCredit();
         }
     }
@@ -1384,8 +1476,9 @@ CAmount CWallet::GetWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             if (pcoin->IsTrusted())
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -1399,8 +1492,9 @@ CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
                 nTotal += pcoin->GetAvailableWatchOnlyCredit();
         }
@@ -1413,8 +1507,9 @@ CAmount CWallet::GetImmatureWatchOnlyBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
             nTotal += pcoin->GetImmatureWatchOnlyCredit();
         }
     }
@@ -1430,9 +1525,10 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        std::vector<const CWalletTx*> vTxs;
+        GetUnspentTxs(vTxs);
+        BOOST_FOREACH (const CWalletTx* pcoin, vTxs) {
+            const uint256& wtxid = pcoin->GetHash();
 
             if (!CheckFinalTx(*pcoin))
                 continue;
@@ -1472,9 +1568,9 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
                 isminetype mine = IsMine(pcoin->vout[i]);
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_SERVICENODE_REQUIRED_AMOUNT) &&
+                    (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_SERVICENODE_REQUIRED_AMOUNT) &&
                     (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
+                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
                     vCoins.push_back(COutput(pcoin, i, nDepth,
                         ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                             (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
@@ -2413,94 +2509,91 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     if (GetAdjustedTime() <= chainActive.Tip()->nTime)
         MilliSleep(10000);
 
+    // Collect the coins with a known block and search their kernels in parallel
+    vector<CStakeKernelCandidate> vCandidates;
+    vector<pair<const CWalletTx*, unsigned int> > vCandidateCoins;
     BOOST_FOREACH (PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setStakeCoins) {
         //make sure that enough time has elapsed between
-        CBlockIndex* pindex = NULL;
         BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
-        if (it != mapBlockIndex.end())
-            pindex = it->second;
-        else {
+        if (it == mapBlockIndex.end()) {
             if (fDebug)
                 LogPrintf("CreateCoinStake() failed to find block index \n");
             continue;
         }
 
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
+        vCandidates.push_back(CStakeKernelCandidate(it->second, COutPoint(pcoin.first->GetHash(), pcoin.second), pcoin.first->vout[pcoin.second].nValue));
+        vCandidateCoins.push_back(pcoin);
+    }
 
-        bool fKernelFound = false;
-        uint256 hashProofOfStake = 0;
-        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
+    uint256 hashProofOfStake = 0;
+    nTxNewTime = GetAdjustedTime();
+    int nKernel = SearchStakeKernel(nBits, vCandidates, chainActive.Tip()->GetMedianTimePast(), nTxNewTime, nHashDrift, hashProofOfStake);
 
-        //iterates each utxo inside of CheckStakeKernelHash()
-        if (CheckStakeKernelHash(nBits, block, *pcoin.first, prevoutStake, nTxNewTime, nHashDrift, false, hashProofOfStake, true)) {
-            //Double check that this will pass time requirements
-            if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
-                continue;
-            }
+    if (nKernel < 0)
+        return false;
 
-            // Found a kernel
-            if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : kernel found\n");
-
-            vector<valtype> vSolutions;
-            txnouttype whichType;
-            CScript scriptPubKeyOut;
-            scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
-            if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
-                LogPrintf("CreateCoinStake : failed to parse kernel\n");
-                break;
-            }
+    //Double check that this will pass time requirements
+    if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
+        LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
+        return false;
+    }
+
+    const pair<const CWalletTx*, unsigned int>& pcoin = vCandidateCoins[nKernel];
+
+    // Found a kernel
+    if (fDebug && GetBoolArg("-printcoinstake", false))
+        LogPrintf("CreateCoinStake : kernel found\n");
+
+    vector<valtype> vSolutions;
+    txnouttype whichType;
+    CScript scriptPubKeyOut;
+    scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
+    if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
+        LogPrintf("CreateCoinStake : failed to parse kernel\n");
+        return false;
+    }
+    if (fDebug && GetBoolArg("-printcoinstake", false))
+        LogPrintf("CreateCoinStake : parsed kernel type=%d\n", whichType);
+    if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
+        if (fDebug && GetBoolArg("-printcoinstake", false))
+            LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
+        return false; // only support pay to public key and pay to address
+    }
+    if (whichType == TX_PUBKEYHASH) // pay to address type
+    {
+        //convert to pay to public key type
+        CKey key;
+        if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
             if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : parsed kernel type=%d\n", whichType);
-            if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
-                if (fDebug && GetBoolArg("-printcoinstake", false))
-                    LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
-                break; // only support pay to public key and pay to address
-            }
-            if (whichType == TX_PUBKEYHASH) // pay to address type
-            {
-                //convert to pay to public key type
-                CKey key;
-                if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
-                    if (fDebug && GetBoolArg("-printcoinstake", false))
-                        LogPrintf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
-                    break; // unable to find corresponding public key
-                }
+                LogPrintf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
+            return false; // unable to find corresponding public key
+        }
 
-                scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
-            } else
-                scriptPubKeyOut = scriptPubKeyKernel;
+        scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
+    } else
+        scriptPubKeyOut = scriptPubKeyKernel;
 
-            txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
-            nCredit += pcoin.first->vout[pcoin.second].nValue;
-            vwtxPrev.push_back(pcoin.first);
-            txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+    txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
+    nCredit += pcoin.first->vout[pcoin.second].nValue;
+    vwtxPrev.push_back(pcoin.first);
+    txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
 
-            //presstab HyperStake - calculate the total size of our new output including the stake reward so that we can use it to decide whether to split the stake outputs
-            const CBlockIndex* pIndex0 = chainActive.Tip();
-            uint64_t nTotalSize = pcoin.first->vout[pcoin.second].nValue + GetBlockValue(pIndex0->nHeight);
+    //presstab HyperStake - calculate the total size of our new output including the stake reward so that we can use it to decide whether to split the stake outputs
+    const CBlockIndex* pIndex0 = chainActive.Tip();
+    uint64_t nTotalSize = pcoin.first->vout[pcoin.second].nValue + GetBlockValue(pIndex0->nHeight);
 
-            //presstab HyperStake - if MultiSend is set to send in coinstake we will add our outputs here (values asigned further down)
-            if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
-                txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
+    //presstab HyperStake - if MultiSend is set to send in coinstake we will add our outputs here (values asigned further down)
+    if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
+        txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
+
+    if (fDebug && GetBoolArg("-printcoinstake", false))
+        LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
 
-            if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
-            fKernelFound = true;
-            break;
-        }
-        if (fKernelFound)
-            break; // if kernel is found stop searching
-    }
     if (nCredit == 0 || nCredit > nBalance - nReserveBalance)
         return false;
 
     // Calculate reward
     uint64_t nReward;
-    const CBlockIndex* pIndex0 = chainActive.Tip();
     nReward = GetBlockValue(pIndex0->nHeight);
     nCredit += nReward;
 
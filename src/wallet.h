@@ -162,6 +162,18 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Wallet transactions that may still have outputs of ours not spent by a
+     * confirmed transaction. The balance and coin selection functions walk this
+     * set instead of all of mapWallet. It is built on first use and kept up to
+     * date as transactions are added, confirmed, disconnected and erased.
+     */
+    mutable std::set<uint256> setUnspentTxs;
+    mutable bool fUnspentTxsBuilt;
+    bool HasUnspentOutputs(const CWalletTx& wtx) const;
+    void PruneUnspentTxs(const CTransaction& tx);
+    void GetUnspentTxs(std::vector<const CWalletTx*>& vTxs) const;
+
 public:
     bool MintableCoins();
     bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, int64_t nTargetAmount) const;
@@ -243,6 +255,7 @@ public:
         nLastResend = 0;
         nTimeFirstKey = 0;
         fWalletUnlockAnonymizeOnly = false;
+        fUnspentTxsBuilt = false;
 
         // Stake Settings
         nHashDrift = 45;
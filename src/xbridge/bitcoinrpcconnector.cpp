@@ -8,7 +8,14 @@
 #include <boost/iostreams/stream.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/ssl.hpp>
+#include <boost/thread/mutex.hpp>
 #include <stdio.h>
+#ifndef WIN32
+#include <poll.h>
+#endif
+#include <deque>
+#include <set>
+#include <memory>
 
 #include "bitcoinrpcconnector.h"
 #include "util/xutil.h"
@@ -85,9 +92,213 @@ int readHTTP(std::basic_istream<char>& stream, map<string, string>& mapHeadersRe
 
 //******************************************************************************
 //******************************************************************************
-Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
-               const std::string & rpcip, const std::string & rpcport,
-               const std::string & strMethod, const Array & params)
+namespace
+{
+
+// idle keep-alive connections older than this are closed (seconds),
+// less than default rpcservertimeout of the wallets
+const int64_t CONNECTION_IDLE_TIMEOUT = 20;
+
+// wallet calls without side effects; only these are sent on a reused
+// connection and resent when it turns out to be stale, other calls
+// always open a new connection, the wallet may already have executed
+// the first request
+const std::set<std::string> readOnlyMethods =
+{
+    "decoderawtransaction", "getaddressesbyaccount", "getbalance", "getbestblockhash",
+    "getblock", "getblockcount", "getblockhash", "getinfo", "getnetworkinfo",
+    "getrawtransaction", "gettransaction", "gettxout", "listaccounts",
+    "listunspent", "validateaddress", "verifymessage"
+};
+
+bool isReadOnlyMethod(const std::string & strMethod)
+{
+    return readOnlyMethods.count(strMethod) > 0;
+}
+
+//******************************************************************************
+//******************************************************************************
+class Connection
+{
+public:
+    Connection()
+        : context(io_service, ssl::context::sslv23)
+        , sslStream(io_service, context)
+        , device(sslStream, false)
+        , stream(device)
+        , lastUsed(0)
+    {
+        context.set_options(ssl::context::no_sslv2);
+    }
+
+    bool connect(const std::string & rpcip, const std::string & rpcport)
+    {
+        return device.connect(rpcip, rpcport);
+    }
+
+    // health check before reuse
+    bool isAlive()
+    {
+        if (!sslStream.lowest_layer().is_open() || !stream.good())
+        {
+            return false;
+        }
+
+        if (GetTime() - lastUsed > CONNECTION_IDLE_TIMEOUT)
+        {
+            return false;
+        }
+
+        // closed by peer (FIN or RST) or unexpected data,
+        // an idle connection never has anything to read
+        return !isReadable();
+    }
+
+private:
+    bool isReadable()
+    {
+        asio::ip::tcp::socket::native_handle_type hSocket = sslStream.lowest_layer().native_handle();
+#ifdef WIN32
+        struct timeval timeout = { 0, 0 };
+        fd_set fdsetRecv;
+        FD_ZERO(&fdsetRecv);
+        FD_SET(hSocket, &fdsetRecv);
+        return select(hSocket + 1, &fdsetRecv, NULL, NULL, &timeout) != 0;
+#else
+        struct pollfd pfd;
+        pfd.fd = hSocket;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        return poll(&pfd, 1, 0) != 0;
+#endif
+    }
+
+private:
+    asio::io_service                                         io_service;
+    ssl::context                                             context;
+    asio::ssl::stream<asio::ip::tcp::socket>                 sslStream;
+    SSLIOStreamDevice<asio::ip::tcp>                         device;
+
+public:
+    iostreams::stream< SSLIOStreamDevice<asio::ip::tcp> >    stream;
+    int64_t                                                  lastUsed;
+};
+
+typedef std::shared_ptr<Connection> ConnectionPtr;
+
+//******************************************************************************
+//******************************************************************************
+class ConnectionPool
+{
+public:
+    ConnectionPool()
+        : m_size(DEFAULT_CONNECTION_POOL_SIZE)
+    {}
+
+    void setSize(const uint32_t size)
+    {
+        boost::mutex::scoped_lock l(m_lock);
+        m_size = size;
+        while (m_idle.size() > m_size)
+        {
+            m_idle.pop_front();
+        }
+    }
+
+    // take idle connection, nullptr if no alive connections
+    ConnectionPtr take()
+    {
+        boost::mutex::scoped_lock l(m_lock);
+        while (!m_idle.empty())
+        {
+            ConnectionPtr conn = m_idle.back();
+            m_idle.pop_back();
+            if (conn->isAlive())
+            {
+                return conn;
+            }
+            ++m_stats.reconnects;
+        }
+        return ConnectionPtr();
+    }
+
+    void release(const ConnectionPtr & conn)
+    {
+        conn->lastUsed = GetTime();
+
+        boost::mutex::scoped_lock l(m_lock);
+        if (m_idle.size() < m_size)
+        {
+            m_idle.push_back(conn);
+        }
+    }
+
+    void reconnected()
+    {
+        boost::mutex::scoped_lock l(m_lock);
+        ++m_stats.reconnects;
+    }
+
+    void callFinished(const int64_t micros, const bool isError)
+    {
+        boost::mutex::scoped_lock l(m_lock);
+        ++m_stats.calls;
+        if (isError)
+        {
+            ++m_stats.errors;
+        }
+        m_stats.lastMicros   = micros;
+        m_stats.totalMicros += micros;
+        m_stats.maxMicros    = std::max(m_stats.maxMicros, static_cast<uint64_t>(micros));
+    }
+
+    bool isKeepAlive() const
+    {
+        boost::mutex::scoped_lock l(m_lock);
+        return m_size > 0;
+    }
+
+    ConnectorStats stats() const
+    {
+        boost::mutex::scoped_lock l(m_lock);
+        ConnectorStats result = m_stats;
+        result.idleConnections = static_cast<uint32_t>(m_idle.size());
+        return result;
+    }
+
+private:
+    mutable boost::mutex        m_lock;
+    uint32_t                    m_size;
+    std::deque<ConnectionPtr>   m_idle;
+    ConnectorStats              m_stats;
+};
+
+typedef std::shared_ptr<ConnectionPool> ConnectionPoolPtr;
+
+boost::mutex                                poolsLock;
+std::map<std::string, ConnectionPoolPtr>    pools;
+
+//******************************************************************************
+//******************************************************************************
+ConnectionPoolPtr connectionPool(const std::string & rpcip, const std::string & rpcport)
+{
+    boost::mutex::scoped_lock l(poolsLock);
+    ConnectionPoolPtr & pool = pools[rpcip + ":" + rpcport];
+    if (!pool)
+    {
+        pool.reset(new ConnectionPool);
+    }
+    return pool;
+}
+
+//******************************************************************************
+// send json request to wallet, returns reply body,
+// fRetry - the request may be sent on a reused connection and
+// resent if it is stale, otherwise a new connection is opened
+//******************************************************************************
+std::string sendRequest(const std::string & rpcuser, const std::string & rpcpasswd,
+                        const std::string & rpcip, const std::string & rpcport,
+                        const std::string & strRequest, const bool fRetry)
 {
 //    if (mapArgs["-rpcuser"] == "" && mapArgs["-rpcpassword"] == "")
 //        throw runtime_error(strprintf(
@@ -95,39 +306,70 @@ Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
 //              "If the file does not exist, create it with owner-readable-only file permissions."),
 //                GetConfigFile().string().c_str()));
 
-    // Connect to localhost
-    bool fUseSSL = false;//GetBoolArg("-rpcssl");
-    asio::io_service io_service;
-    ssl::context context(io_service, ssl::context::sslv23);
-    context.set_options(ssl::context::no_sslv2);
-    asio::ssl::stream<asio::ip::tcp::socket> sslStream(io_service, context);
-    SSLIOStreamDevice<asio::ip::tcp> d(sslStream, fUseSSL);
-    iostreams::stream< SSLIOStreamDevice<asio::ip::tcp> > stream(d);
-    if (!d.connect(rpcip, rpcport))
-        throw runtime_error("couldn't connect to server");
+    ConnectionPoolPtr pool = connectionPool(rpcip, rpcport);
+    const bool fKeepAlive  = pool->isKeepAlive();
+    const int64_t nStart   = GetTimeMicros();
 
     // HTTP basic authentication
     string strUserPass64 = util::base64_encode(rpcuser + ":" + rpcpasswd);
     map<string, string> mapRequestHeaders;
     mapRequestHeaders["Authorization"] = string("Basic ") + strUserPass64;
 
-    // Send request
-    string strRequest = JSONRPCRequest(strMethod, params, 1);
-
-    if(fDebug)
-        LOG() << "HTTP: req  " << strMethod << " " << strRequest;
-
-    string strPost = HTTPPost(strRequest, mapRequestHeaders);
-    stream << strPost << std::flush;
+    string strPost = HTTPPost(strRequest, mapRequestHeaders, fKeepAlive);
 
     // Receive reply
     map<string, string> mapHeaders;
     string strReply;
-    int nStatus = readHTTP(stream, mapHeaders, strReply);
+    int nStatus = 0;
+
+    // reuse idle keep-alive connection, if it was closed by
+    // the wallet in the meantime - reconnect once for read-only calls
+    ConnectionPtr conn = fRetry ? pool->take() : ConnectionPtr();
+    const bool fReused = conn != nullptr;
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (!conn)
+        {
+            // Connect to wallet
+            conn.reset(new Connection);
+            if (!conn->connect(rpcip, rpcport))
+            {
+                pool->callFinished(GetTimeMicros() - nStart, true);
+                throw runtime_error("couldn't connect to server");
+            }
+        }
+
+        try
+        {
+            conn->stream << strPost << std::flush;
+            nStatus = readHTTP(conn->stream, mapHeaders, strReply);
+        }
+        catch (std::exception &)
+        {
+            nStatus = 0;
+            strReply.clear();
+        }
+
+        if (nStatus != 0 || !strReply.empty() || !fReused || !fRetry || attempt > 0)
+        {
+            break;
+        }
+
+        // stale connection
+        conn.reset();
+        pool->reconnected();
+    }
 
     if(fDebug)
         LOG() << "HTTP: resp " << nStatus << " " << strReply;
 
+    if (fKeepAlive && nStatus != 0 && conn->stream.good() && mapHeaders["connection"] == "keep-alive")
+    {
+        pool->release(conn);
+    }
+
+    pool->callFinished(GetTimeMicros() - nStart, nStatus == 0 || nStatus >= 400);
+
     if (nStatus == HTTP_UNAUTHORIZED)
         throw runtime_error("incorrect rpcuser or rpcpassword (authorization failed)");
     else if (nStatus >= 400 && nStatus != HTTP_BAD_REQUEST && nStatus != HTTP_NOT_FOUND && nStatus != HTTP_INTERNAL_SERVER_ERROR)
@@ -135,6 +377,41 @@ Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
     else if (strReply.empty())
         throw runtime_error("no response from server");
 
+    return strReply;
+}
+
+} // namespace
+
+//******************************************************************************
+//******************************************************************************
+void setConnectionPoolSize(const std::string & rpcip, const std::string & rpcport,
+                           const uint32_t size)
+{
+    connectionPool(rpcip, rpcport)->setSize(size);
+}
+
+//******************************************************************************
+//******************************************************************************
+ConnectorStats connectorStats(const std::string & rpcip, const std::string & rpcport)
+{
+    return connectionPool(rpcip, rpcport)->stats();
+}
+
+//******************************************************************************
+//******************************************************************************
+Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
+               const std::string & rpcip, const std::string & rpcport,
+               const std::string & strMethod, const Array & params)
+{
+    // Send request
+    string strRequest = JSONRPCRequest(strMethod, params, 1);
+
+    if(fDebug)
+        LOG() << "HTTP: req  " << strMethod << " " << strRequest;
+
+    string strReply = sendRequest(rpcuser, rpcpasswd, rpcip, rpcport, strRequest,
+                                  isReadOnlyMethod(strMethod));
+
     // Parse reply
     Value valReply;
     if (!read_string(strReply, valReply))
@@ -146,6 +423,73 @@ Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
     return reply;
 }
 
+//******************************************************************************
+// JSON-RPC 2.0 batch, one round trip for all requests,
+// returns reply objects in order of requests
+//******************************************************************************
+Array CallRPCBatch(const std::string & rpcuser, const std::string & rpcpasswd,
+                   const std::string & rpcip, const std::string & rpcport,
+                   const std::vector<std::pair<std::string, Array> > & requests)
+{
+    if (requests.empty())
+    {
+        return Array();
+    }
+
+    Array batch;
+    bool fReadOnly = true;
+    for (std::size_t i = 0; i < requests.size(); ++i)
+    {
+        fReadOnly = fReadOnly && isReadOnlyMethod(requests[i].first);
+
+        Object request;
+        request.push_back(Pair("jsonrpc", "2.0"));
+        request.push_back(Pair("method", requests[i].first));
+        request.push_back(Pair("params", requests[i].second));
+        request.push_back(Pair("id", static_cast<int>(i)));
+        batch.push_back(request);
+    }
+
+    string strRequest = write_string(Value(batch), false) + "\n";
+
+    if(fDebug)
+        LOG() << "HTTP: req  batch of " << requests.size() << " " << strRequest;
+
+    string strReply = sendRequest(rpcuser, rpcpasswd, rpcip, rpcport, strRequest, fReadOnly);
+
+    // Parse reply
+    Value valReply;
+    if (!read_string(strReply, valReply))
+        throw runtime_error("couldn't parse reply from server");
+    if (valReply.type() != array_type)
+        throw runtime_error("expected batch reply to be an array");
+
+    // replies can be in any order
+    Object noReply;
+    noReply.push_back(Pair("result", Value()));
+    noReply.push_back(Pair("error", JSONRPCError(RPC_MISC_ERROR, "no reply in batch")));
+
+    Array replies(requests.size(), noReply);
+    for (const Value & item : valReply.get_array())
+    {
+        if (item.type() != obj_type)
+        {
+            continue;
+        }
+
+        const Value & id = find_value(item.get_obj(), "id");
+        if (id.type() != int_type || id.get_int() < 0 ||
+                id.get_int() >= static_cast<int>(requests.size()))
+        {
+            continue;
+        }
+
+        replies[id.get_int()] = item;
+    }
+
+    return replies;
+}
+
 //*****************************************************************************
 //*****************************************************************************
 bool storeDataIntoBlockchain(const std::vector<unsigned char> & dstAddress,
@@ -17,6 +17,50 @@ namespace xbridge
 //******************************************************************************
 namespace rpc
 {
+    //! default count of idle keep-alive connections per wallet (<currency>.RpcConnections)
+    const uint32_t DEFAULT_CONNECTION_POOL_SIZE = 4;
+
+    /**
+     * @brief The ConnectorStats struct - wallet rpc call counters of one wallet (ip:port)
+     */
+    struct ConnectorStats
+    {
+        uint64_t calls;
+        uint64_t errors;
+        uint64_t reconnects;
+        uint64_t totalMicros;
+        uint64_t maxMicros;
+        uint64_t lastMicros;
+        uint32_t idleConnections;
+
+        ConnectorStats()
+            : calls(0)
+            , errors(0)
+            , reconnects(0)
+            , totalMicros(0)
+            , maxMicros(0)
+            , lastMicros(0)
+            , idleConnections(0)
+        {}
+    };
+
+    /**
+     * @brief setConnectionPoolSize - set max count of idle keep-alive connections
+     * to wallet, 0 disables keep-alive
+     * @param rpcip - wallet ip
+     * @param rpcport - wallet port
+     * @param size - max idle connections
+     */
+    void setConnectionPoolSize(const std::string & rpcip, const std::string & rpcport,
+                               const uint32_t size);
+    /**
+     * @brief connectorStats
+     * @param rpcip - wallet ip
+     * @param rpcport - wallet port
+     * @return rpc call counters and latency of the wallet
+     */
+    ConnectorStats connectorStats(const std::string & rpcip, const std::string & rpcport);
+
     // helper fn-s
 /**
      * @brief storeDataIntoBlockchain
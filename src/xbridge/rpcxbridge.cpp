@@ -30,6 +30,7 @@
 #include "xbridgeexchange.h"
 #include "xbridgetransaction.h"
 #include "xbridgetransactiondescr.h"
+#include "bitcoinrpcconnector.h"
 #include "xuiconnector.h"
 #include "rpcserver.h"
 #include "init.h"
@@ -106,6 +107,42 @@ Value dxGetNetworkTokens(const Array & params, bool fHelp)
     return r;
 }
 
+//******************************************************************************
+//******************************************************************************
+Value dxGetConnectorStats(const Array & params, bool fHelp)
+{
+    if (fHelp) {
+
+        throw runtime_error("dxGetConnectorStats\nRpc call counters and latency of the connected wallets.");
+
+    }
+    if (params.size() > 0) {
+
+        return util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
+                               "This function does not accept any parameters");
+
+    }
+
+    Object r;
+
+    for (const xbridge::WalletConnectorPtr & conn : xbridge::App::instance().connectors()) {
+
+        const xbridge::rpc::ConnectorStats stats = xbridge::rpc::connectorStats(conn->m_ip, conn->m_port);
+
+        Object o;
+        o.emplace_back(Pair("calls",           static_cast<int64_t>(stats.calls)));
+        o.emplace_back(Pair("errors",          static_cast<int64_t>(stats.errors)));
+        o.emplace_back(Pair("reconnects",      static_cast<int64_t>(stats.reconnects)));
+        o.emplace_back(Pair("idle_connections", static_cast<int64_t>(stats.idleConnections)));
+        o.emplace_back(Pair("avg_latency_ms",  stats.calls ? static_cast<double>(stats.totalMicros) / stats.calls / 1000 : 0.));
+        o.emplace_back(Pair("max_latency_ms",  static_cast<double>(stats.maxMicros) / 1000));
+        o.emplace_back(Pair("last_latency_ms", static_cast<double>(stats.lastMicros) / 1000));
+        r.emplace_back(Pair(conn->currency, o));
+
+    }
+    return r;
+}
+
 //******************************************************************************
 //******************************************************************************
 
@@ -233,7 +270,7 @@ Value dxGetOrderFills(const Array & params, bool fHelp)
     return arr;
 }
 
-Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
+void dxGetOrderHistory(const json_spirit::Array& params, bool fHelp, JSONWriter& writer)
 {
 
     if (fHelp) {
@@ -241,37 +278,30 @@ Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
         throw runtime_error("dxGetOrderHistory (maker) (taker) (start time) (end time) (granularity) (order_ids, default=false)[optional]\n"
                             "Returns the order history over a specified time interval. [start_time] and [end_time] are \n"
                             "in unix time seconds [granularity] in seconds of supported time interval lengths include: \n"
-                            "60,300,900,3600,21600,86400. [order_ids] is a boolean, defaults to false (not showing ids).");
+                            "60,300,900,3600,21600,86400. [start_time] is rounded down to a multiple of [granularity]. \n"
+                            "[order_ids] is a boolean, defaults to false (not showing ids).");
 
     }
     if (params.size() < 5) {
 
-        return util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
-                               "(maker) (taker) (start time) (end time) (granularity) "
-                               "(order_ids, default=false)[optional]");
-    }
-
-    Array arr;
-    TransactionMap history = xbridge::App::instance().history();
-
-    if(history.empty()) {
-
-        LOG() << "empty history transactions list";
-        return arr;
-
+        writer.Write(util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
+                                     "(maker) (taker) (start time) (end time) (granularity) "
+                                     "(order_ids, default=false)[optional]"));
+        return;
     }
 
     const auto fromCurrency     = params[0].get_str();
     const auto toCurrency       = params[1].get_str();
-    const auto startTimeFrame   = params[2].get_int();
+    auto startTimeFrame         = params[2].get_int();
     auto endTimeFrame           = params[3].get_int();
     const auto granularity      = params[4].get_int();
 
     // Validate start time (no start date less than 2/25/2018)
     if (startTimeFrame < 1519540000) {
 
-        return util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
-                               "Start time too early.");
+        writer.Write(util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
+                                     "Start time too early."));
+        return;
 
     }
 
@@ -283,139 +313,65 @@ Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
         error.emplace_back(Pair("error", "Start/end times are too large."));
         error.emplace_back(Pair("code", xbridge::INVALID_PARAMETERS));
         error.emplace_back(Pair("name",  __FUNCTION__));
-        return error;
+        writer.Write(error);
+        return;
     }
     if (endTimeFrame > currentTime)
         endTimeFrame = (int)currentTime + 1;
 
     // Validate granularity
-    switch (granularity) {
-        case 60:
-        case 300:
-        case 900:
-        case 3600:
-        case 21600:
-        case 86400:
-            break;
-        default:
-            return util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
-                                   "granularity must be one of: 60,300,900,3600,21600,86400");
+    if (!xbridge::OrderHistory::isValidGranularity(granularity)) {
+        writer.Write(util::makeError(xbridge::INVALID_PARAMETERS, __FUNCTION__,
+                                     "granularity must be one of: 60,300,900,3600,21600,86400"));
+        return;
     }
 
     bool isShowTxids = params.size() == 6 ? params[5].get_bool() : false;
 
-    TransactionMap trList;
-    std::vector<xbridge::TransactionDescrPtr> trVector;
-
-    //copy all transactions between startTimeFrame and endTimeFrame
-    std::copy_if(history.begin(), history.end(), std::inserter(trList, trList.end()),
-                 [&startTimeFrame, &endTimeFrame, &toCurrency, &fromCurrency](const TransactionPair &transaction){
-        return  ((transaction.second->created)   <=  bpt::from_time_t(endTimeFrame)) &&
-                ((transaction.second->created)   >=  bpt::from_time_t(startTimeFrame)) &&
-                ((transaction.second->toCurrency == toCurrency && transaction.second->fromCurrency == fromCurrency) || // return requested and inverse trading pairs
-                (transaction.second->toCurrency  == fromCurrency && transaction.second->fromCurrency == toCurrency)) &&
-                (transaction.second->state       == xbridge::TransactionDescr::trFinished);
-    });
+    // stored candles are aligned to the granularity
+    startTimeFrame -= startTimeFrame % granularity;
 
-    if(trList.empty()) {
+    const std::vector<xbridge::Candle> candles =
+            xbridge::App::instance().orderHistory(fromCurrency, toCurrency, granularity,
+                                                  startTimeFrame, endTimeFrame);
 
-        LOG() << "No orders for the specified period " << __FUNCTION__;
-        return  arr;
+    writer.BeginArray();
 
-    }
+    if(candles.empty()) {
 
-    //copy values into vector
-    for (const auto &trEntry : trList) {
-        const auto &tr = trEntry.second;
-        trVector.push_back(tr);
-    }
+        LOG() << "No orders for the specified period " << __FUNCTION__;
+        writer.EndArray();
+        return;
 
-    // Sort ascending by updated time
-    std::sort(trVector.begin(), trVector.end(),
-              [](const xbridge::TransactionDescrPtr &a, const xbridge::TransactionDescrPtr &b)
-    {
-         return (a->txtime) < (b->txtime);
-    });
+    }
 
-    // Setup intervals. Each time period (interval) has a high,low,open,close,volume. This code is
-    // responsible for calculating the results for each interval.
-    int jstart = 0;
+    // Setup intervals. Each time period (interval) has a high,low,open,close,volume,
+    // intervals without stored candle have no orders.
+    auto candle = candles.begin();
     for (int timeInterval = startTimeFrame; timeInterval < endTimeFrame; timeInterval += granularity) {
         Array interval;
 
-        double volume = 0; // store total volume for interval
-        xbridge::TransactionDescrPtr open = nullptr; // open order
-        xbridge::TransactionDescrPtr close = nullptr; // close order
-        xbridge::TransactionDescrPtr high = nullptr; // high order
-        xbridge::TransactionDescrPtr low = nullptr; // low order
-        bool orderFound = false;
-        Array orderIds;
-
-        // start searching from point of last checked order (since orders are only processed once)
-        for (int j = jstart; j < (int)trVector.size(); j++) {
-            const auto &tr = trVector[j];
-            auto t = (int)(util::timeToInt(tr->txtime)/1000/1000); // need seconds, timeToInt is in microseconds
-            // only check orders within boundaries (time interval)
-            if (t >= timeInterval && t < timeInterval + granularity) {
-                // Record if order found
-                orderFound = true;
-                // open is always first order
-                if (open == nullptr)
-                    open = tr;
-                // defaults
-                if (high == nullptr)
-                    high = tr;
-                if (low == nullptr)
-                    low = tr;
-                // close is always last order
-                close = tr;
-
-                // volume is based in "to amount" (track volume of what we're priced in, in this case orders are priced in "to amount")
-                volume += fromCurrency == tr->fromCurrency ? util::xBridgeValueFromAmount(tr->fromAmount) :
-                          util::xBridgeValueFromAmount(tr->toAmount);
-
-                // calc prices, algo: to/from = price (in terms of to). e.g. LTC-SYS price = SYS-size / LTC-size = SYS per unit priced in LTC
-                double high_price    = fromCurrency == high->fromCurrency ? util::price(high) : util::priceBid(high);
-                double low_price     = fromCurrency == low->fromCurrency  ? util::price(low)  : util::priceBid(low);
-                double current_price = fromCurrency == tr->fromCurrency   ? util::price(tr)   : util::priceBid(tr);
-
-                // record highest if current price larger than highest price
-                if (current_price > high_price)
-                    high = tr;
-                // record lowest if current price is lower than lowest price
-                if (current_price < low_price)
-                    low = tr;
-
-                // store order id if necessary
-                if (isShowTxids)
-                    orderIds.emplace_back(tr->id.GetHex());
-
-                jstart = j; // want to skip already searched orders
-            }
-        }
+        // format: [ time, low, high, open, close, volume ]
+        interval.emplace_back(util::iso8601(boost::posix_time::from_time_t(timeInterval + granularity)));
 
         // Process if at least 1 order is found
-        if (orderFound) {
-            // latest prices
-            double open_price  = fromCurrency == open->fromCurrency  ? util::price(open)  : util::priceBid(open);
-            double close_price = fromCurrency == close->fromCurrency ? util::price(close) : util::priceBid(close);
-            double high_price  = fromCurrency == high->fromCurrency  ? util::price(high)  : util::priceBid(high);
-            double low_price   = fromCurrency == low->fromCurrency   ? util::price(low)   : util::priceBid(low);
-
-            // format: [ time, low, high, open, close, volume ]
-            interval.emplace_back(util::iso8601(boost::posix_time::from_time_t(timeInterval + granularity)));
-            interval.emplace_back(low_price);
-            interval.emplace_back(high_price);
-            interval.emplace_back(open_price);
-            interval.emplace_back(close_price);
-            interval.emplace_back(volume);
-
-            if (isShowTxids)
+        if (candle != candles.end() && static_cast<int>(candle->time) == timeInterval) {
+            interval.emplace_back(candle->low);
+            interval.emplace_back(candle->high);
+            interval.emplace_back(candle->open);
+            interval.emplace_back(candle->close);
+            interval.emplace_back(candle->volume);
+
+            if (isShowTxids) {
+                Array orderIds;
+                for (const uint256 & id : candle->orderIds)
+                    orderIds.emplace_back(id.GetHex());
                 interval.emplace_back(orderIds);
+            }
+
+            ++candle;
 
         } else { // if no orders for time interval, return empty data
-            // format: [ time, low, high, open, close, volume ]
-            interval.emplace_back(util::iso8601(boost::posix_time::from_time_t(timeInterval + granularity)));
             interval.emplace_back(0);
             interval.emplace_back(0);
             interval.emplace_back(0);
@@ -425,10 +381,17 @@ Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
                 interval.emplace_back(Array());
         }
 
-        arr.emplace_back(interval);
+        writer.Write(interval);
     }
 
-    return arr;
+    writer.EndArray();
+}
+
+Value dxGetOrderHistory(const json_spirit::Array& params, bool fHelp)
+{
+    JSONValueWriter writer;
+    dxGetOrderHistory(params, fHelp, writer);
+    return writer.GetValue();
 }
 
 //*****************************************************************************
@@ -907,7 +870,6 @@ Value dxGetOrderBook(const json_spirit::Array& params, bool fHelp)
     }
 
     Object res;
-    TransactionMap trList = xbridge::App::instance().transactions();
     {
         /**
          * @brief detaiLevel - Get a list of open orders for a product.
@@ -943,186 +905,42 @@ Value dxGetOrderBook(const json_spirit::Array& params, bool fHelp)
          */
         Array asks;
 
-        if(trList.empty())
-        {
-            LOG() << "empty transactions list";
-            res.emplace_back(Pair("asks", asks));
-            res.emplace_back(Pair("bids", bids));
-            return res;
-        }
-
-        TransactionMap asksList;
-        TransactionMap bidsList;
-
-        //copy all transactions in currencies specified in the parameters
-
-        // ask orders are based in the first token in the trading pair
-        std::copy_if(trList.begin(), trList.end(), std::inserter(asksList, asksList.end()),
-                     [&toCurrency, &fromCurrency](const TransactionPair &transaction)
-        {
-            if(transaction.second == nullptr)
-                return false;
-            if (transaction.second->fromAmount <= 0 || transaction.second->toAmount <= 0)
-                return false;
-            if (transaction.second->state != xbridge::TransactionDescr::trPending)
-                return false;
-
-            return  ((transaction.second->toCurrency == toCurrency) &&
-                    (transaction.second->fromCurrency == fromCurrency));
-        });
-
-        // bid orders are based in the second token in the trading pair (inverse of asks)
-        std::copy_if(trList.begin(), trList.end(), std::inserter(bidsList, bidsList.end()),
-                     [&toCurrency, &fromCurrency](const TransactionPair &transaction)
-        {
-            if(transaction.second == nullptr)
-                return false;
-            if (transaction.second->fromAmount <= 0 || transaction.second->toAmount <= 0)
-                return false;
-            if (transaction.second->state != xbridge::TransactionDescr::trPending)
-                return false;
-
-            return  ((transaction.second->toCurrency == fromCurrency) &&
-                    (transaction.second->fromCurrency == toCurrency));
-        });
-
-        std::vector<xbridge::TransactionDescrPtr> asksVector;
-        std::vector<xbridge::TransactionDescrPtr> bidsVector;
-
-        for (const auto &trEntry : asksList)
-            asksVector.emplace_back(trEntry.second);
+        xbridge::App & xapp = xbridge::App::instance();
 
-        for (const auto &trEntry : bidsList)
-            bidsVector.emplace_back(trEntry.second);
+        // only the top of the book is needed for the best bid and ask
+        const std::size_t depth = (detailLevel == 1 || detailLevel == 4) ? 1 : maxOrders;
 
-        // sort asks descending
-        std::sort(asksVector.begin(), asksVector.end(),
-                  [](const xbridge::TransactionDescrPtr &a, const xbridge::TransactionDescrPtr &b)
-        {
-            const auto priceA = util::price(a);
-            const auto priceB = util::price(b);
-            return priceA > priceB;
-        });
-
-        //sort bids descending
-        std::sort(bidsVector.begin(), bidsVector.end(),
-                  [](const xbridge::TransactionDescrPtr &a, const xbridge::TransactionDescrPtr &b)
-        {
-            const auto priceA = util::priceBid(a);
-            const auto priceB = util::priceBid(b);
-            return priceA > priceB;
-        });
+        // ask orders are based in the first token in the trading pair,
+        // the best (lowest) ask first, levels 2 and 3 list asks descending
+        const xbridge::PriceLevels asksLevels =
+                xapp.orderBookLevels(fromCurrency, toCurrency, depth, detailLevel == 1 || detailLevel == 4);
 
-        // floating point comparisons
-        // see Knuth 4.2.2 Eq 36
-        auto floatCompare = [](const double a, const double b) -> bool
-        {
-            const auto epsilon = std::numeric_limits<double>::epsilon();
-            return (fabs(a - b) / fabs(a) <= epsilon) && (fabs(a - b) / fabs(b) <= epsilon);
-        };
+        // bid orders are based in the second token in the trading pair (inverse of asks),
+        // lowest ask price of the inverse pair is the highest bid price
+        const xbridge::PriceLevels bidsLevels =
+                xapp.orderBookLevels(toCurrency, fromCurrency, depth, true);
 
         switch (detailLevel)
         {
         case 1:
         {
             //return only the best bid and ask
-            if (!bidsList.empty()) {
-                const auto bidsItem = std::max_element(bidsList.begin(), bidsList.end(),
-                                       [](const TransactionPair &a, const TransactionPair &b)
-                {
-                    //find transaction with best bids
-                    const auto &tr1 = a.second;
-                    const auto &tr2 = b.second;
-
-                    if(tr1 == nullptr)
-                        return true;
-
-                    if(tr2 == nullptr)
-                        return false;
-
-                    const auto priceA = util::priceBid(tr1);
-                    const auto priceB = util::priceBid(tr2);
-
-                    return priceA < priceB;
-                });
-
-                const auto bidsCount = std::count_if(bidsList.begin(), bidsList.end(),
-                                                     [bidsItem, floatCompare](const TransactionPair &a)
-                {
-                    const auto &tr = a.second;
-
-                    if(tr == nullptr)
-                        return false;
-
-                    const auto price = util::priceBid(tr);
-
-                    const auto &bestTr = bidsItem->second;
-                    if (bestTr != nullptr)
-                    {
-                        const auto bestBidPrice = util::priceBid(bestTr);
-                        return floatCompare(price, bestBidPrice);
-                    }
-
-                    return false;
-                });
-
-                const auto &tr = bidsItem->second;
-                if (tr != nullptr)
-                {
-                    const auto bidPrice = util::priceBid(tr);
-                    bids.emplace_back(Array{util::xBridgeStringValueFromPrice(bidPrice),
-                                            util::xBridgeStringValueFromAmount(tr->toAmount),
-                                            static_cast<int64_t>(bidsCount)});
-                }
+            if (!bidsLevels.empty())
+            {
+                const xbridge::PriceLevel & level = bidsLevels.front();
+                const auto &tr = level.front();
+                bids.emplace_back(Array{util::xBridgeStringValueFromPrice(util::priceBid(tr)),
+                                        util::xBridgeStringValueFromAmount(tr->toAmount),
+                                        static_cast<int64_t>(level.size())});
             }
 
-            if (!asksList.empty()) {
-                const auto asksItem = std::min_element(asksList.begin(), asksList.end(),
-                                                   [](const TransactionPair &a, const TransactionPair &b)
-                {
-                    //find transactions with best asks
-                    const auto &tr1 = a.second;
-                    const auto &tr2 = b.second;
-
-                    if(tr1 == nullptr)
-                        return true;
-
-                    if(tr2 == nullptr)
-                        return false;
-
-                    const auto priceA = util::price(tr1);
-                    const auto priceB = util::price(tr2);
-                    return priceA < priceB;
-                });
-
-                const auto asksCount = std::count_if(asksList.begin(), asksList.end(),
-                                                     [asksItem, floatCompare](const TransactionPair &a)
-                {
-                    const auto &tr = a.second;
-
-                    if(tr == nullptr)
-                        return false;
-
-                    const auto price = util::price(tr);
-
-                    const auto &bestTr = asksItem->second;
-                    if (bestTr != nullptr)
-                    {
-                        const auto bestAskPrice = util::price(bestTr);
-                        return floatCompare(price, bestAskPrice);
-                    }
-
-                    return false;
-                });
-
-                const auto &tr = asksItem->second;
-                if (tr != nullptr)
-                {
-                    const auto askPrice = util::price(tr);
-                    asks.emplace_back(Array{util::xBridgeStringValueFromPrice(askPrice),
-                                            util::xBridgeStringValueFromAmount(tr->fromAmount),
-                                            static_cast<int64_t>(asksCount)});
-                }
+            if (!asksLevels.empty())
+            {
+                const xbridge::PriceLevel & level = asksLevels.front();
+                const auto &tr = level.front();
+                asks.emplace_back(Array{util::xBridgeStringValueFromPrice(util::price(tr)),
+                                        util::xBridgeStringValueFromAmount(tr->fromAmount),
+                                        static_cast<int64_t>(level.size())});
             }
 
             res.emplace_back(Pair("asks", asks));
@@ -1132,72 +950,32 @@ Value dxGetOrderBook(const json_spirit::Array& params, bool fHelp)
         case 2:
         {
             //Top X bids and asks (aggregated)
-
-            /**
-             * @brief bound - calculate upper bound
-             */
-            auto bound = std::min(maxOrders, bidsVector.size());
-
-            for (size_t i = 0; i < bound; i++)
+            for (const xbridge::PriceLevel & level : bidsLevels)
             {
-                if(bidsVector[i] == nullptr)
-                    continue;
-
-                Array bid;
-                //calculate bids and push to array
-                const auto bidAmount    = bidsVector[i]->toAmount;
-                const auto bidPrice     = util::priceBid(bidsVector[i]);
-                const auto bidSize      = util::xBridgeStringValueFromAmount(bidAmount);
-                const auto bidsCount    = std::count_if(bidsList.begin(), bidsList.end(),
-                                                     [bidPrice, floatCompare](const TransactionPair &a)
+                for (const auto &tr : level)
                 {
-                    const auto &tr = a.second;
-
-                    if(tr == nullptr)
-                        return false;
-
-                    const auto price = util::priceBid(tr);
+                    if (bids.size() >= maxOrders)
+                        break;
 
-                    return floatCompare(price, bidPrice);
-                });
-
-                bid.emplace_back(util::xBridgeStringValueFromPrice(bidPrice));
-                bid.emplace_back(bidSize);
-                bid.emplace_back((int64_t)bidsCount);
-
-                bids.emplace_back(bid);
+                    //calculate bids and push to array
+                    bids.emplace_back(Array{util::xBridgeStringValueFromPrice(util::priceBid(tr)),
+                                            util::xBridgeStringValueFromAmount(tr->toAmount),
+                                            static_cast<int64_t>(level.size())});
+                }
             }
 
-            bound = std::min(maxOrders, asksVector.size());
-
-            for (size_t i = 0; i < bound; i++)
+            for (const xbridge::PriceLevel & level : asksLevels)
             {
-                if(asksVector[i] == nullptr)
-                    continue;
-
-                Array ask;
-                //calculate asks and push to array
-                const auto bidAmount    = asksVector[i]->fromAmount;
-                const auto askPrice     = util::price(asksVector[i]);
-                const auto bidSize      = util::xBridgeStringValueFromAmount(bidAmount);
-                const auto asksCount    = std::count_if(asksList.begin(), asksList.end(),
-                                                     [askPrice, floatCompare](const TransactionPair &a)
+                for (const auto &tr : level)
                 {
-                    const auto &tr = a.second;
+                    if (asks.size() >= maxOrders)
+                        break;
 
-                    if(tr == nullptr)
-                        return false;
-
-                    const auto price = util::price(tr);
-
-                    return floatCompare(price, askPrice);
-                });
-
-                ask.emplace_back(util::xBridgeStringValueFromPrice(askPrice));
-                ask.emplace_back(bidSize);
-                ask.emplace_back(static_cast<int64_t>(asksCount));
-
-                asks.emplace_back(ask);
+                    //calculate asks and push to array
+                    asks.emplace_back(Array{util::xBridgeStringValueFromPrice(util::price(tr)),
+                                            util::xBridgeStringValueFromAmount(tr->fromAmount),
+                                            static_cast<int64_t>(level.size())});
+                }
             }
 
             res.emplace_back(Pair("asks", asks));
@@ -1207,38 +985,30 @@ Value dxGetOrderBook(const json_spirit::Array& params, bool fHelp)
         case 3:
         {
             //Full order book (non aggregated)
-            auto bound = std::min(maxOrders, bidsVector.size());
-
-            for (size_t i = 0; i < bound; i++)
+            for (const xbridge::PriceLevel & level : bidsLevels)
             {
-                if(bidsVector[i] == nullptr)
-                    continue;
-
-                Array bid;
-                const auto bidAmount   = bidsVector[i]->toAmount;
-                const auto bidPrice    = util::priceBid(bidsVector[i]);
-                bid.emplace_back(util::xBridgeStringValueFromPrice(bidPrice));
-                bid.emplace_back(util::xBridgeStringValueFromAmount(bidAmount));
-                bid.emplace_back(bidsVector[i]->id.GetHex());
+                for (const auto &tr : level)
+                {
+                    if (bids.size() >= maxOrders)
+                        break;
 
-                bids.emplace_back(bid);
+                    bids.emplace_back(Array{util::xBridgeStringValueFromPrice(util::priceBid(tr)),
+                                            util::xBridgeStringValueFromAmount(tr->toAmount),
+                                            tr->id.GetHex()});
+                }
             }
 
-            bound = std::min(maxOrders, asksVector.size());
-
-            for (size_t i = 0; i < bound; i++)
+            for (const xbridge::PriceLevel & level : asksLevels)
             {
-                if(asksVector[i] == nullptr)
-                    continue;
-
-                Array ask;
-                const auto bidAmount    = asksVector[i]->fromAmount;
-                const auto askPrice     = util::price(asksVector[i]);
-                ask.emplace_back(util::xBridgeStringValueFromPrice(askPrice));
-                ask.emplace_back(util::xBridgeStringValueFromAmount(bidAmount));
-                ask.emplace_back(asksVector[i]->id.GetHex());
+                for (const auto &tr : level)
+                {
+                    if (asks.size() >= maxOrders)
+                        break;
 
-                asks.emplace_back(ask);
+                    asks.emplace_back(Array{util::xBridgeStringValueFromPrice(util::price(tr)),
+                                            util::xBridgeStringValueFromAmount(tr->fromAmount),
+                                            tr->id.GetHex()});
+                }
             }
 
             res.emplace_back(Pair("asks", asks));
@@ -1248,107 +1018,32 @@ Value dxGetOrderBook(const json_spirit::Array& params, bool fHelp)
         case 4:
         {
             //return Only the best bid and ask
-            if (!bidsList.empty()) {
-                const auto bidsItem = std::max_element(bidsList.begin(), bidsList.end(),
-                                           [](const TransactionPair &a, const TransactionPair &b)
-                {
-                    //find transaction with best bids
-                    const auto &tr1 = a.second;
-                    const auto &tr2 = b.second;
-
-                    if(tr1 == nullptr)
-                        return true;
-
-                    if(tr2 == nullptr)
-                        return false;
-
-                    const auto priceA = util::priceBid(tr1);
-                    const auto priceB = util::priceBid(tr2);
-
-                    return priceA < priceB;
-                });
-
-                const auto &tr = bidsItem->second;
-                if (tr != nullptr)
-                {
-                    const auto bidPrice = util::priceBid(tr);
-                    bids.emplace_back(util::xBridgeStringValueFromPrice(bidPrice));
-                    bids.emplace_back(util::xBridgeStringValueFromAmount(tr->toAmount));
-
-                    Array bidsIds;
-                    bidsIds.emplace_back(tr->id.GetHex());
-
-                    for(const TransactionPair &tp : bidsList)
-                    {
-                        const auto &otherTr = tp.second;
-
-                        if(otherTr == nullptr)
-                            continue;
-
-                        if(tr->id == otherTr->id)
-                            continue;
-
-                        const auto otherTrBidPrice = util::priceBid(otherTr);
-
-                        if(!floatCompare(bidPrice, otherTrBidPrice))
-                            continue;
+            if (!bidsLevels.empty())
+            {
+                const xbridge::PriceLevel & level = bidsLevels.front();
+                const auto &tr = level.front();
+                bids.emplace_back(util::xBridgeStringValueFromPrice(util::priceBid(tr)));
+                bids.emplace_back(util::xBridgeStringValueFromAmount(tr->toAmount));
 
-                        bidsIds.emplace_back(otherTr->id.GetHex());
-                    }
+                Array bidsIds;
+                for (const auto &levelTr : level)
+                    bidsIds.emplace_back(levelTr->id.GetHex());
 
-                    bids.emplace_back(bidsIds);
-                }
+                bids.emplace_back(bidsIds);
             }
 
-            if (!asksList.empty()) {
-                const auto asksItem = std::min_element(asksList.begin(), asksList.end(),
-                                                   [](const TransactionPair &a, const TransactionPair &b)
-                {
-                    //find transactions with best asks
-                    const auto &tr1 = a.second;
-                    const auto &tr2 = b.second;
-
-                    if(tr1 == nullptr)
-                        return true;
-
-                    if(tr2 == nullptr)
-                        return false;
-
-                    const auto priceA = util::price(tr1);
-                    const auto priceB = util::price(tr2);
-                    return priceA < priceB;
-                });
-
-                const auto &tr = asksItem->second;
-                if (tr != nullptr)
-                {
-                    const auto askPrice = util::price(tr);
-                    asks.emplace_back(util::xBridgeStringValueFromPrice(askPrice));
-                    asks.emplace_back(util::xBridgeStringValueFromAmount(tr->fromAmount));
-
-                    Array asksIds;
-                    asksIds.emplace_back(tr->id.GetHex());
-
-                    for(const TransactionPair &tp : asksList)
-                    {
-                        const auto &otherTr = tp.second;
-
-                        if(otherTr == nullptr)
-                            continue;
-
-                        if(tr->id == otherTr->id)
-                            continue;
-
-                        const auto otherTrAskPrice = util::price(otherTr);
-
-                        if(!floatCompare(askPrice, otherTrAskPrice))
-                            continue;
+            if (!asksLevels.empty())
+            {
+                const xbridge::PriceLevel & level = asksLevels.front();
+                const auto &tr = level.front();
+                asks.emplace_back(util::xBridgeStringValueFromPrice(util::price(tr)));
+                asks.emplace_back(util::xBridgeStringValueFromAmount(tr->fromAmount));
 
-                        asksIds.emplace_back(otherTr->id.GetHex());
-                    }
+                Array asksIds;
+                for (const auto &levelTr : level)
+                    asksIds.emplace_back(levelTr->id.GetHex());
 
-                    asks.emplace_back(asksIds);
-                }
+                asks.emplace_back(asksIds);
             }
 
             res.emplace_back(Pair("asks", asks));
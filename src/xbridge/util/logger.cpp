@@ -5,20 +5,34 @@
 #include "settings.h"
 #include "xbridge/xuiconnector.h"
 
+#include "logwriter.h"
 #include "util.h"
 
+#include <atomic>
 #include <string>
 #include <sstream>
-#include <fstream>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/locks.hpp>
+#include <boost/thread/once.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/filesystem.hpp>
 
 boost::mutex logLocker;
 
+namespace
+{
+
+// written by all LOG objects, never destroyed
+CLogWriter * logWriter = nullptr;
+boost::once_flag logWriterInitFlag = BOOST_ONCE_INIT;
+
+// day of the current log file
+std::atomic<long> logDay(0);
+
+} // namespace
+
 //******************************************************************************
 //******************************************************************************
 // static
@@ -41,42 +55,47 @@ LOG::LOG(const char reason)
 // static
 std::string LOG::logFileName()
 {
+    boost::lock_guard<boost::mutex> lock(logLocker);
     return m_logFileName;
 }
 
 //******************************************************************************
 //******************************************************************************
-LOG::~LOG()
+// static
+void LOG::initWriter()
 {
     boost::lock_guard<boost::mutex> lock(logLocker);
+    m_logFileName = makeFileName();
+    logDay = boost::gregorian::day_clock::local_day().day_number();
+    logWriter = new CLogWriter(m_logFileName, GetBoolArg("-logasync", true));
+}
 
-    // const static std::string path     = settings().logPath().size() ? settings().logPath() : settings().appPath();
-    const static bool logToFile       = true; // !path.empty();
-    static boost::gregorian::date day =
-            boost::gregorian::day_clock::local_day();
-    if (m_logFileName.empty())
+//******************************************************************************
+//******************************************************************************
+LOG::~LOG()
+{
+    // errors and warnings are never rate limited
+    if (m_r != 'E' && m_r != 'W' && !LogAcceptRate("xbridge"))
     {
-        m_logFileName    = makeFileName();
+        return;
     }
 
-    // std::cout << str().c_str();
-
     try
     {
-        if (logToFile)
-        {
-            boost::gregorian::date tmpday =
-                    boost::gregorian::day_clock::local_day();
-
-            if (day != tmpday)
-            {
-                m_logFileName = makeFileName();
-                day = tmpday;
-            }
+        boost::call_once(&LOG::initWriter, logWriterInitFlag);
 
-            std::ofstream file(m_logFileName.c_str(), std::ios_base::app);
-            file << str().c_str();
+        // new file every day
+        long day = logDay;
+        const long today = boost::gregorian::day_clock::local_day().day_number();
+        if (day != today && logDay.compare_exchange_strong(day, today))
+        {
+            boost::lock_guard<boost::mutex> lock(logLocker);
+            m_logFileName = makeFileName();
+            logWriter->Reopen(m_logFileName);
         }
+
+        const auto & s = str();
+        logWriter->Write(std::string(s.begin(), s.end()));
     }
     catch (std::exception &)
     {
@@ -32,6 +32,7 @@ public:
 
 private:
     static std::string makeFileName();
+    static void initWriter();
 
 private:
     char m_r;
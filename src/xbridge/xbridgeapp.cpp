@@ -18,10 +18,12 @@
 #include "init.h"
 #include "wallet.h"
 #include "servicenodeman.h"
+#include "main.h"
 #include "xbridgewalletconnector.h"
 #include "xbridgewalletconnectorbtc.h"
 #include "xbridgewalletconnectorbcc.h"
 #include "xbridgewalletconnectorsys.h"
+#include "bitcoinrpcconnector.h"
 
 #include <assert.h>
 
@@ -62,7 +64,22 @@ class App::Impl
 
     enum
     {
-        TIMER_INTERVAL = 15
+        TIMER_INTERVAL = 15,
+
+        // received messages waiting for processing
+        MAX_INGRESS_MESSAGES      = 4096,
+        MAX_PEER_INGRESS_MESSAGES = 256,
+
+        // known messages filters, selected by first byte of hash
+        KNOWN_MESSAGES_SHARDS     = 16,
+        DEFAULT_KNOWN_MESSAGES    = 100000
+    };
+
+    struct IngressMessage
+    {
+        int                        peer;
+        std::vector<unsigned char> id;
+        std::vector<unsigned char> message;
     };
 
 protected:
@@ -99,6 +116,18 @@ protected:
      */
     void onTimer();
 
+    /**
+     * @brief service - rotate services queue
+     * @return next service for posting work
+     */
+    IoServicePtr service();
+
+    /**
+     * @brief processIngress - take message of next peer from ingress queue,
+     * verify and process it
+     */
+    void processIngress();
+
     /**
      * @brief getSession - move session to head of queue
      * @return pointer to head of sessions queue
@@ -141,6 +170,7 @@ protected:
     std::deque<IoServicePtr>                           m_services;
     std::deque<WorkPtr>                                m_works;
     boost::thread_group                                m_threads;
+    boost::mutex                                       m_servicesLock;
 
     // timer
     boost::asio::io_service                            m_timerIo;
@@ -159,10 +189,18 @@ protected:
     ConnectorsAddrMap                                  m_connectorAddressMap;
     ConnectorsCurrencyMap                              m_connectorCurrencyMap;
 
-    // pending messages (packet processing loop)
-    boost::mutex                                       m_messagesLock;
-    typedef std::set<uint256> ProcessedMessages;
-    ProcessedMessages                                  m_processedMessages;
+    // received messages by peer, peers with messages in turn,
+    // peers with a message in processing are out of turn until it is done
+    boost::mutex                                       m_ingressLock;
+    bool                                               m_ingressRunning;
+    std::map<int, std::deque<IngressMessage> >         m_ingress;
+    std::deque<int>                                    m_ingressPeers;
+    std::set<int>                                      m_ingressBusy;
+    std::size_t                                        m_ingressSize;
+
+    // processed messages, last -xbridgeknownmessages remembered
+    boost::mutex                                       m_messagesLock[KNOWN_MESSAGES_SHARDS];
+    std::vector<CRollingBloomFilter>                   m_processedMessages;
 
     // address book
     boost::mutex                                       m_addressBookLock;
@@ -174,6 +212,12 @@ protected:
     std::map<uint256, TransactionDescrPtr>             m_transactions;
     std::map<uint256, TransactionDescrPtr>             m_historicTransactions;
 
+    // pending orders by trading pair and price
+    OrderBook                                          m_orderBook;
+
+    // candles of finished orders
+    OrderHistory                                       m_orderHistory;
+
     // network packets queue
     boost::mutex                                       m_ppLocker;
     std::map<uint256, XBridgePacketPtr>                m_pendingPackets;
@@ -185,7 +229,17 @@ App::Impl::Impl()
     : m_timerIoWork(new boost::asio::io_service::work(m_timerIo))
     , m_timerThread(boost::bind(&boost::asio::io_service::run, &m_timerIo))
     , m_timer(m_timerIo, boost::posix_time::seconds(TIMER_INTERVAL))
+    , m_ingressRunning(false)
+    , m_ingressSize(0)
 {
+    const int64_t known = std::max(GetArg("-xbridgeknownmessages", DEFAULT_KNOWN_MESSAGES),
+                                   static_cast<int64_t>(KNOWN_MESSAGES_SHARDS));
+    for (size_t i = 0; i < KNOWN_MESSAGES_SHARDS; ++i)
+    {
+        m_processedMessages.push_back(CRollingBloomFilter(known / KNOWN_MESSAGES_SHARDS,
+                                                          KnownMessagesFPRate(),
+                                                          GetRand(std::numeric_limits<unsigned int>::max())));
+    }
 
 }
 
@@ -263,6 +317,11 @@ bool App::Impl::start()
             m_threads.create_thread(boost::bind(&boost::asio::io_service::run, ios));
         }
 
+        {
+            boost::mutex::scoped_lock l(m_ingressLock);
+            m_ingressRunning = !m_services.empty();
+        }
+
         m_timer.async_wait(boost::bind(&Impl::onTimer, this));
 
         // sessions
@@ -290,6 +349,7 @@ bool App::Impl::start()
                 wp.method                      = s.get<std::string>(*i + ".CreateTxMethod");
                 wp.blockTime                   = s.get<int>(*i + ".BlockTime", 0);
                 wp.requiredConfirmations       = s.get<int>(*i + ".Confirmations", 0);
+                wp.rpcConnections              = s.get<uint32_t>(*i + ".RpcConnections", rpc::DEFAULT_CONNECTION_POOL_SIZE);
 
                 if (wp.m_ip.empty() || wp.m_port.empty() ||
                     wp.m_user.empty() || wp.m_passwd.empty() ||
@@ -340,6 +400,8 @@ bool App::Impl::start()
                     continue;
                 }
 
+                rpc::setConnectionPoolSize(wp.m_ip, wp.m_port, wp.rpcConnections);
+
                 if (!conn->init())
                 {
                     ERR() << "connection not initialized " << *i << " " << __FUNCTION__;
@@ -373,6 +435,9 @@ bool App::init(int argc, char *argv[])
         LOG() << "Finished loading config" << path;
     }
 
+    // candles of finished orders
+    m_p->m_orderHistory.open(GetDataDir(false) / "xbridgehistory");
+
     // init secp256
     if(!ECC_Start()) {
 
@@ -418,6 +483,15 @@ bool App::Impl::stop()
     m_timerIoWork.reset();
     m_timerThread.join();
 
+    {
+        boost::mutex::scoped_lock l(m_ingressLock);
+        m_ingressRunning = false;
+        m_ingress.clear();
+        m_ingressPeers.clear();
+        m_ingressBusy.clear();
+        m_ingressSize = 0;
+    }
+
 //    for (IoServicePtr & i : m_services)
 //    {
 //        i->stop();
@@ -429,6 +503,8 @@ bool App::Impl::stop()
 
     m_threads.join_all();
 
+    m_orderHistory.close();
+
     // secp stop
     ECC_Stop();
 
@@ -467,12 +543,17 @@ void App::Impl::onSend(const std::vector<unsigned char> & id, const std::vector<
 
     uint256 hash = Hash(msg.begin(), msg.end());
 
+    // serialize once, buffer shared by all nodes
+    CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+    payload << msg;
+    CSerializeDataPtr data = CNode::MakeMessage("xbridge", &payload.begin()[0], payload.size());
+
     LOCK(cs_vNodes);
     for  (CNode * pnode : vNodes)
     {
-        if (pnode->setKnown.insert(hash).second)
+        if (pnode->AddKnownMessage(hash))
         {
-            pnode->PushMessage("xbridge", msg);
+            pnode->PushSharedMessage(data);
         }
     }
 }
@@ -511,10 +592,141 @@ SessionPtr App::Impl::getSession(const std::vector<unsigned char> & address)
     return SessionPtr();
 }
 
+//*****************************************************************************
+//*****************************************************************************
+App::IngressResult App::enqueueMessage(const int peer,
+                                       const std::vector<unsigned char> & id,
+                                       std::vector<unsigned char> && message)
+{
+    {
+        boost::mutex::scoped_lock l(m_p->m_ingressLock);
+
+        if (!m_p->m_ingressRunning)
+        {
+            return ingressNotRunning;
+        }
+
+        std::deque<Impl::IngressMessage> & queue = m_p->m_ingress[peer];
+        if (m_p->m_ingressSize >= Impl::MAX_INGRESS_MESSAGES ||
+                queue.size() >= Impl::MAX_PEER_INGRESS_MESSAGES)
+        {
+            if (queue.empty())
+            {
+                m_p->m_ingress.erase(peer);
+            }
+            return ingressQueueFull;
+        }
+
+        if (queue.empty() && !m_p->m_ingressBusy.count(peer))
+        {
+            m_p->m_ingressPeers.push_back(peer);
+        }
+
+        queue.push_back(Impl::IngressMessage());
+
+        Impl::IngressMessage & item = queue.back();
+        item.peer = peer;
+        item.id   = id;
+        item.message.swap(message);
+
+        ++m_p->m_ingressSize;
+    }
+
+    // one task per message, task takes message of next peer when runs,
+    // so thread blocked by wallet call not holds queued messages
+    m_p->service()->post(boost::bind(&Impl::processIngress, m_p.get()));
+
+    return ingressQueued;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void App::Impl::processIngress()
+{
+    IngressMessage item;
+    {
+        boost::mutex::scoped_lock l(m_ingressLock);
+
+        if (m_ingressPeers.empty())
+        {
+            return;
+        }
+
+        const int peer = m_ingressPeers.front();
+        m_ingressPeers.pop_front();
+
+        std::deque<IngressMessage> & queue = m_ingress[peer];
+        item.peer = queue.front().peer;
+        item.id.swap(queue.front().id);
+        item.message.swap(queue.front().message);
+        queue.pop_front();
+        --m_ingressSize;
+
+        if (queue.empty())
+        {
+            m_ingress.erase(peer);
+        }
+
+        // next message of the peer waits for this one,
+        // sessions expect packets of a peer in order
+        m_ingressBusy.insert(item.peer);
+    }
+
+    static const std::vector<unsigned char> zero(20, 0);
+
+    CValidationState state;
+
+    xbridge::App & app = xbridge::App::instance();
+    if (item.id != zero)
+    {
+        app.onMessageReceived(item.id, std::move(item.message), state);
+    }
+    else
+    {
+        app.onBroadcastReceived(std::move(item.message), state);
+    }
+
+    int dos = 0;
+    if (state.IsInvalid(dos))
+    {
+        LOG() << "invalid xbridge packet from peer " << item.peer
+              << " " << state.GetRejectReason();
+        if (dos > 0)
+        {
+            LOCK(cs_main);
+            Misbehaving(item.peer, dos);
+        }
+    }
+    else if (state.IsError())
+    {
+        LOG() << "xbridge packet from peer " << item.peer
+              << " processed with error " << state.GetRejectReason();
+    }
+
+    // peer back in turn, if more messages were received meanwhile
+    bool requeued = false;
+    {
+        boost::mutex::scoped_lock l(m_ingressLock);
+
+        m_ingressBusy.erase(item.peer);
+        if (m_ingressRunning && m_ingress.count(item.peer))
+        {
+            m_ingressPeers.push_back(item.peer);
+            requeued = true;
+        }
+    }
+
+    // task of the queued message may have run while the peer was busy
+    if (requeued)
+    {
+        service()->post(boost::bind(&Impl::processIngress, this));
+    }
+}
+
 //*****************************************************************************
 //*****************************************************************************
 void App::onMessageReceived(const std::vector<unsigned char> & id,
-                            const std::vector<unsigned char> & message,
+                            std::vector<unsigned char> && message,
                             CValidationState & /*state*/)
 {
     if (isKnownMessage(message))
@@ -531,7 +743,7 @@ void App::onMessageReceived(const std::vector<unsigned char> & id,
     }
 
     XBridgePacketPtr packet(new XBridgePacket);
-    if (!packet->copyFrom(message))
+    if (!packet->copyFrom(std::move(message)))
     {
         LOG() << "incorrect packet received " << __FUNCTION__;
         return;
@@ -573,7 +785,7 @@ void App::onMessageReceived(const std::vector<unsigned char> & id,
 
 //*****************************************************************************
 //*****************************************************************************
-void App::onBroadcastReceived(const std::vector<unsigned char> & message,
+void App::onBroadcastReceived(std::vector<unsigned char> && message,
                                      CValidationState & /*state*/)
 {
     if (isKnownMessage(message))
@@ -591,7 +803,7 @@ void App::onBroadcastReceived(const std::vector<unsigned char> & message,
 
     // process message
     XBridgePacketPtr packet(new XBridgePacket);
-    if (!packet->copyFrom(message))
+    if (!packet->copyFrom(std::move(message)))
     {
         LOG() << "incorrect packet received " << __FUNCTION__;
         return;
@@ -730,17 +942,23 @@ std::vector<WalletConnectorPtr> App::connectors() const
 //*****************************************************************************
 bool App::isKnownMessage(const std::vector<unsigned char> & message)
 {
-    boost::mutex::scoped_lock l(m_p->m_messagesLock);
-    return m_p->m_processedMessages.count(Hash(message.begin(), message.end())) > 0;
+    const uint256 hash = Hash(message.begin(), message.end());
+    const size_t shard = *hash.begin() % Impl::KNOWN_MESSAGES_SHARDS;
+
+    boost::mutex::scoped_lock l(m_p->m_messagesLock[shard]);
+    return m_p->m_processedMessages[shard].contains(hash);
 }
 
 //*****************************************************************************
 //*****************************************************************************
 void App::addToKnown(const std::vector<unsigned char> & message)
 {
+    const uint256 hash = Hash(message.begin(), message.end());
+    const size_t shard = *hash.begin() % Impl::KNOWN_MESSAGES_SHARDS;
+
     // add to known
-    boost::mutex::scoped_lock l(m_p->m_messagesLock);
-    m_p->m_processedMessages.insert(Hash(message.begin(), message.end()));
+    boost::mutex::scoped_lock l(m_p->m_messagesLock[shard]);
+    m_p->m_processedMessages[shard].insert(hash);
 }
 
 //******************************************************************************
@@ -805,6 +1023,8 @@ void App::appendTransaction(const TransactionDescrPtr & ptr)
         // existing, update timestamp
         m_p->m_transactions[ptr->id]->updateTimestamp(*ptr);
     }
+
+    m_p->m_orderBook.update(m_p->m_transactions[ptr->id]);
 }
 
 //******************************************************************************
@@ -828,6 +1048,8 @@ void App::moveTransactionToHistory(const uint256 & id)
             }
         }
 
+        m_p->m_orderBook.remove(id);
+
         if (xtx)
         {
             if(m_p->m_historicTransactions.count(id) != 0) {
@@ -840,6 +1062,11 @@ void App::moveTransactionToHistory(const uint256 & id)
 
     if (xtx)
     {
+        if (xtx->state == TransactionDescr::trFinished)
+        {
+            m_p->m_orderHistory.append(xtx);
+        }
+
         // unlock tx coins
         WalletConnectorPtr conn = connectorByCurrency(xtx->fromCurrency);
         if (conn)
@@ -852,6 +1079,41 @@ void App::moveTransactionToHistory(const uint256 & id)
     removePackets(id);
 }
 
+//******************************************************************************
+//******************************************************************************
+void App::updateOrderBook(const TransactionDescrPtr & ptr)
+{
+    boost::mutex::scoped_lock l(m_p->m_txLocker);
+
+    if (!m_p->m_transactions.count(ptr->id))
+    {
+        return;
+    }
+
+    m_p->m_orderBook.update(ptr);
+}
+
+//******************************************************************************
+//******************************************************************************
+PriceLevels App::orderBookLevels(const std::string & fromCurrency,
+                                 const std::string & toCurrency,
+                                 const std::size_t maxOrders,
+                                 const bool ascending) const
+{
+    return m_p->m_orderBook.levels(fromCurrency, toCurrency, maxOrders, ascending);
+}
+
+//******************************************************************************
+//******************************************************************************
+std::vector<Candle> App::orderHistory(const std::string & fromCurrency,
+                                      const std::string & toCurrency,
+                                      const uint32_t granularity,
+                                      const uint32_t startTime,
+                                      const uint32_t endTime) const
+{
+    return m_p->m_orderHistory.candles(fromCurrency, toCurrency, granularity, startTime, endTime);
+}
+
 //******************************************************************************
 //******************************************************************************
 xbridge::Error App::sendXBridgeTransaction(const std::string & from,
@@ -1012,6 +1274,7 @@ xbridge::Error App::sendXBridgeTransaction(const std::string & from,
     {
         boost::mutex::scoped_lock l(m_p->m_txLocker);
         m_p->m_transactions[id] = ptr;
+        m_p->m_orderBook.update(ptr);
     }
 
     LOG() << "order created" << ptr << __FUNCTION__;
@@ -1261,6 +1524,7 @@ bool App::Impl::sendAcceptingTransaction(const TransactionDescrPtr & ptr)
     onSend(ptr->hubAddress, ptr->packet->body());
 
     ptr->state = TransactionDescr::trAccepting;
+    m_orderBook.update(ptr);
     xuiConnector.NotifyXBridgeTransactionChanged(ptr->id);
 
     return true;
@@ -1473,12 +1737,9 @@ void App::Impl::onTimer()
 {
     // DEBUG_TRACE();
     {
-        m_services.push_back(m_services.front());
-        m_services.pop_front();
-
         xbridge::SessionPtr session = getSession();
 
-        IoServicePtr io = m_services.front();
+        IoServicePtr io = service();
 
         // call check expired transactions
         io->post(boost::bind(&xbridge::Session::checkFinishedTransactions, session));
@@ -1528,4 +1789,16 @@ void App::Impl::onTimer()
     m_timer.async_wait(boost::bind(&Impl::onTimer, this));
 }
 
+//******************************************************************************
+//******************************************************************************
+IoServicePtr App::Impl::service()
+{
+    boost::mutex::scoped_lock l(m_servicesLock);
+
+    m_services.push_back(m_services.front());
+    m_services.pop_front();
+
+    return m_services.front();
+}
+
 } // namespace xbridge
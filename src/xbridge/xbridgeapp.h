@@ -10,6 +10,8 @@
 #include "xbridgetransactiondescr.h"
 #include "util/xbridgeerror.h"
 #include "xbridgewalletconnector.h"
+#include "xbridgeorderbook.h"
+#include "xbridgeorderhistory.h"
 #include "xbridgedef.h"
 #include "validationstate.h"
 
@@ -123,6 +125,41 @@ public:
      */
     void moveTransactionToHistory(const uint256 & id);
 
+    /**
+     * @brief updateOrderBook - reindex order in the order book after state changed
+     * @param ptr - order
+     */
+    void updateOrderBook(const TransactionDescrPtr & ptr);
+    /**
+     * @brief orderBookLevels - pending orders of the (fromCurrency, toCurrency) pair,
+     * grouped by price
+     * @param fromCurrency - maker currency of the orders
+     * @param toCurrency - taker currency of the orders
+     * @param maxOrders - orders limit
+     * @param ascending - true to start from the lowest price, false from the highest
+     * @return price levels, see OrderBook::levels
+     */
+    PriceLevels orderBookLevels(const std::string & fromCurrency,
+                                const std::string & toCurrency,
+                                const std::size_t maxOrders,
+                                const bool ascending) const;
+
+    /**
+     * @brief orderHistory - candles of finished orders of the trading pair,
+     * see OrderHistory::candles
+     * @param fromCurrency - maker currency
+     * @param toCurrency - taker currency
+     * @param granularity - candle length in seconds
+     * @param startTime - first interval start
+     * @param endTime - intervals started before this time
+     * @return candles with at least one order, ascending by time
+     */
+    std::vector<Candle> orderHistory(const std::string & fromCurrency,
+                                     const std::string & toCurrency,
+                                     const uint32_t granularity,
+                                     const uint32_t startTime,
+                                     const uint32_t endTime) const;
+
     /**
      * @brief sendXBridgeTransaction - create new xbridge transaction and send to network
      * @param from - source address
@@ -285,23 +322,46 @@ public:
      */
     void sendPacket(const std::vector<unsigned char> & id, const XBridgePacketPtr & packet);
 
+    /**
+     * @brief The IngressResult enum - result of enqueueMessage
+     */
+    enum IngressResult
+    {
+        ingressQueued,
+        ingressNotRunning,
+        ingressQueueFull
+    };
+
+    /**
+     * @brief enqueueMessage - queue message received from peer for verification
+     * and processing on xbridge threads, messages of different peers are
+     * processed in turn, messages of one peer one by one in order
+     * @param peer - id of sending node
+     * @param id - destination address, zero address for broadcast
+     * @param message - packet, moved to queue
+     * @return ingressQueued, or why the message was dropped
+     */
+    IngressResult enqueueMessage(const int peer,
+                        const std::vector<unsigned char> & id,
+                        std::vector<unsigned char> && message);
+
     // call when message from xbridge network received
     /**
      * @brief onMessageReceived  call when message from xbridge network received
      * @param id packet id
-     * @param message
+     * @param message - packet, moved to XBridgePacket
      * @param state
      */
     void onMessageReceived(const std::vector<unsigned char> & id,
-                           const std::vector<unsigned char> & message,
+                           std::vector<unsigned char> && message,
                            CValidationState & state);
     //
     /**
      * @brief onBroadcastReceived - processing recieved   broadcast message
-     * @param message
+     * @param message - packet, moved to XBridgePacket
      * @param state
      */
-    void onBroadcastReceived(const std::vector<unsigned char> & message,
+    void onBroadcastReceived(std::vector<unsigned char> && message,
                              CValidationState & state);
 
     /**
@@ -0,0 +1,160 @@
+//*****************************************************************************
+//*****************************************************************************
+
+#include "xbridgeorderbook.h"
+#include "xbridgetransactiondescr.h"
+#include "util/xutil.h"
+
+#include <cmath>
+#include <limits>
+
+//*****************************************************************************
+//*****************************************************************************
+namespace xbridge
+{
+
+namespace
+{
+
+//*****************************************************************************
+// floating point comparisons
+// see Knuth 4.2.2 Eq 36
+//*****************************************************************************
+bool samePrice(const double a, const double b)
+{
+    const auto epsilon = std::numeric_limits<double>::epsilon();
+    return (fabs(a - b) / fabs(a) <= epsilon) && (fabs(a - b) / fabs(b) <= epsilon);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+bool isOpen(const TransactionDescrPtr & ptr)
+{
+    return ptr->state == TransactionDescr::trPending &&
+           ptr->fromAmount > 0 && ptr->toAmount > 0;
+}
+
+} // namespace
+
+//*****************************************************************************
+//*****************************************************************************
+void OrderBook::update(const TransactionDescrPtr & ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    boost::mutex::scoped_lock l(m_lock);
+
+    if (!isOpen(ptr))
+    {
+        removeUnlocked(ptr->id);
+        return;
+    }
+
+    if (m_index.count(ptr->id))
+    {
+        // already in book, price not changed
+        return;
+    }
+
+    Entry entry;
+    entry.pair = std::make_pair(ptr->fromCurrency, ptr->toCurrency);
+    entry.it   = m_books[entry.pair].insert(std::make_pair(util::price(ptr), ptr));
+    m_index[ptr->id] = entry;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void OrderBook::remove(const uint256 & id)
+{
+    boost::mutex::scoped_lock l(m_lock);
+    removeUnlocked(id);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void OrderBook::removeUnlocked(const uint256 & id)
+{
+    auto i = m_index.find(id);
+    if (i == m_index.end())
+    {
+        return;
+    }
+
+    auto book = m_books.find(i->second.pair);
+    if (book != m_books.end())
+    {
+        book->second.erase(i->second.it);
+        if (book->second.empty())
+        {
+            m_books.erase(book);
+        }
+    }
+
+    m_index.erase(i);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+PriceLevels OrderBook::levels(const std::string & fromCurrency,
+                              const std::string & toCurrency,
+                              const std::size_t maxOrders,
+                              const bool ascending) const
+{
+    PriceLevels result;
+
+    boost::mutex::scoped_lock l(m_lock);
+
+    auto book = m_books.find(std::make_pair(fromCurrency, toCurrency));
+    if (book == m_books.end())
+    {
+        return result;
+    }
+
+    std::size_t count = 0;
+    double levelPrice = .0;
+
+    auto collect = [&](const Book::value_type & item) -> bool
+    {
+        const TransactionDescrPtr & ptr = item.second;
+        if (!isOpen(ptr))
+        {
+            // state changed and not reindexed yet
+            return true;
+        }
+
+        if (!result.empty() && samePrice(levelPrice, item.first))
+        {
+            result.back().push_back(ptr);
+            ++count;
+            return true;
+        }
+
+        if (count >= maxOrders)
+        {
+            return false;
+        }
+
+        levelPrice = item.first;
+        result.push_back(PriceLevel(1, ptr));
+        ++count;
+        return true;
+    };
+
+    if (ascending)
+    {
+        for (auto i = book->second.begin(); i != book->second.end() && collect(*i); ++i)
+            ;
+    }
+    else
+    {
+        for (auto i = book->second.rbegin(); i != book->second.rend() && collect(*i); ++i)
+            ;
+    }
+
+    return result;
+}
+
+} // namespace xbridge
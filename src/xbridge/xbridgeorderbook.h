@@ -0,0 +1,79 @@
+//*****************************************************************************
+//*****************************************************************************
+
+#ifndef XBRIDGEORDERBOOK_H
+#define XBRIDGEORDERBOOK_H
+
+#include "uint256.h"
+#include "xbridgedef.h"
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+
+//*****************************************************************************
+//*****************************************************************************
+namespace xbridge
+{
+
+/**
+ * @brief PriceLevel - pending orders with the same price
+ */
+typedef std::vector<TransactionDescrPtr> PriceLevel;
+typedef std::vector<PriceLevel>          PriceLevels;
+
+//*****************************************************************************
+//*****************************************************************************
+class OrderBook
+{
+    typedef std::pair<std::string, std::string>            CurrencyPair;
+    typedef std::multimap<double, TransactionDescrPtr>     Book;
+
+    struct Entry
+    {
+        CurrencyPair   pair;
+        Book::iterator it;
+    };
+
+public:
+    /**
+     * @brief update - add pending order to the book of its (from, to) pair,
+     * or remove it if the order is no longer pending
+     * @param ptr - order
+     */
+    void update(const TransactionDescrPtr & ptr);
+    /**
+     * @brief remove - remove order from book
+     * @param id - id of order
+     */
+    void remove(const uint256 & id);
+
+    /**
+     * @brief levels - orders of the (fromCurrency, toCurrency) book grouped by price,
+     * walked from the lowest (ascending) or highest price until maxOrders orders collected,
+     * the last level is always returned complete
+     * @param fromCurrency - maker currency of the orders
+     * @param toCurrency - taker currency of the orders
+     * @param maxOrders - orders limit
+     * @param ascending - walk direction
+     * @return price levels
+     */
+    PriceLevels levels(const std::string & fromCurrency,
+                       const std::string & toCurrency,
+                       const std::size_t maxOrders,
+                       const bool ascending) const;
+
+private:
+    void removeUnlocked(const uint256 & id);
+
+private:
+    mutable boost::mutex             m_lock;
+    std::map<CurrencyPair, Book>     m_books;
+    std::map<uint256, Entry>         m_index;
+};
+
+} // namespace xbridge
+
+#endif // XBRIDGEORDERBOOK_H
@@ -0,0 +1,245 @@
+//*****************************************************************************
+//*****************************************************************************
+
+#include "xbridgeorderhistory.h"
+#include "xbridgetransactiondescr.h"
+#include "util/xutil.h"
+#include "util/logger.h"
+#include "leveldbwrapper.h"
+
+#include <boost/scoped_ptr.hpp>
+
+//*****************************************************************************
+//*****************************************************************************
+namespace xbridge
+{
+
+namespace
+{
+
+// 'c' + ((maker, taker), (granularity, interval start))
+typedef std::pair<std::pair<std::string, std::string>, std::pair<uint32_t, uint32_t> > CandleKey;
+
+const char DB_CANDLE = 'c';
+
+} // namespace
+
+//*****************************************************************************
+//*****************************************************************************
+OrderHistory::OrderHistory()
+{
+}
+
+//*****************************************************************************
+//*****************************************************************************
+OrderHistory::~OrderHistory()
+{
+    close();
+}
+
+//*****************************************************************************
+//*****************************************************************************
+// static
+const std::vector<uint32_t> & OrderHistory::granularities()
+{
+    static const std::vector<uint32_t> values { 60, 300, 900, 3600, 21600, 86400 };
+    return values;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+// static
+bool OrderHistory::isValidGranularity(const int granularity)
+{
+    for (uint32_t g : granularities())
+    {
+        if (static_cast<int>(g) == granularity)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+bool OrderHistory::open(const boost::filesystem::path & path)
+{
+    boost::mutex::scoped_lock l(m_lock);
+
+    m_series.clear();
+    m_orderIds.clear();
+
+    try
+    {
+        m_db.reset(new CLevelDBWrapper(path, 1 << 20));
+
+        boost::scoped_ptr<leveldb::Iterator> pcursor(m_db->NewIterator());
+
+        CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+        ssKeySet << DB_CANDLE;
+        pcursor->Seek(ssKeySet.str());
+
+        for (; pcursor->Valid(); pcursor->Next())
+        {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != DB_CANDLE)
+            {
+                break;
+            }
+
+            CandleKey key;
+            ssKey >> key;
+
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            Candle candle;
+            ssValue >> candle;
+
+            m_series[std::make_pair(key.first, key.second.first)][candle.time] = candle;
+            m_orderIds.insert(candle.orderIds.begin(), candle.orderIds.end());
+        }
+    }
+    catch (std::exception & e)
+    {
+        ERR() << "order history not loaded: " << e.what() << " " << __FUNCTION__;
+        m_db.reset();
+        m_series.clear();
+        m_orderIds.clear();
+        return false;
+    }
+
+    LOG() << "loaded " << m_series.size() << " order history series " << __FUNCTION__;
+
+    return true;
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void OrderHistory::close()
+{
+    boost::mutex::scoped_lock l(m_lock);
+    m_db.reset();
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void OrderHistory::append(const TransactionDescrPtr & ptr)
+{
+    if (!ptr || ptr->fromAmount == 0 || ptr->toAmount == 0)
+    {
+        return;
+    }
+
+    // need seconds, timeToInt is in microseconds
+    const uint32_t txtime = static_cast<uint32_t>(util::timeToInt(ptr->txtime)/1000/1000);
+
+    boost::mutex::scoped_lock l(m_lock);
+
+    // peers may announce a finished order again, e.g. after restart
+    if (!m_orderIds.insert(ptr->id).second)
+    {
+        LOG() << "order " << ptr->id.GetHex() << " already in history " << __FUNCTION__;
+        return;
+    }
+
+    CLevelDBBatch batch;
+
+    for (uint32_t granularity : granularities())
+    {
+        // algo: to/from = price (in terms of to), volume in terms of from
+        appendUnlocked(batch, ptr->fromCurrency, ptr->toCurrency, granularity, txtime,
+                       util::price(ptr), util::xBridgeValueFromAmount(ptr->fromAmount), ptr->id);
+
+        // inverse trading pair
+        appendUnlocked(batch, ptr->toCurrency, ptr->fromCurrency, granularity, txtime,
+                       util::priceBid(ptr), util::xBridgeValueFromAmount(ptr->toAmount), ptr->id);
+    }
+
+    if (m_db)
+    {
+        try
+        {
+            m_db->WriteBatch(batch);
+        }
+        catch (std::exception & e)
+        {
+            ERR() << "order history not saved: " << e.what() << " " << __FUNCTION__;
+        }
+    }
+}
+
+//*****************************************************************************
+//*****************************************************************************
+void OrderHistory::appendUnlocked(CLevelDBBatch & batch,
+                                  const std::string & fromCurrency,
+                                  const std::string & toCurrency,
+                                  const uint32_t granularity,
+                                  const uint32_t txtime,
+                                  const double price,
+                                  const double volume,
+                                  const uint256 & id)
+{
+    const auto pair = std::make_pair(fromCurrency, toCurrency);
+    const uint32_t start = txtime - txtime % granularity;
+
+    Series & series = m_series[std::make_pair(pair, granularity)];
+
+    auto i = series.find(start);
+    if (i == series.end())
+    {
+        Candle candle;
+        candle.time = start;
+        candle.low  = price;
+        candle.high = price;
+        candle.open = price;
+        i = series.insert(std::make_pair(start, candle)).first;
+    }
+
+    Candle & candle = i->second;
+
+    // close is always last order
+    candle.close   = price;
+    candle.volume += volume;
+
+    if (price > candle.high)
+        candle.high = price;
+    if (price < candle.low)
+        candle.low = price;
+
+    candle.orderIds.push_back(id);
+
+    batch.Write(std::make_pair(DB_CANDLE, CandleKey(pair, std::make_pair(granularity, start))), candle);
+}
+
+//*****************************************************************************
+//*****************************************************************************
+std::vector<Candle> OrderHistory::candles(const std::string & fromCurrency,
+                                          const std::string & toCurrency,
+                                          const uint32_t granularity,
+                                          const uint32_t startTime,
+                                          const uint32_t endTime) const
+{
+    std::vector<Candle> result;
+
+    boost::mutex::scoped_lock l(m_lock);
+
+    auto series = m_series.find(std::make_pair(std::make_pair(fromCurrency, toCurrency), granularity));
+    if (series == m_series.end())
+    {
+        return result;
+    }
+
+    auto end = series->second.lower_bound(endTime);
+    for (auto i = series->second.lower_bound(startTime); i != end; ++i)
+    {
+        result.push_back(i->second);
+    }
+
+    return result;
+}
+
+} // namespace xbridge
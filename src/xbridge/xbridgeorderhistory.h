@@ -0,0 +1,147 @@
+//*****************************************************************************
+//*****************************************************************************
+
+#ifndef XBRIDGEORDERHISTORY_H
+#define XBRIDGEORDERHISTORY_H
+
+#include "uint256.h"
+#include "serialize.h"
+#include "xbridgedef.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CLevelDBWrapper;
+class CLevelDBBatch;
+
+//*****************************************************************************
+//*****************************************************************************
+namespace xbridge
+{
+
+//*****************************************************************************
+//*****************************************************************************
+struct Candle
+{
+    // interval start, unix time seconds
+    uint32_t             time;
+
+    double               low;
+    double               high;
+    double               open;
+    double               close;
+    double               volume;
+
+    std::vector<uint256> orderIds;
+
+    Candle()
+        : time(0)
+        , low(0)
+        , high(0)
+        , open(0)
+        , close(0)
+        , volume(0)
+    {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(time);
+        READWRITE(low);
+        READWRITE(high);
+        READWRITE(open);
+        READWRITE(close);
+        READWRITE(volume);
+        READWRITE(orderIds);
+    }
+};
+
+//*****************************************************************************
+//*****************************************************************************
+class OrderHistory
+{
+    // maker, taker, granularity
+    typedef std::pair<std::pair<std::string, std::string>, uint32_t> SeriesKey;
+    typedef std::map<uint32_t, Candle>                              Series;
+
+public:
+    OrderHistory();
+    ~OrderHistory();
+
+    /**
+     * @brief granularities
+     * @return supported candle lengths in seconds
+     */
+    static const std::vector<uint32_t> & granularities();
+    /**
+     * @brief isValidGranularity
+     * @param granularity - candle length in seconds
+     * @return true, if candles of this length are maintained
+     */
+    static bool isValidGranularity(const int granularity);
+
+    /**
+     * @brief open - open candles database and load stored candles
+     * @param path - database directory
+     * @return true, if database opened
+     */
+    bool open(const boost::filesystem::path & path);
+    /**
+     * @brief close - close candles database
+     */
+    void close();
+
+    /**
+     * @brief append - add finished order to the candles of both
+     * (from, to) and (to, from) pairs for all granularities,
+     * orders already in the stored candles are skipped
+     * @param ptr - finished order
+     */
+    void append(const TransactionDescrPtr & ptr);
+
+    /**
+     * @brief candles - stored candles of the pair, prices in terms of toCurrency
+     * per unit of fromCurrency, volume in fromCurrency
+     * @param fromCurrency - maker currency
+     * @param toCurrency - taker currency
+     * @param granularity - candle length in seconds
+     * @param startTime - first interval start
+     * @param endTime - intervals started before this time
+     * @return candles with at least one order, ascending by time
+     */
+    std::vector<Candle> candles(const std::string & fromCurrency,
+                                const std::string & toCurrency,
+                                const uint32_t granularity,
+                                const uint32_t startTime,
+                                const uint32_t endTime) const;
+
+private:
+    void appendUnlocked(CLevelDBBatch & batch,
+                        const std::string & fromCurrency,
+                        const std::string & toCurrency,
+                        const uint32_t granularity,
+                        const uint32_t txtime,
+                        const double price,
+                        const double volume,
+                        const uint256 & id);
+
+private:
+    mutable boost::mutex                m_lock;
+    std::unique_ptr<CLevelDBWrapper>    m_db;
+    std::map<SeriesKey, Series>         m_series;
+    // ids of all orders in m_series, rebuilt from stored candles on open
+    std::set<uint256>                   m_orderIds;
+};
+
+} // namespace xbridge
+
+#endif // XBRIDGEORDERHISTORY_H
@@ -462,6 +462,27 @@ public:
         return true;
     }
 
+    bool copyFrom(std::vector<unsigned char> && data)
+    {
+        if (data.size() < headerSize)
+        {
+            ERR() << "received data size less than packet header size " << __FUNCTION__;
+            return false;
+        }
+
+        // take received buffer without copy
+        m_body.swap(data);
+
+        if (sizeField() != static_cast<uint32_t>(m_body.size())-headerSize)
+        {
+            ERR() << "incorrect data size " << __FUNCTION__;
+            return false;
+        }
+
+        // TODO check packet crc
+        return true;
+    }
+
     XBridgePacket() : m_body(headerSize, 0)
     {
         versionField()   = static_cast<uint32_t>(XBRIDGE_PROTOCOL_VERSION);
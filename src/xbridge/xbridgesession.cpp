@@ -472,28 +472,19 @@ bool Session::Impl::processTransaction(XBridgePacketPtr packet)
             entry.signature = std::vector<unsigned char>(packet->data()+offset, packet->data()+offset+XBridgePacket::signatureSize);
             offset += XBridgePacket::signatureSize;
 
-            if (!sconn->getTxOut(entry))
-            {
-                LOG() << "not found utxo entry <" << entry.txId
-                      << "> no " << entry.vout << " " << __FUNCTION__;
-                continue;
-            }
-
-            // check signature
-            std::string signature = EncodeBase64(&entry.signature[0], entry.signature.size());
-            if (!sconn->verifyMessage(entry.address, entry.toString(), signature))
-            {
-                LOG() << "not valid signature, bad utxo entry" << entry.txId
-                      << "> no " << entry.vout << " " << __FUNCTION__;
-                continue;
-            }
-
-            commonAmount += entry.amount;
-
             utxoItems.push_back(entry);
         }
     }
 
+    // check all utxo items with batch requests to the wallet,
+    // not found or badly signed items are dropped
+    sconn->checkUtxoEntries(utxoItems);
+
+    for (const wallet::UtxoEntry & entry : utxoItems)
+    {
+        commonAmount += entry.amount;
+    }
+
     if (utxoItems.empty())
     {
         LOG() << "transaction rejected, utxo items are empty <" << __FUNCTION__;
@@ -690,6 +681,7 @@ bool Session::Impl::processPendingTransaction(XBridgePacketPtr packet)
         {
             LOG() << "received confirmed order from snode, setting status to pending " << __FUNCTION__;
             ptr->state = TransactionDescr::trPending;
+            xapp.updateOrderBook(ptr);
         }
 
         // update snode addr and pubkey ( ???? )
@@ -846,28 +838,19 @@ bool Session::Impl::processTransactionAccepting(XBridgePacketPtr packet)
                                                          packet->data()+offset+XBridgePacket::signatureSize);
             offset += XBridgePacket::signatureSize;
 
-            if (!conn->getTxOut(entry))
-            {
-                LOG() << "not found utxo entry <" << entry.txId
-                      << "> no " << entry.vout << " " << __FUNCTION__;
-                continue;
-            }
-
-            // check signature
-            std::string signature = EncodeBase64(&entry.signature[0], entry.signature.size());
-            if (!conn->verifyMessage(entry.address, entry.toString(), signature))
-            {
-                LOG() << "not valid signature, bad utxo entry <" << entry.txId
-                      << "> no " << entry.vout << " " << __FUNCTION__;
-                continue;
-            }
-
-            commonAmount += entry.amount;
-
             utxoItems.push_back(entry);
         }
     }
 
+    // check all utxo items with batch requests to the wallet,
+    // not found or badly signed items are dropped
+    conn->checkUtxoEntries(utxoItems);
+
+    for (const wallet::UtxoEntry & entry : utxoItems)
+    {
+        commonAmount += entry.amount;
+    }
+
     if (commonAmount * TransactionDescr::COIN < samount)
     {
         LOG() << "transaction rejected, amount from utxo items <" << commonAmount
@@ -971,7 +954,7 @@ bool Session::Impl::processTransactionHold(XBridgePacketPtr packet)
         pksnode.Set(packet->pubkey(), packet->pubkey()+len);
 
         // check servicenode
-        CServicenode * snode = mnodeman.Find(pksnode);
+        CServicenodePtr snode = mnodeman.Find(pksnode);
         if (!snode)
         {
             // try to uncompress pubkey and search
@@ -1058,6 +1041,7 @@ bool Session::Impl::processTransactionHold(XBridgePacketPtr packet)
     }
 
     xtx->state = TransactionDescr::trHold;
+    xapp.updateOrderBook(xtx);
 
     LOG() << __FUNCTION__ << std::endl << "order holded" << xtx;
 
@@ -1266,7 +1250,7 @@ bool Session::Impl::processTransactionInit(XBridgePacketPtr packet)
     // check servicenode
     std::vector<unsigned char> snodeAddress;
     {
-        CServicenode * snode = mnodeman.Find(pksnode);
+        CServicenodePtr snode = mnodeman.Find(pksnode);
         if (!snode)
         {
             // try to uncompress pubkey and search
@@ -2620,6 +2604,7 @@ bool Session::Impl::sendCancelTransaction(const TransactionDescrPtr & tx,
     // update transaction state for gui
     tx->state  = TransactionDescr::trCancelled;
     tx->reason = reason;
+    App::instance().updateOrderBook(tx);
     xuiConnector.NotifyXBridgeTransactionChanged(tx->id);
 
     return true;
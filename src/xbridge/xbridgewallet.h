@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <cstring>
 
+#include "bitcoinrpcconnector.h"
+
 //*****************************************************************************
 //*****************************************************************************
 namespace xbridge
@@ -54,6 +56,7 @@ public:
         , dustAmount(0)
         , blockTime(0)
         , requiredConfirmations(0)
+        , rpcConnections(rpc::DEFAULT_CONNECTION_POOL_SIZE)
         , serviceNodeFee(.005)
     {
         memset(addrPrefix,   0, sizeof(addrPrefix));
@@ -84,6 +87,7 @@ public:
         method                      = other.method;
         blockTime                   = other.blockTime;
         requiredConfirmations       = other.requiredConfirmations;
+        rpcConnections              = other.rpcConnections;
         // serviceNodeFee = other.serviceNodeFee;
 
         return *this;
@@ -117,6 +121,9 @@ public:
     // required confirmations for tx
     uint32_t                   requiredConfirmations;
 
+    // idle keep-alive rpc connections to wallet, 0 - new connection per call
+    uint32_t                   rpcConnections;
+
     //service node fee, see rpc::storeDataIntoBlockchain
     const double               serviceNodeFee;
 };
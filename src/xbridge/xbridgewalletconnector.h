@@ -51,6 +51,13 @@ public:
                              const bool lock = true) const = 0;
 
     virtual bool getTxOut(wallet::UtxoEntry & entry) = 0;
+    /**
+     * @brief checkUtxoEntries - check that entries are unspent and signed by owner,
+     * uses one batch request for gettxout and one for verifymessage, falls back to
+     * single calls if a batch fails
+     * @param entries - entries to check, on return only valid entries with amounts
+     */
+    virtual void checkUtxoEntries(std::vector<wallet::UtxoEntry> & entries) = 0;
 
     virtual bool sendRawTransaction(const std::string & rawtx,
                                     std::string & txid,
@@ -39,6 +39,10 @@ Object CallRPC(const std::string & rpcuser, const std::string & rpcpasswd,
                const std::string & rpcip, const std::string & rpcport,
                const std::string & strMethod, const Array & params);
 
+Array CallRPCBatch(const std::string & rpcuser, const std::string & rpcpasswd,
+                   const std::string & rpcip, const std::string & rpcport,
+                   const std::vector<std::pair<std::string, Array> > & requests);
+
 //*****************************************************************************
 //*****************************************************************************
 struct WalletInfo
@@ -466,6 +470,72 @@ bool gettxout(const std::string & rpcuser,
     return true;
 }
 
+//*****************************************************************************
+// gettxout for all entries in one batch, amount of not found entries is 0
+//*****************************************************************************
+bool gettxouts(const std::string & rpcuser,
+               const std::string & rpcpasswd,
+               const std::string & rpcip,
+               const std::string & rpcport,
+               std::vector<wallet::UtxoEntry> & txouts,
+               std::vector<bool> & found)
+{
+    found.assign(txouts.size(), false);
+
+    try
+    {
+        LOG() << "rpc call <gettxout> batch of " << txouts.size();
+
+        std::vector<std::pair<std::string, Array> > requests;
+        for (wallet::UtxoEntry & txout : txouts)
+        {
+            txout.amount = 0;
+
+            Array params;
+            params.push_back(txout.txId);
+            params.push_back(static_cast<int>(txout.vout));
+            requests.push_back(std::make_pair(std::string("gettxout"), params));
+        }
+
+        const Array replies = CallRPCBatch(rpcuser, rpcpasswd, rpcip, rpcport, requests);
+
+        for (std::size_t i = 0; i < replies.size(); ++i)
+        {
+            const Object & reply = replies[i].get_obj();
+
+            // Parse reply
+            const Value & result = find_value(reply, "result");
+            const Value & error  = find_value(reply, "error");
+
+            if (error.type() != null_type)
+            {
+                // Error
+                LOG() << "error: " << write_string(error, false);
+                continue;
+            }
+            else if (result.type() != obj_type)
+            {
+                // Result
+                LOG() << "result not an object " <<
+                         (result.type() == null_type ? "" :
+                          result.type() == str_type  ? result.get_str() :
+                                                       write_string(result, true));
+                continue;
+            }
+
+            txouts[i].amount = find_value(result.get_obj(), "value").get_real();
+            found[i] = true;
+        }
+    }
+    catch (std::exception & e)
+    {
+        LOG() << "gettxout exception " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
 //*****************************************************************************
 //*****************************************************************************
 bool getRawTransaction(const std::string & rpcuser,
@@ -1030,6 +1100,66 @@ bool verifyMessage(const std::string & rpcuser, const std::string & rpcpasswd,
     return true;
 }
 
+//*****************************************************************************
+// verifymessage for all (address, message, signature) in one batch
+//*****************************************************************************
+bool verifyMessages(const std::string & rpcuser, const std::string & rpcpasswd,
+                    const std::string & rpcip,   const std::string & rpcport,
+                    const std::vector<std::vector<std::string> > & messages,
+                    std::vector<bool> & valid)
+{
+    valid.assign(messages.size(), false);
+
+    try
+    {
+        LOG() << "rpc call <verifymessage> batch of " << messages.size();
+
+        std::vector<std::pair<std::string, Array> > requests;
+        for (const std::vector<std::string> & m : messages)
+        {
+            // address, signature, message
+            Array params;
+            params.push_back(m[0]);
+            params.push_back(m[2]);
+            params.push_back(m[1]);
+            requests.push_back(std::make_pair(std::string("verifymessage"), params));
+        }
+
+        const Array replies = CallRPCBatch(rpcuser, rpcpasswd, rpcip, rpcport, requests);
+
+        for (std::size_t i = 0; i < replies.size(); ++i)
+        {
+            const Object & reply = replies[i].get_obj();
+
+            // reply
+            const Value & error  = find_value(reply, "error");
+            if (error.type() != null_type)
+            {
+                // Error
+                LOG() << "error: " << write_string(error, false);
+                continue;
+            }
+
+            const Value & result = find_value(reply, "result");
+            if (result.type() != bool_type)
+            {
+                // Result
+                LOG() << "result not an bool " << write_string(result, true);
+                continue;
+            }
+
+            valid[i] = result.get_bool();
+        }
+    }
+    catch (std::exception & e)
+    {
+        LOG() << "verifymessage exception " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
 } // namespace rpc
 
 //*****************************************************************************
@@ -1158,6 +1288,74 @@ bool BtcWalletConnector::getTxOut(wallet::UtxoEntry & entry)
     return true;
 }
 
+//******************************************************************************
+//******************************************************************************
+void BtcWalletConnector::checkUtxoEntries(std::vector<wallet::UtxoEntry> & entries)
+{
+    if (entries.empty())
+    {
+        return;
+    }
+
+    std::vector<bool> found;
+    if (!rpc::gettxouts(m_user, m_passwd, m_ip, m_port, entries, found))
+    {
+        // batch failed, check the entries one by one
+        LOG() << "rpc::gettxouts failed " << __FUNCTION__;
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+            found[i] = getTxOut(entries[i]);
+        }
+    }
+
+    std::vector<wallet::UtxoEntry> unspent;
+    std::vector<std::vector<std::string> > messages;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        const wallet::UtxoEntry & entry = entries[i];
+        if (!found[i])
+        {
+            LOG() << "not found utxo entry <" << entry.txId
+                  << "> no " << entry.vout << " " << __FUNCTION__;
+            continue;
+        }
+
+        // signed message contains amount, verify after gettxout
+        std::vector<std::string> m;
+        m.push_back(entry.address);
+        m.push_back(entry.toString());
+        m.push_back(EncodeBase64(&entry.signature[0], entry.signature.size()));
+        messages.push_back(m);
+
+        unspent.push_back(entry);
+    }
+
+    std::vector<bool> valid;
+    if (!messages.empty() &&
+        !rpc::verifyMessages(m_user, m_passwd, m_ip, m_port, messages, valid))
+    {
+        // batch failed, verify the signatures one by one
+        LOG() << "rpc::verifyMessages failed " << __FUNCTION__;
+        for (std::size_t i = 0; i < messages.size(); ++i)
+        {
+            valid[i] = verifyMessage(messages[i][0], messages[i][1], messages[i][2]);
+        }
+    }
+
+    entries.clear();
+    for (std::size_t i = 0; i < unspent.size(); ++i)
+    {
+        if (!valid[i])
+        {
+            LOG() << "not valid signature, bad utxo entry <" << unspent[i].txId
+                  << "> no " << unspent[i].vout << " " << __FUNCTION__;
+            continue;
+        }
+
+        entries.push_back(unspent[i]);
+    }
+}
+
 //******************************************************************************
 //******************************************************************************
 bool BtcWalletConnector::sendRawTransaction(const std::string & rawtx,
@@ -34,6 +34,7 @@ public:
     bool getNewAddress(std::string & addr);
 
     bool getTxOut(wallet::UtxoEntry & entry);
+    void checkUtxoEntries(std::vector<wallet::UtxoEntry> & entries);
 
     bool sendRawTransaction(const std::string & rawtx,
                             std::string & txid,